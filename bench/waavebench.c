@@ -0,0 +1,1178 @@
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+/*******************************************/
+/* the waave benchmark                     */
+/*                                         */
+/* generate deterministic test media and   */
+/* measure the engine without display nor  */
+/* sound card (SDL dummy drivers)          */
+/* the results are written in json         */
+/*                                         */
+/* !!! build in the source tree, the       */
+/* packet feeder is measured directly !!!  */
+/*******************************************/
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "config_sdl.h"
+#include "config_ffmpeg.h"
+
+#include "WAAVE.h"
+#include "packet_feeder.h"
+#include "slice_scaler.h"
+
+#if !SDL_VERSION_ATLEAST(2,0,0)
+#error "the benchmark need SDL 2.0"
+#endif
+
+
+/* the default parameters */
+#define BENCH_DEFAULT_SECONDS 5
+#define BENCH_MEDIA_SECONDS 10
+#define BENCH_MAX_AUDIO_STREAMS 30
+#define BENCH_MEMORY_STREAMS 4
+#define BENCH_SEEKS 20
+#define BENCH_FIRST_FRAME_LOADS 5
+#define BENCH_SLICES_SRC_WIDTH 1920
+#define BENCH_SLICES_SRC_HEIGHT 1080
+#define BENCH_SLICES_DST_WIDTH 1280
+#define BENCH_SLICES_DST_HEIGHT 720
+
+/* the parameters */
+static const char* mediaDir = "media";
+static const char* outputName = "bench.json";
+static int benchSeconds = BENCH_DEFAULT_SECONDS;
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*           THE TIMERS           */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+static uint64_t getWallTime(void)
+{
+  struct timespec currentTime;
+  clock_gettime(CLOCK_MONOTONIC, &currentTime);
+
+  return (uint64_t)currentTime.tv_sec * 1000000000 + currentTime.tv_nsec;
+}
+
+
+/* the cpu time of all the engine threads */
+static uint64_t getCpuTime(void)
+{
+  struct timespec currentTime;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &currentTime);
+
+  return (uint64_t)currentTime.tv_sec * 1000000000 + currentTime.tv_nsec;
+}
+
+
+/* the resident memory in bytes, 0 if unknown */
+static uint64_t getResidentMemory(void)
+{
+  unsigned long totalPages, residentPages;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if(!statm)
+    return 0;
+
+  if(fscanf(statm, "%lu %lu", &totalPages, &residentPages) != 2)
+    residentPages = 0;
+  fclose(statm);
+
+  return (uint64_t)residentPages * sysconf(_SC_PAGESIZE);
+}
+
+
+/* play the streams during the given time */
+/* the pull streams are presented here */
+static void runStreams(uint64_t durationNs)
+{
+  uint64_t endTime = getWallTime() + durationNs;
+  SDL_Event event;
+
+  while(getWallTime() < endTime){
+    WV_presentDue(WV_getPresentClock());
+    while(SDL_PollEvent(&event));    //the eof events
+    SDL_Delay(1);
+  }
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*        THE TEST MEDIA          */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* the generated files */
+typedef struct BenchMedia{
+
+  const char* name;
+  enum CodecID videoCodec;     //CODEC_ID_NONE for audio only
+  enum PixelFormat pixFormat;
+  int width;
+  int height;
+  int videoBitrate;
+  enum CodecID audioCodec;
+  int audioBitrate;
+
+}BenchMedia;
+
+static BenchMedia benchMedias[] = {
+  {"mpeg4_320x240.avi", CODEC_ID_MPEG4, PIX_FMT_YUV420P, 320, 240, 400000, CODEC_ID_MP2, 128000},
+  {"mpeg4_1280x720.avi", CODEC_ID_MPEG4, PIX_FMT_YUV420P, 1280, 720, 4000000, CODEC_ID_MP2, 192000},
+  {"mpeg1_640x480.avi", CODEC_ID_MPEG1VIDEO, PIX_FMT_YUV420P, 640, 480, 2000000, CODEC_ID_MP2, 128000},
+  {"mjpeg_640x360.avi", CODEC_ID_MJPEG, PIX_FMT_YUVJ420P, 640, 360, 8000000, CODEC_ID_PCM_S16LE, 0},
+  {"audio_mp2.avi", CODEC_ID_NONE, PIX_FMT_NONE, 0, 0, 0, CODEC_ID_MP2, 192000},
+};
+
+#define BENCH_NB_MEDIAS (int)(sizeof(benchMedias)/sizeof(BenchMedia))
+#define BENCH_AUDIO_MEDIA (BENCH_NB_MEDIAS - 1)
+
+#define BENCH_FRAME_RATE 25
+#define BENCH_SAMPLE_RATE 44100
+
+
+static void getMediaPath(BenchMedia* media, char* path, int pathSize)
+{
+  snprintf(path, pathSize, "%s/%s", mediaDir, media->name);
+}
+
+
+/* a moving pattern, the same for each run */
+static void fillVideoFrame(AVFrame* frame, int width, int height, int frameIdx)
+{
+  int x, y;
+
+  for(y=0; y<height; y++)
+    for(x=0; x<width; x++)
+      frame->data[0][y * frame->linesize[0] + x] = (uint8_t)(x + y + frameIdx * 3);
+
+  for(y=0; y<height/2; y++){
+    for(x=0; x<width/2; x++){
+      frame->data[1][y * frame->linesize[1] + x] = (uint8_t)(128 + y + frameIdx * 2);
+      frame->data[2][y * frame->linesize[2] + x] = (uint8_t)(64 + x + frameIdx * 5);
+    }
+  }
+}
+
+
+/* a stereo tone */
+static void fillAudioFrame(int16_t* samples, int nbSamples, int64_t firstSample)
+{
+  int i;
+  int64_t sample;
+
+  for(i=0; i<nbSamples; i++){
+    sample = firstSample + i;
+    samples[2*i] = (int16_t)(((sample * 440 * 65536 / BENCH_SAMPLE_RATE) & 0xFFFF) - 32768) / 4;
+    samples[2*i+1] = (int16_t)(((sample * 660 * 65536 / BENCH_SAMPLE_RATE) & 0xFFFF) - 32768) / 4;
+  }
+}
+
+
+static AVStream* addMediaStream(AVFormatContext* formatCtx, enum CodecID codecId)
+{
+  AVCodec* codec = avcodec_find_encoder(codecId);
+  if(!codec){
+    fprintf(stderr, "no encoder for codec %d\n", codecId);
+    return NULL;
+  }
+
+  AVStream* stream = avformat_new_stream(formatCtx, codec);
+  if(!stream)
+    return NULL;
+
+  if(formatCtx->oformat->flags & AVFMT_GLOBALHEADER)
+    stream->codec->flags |= CODEC_FLAG_GLOBAL_HEADER;
+  stream->codec->flags |= CODEC_FLAG_BITEXACT;
+
+  return stream;
+}
+
+
+static int writeMediaPacket(AVFormatContext* formatCtx, AVStream* stream, AVPacket* pkt)
+{
+  if(pkt->pts != AV_NOPTS_VALUE)
+    pkt->pts = av_rescale_q(pkt->pts, stream->codec->time_base, stream->time_base);
+  if(pkt->dts != AV_NOPTS_VALUE)
+    pkt->dts = av_rescale_q(pkt->dts, stream->codec->time_base, stream->time_base);
+  pkt->stream_index = stream->index;
+
+  return av_interleaved_write_frame(formatCtx, pkt);
+}
+
+
+/* encode a test file with libavformat/libavcodec */
+static int generateMedia(BenchMedia* media, const char* path)
+{
+  AVFormatContext* formatCtx = NULL;
+  AVStream* videoStream = NULL;
+  AVStream* audioStream = NULL;
+  AVFrame* videoFrame = NULL;
+  AVFrame* audioFrame = NULL;
+  int16_t* audioSamples = NULL;
+  int audioFrameSize = 0;
+  AVPacket pkt;
+  int gotPacket;
+  int ret = -1;
+
+  if(avformat_alloc_output_context2(&formatCtx, NULL, NULL, path) < 0)
+    return -1;
+
+  /*******************/
+  /* open the codecs */
+  /*******************/
+  if(media->videoCodec != CODEC_ID_NONE){
+    videoStream = addMediaStream(formatCtx, media->videoCodec);
+    if(!videoStream)
+      goto end;
+
+    AVCodecContext* codec = videoStream->codec;
+    codec->width = media->width;
+    codec->height = media->height;
+    codec->pix_fmt = media->pixFormat;
+    codec->bit_rate = media->videoBitrate;
+    codec->time_base.num = 1;
+    codec->time_base.den = BENCH_FRAME_RATE;
+    codec->gop_size = 12;
+    if(avcodec_open2(codec, codec->codec, NULL) < 0)
+      goto end;
+
+    videoFrame = avcodec_alloc_frame();
+    if(avpicture_alloc((AVPicture*)videoFrame, codec->pix_fmt, codec->width, codec->height) < 0)
+      goto end;
+  }
+
+  audioStream = addMediaStream(formatCtx, media->audioCodec);
+  if(!audioStream)
+    goto end;
+
+  AVCodecContext* audioCodec = audioStream->codec;
+  audioCodec->sample_fmt = AV_SAMPLE_FMT_S16;
+  audioCodec->sample_rate = BENCH_SAMPLE_RATE;
+  audioCodec->channels = 2;
+  audioCodec->channel_layout = AV_CH_LAYOUT_STEREO;
+  audioCodec->bit_rate = media->audioBitrate;
+  audioCodec->time_base.num = 1;
+  audioCodec->time_base.den = BENCH_SAMPLE_RATE;
+  if(avcodec_open2(audioCodec, audioCodec->codec, NULL) < 0)
+    goto end;
+
+  audioFrameSize = audioCodec->frame_size;
+  if(audioFrameSize <= 0)
+    audioFrameSize = 1024;      //pcm
+  audioSamples = (int16_t*)malloc(audioFrameSize * 2 * sizeof(int16_t));
+  audioFrame = avcodec_alloc_frame();
+  if(!audioSamples || !audioFrame)
+    goto end;
+
+  /******************/
+  /* write the file */
+  /******************/
+  if(avio_open(&formatCtx->pb, path, AVIO_FLAG_WRITE) < 0)
+    goto end;
+  if(avformat_write_header(formatCtx, NULL) < 0){
+    avio_close(formatCtx->pb);
+    goto end;
+  }
+
+  int nbFrames = BENCH_MEDIA_SECONDS * BENCH_FRAME_RATE;
+  int64_t nbSamples = (int64_t)BENCH_MEDIA_SECONDS * BENCH_SAMPLE_RATE;
+  int frameIdx = 0;
+  int64_t sampleIdx = 0;
+
+  while((videoStream && frameIdx < nbFrames) || sampleIdx < nbSamples){
+
+    /* interleave by time */
+    int videoFirstFlag = (videoStream && frameIdx < nbFrames &&		\
+			  (sampleIdx >= nbSamples ||			\
+			   (int64_t)frameIdx * BENCH_SAMPLE_RATE <= sampleIdx * BENCH_FRAME_RATE));
+
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+
+    if(videoFirstFlag){
+      fillVideoFrame(videoFrame, media->width, media->height, frameIdx);
+      videoFrame->pts = frameIdx;
+      frameIdx++;
+
+      if(avcodec_encode_video2(videoStream->codec, &pkt, videoFrame, &gotPacket) < 0)
+	goto close;
+      if(gotPacket)
+	writeMediaPacket(formatCtx, videoStream, &pkt);
+    }
+    else{
+      fillAudioFrame(audioSamples, audioFrameSize, sampleIdx);
+      avcodec_get_frame_defaults(audioFrame);
+      audioFrame->nb_samples = audioFrameSize;
+      audioFrame->pts = sampleIdx;
+      avcodec_fill_audio_frame(audioFrame, 2, AV_SAMPLE_FMT_S16, (uint8_t*)audioSamples, \
+			       audioFrameSize * 2 * sizeof(int16_t), 1);
+      sampleIdx += audioFrameSize;
+
+      if(avcodec_encode_audio2(audioCodec, &pkt, audioFrame, &gotPacket) < 0)
+	goto close;
+      if(gotPacket)
+	writeMediaPacket(formatCtx, audioStream, &pkt);
+    }
+  }
+
+  /* the delayed packets */
+  if(videoStream && (videoStream->codec->codec->capabilities & CODEC_CAP_DELAY)){
+    do{
+      av_init_packet(&pkt);
+      pkt.data = NULL;
+      pkt.size = 0;
+      if(avcodec_encode_video2(videoStream->codec, &pkt, NULL, &gotPacket) < 0)
+	break;
+      if(gotPacket)
+	writeMediaPacket(formatCtx, videoStream, &pkt);
+    }while(gotPacket);
+  }
+
+  av_write_trailer(formatCtx);
+  ret = 0;
+
+ close:
+  avio_close(formatCtx->pb);
+
+ end:
+  if(videoStream && videoStream->codec->codec)
+    avcodec_close(videoStream->codec);
+  if(audioStream && audioStream->codec->codec)
+    avcodec_close(audioStream->codec);
+  if(videoFrame){
+    avpicture_free((AVPicture*)videoFrame);
+    av_free(videoFrame);
+  }
+  if(audioFrame)
+    av_free(audioFrame);
+  free(audioSamples);
+  avformat_free_context(formatCtx);
+
+  if(ret < 0)
+    fprintf(stderr, "can't generate %s\n", path);
+
+  return ret;
+}
+
+
+/* generate the missing files */
+static int generateMedias(void)
+{
+  int i;
+  char path[512];
+  struct stat fileStat;
+
+  mkdir(mediaDir, 0755);
+
+  for(i=0; i<BENCH_NB_MEDIAS; i++){
+    getMediaPath(&benchMedias[i], path, sizeof(path));
+    if(stat(path, &fileStat) == 0 && fileStat.st_size > 0)
+      continue;
+
+    printf("generating %s\n", path);
+    if(generateMedia(&benchMedias[i], path) < 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*      THE STREAMING OBJECTS     */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* the measured object types */
+//the sinks are memory objects
+#define BENCH_OBJ_SINK_YUV 0
+#define BENCH_OBJ_SINK_RGB 1
+#define BENCH_OBJ_RENDERER 2
+#define BENCH_NB_OBJ_TYPES 3
+
+static const char* objTypeNames[BENCH_NB_OBJ_TYPES] = {"sink_yuv", "sink_rgb", "renderer"};
+
+
+/* the refreshs are counted by wrapping */
+/* the refreshFrame method of the objects */
+#define BENCH_MAX_COUNTED_OBJS 32
+
+typedef struct CountedObj{
+
+  WVStreamingObject* streamObj;
+  int (*refreshFrame)(WVStreamingObject* streamObj, int slotIdx);
+  uint32_t refreshCount;
+
+}CountedObj;
+
+static CountedObj countedObjs[BENCH_MAX_COUNTED_OBJS];
+static int nbCountedObjs = 0;
+
+
+static CountedObj* findCountedObj(WVStreamingObject* streamObj)
+{
+  int i;
+  for(i=0; i<nbCountedObjs; i++){
+    if(countedObjs[i].streamObj == streamObj)
+      return &countedObjs[i];
+  }
+
+  return NULL;
+}
+
+
+static int countRefreshFrame(WVStreamingObject* streamObj, int slotIdx)
+{
+  CountedObj* countedObj = findCountedObj(streamObj);
+  countedObj->refreshCount++;
+
+  return countedObj->refreshFrame(streamObj, slotIdx);
+}
+
+
+static CountedObj* countRefreshs(WVStreamingObject* streamObj)
+{
+  if(nbCountedObjs >= BENCH_MAX_COUNTED_OBJS)
+    return NULL;
+
+  CountedObj* countedObj = &countedObjs[nbCountedObjs];
+  nbCountedObjs++;
+
+  countedObj->streamObj = streamObj;
+  countedObj->refreshFrame = streamObj->refreshFrame;
+  countedObj->refreshCount = 0;
+  streamObj->refreshFrame = countRefreshFrame;
+
+  return countedObj;
+}
+
+
+/* the display targets */
+static SDL_Window* benchWindow = NULL;
+static SDL_Renderer* benchRenderer = NULL;
+
+
+static WVStreamingObject* getBenchObj(int objType, int width, int height)
+{
+  switch(objType){
+
+  case BENCH_OBJ_SINK_YUV :
+    return WV_getStreamMemoryObj(PIX_FMT_YUV420P, 0, 0, 0, NULL, NULL);
+
+  case BENCH_OBJ_SINK_RGB :
+    return WV_getStreamMemoryObj(PIX_FMT_BGRA, 0, 0, 0, NULL, NULL);
+
+  case BENCH_OBJ_RENDERER :
+    if(!benchRenderer)
+      return NULL;
+    SDL_SetWindowSize(benchWindow, width, height);
+    return WV_getStreamRendererObj(benchRenderer, NULL, 0);
+  }
+
+  return NULL;
+}
+
+
+static void freeBenchObj(int objType, WVStreamingObject* streamObj)
+{
+  /* forget the counter */
+  int i;
+  for(i=0; i<nbCountedObjs; i++){
+    if(countedObjs[i].streamObj == streamObj){
+      nbCountedObjs--;
+      countedObjs[i] = countedObjs[nbCountedObjs];
+      break;
+    }
+  }
+
+  switch(objType){
+
+  case BENCH_OBJ_SINK_YUV :
+  case BENCH_OBJ_SINK_RGB :
+    WV_freeStreamMemoryObj(streamObj);
+    break;
+
+  case BENCH_OBJ_RENDERER :
+    WV_freeStreamRendererObj(streamObj);
+    break;
+  }
+}
+
+
+/* open and load a video stream for the benchmark */
+static WVStream* loadVideoStream(BenchMedia* media, WVStreamingObject* streamObj)
+{
+  char path[512];
+  getMediaPath(media, path, sizeof(path));
+
+  WVStream* stream = WV_getStream(path);
+  if(!stream)
+    return NULL;
+
+  WV_disableAudio(stream);
+  WV_setEOFMethod(stream, WV_LOOPING_STREAM);
+  WV_setPresentMethod(stream, WV_PULL_PRESENT);
+  WV_setStreamingMethod(stream, streamObj);
+
+  if(WV_loadStream(stream) < 0){
+    WV_closeStream(stream);
+    return NULL;
+  }
+
+  return stream;
+}
+
+
+/* wait a new refresh */
+static int waitRefresh(CountedObj* countedObj, uint32_t refreshCount, uint64_t timeoutNs)
+{
+  uint64_t endTime = getWallTime() + timeoutNs;
+
+  while(countedObj->refreshCount == refreshCount){
+    if(getWallTime() > endTime)
+      return -1;
+    WV_presentDue(WV_getPresentClock());
+    SDL_Delay(1);
+  }
+
+  return 0;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*         THE BENCHMARKS         */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+static FILE* output;
+
+
+/* json helpers */
+static void beginSection(const char* name, int firstFlag)
+{
+  fprintf(output, "%s\n  \"%s\": [", firstFlag ? "" : ",", name);
+}
+
+static void beginEntry(int firstFlag)
+{
+  fprintf(output, "%s\n    {", firstFlag ? "" : ",");
+}
+
+static void endSection(void)
+{
+  fprintf(output, "\n  ]");
+}
+
+
+/***************************/
+/* feeder packets/s        */
+/* one pass on each file   */
+/***************************/
+static void benchFeeder(void)
+{
+  int i, q;
+  int firstFlag = 1;
+  char path[512];
+
+  beginSection("feeder", 1);
+
+  for(i=0; i<BENCH_NB_MEDIAS; i++){
+    getMediaPath(&benchMedias[i], path, sizeof(path));
+
+    AVFormatContext* formatCtx = NULL;
+    if(avformat_open_input(&formatCtx, path, NULL, NULL) < 0)
+      continue;
+    if(avformat_find_stream_info(formatCtx, NULL) < 0){
+      avformat_close_input(&formatCtx);
+      continue;
+    }
+
+    /* queue all the streams */
+    WVPacketFeederHandle feederHdl = WV_initPacketFeeder();
+    int nbQueues = formatCtx->nb_streams;
+    WVQueueHandle queues[8];
+    int eofFlags[8];
+
+    if(nbQueues > 8)
+      nbQueues = 8;
+
+    WV_buildFeederContext(feederHdl, formatCtx, nbQueues);
+    for(q=0; q<nbQueues; q++){
+      queues[q] = WV_getStreamQueue(feederHdl, q);
+      eofFlags[q] = 0;
+    }
+
+    /* get the pkts until all the queues reach eof */
+    uint64_t startTime = getWallTime();
+    WV_addFeederContext(feederHdl);
+
+    uint64_t nbPackets = 0;
+    uint64_t nbBytes = 0;
+    int nbEof = 0;
+
+    while(nbEof < nbQueues){
+      for(q=0; q<nbQueues; q++){
+	AVPacket* pkt = WV_packetQueueGet(queues[q], WV_QUEUE_GET_DOESNT_WAIT);
+	if(!pkt)
+	  continue;
+
+	if(pkt->data){
+	  if(!eofFlags[q]){
+	    nbPackets++;
+	    nbBytes += pkt->size;
+	  }
+	  av_free_packet(pkt);
+	}
+	else if(pkt->flags == WV_PACKET_FLAG_EOF && !eofFlags[q]){
+	  eofFlags[q] = 1;
+	  nbEof++;
+	}
+	free(pkt);
+      }
+    }
+
+    uint64_t elapsedTime = getWallTime() - startTime;
+
+    WV_delFeederContext(feederHdl, formatCtx);
+    WV_packetFeederShutdown(feederHdl);
+    avformat_close_input(&formatCtx);
+
+    beginEntry(firstFlag);
+    firstFlag = 0;
+    fprintf(output, "\"file\": \"%s\", \"packets\": %llu, \"bytes\": %llu, \"packets_per_s\": %.1f, \"mbytes_per_s\": %.2f}", \
+	    benchMedias[i].name, (unsigned long long)nbPackets, (unsigned long long)nbBytes, \
+	    nbPackets * 1e9 / elapsedTime, nbBytes * 1e3 / elapsedTime);
+  }
+
+  endSection();
+}
+
+
+/*************************************/
+/* audio decode and mix throughput   */
+/* the cpu time per mixed sample     */
+/*************************************/
+static void benchAudio(void)
+{
+  int i, s;
+  int firstFlag = 1;
+  int nbStreamsList[] = {1, 2, 4, 8, 16, BENCH_MAX_AUDIO_STREAMS};
+  int nbTests = sizeof(nbStreamsList)/sizeof(int);
+  WVStream* streams[BENCH_MAX_AUDIO_STREAMS];
+  char path[512];
+
+  getMediaPath(&benchMedias[BENCH_AUDIO_MEDIA], path, sizeof(path));
+  beginSection("audio", 0);
+
+  for(i=0; i<nbTests; i++){
+    int nbStreams = nbStreamsList[i];
+
+    /* load and play */
+    int nbLoaded = 0;
+    for(s=0; s<nbStreams; s++){
+      streams[s] = WV_getStream(path);
+      if(!streams[s])
+	break;
+      WV_setEOFMethod(streams[s], WV_LOOPING_STREAM);
+      WV_setVolume(streams[s], 1.0 / nbStreams);
+      if(WV_loadStream(streams[s]) < 0){
+	WV_closeStream(streams[s]);
+	break;
+      }
+      nbLoaded++;
+    }
+
+    for(s=0; s<nbLoaded; s++)
+      WV_playStream(streams[s]);
+
+    /* measure */
+    uint64_t startWall = getWallTime();
+    uint64_t startCpu = getCpuTime();
+    runStreams((uint64_t)benchSeconds * 1000000000);
+    uint64_t wallTime = getWallTime() - startWall;
+    uint64_t cpuTime = getCpuTime() - startCpu;
+
+    for(s=0; s<nbLoaded; s++)
+      WV_closeStream(streams[s]);
+
+    /* the dummy driver play in real time */
+    double nbSamples = (double)wallTime * 1e-9 * BENCH_SAMPLE_RATE * 2 * nbLoaded;
+
+    beginEntry(firstFlag);
+    firstFlag = 0;
+    fprintf(output, "\"streams\": %d, \"cpu_ms\": %.1f, \"ns_per_sample\": %.2f}", \
+	    nbLoaded, cpuTime * 1e-6, nbSamples > 0 ? cpuTime / nbSamples : 0.0);
+  }
+
+  endSection();
+}
+
+
+/*****************************************/
+/* video decode and convert fps for each */
+/* streaming object type                 */
+/*****************************************/
+static void benchVideo(void)
+{
+  int i, t;
+  int firstFlag = 1;
+
+  beginSection("video", 0);
+
+  for(i=0; i<BENCH_NB_MEDIAS; i++){
+    BenchMedia* media = &benchMedias[i];
+    if(media->videoCodec == CODEC_ID_NONE)
+      continue;
+
+    for(t=0; t<BENCH_NB_OBJ_TYPES; t++){
+      WVStreamingObject* streamObj = getBenchObj(t, media->width, media->height);
+      if(!streamObj)
+	continue;
+
+      CountedObj* countedObj = countRefreshs(streamObj);
+      WVStream* stream = loadVideoStream(media, streamObj);
+      if(!stream){
+	freeBenchObj(t, streamObj);
+	continue;
+      }
+
+      /* measure */
+      WV_playStream(stream);
+      uint64_t startWall = getWallTime();
+      uint64_t startCpu = getCpuTime();
+      runStreams((uint64_t)benchSeconds * 1000000000);
+      uint64_t wallTime = getWallTime() - startWall;
+      uint64_t cpuTime = getCpuTime() - startCpu;
+
+      uint32_t nbRefreshs = countedObj->refreshCount;
+      uint32_t nbDropped = WV_getDroppedFrames(stream);
+      uint32_t conversionTime = WV_getConversionTime(stream);
+
+      WV_closeStream(stream);
+      freeBenchObj(t, streamObj);
+
+      /* the decoded frames are displayed or dropped */
+      beginEntry(firstFlag);
+      firstFlag = 0;
+      fprintf(output, "\"file\": \"%s\", \"object\": \"%s\", \"fps\": %.2f, \"cpu_fps\": %.2f, \"dropped\": %u, \"conversion_us\": %u}", \
+	      media->name, objTypeNames[t], nbRefreshs * 1e9 / wallTime, \
+	      cpuTime > 0 ? (nbRefreshs + nbDropped) * 1e9 / cpuTime : 0.0, \
+	      nbDropped, conversionTime);
+    }
+  }
+
+  endSection();
+}
+
+
+/****************************/
+/* seek latency             */
+/****************************/
+static void benchSeek(void)
+{
+  int i, s;
+  int firstFlag = 1;
+  uint32_t seed = 12345;    //the same seeks for each run
+
+  beginSection("seek", 0);
+
+  for(i=0; i<BENCH_NB_MEDIAS; i++){
+    BenchMedia* media = &benchMedias[i];
+    if(media->videoCodec == CODEC_ID_NONE)
+      continue;
+
+    WVStreamingObject* streamObj = getBenchObj(BENCH_OBJ_SINK_YUV, media->width, media->height);
+    if(!streamObj)
+      continue;
+    CountedObj* countedObj = countRefreshs(streamObj);
+    WVStream* stream = loadVideoStream(media, streamObj);
+    if(!stream){
+      freeBenchObj(BENCH_OBJ_SINK_YUV, streamObj);
+      continue;
+    }
+
+    WV_playStream(stream);
+    waitRefresh(countedObj, 0, 2000000000);
+
+    /* random seeks */
+    uint32_t duration = WV_getStreamDuration(stream);
+    uint64_t totalLatency = 0;
+    uint32_t maxLatency = 0;
+    int nbSeeks = 0;
+
+    for(s=0; s<BENCH_SEEKS && duration > 0; s++){
+      seed = seed * 1103515245 + 12345;
+      uint32_t target = (seed >> 8) % duration;
+      uint32_t refreshCount = countedObj->refreshCount;
+
+      WV_seekStream(stream, target);
+      if(waitRefresh(countedObj, refreshCount, 2000000000) < 0)
+	continue;
+
+      uint32_t latency = WV_getSeekLatency(stream);
+      totalLatency += latency;
+      if(latency > maxLatency)
+	maxLatency = latency;
+      nbSeeks++;
+    }
+
+    WV_closeStream(stream);
+    freeBenchObj(BENCH_OBJ_SINK_YUV, streamObj);
+
+    beginEntry(firstFlag);
+    firstFlag = 0;
+    fprintf(output, "\"file\": \"%s\", \"seeks\": %d, \"mean_us\": %.1f, \"max_us\": %u}", \
+	    media->name, nbSeeks, nbSeeks ? (double)totalLatency / nbSeeks : 0.0, maxLatency);
+  }
+
+  endSection();
+}
+
+
+/*********************************/
+/* time to first frame           */
+/* open time + first frame time  */
+/*********************************/
+static void benchFirstFrame(void)
+{
+  int i, l;
+  int firstFlag = 1;
+
+  beginSection("first_frame", 0);
+
+  for(i=0; i<BENCH_NB_MEDIAS; i++){
+    BenchMedia* media = &benchMedias[i];
+    if(media->videoCodec == CODEC_ID_NONE)
+      continue;
+
+    uint64_t totalOpen = 0;
+    uint64_t totalFirstFrame = 0;
+    int nbLoads = 0;
+
+    for(l=0; l<BENCH_FIRST_FRAME_LOADS; l++){
+      WVStreamingObject* streamObj = getBenchObj(BENCH_OBJ_SINK_YUV, media->width, media->height);
+      if(!streamObj)
+	break;
+      WVStream* stream = loadVideoStream(media, streamObj);
+      if(!stream){
+	freeBenchObj(BENCH_OBJ_SINK_YUV, streamObj);
+	break;
+      }
+
+      /* wait the first decoded frame */
+      WV_playStream(stream);
+      uint64_t endTime = getWallTime() + 2000000000;
+      while(!WV_getFirstFrameLatency(stream) && getWallTime() < endTime){
+	WV_presentDue(WV_getPresentClock());
+	SDL_Delay(1);
+      }
+
+      if(WV_getFirstFrameLatency(stream)){
+	totalOpen += WV_getStreamOpenTime(stream);
+	totalFirstFrame += WV_getFirstFrameLatency(stream);
+	nbLoads++;
+      }
+
+      WV_closeStream(stream);
+      freeBenchObj(BENCH_OBJ_SINK_YUV, streamObj);
+    }
+
+    if(!nbLoads)
+      continue;
+
+    beginEntry(firstFlag);
+    firstFlag = 0;
+    fprintf(output, "\"file\": \"%s\", \"loads\": %d, \"open_us\": %.1f, \"first_frame_us\": %.1f, \"total_us\": %.1f}", \
+	    media->name, nbLoads, (double)totalOpen / nbLoads, (double)totalFirstFrame / nbLoads, \
+	    (double)(totalOpen + totalFirstFrame) / nbLoads);
+  }
+
+  endSection();
+}
+
+
+/*****************************/
+/* memory per loaded stream  */
+/*****************************/
+static void benchMemory(void)
+{
+  int i, s;
+  int firstFlag = 1;
+  WVStream* streams[BENCH_MEMORY_STREAMS];
+  WVStreamingObject* streamObjs[BENCH_MEMORY_STREAMS];
+
+  beginSection("memory", 0);
+
+  for(i=0; i<BENCH_NB_MEDIAS; i++){
+    BenchMedia* media = &benchMedias[i];
+    if(media->videoCodec == CODEC_ID_NONE)
+      continue;
+
+    /* load the streams and decode their first frames */
+    uint64_t startMemory = getResidentMemory();
+    int nbLoaded = 0;
+
+    for(s=0; s<BENCH_MEMORY_STREAMS; s++){
+      streamObjs[s] = getBenchObj(BENCH_OBJ_SINK_YUV, media->width, media->height);
+      if(!streamObjs[s])
+	break;
+      streams[s] = loadVideoStream(media, streamObjs[s]);
+      if(!streams[s]){
+	freeBenchObj(BENCH_OBJ_SINK_YUV, streamObjs[s]);
+	break;
+      }
+      WV_playStream(streams[s]);
+      nbLoaded++;
+    }
+    runStreams(1000000000);
+
+    uint64_t loadedMemory = getResidentMemory();
+
+    for(s=0; s<nbLoaded; s++){
+      WV_closeStream(streams[s]);
+      freeBenchObj(BENCH_OBJ_SINK_YUV, streamObjs[s]);
+    }
+
+    if(!nbLoaded || !startMemory)
+      continue;
+
+    beginEntry(firstFlag);
+    firstFlag = 0;
+    fprintf(output, "\"file\": \"%s\", \"streams\": %d, \"bytes_per_stream\": %lld}", \
+	    media->name, nbLoaded, ((long long)loadedMemory - (long long)startMemory) / nbLoaded);
+  }
+
+  endSection();
+}
+
+
+
+/**********************************************/
+/* sliced YUV420P to RGB32 downscale, fps and */
+/* check against the entire frame conversion  */
+/**********************************************/
+static void benchSlices(void)
+{
+  int n;
+  int firstFlag = 1;
+
+  beginSection("slices", 0);
+
+  AVFrame* srcFrame = avcodec_alloc_frame();
+  AVPicture dstPicture;
+  WVSliceScalerHandle scaler = WV_getSliceScaler();
+
+  if(!srcFrame || !scaler){
+    if(srcFrame)
+      av_free(srcFrame);
+    if(scaler)
+      WV_freeSliceScaler(scaler);
+    endSection();
+    return;
+  }
+  
+  if(avpicture_alloc((AVPicture*)srcFrame, PIX_FMT_YUV420P, BENCH_SLICES_SRC_WIDTH, BENCH_SLICES_SRC_HEIGHT) < 0){
+    av_free(srcFrame);
+    WV_freeSliceScaler(scaler);
+    endSection();
+    return;
+  }
+  if(avpicture_alloc(&dstPicture, PIX_FMT_RGB32, BENCH_SLICES_DST_WIDTH, BENCH_SLICES_DST_HEIGHT) < 0){
+    avpicture_free((AVPicture*)srcFrame);
+    av_free(srcFrame);
+    WV_freeSliceScaler(scaler);
+    endSection();
+    return;
+  }
+  fillVideoFrame(srcFrame, BENCH_SLICES_SRC_WIDTH, BENCH_SLICES_SRC_HEIGHT, 0);
+
+  for(n=1; n<=WV_SLICE_SCALER_MAX_SLICES; n++){
+
+    /* the sliced output must be the same */
+    //-1 when the frame is converted in one time
+    int identical = -1;
+    if(n > 1)
+      identical = WV_checkSliceScaler(n,				\
+				      srcFrame->data, srcFrame->linesize, \
+				      BENCH_SLICES_SRC_WIDTH, BENCH_SLICES_SRC_HEIGHT, PIX_FMT_YUV420P, \
+				      BENCH_SLICES_DST_WIDTH, BENCH_SLICES_DST_HEIGHT, PIX_FMT_RGB32, \
+				      WV_VIDEO_DECODER_SCALE_FILTER);
+    if(identical == 0)
+      fprintf(stderr, "the %d slices conversion differ from the entire frame conversion\n", n);
+
+    /* measure */
+    int nbFrames = 0;
+    WV_setSliceScalerSlices(scaler, n);
+    uint64_t startWall = getWallTime();
+    uint64_t endWall = startWall + (uint64_t)benchSeconds * 1000000000;
+    uint64_t wallTime;
+
+    do{
+      WV_sliceScale(scaler,						\
+		    srcFrame->data, srcFrame->linesize,			\
+		    BENCH_SLICES_SRC_WIDTH, BENCH_SLICES_SRC_HEIGHT, PIX_FMT_YUV420P, \
+		    dstPicture.data, dstPicture.linesize,		\
+		    BENCH_SLICES_DST_WIDTH, BENCH_SLICES_DST_HEIGHT, PIX_FMT_RGB32, \
+		    WV_VIDEO_DECODER_SCALE_FILTER);
+      nbFrames++;
+      wallTime = getWallTime();
+    }while(wallTime < endWall);
+    wallTime -= startWall;
+
+    beginEntry(firstFlag);
+    firstFlag = 0;
+    fprintf(output, "\"slices\": %d, \"fps\": %.1f, \"identical\": %s}", \
+	    n, nbFrames / (wallTime * 1e-9),				\
+	    identical < 0 ? "null" : (identical ? "true" : "false"));
+  }
+
+  avpicture_free(&dstPicture);
+  avpicture_free((AVPicture*)srcFrame);
+  av_free(srcFrame);
+  WV_freeSliceScaler(scaler);
+
+  endSection();
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*            THE MAIN            */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+static void usage(const char* name)
+{
+  printf("usage : %s [-o results.json] [-m mediadir] [-t seconds]\n", name);
+}
+
+
+int main(int argc, char** argv)
+{
+  int i;
+
+  /* parse args */
+  for(i=1; i<argc; i++){
+    if(!strcmp(argv[i], "-o") && i+1 < argc)
+      outputName = argv[++i];
+    else if(!strcmp(argv[i], "-m") && i+1 < argc)
+      mediaDir = argv[++i];
+    else if(!strcmp(argv[i], "-t") && i+1 < argc)
+      benchSeconds = atoi(argv[++i]);
+    else{
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if(benchSeconds < 1)
+    benchSeconds = 1;
+
+  /*******************/
+  /* headless SDL    */
+  /*******************/
+  setenv("SDL_VIDEODRIVER", "dummy", 0);
+  setenv("SDL_AUDIODRIVER", "dummy", 0);
+
+  if(SDL_Init(SDL_INIT_VIDEO|SDL_INIT_AUDIO|SDL_INIT_TIMER) < 0){
+    fprintf(stderr, "SDL initialization failed: %s\n", SDL_GetError());
+    return 1;
+  }
+
+  /* the renderer object need a window */
+  benchWindow = SDL_CreateWindow("waavebench", 0, 0, 640, 480, SDL_WINDOW_HIDDEN);
+  if(benchWindow)
+    benchRenderer = SDL_CreateRenderer(benchWindow, -1, SDL_RENDERER_SOFTWARE);
+
+  /**************************/
+  /* init waave and media   */
+  /**************************/
+  WV_waaveInit(WAAVE_INIT_AUDIO|WAAVE_INIT_VIDEO);
+
+  if(generateMedias() < 0){
+    WV_waaveClose();
+    SDL_Quit();
+    return 1;
+  }
+
+  output = fopen(outputName, "w");
+  if(!output){
+    fprintf(stderr, "can't open %s\n", outputName);
+    WV_waaveClose();
+    SDL_Quit();
+    return 1;
+  }
+
+  /*******************/
+  /* run the benchs  */
+  /*******************/
+  fprintf(output, "{\n  \"waave_bench\": 1,\n  \"seconds\": %d,", benchSeconds);
+
+  printf("feeder...\n");
+  benchFeeder();
+  printf("audio...\n");
+  benchAudio();
+  printf("video...\n");
+  benchVideo();
+  printf("seek...\n");
+  benchSeek();
+  printf("first frame...\n");
+  benchFirstFrame();
+  printf("memory...\n");
+  benchMemory();
+  printf("slices...\n");
+  benchSlices();
+
+  fprintf(output, "\n}\n");
+  fclose(output);
+  printf("results written in %s\n", outputName);
+
+  /* close */
+  WV_waaveClose();
+  if(benchRenderer)
+    SDL_DestroyRenderer(benchRenderer);
+  if(benchWindow)
+    SDL_DestroyWindow(benchWindow);
+  SDL_Quit();
+
+  return 0;
+}
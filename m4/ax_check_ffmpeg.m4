@@ -63,6 +63,8 @@ AC_CHECK_LIB([avformat], [av_dump_format],[AC_DEFINE([HAVE_AV_DUMP_FORMAT], [1],
 dnl-- check AVCODEC
 AC_CHECK_TYPES([enum AVSampleFormat], [], [], [[#include <libavcodec/avcodec.h>]])
 AC_CHECK_LIB([avcodec], [avcodec_open2],[AC_DEFINE([HAVE_AVCODEC_OPEN_TWO], [1],[Define if avcodec_open2 exist in libavcodec])])
+AC_CHECK_LIB([avcodec], [av_lockmgr_register],[AC_DEFINE([HAVE_AV_LOCKMGR_REGISTER], [1],[Define if av_lockmgr_register exist in libavcodec])])
+AC_CHECK_MEMBERS([AVCodecContext.thread_type],[AC_DEFINE([HAVE_CODEC_THREAD_TYPE], [1],[Define if AVCodecContext.thread_type exist in libavcodec]) ], [ ], [[#include <libavcodec/avcodec.h>]])
 
 dnl-- check decode/pts method
 AC_CHECK_LIB([avutil], [av_opt_ptr],[AC_DEFINE([HAVE_AV_OPT_PTR], [1],[Define if av_opt_ptr exist in libavutil])])
@@ -70,6 +72,13 @@ AC_CHECK_LIB([avcodec], [avcodec_get_frame_class],[AC_DEFINE([HAVE_AVCODEC_GET_F
 AC_CHECK_MEMBERS([AVFrame.best_effort_timestamp],[AC_DEFINE([HAVE_BEST_EFFORT_TIMESTAMP], [1],[Define if AVFrame.best_effort_timestamp exist in libavcodec]) ], [ ], [[#include <libavcodec/avcodec.h>]])
 AC_CHECK_LIB([avcodec], [avcodec_decode_video2],[AC_DEFINE([HAVE_AVCODEC_DECODE_VIDEO_TWO], [1],[Define if avcodec_decode_video2 exist in libavcodec])])
 
+dnl-- check refcounted frames
+AC_CHECK_LIB([avutil], [av_frame_ref],[AC_DEFINE([HAVE_AV_FRAME_REF], [1],[Define if av_frame_ref exist in libavutil])])
+
+dnl-- check refcounted packets
+AC_CHECK_LIB([avcodec], [av_packet_ref],[AC_DEFINE([HAVE_AV_PACKET_REF], [1],[Define if av_packet_ref exist in libavcodec])])
+AC_CHECK_LIB([avcodec], [av_copy_packet],[AC_DEFINE([HAVE_AV_COPY_PACKET], [1],[Define if av_copy_packet exist in libavcodec])])
+
 dnl-- check for audio resample method 
 AC_CHECK_MEMBERS([AVFrame.nb_samples],[AC_DEFINE([HAVE_FRAME_NB_SAMPLES], [1],[Define if AVFrame.nb_samples exist in libavcodec]) ], [ ], [[#include <libavcodec/avcodec.h>]])
 AC_CHECK_MEMBERS([AVFrame.channels],[AC_DEFINE([HAVE_FRAME_CHANNELS], [1],[Define if AVFrame.nb_samples exist in libavcodec]) ], [ ], [[#include <libavcodec/avcodec.h>]])
@@ -44,6 +44,9 @@ extern "C" {
 //the function is not thread safe
 #define WV_NO_THREAD_SAFE 0 
 
+/* the maximum number of formats accepted by a streaming object */
+#define WV_STREAMING_MAX_FORMATS 8
+
 
 /**
  * \brief Frame buffer descriptor 
@@ -75,6 +78,25 @@ typedef struct WVStreamingBuffer{
 
 
 
+/**
+ * \brief Format accepted by a streaming object
+ *
+ * Describe a frame buffer format that a streaming object can
+ * display. The engine use it to choose the cheapest conversion
+ * from the video native format.
+ *
+ */
+typedef struct WVStreamingFormat{
+  
+  enum PixelFormat format; /**< \brief The buffer pixel format, see ffmpeg documentation */
+  int width;               /**< \brief The buffer width, 0 if the object choose it */
+  int height;              /**< \brief The buffer height, 0 if the object choose it */
+  int cost;                /**< \brief The object cost to display this format, 0 is the cheapest */
+
+}WVStreamingFormat;
+
+
+
 /**
  * \brief Streaming method descriptor
  *
@@ -116,6 +138,35 @@ typedef struct WVStreamingObject{
    * the frame buffers relative to native format.
    */
   enum PixelFormat srcFormat;  //ffmpeg src format 
+
+
+  /**
+   * \brief The number of accepted formats (Set by user)
+   *
+   * The number of formats in the *formats* list. Set it
+   * to 0 if the object doesn't negotiate its buffer format.
+   */
+  int nbFormats;
+
+  /**
+   * \brief The accepted formats (Set by user)
+   *
+   * The buffer formats the object can display, ordered by
+   * preference. The decoder add to each format cost the cost of the
+   * conversion from the native format and choose the cheapest, ideally 
+   * the native format itself. This is done before *init* and again when 
+   * the native format change. Set it at object creation.
+   */
+  WVStreamingFormat formats[WV_STREAMING_MAX_FORMATS];
+
+  /**
+   * \brief The negotiated format (Set by decoder)
+   *
+   * The index of the chosen format in the *formats* list, or -1
+   * if the object doesn't negotiate. The *init* and *getBuffer* methods
+   * can use it to build the frame buffers.
+   */
+  int formatIdx;
   
 
   /**
@@ -209,6 +260,8 @@ typedef struct WVStreamingObject{
    * has not been done at object creation. It initialize the decoding
    * slot by reading the video native format and prepare decoding 
    * buffer creation. This method is always called by the main thread.
+   * Return -1 if the object can't be initialized, the stream is then
+   * not loaded.
    *
    */
   int (*init)(struct WVStreamingObject* streamObj);
@@ -279,6 +332,26 @@ typedef struct WVStreamingObject{
    */
   int (*refreshFrame)(struct WVStreamingObject* streamObj, int slotIdx);
 
+
+
+  /**
+   * \brief Upload the decoded frame without conversion
+   *
+   * \param streamObj The streaming object 
+   * \param slotIdx The associated slot index    
+   * \param frame The decoded frame in the codec format
+   *
+   * When this method is set the decoder doesn't convert the frames and doesn't
+   * use the get/lock/release methods. The decoded frame is given just before
+   * refreshFrame and the object upload it in the slot itself. The init method can
+   * set it when the object support the codec format (srcFormat). Return -1 to refuse
+   * a frame, for example after a source change : it is then converted in the main
+   * thread with the get/lock/release methods. This will always called by the main
+   * thread. If this action is not needed set to NULL.
+   *
+   */
+  int (*uploadFrame)(struct WVStreamingObject* streamObj, int slotIdx, WVStreamingBuffer* frame);
+
   
 
   /**
@@ -568,14 +641,41 @@ typedef struct WVSyncObject{
 #define WV_SEEK_BACKWARD -1
 #define WV_SEEK_FORWARD 1
 
+/* the seek precision */
+#define WV_FAST_SEEK 0       //restart at the keyframe before the target
+#define WV_ACCURATE_SEEK 1   //restart exactly at the target
+
+/* the conversion method */
+#define WV_EARLY_CONVERSION 0
+#define WV_LAZY_CONVERSION 1
+
+/* the present method */
+#define WV_PUSH_PRESENT 0
+#define WV_PULL_PRESENT 1
+
+/* the loop cache */
+#define WV_NO_LOOP_CACHE 0
+#define WV_LOOP_CACHE 1
+
+/* the frame cache */
+#define WV_NO_FRAME_CACHE 0
+#define WV_FRAME_CACHE 1
+
 
 /* the stream struct */
 struct WVStream;
 typedef struct WVStream  WVStream;
 
+/* the engine struct */
+struct WVEngine;
+typedef struct WVEngine  WVEngine;
+
 /* to signal eof */
 typedef  int (*WVEOFSignalCall)(struct WVStream* stream, void* param);
 
+/* to signal the asynchronous open and load */
+typedef  int (*WVStreamReadyCall)(struct WVStream* stream, int status, void* param);
+
 
 #define WAAVE_INIT_NONE 0
 #define WAAVE_INIT_AUDIO 1
@@ -639,6 +739,79 @@ int WV_waaveInit(int flag);
 int WV_waaveClose(void);
 
 
+/**
+ * \brief Start a new engine instance
+ *
+ * \param flag Set the components to start, like *WV_waaveInit*
+ * \param audioDevice The name of the audio device used by the engine, NULL for the default device
+ *
+ * *WV_waaveInit* start the default engine used by all the streams. To share the workload
+ * between several displays or audio devices, you can start other engines. Each engine 
+ * has its own packet feeder and decoder threads, and the streams loaded in it are 
+ * decoded by them. The refresh scheduler, the conversion workers and the stream 
+ * loader are shared by all the engines. *WV_waaveInit* must be called first. 
+ * With SDL 1.2, only one engine can start the audio on the default device. 
+ * Return NULL if the engine can't be started.
+ *
+ * \code
+ * WVEngine* secondEngine = WV_createEngine(WAAVE_INIT_AUDIO|WAAVE_INIT_VIDEO, NULL);
+ * WV_setStreamEngine(stream, secondEngine);
+ * WV_loadStream(stream);
+ * \endcode
+ */
+WVEngine* WV_createEngine(int flag, const char* audioDevice);
+
+
+/**
+ * \brief Stop an engine instance
+ *
+ * \param engine An engine given by ::WV_createEngine
+ *
+ * All the streams of the engine must be closed before. The default engine is
+ * stopped by *WV_waaveClose*. Return -1 if the engine can't be destroyed.
+ */
+int WV_destroyEngine(WVEngine* engine);
+
+
+/**
+ * \brief Choose the engine that decode a stream
+ *
+ * \param stream The stream you want to set the engine
+ * \param engine An engine given by ::WV_createEngine, NULL for the default engine
+ *
+ * The streams are decoded by the default engine unless this is set. This must be 
+ * set before loading the stream.
+ */
+int WV_setStreamEngine(WVStream* stream, WVEngine* engine);
+
+
+/**
+ * \brief Set the task workers shared by the engines
+ *
+ * \param nbWorkers The number of workers, 0 for the default
+ * \param cpus An array of nbWorkers cpu numbers where each worker is pinned, NULL for no pinning
+ *
+ * The streams of an engine are decoded in parallel by a pool of task workers, 
+ * shared by all the engines and the conversion slices. Each worker has its own 
+ * task queue and steal the tasks of the others when it has nothing to do. The 
+ * audio tasks are always taken before the video tasks. By default there is one 
+ * worker per cpu with SDL 2 and 4 workers with SDL 1.2. A cpu number set to -1 
+ * let the worker unpinned. The pinning need pthread_setaffinity_np or Windows.
+ * The libavcodec threads of each video stream are limited to 2 and to the number
+ * of workers, so many streams don't oversubscribe the cpus.
+ * This must be called before *WV_waaveInit*, or when all the engines are stopped.
+ * Return -1 if the workers are running, nbWorkers is too big (16 max) or a cpu number
+ * is not a cpu of the system.
+ *
+ * \code
+ * int cpus[2] = {2, 3};
+ * WV_setTaskWorkers(2, cpus);
+ * WV_waaveInit(WAAVE_INIT_AUDIO|WAAVE_INIT_VIDEO);
+ * \endcode
+ */
+int WV_setTaskWorkers(int nbWorkers, const int* cpus);
+
+
 /** @} */
 
 
@@ -674,6 +847,25 @@ int WV_waaveClose(void);
 WVStream* WV_getStream(const char* filename);
 
 
+/**
+ * \brief Enable the probe cache
+ *
+ * \param cacheFilename The cache file, NULL to disable the cache
+ *
+ * The stream information found when a file is opened are saved in the cache
+ * file : the codec parameters, the stream selection, the duration and the start 
+ * time. When the same file is reopened, recognized by its path, size and
+ * modification time, the information are read from the cache and the file is not
+ * probed. The cache is loaded by this call and the new files are appended to it,
+ * so it persist between the sessions. The file is rewritten when it hold too many
+ * replaced entries, and only the 1024 newest files are kept. A corrupted file is
+ * read until the corruption. Only the local files are cached. Need
+ * *WV_waaveInit*. The time saved is given by ::WV_getStreamOpenTime.
+ *
+ */
+int WV_setProbeCache(const char* cacheFilename);
+
+
 /**
  * \brief Close an opened stream
  *
@@ -736,6 +928,128 @@ int WV_getStreamHeight(WVStream* stream);
 int WV_loadStream(WVStream* stream);
 
 
+/* the stream ready signal */
+#if SDL_VERSION_ATLEAST(2,0,0)
+
+extern int dynamic_wv_stream_ready_event;  //dynamic, see waave_engine_flags.c
+#define WV_STREAM_READY_EVENT dynamic_wv_stream_ready_event
+
+#else
+
+#define WV_STREAM_READY_EVENT SDL_NUMEVENTS - 3
+
+#endif
+
+
+/**
+ * \brief Open a media file without blocking
+ *
+ * \param filename The media file
+ * \param readyCall The function called when the stream is opened. May be NULL.
+ * \param param The param given with the signal
+ *
+ * Like *WV_getStream* but the file is opened and probed by a pool of worker threads,
+ * so many files can be opened in parallel without freezing the caller. When it's done,
+ * *readyCall* is launched **by the worker thread** with the new stream (NULL on error),
+ * the status (0 if the stream is opened, -1 otherwise) and *param*. If *readyCall* is NULL
+ * a *WV_STREAM_READY_EVENT* is pushed with the status in *event.user.code*, the stream
+ * in *event.user.data1* and *param* in *event.user.data2*. The stream information are not
+ * dumped. Need *WV_waaveInit*. Return -1 if the request can't be queued.
+ *
+ */
+int WV_getStreamAsync(const char* filename, WVStreamReadyCall readyCall, void* param);
+
+
+/**
+ * \brief Load a stream in the Waave engine without blocking
+ *
+ * \param stream The stream to load.
+ * \param readyCall The function called when the stream is loaded. May be NULL.
+ * \param param The param given with the signal
+ *
+ * Like *WV_loadStream* but the codecs are opened by a worker thread. The streams without
+ * video are also added to the engine by the worker. With video the streaming object is
+ * initialized in the main thread : the engine push a *WV_REFRESH_EVENT* and the stream
+ * is added by ::WV_refreshVideoFrame, that then launch the signal. The packets start to
+ * be buffered as soon as the stream is added. The end of the load is signaled like
+ * *WV_getStreamAsync*, the status is the *WV_loadStream* returned value. Don't use the
+ * stream before the signal. Return -1 if the request can't be queued.
+ *
+ */
+int WV_loadStreamAsync(WVStream* stream, WVStreamReadyCall readyCall, void* param);
+
+
+/** @} */
+
+
+
+
+/*********************/
+/* Thumbnails        */
+/*********************/
+
+/** 
+ * \defgroup thumbnails Extract thumbnails
+ *
+ * For previews and thumbnails, the Waave engine can extract
+ * the keyframes of the files without loading streams. Only
+ * the video keyframes are demuxed and decoded, directly in
+ * the caller buffers.
+ * @{
+ */
+
+/**
+ * \brief Thumbnail request
+ *
+ * Describe the wanted thumbnail and receive the result.
+ *
+ */
+typedef struct WVThumbnail{
+  
+  const char* filename;     /**< \brief The media file */
+  uint32_t time;            /**< \brief The wanted position in milliseconds */
+  
+  /**
+   * \brief The caller buffer
+   * The thumbnail is converted to the buffer size and pixel format
+   */
+  WVStreamingBuffer buffer;
+
+  uint32_t keyframeTime;    /**< \brief Set to the position of the extracted keyframe in milliseconds */
+  int status;               /**< \brief Set to 0 if the thumbnail was extracted, -1 otherwise */
+
+}WVThumbnail;
+
+
+/**
+ * \brief Extract thumbnails from a batch of files
+ *
+ * \param thumbnails The thumbnail requests
+ * \param nbThumbnails The number of requests
+ *
+ * Each thumbnail is the nearest keyframe at or before the requested time, found with
+ * the demuxer index. The consecutive requests on the same file share the same demuxer
+ * and decoder, so group them. The files are processed in parallel. When the codec support
+ * it, the keyframes are decoded at a lower resolution close to the buffer size. This doesn't
+ * need the Waave engine to be started but *WV_waaveInit* must be called before to let the
+ * codecs be opened in parallel. Return the number of extracted thumbnails or -1 if
+ * the parameters are not valid.
+ *
+ */
+int WV_getThumbnails(WVThumbnail* thumbnails, int nbThumbnails);
+
+
+/**
+ * \brief Extract one thumbnail
+ *
+ * \param thumbnail The thumbnail request
+ *
+ * Like *WV_getThumbnails* for one request. Return 0 if the thumbnail was extracted, -1 otherwise.
+ *
+ */
+int WV_getThumbnail(WVThumbnail* thumbnail);
+
+
 /** @} */
 
 
@@ -777,8 +1091,10 @@ extern int dynamic_wv_refresh_event;  //dynamic, see waave_engine_flags.c
  * Display a video frame of a stream using the method
  * discribed in the corresponding streaming object.
  * Call this function each time you receive the 
- * *WV_REFRESH_EVENT* to play video. Use a simple 
- * test like this :
+ * *WV_REFRESH_EVENT* to play video. The event also
+ * commit the gapless splices and finish the async
+ * loads, see ::WV_preloadNext and ::WV_loadStreamAsync.
+ * Use a simple test like this :
  * \code
  * SDL_Event event;
  * while( SDL_PollEvent( &event ) ) {
@@ -793,6 +1109,116 @@ extern int dynamic_wv_refresh_event;  //dynamic, see waave_engine_flags.c
  */
 void WV_refreshVideoFrame(SDL_Event* refreshEvent);
 
+
+/**
+ * \brief Give the present clock
+ *
+ * Give the current time of the clock used to schedule the video frames, in microseconds.
+ * Use it as the *now* parameter of ::WV_presentDue and ::WV_acquireFrame. With the 
+ * virtual time source this is the virtual time (see ::WV_setTimeSource).
+ *
+ */
+uint64_t WV_getPresentClock(void);
+
+
+/* the time sources */
+#define WV_REAL_TIME 0
+#define WV_VIRTUAL_TIME 1
+
+/**
+ * \brief Set the engine time source
+ *
+ * \param sourceFlag The time source
+ *
+ * The engine time drive the clock synchronisation, the audio clock, the refresh
+ * scheduling and the present clock. With the virtual time source it only move 
+ * when ::WV_advanceVirtualTime is called, so the refresh and sync decisions are 
+ * reproducible and a clip can be played faster than real time. This must be called 
+ * before *WV_waaveInit*, or when all the engines are stopped. Return -1 if the flag 
+ * is not valid.
+ *
+ * sourceFlag       | Description
+ * ---------------- | -----------
+ * WV_REAL_TIME     | The system monotonic time, the default
+ * WV_VIRTUAL_TIME  | A virtual time starting at 0 and advanced by the user
+ *
+ * The audio devices still read the samples at their own rate, so use the virtual
+ * time with video only streams (see ::WV_disableAudio) or with a dummy audio driver.
+ * The pull present method give the most reproducible runs, as the frames are 
+ * presented by the thread that advance the time :
+ * \code
+ * WV_setTimeSource(WV_VIRTUAL_TIME);
+ * WV_waaveInit(WAAVE_INIT_VIDEO);
+ * ...
+ * while(playing) {
+ *     WV_advanceVirtualTime(1000000/60);
+ *     WV_presentDue(WV_getPresentClock());
+ * }
+ * \endcode
+ */
+int WV_setTimeSource(int sourceFlag);
+
+
+/**
+ * \brief Advance the virtual time
+ *
+ * \param delay The time to add in microseconds
+ *
+ * Move the virtual time forward and launch the refreshs that become due. The call
+ * doesn't wait for the decoders, so with the virtual time the late frames are never
+ * dropped and the decoding quality is never lowered : all the frames are displayed,
+ * whatever the advance speed. Return -1 if the time source is not virtual.
+ *
+ */
+int WV_advanceVirtualTime(uint32_t delay);
+
+
+/**
+ * \brief Display all the due video frames
+ *
+ * \param now The present time given by ::WV_getPresentClock 
+ *
+ * For the streams loaded with the WV_PULL_PRESENT method (see ::WV_setPresentMethod) 
+ * no *WV_REFRESH_EVENT* are sent. Instead a render loop call this function 
+ * to display all the frames that are due at *now*. Call it from the 
+ * thread that load and close the streams. A loop that already run at vsync
+ * can give the time of the next vsync :
+ * \code
+ * while(playing) {
+ *     WV_presentDue(WV_getPresentClock());
+ *     //wait for vsync
+ * }
+ * \endcode
+ * 
+ * Return the number of new displayed frames.
+ */
+int WV_presentDue(uint64_t now);
+
+
+/**
+ * \brief Display all the due video frames of an engine
+ *
+ * \param engine An engine given by ::WV_createEngine 
+ * \param now The present time given by ::WV_getPresentClock 
+ *
+ * Like ::WV_presentDue but for the streams of another engine than the default.
+ * Return the number of new displayed frames.
+ */
+int WV_presentEngineDue(WVEngine* engine, uint64_t now);
+
+
+/**
+ * \brief Display the due video frame of one stream
+ *
+ * \param stream A stream loaded with the WV_PULL_PRESENT method 
+ * \param now The present time given by ::WV_getPresentClock 
+ *
+ * Like ::WV_presentDue but only for one stream. Return 1 if a new frame 
+ * was displayed, 0 if no frame was due and -1 if the stream doesn't 
+ * use the pull method.
+ */
+int WV_acquireFrame(WVStream* stream, uint64_t now);
+
 /** @} */
 
 
@@ -835,6 +1261,34 @@ int WV_disableAudio(WVStream* stream);
  */
 int WV_disableVideo(WVStream* stream);
 
+/**
+ * \brief Give the number of audio tracks in a stream
+ *
+ * \param stream The stream
+ *
+ * The audio tracks are numbered from 0 in the file order. At most 8 tracks are listed.
+ *
+ */
+int WV_getAudioTrackCount(WVStream* stream);
+
+/**
+ * \brief Choose the audio tracks loaded with the stream
+ *
+ * \param stream The stream, not loaded yet
+ * \param tracks The track numbers
+ * \param nbTracks The number of tracks
+ *
+ * By default only the best audio track of the file is loaded. With this function you can
+ * load several tracks, like alternate languages or stems, that are read from the same file
+ * and mixed together. The first track is the master, it give the clock to the video and 
+ * signal the end of file. Each track has its own volume, see ::WV_setAudioTrackVolume, and
+ * can be switched on and off while playing, see ::WV_setAudioTrackActive. The tracks not
+ * loaded are discarded by the demuxer. Return -1 if a track doesn't exist or if the stream 
+ * is already loaded.
+ *
+ */
+int WV_setAudioTracks(WVStream* stream, const int* tracks, int nbTracks);
+
 /**
  * \brief Set the stream behavior when a *play* command is sent 
  *
@@ -874,6 +1328,28 @@ int WV_setPlayMethod(WVStream* stream, int playFlag);
 int WV_setSeekMethod(WVStream* stream, int seekFlag);
 
 
+/**
+ * \brief Set where the stream restart after a *seek* command
+ *
+ * \param stream The stream you want to set the seek precision
+ * \param precisionFlag The wanted seek precision
+ *
+ * Possible precisions are :
+ *
+ * Seek precision   |   Description 
+ * -----------------|--------------------------------
+ * WV_FAST_SEEK     | The stream restart at the keyframe before the target (default)
+ * WV_ACCURATE_SEEK | The stream restart exactly at the target
+ *
+ * With accurate seek the frames between the keyframe and the target are decoded
+ * but never converted nor displayed, and the audio samples before the target are
+ * trimmed. The first displayed frame is the one showing the target. The time taken
+ * is given by ::WV_getSeekLatency. Return -1 if the flag is not valid.
+ *
+ */
+int WV_setSeekPrecision(WVStream* stream, int precisionFlag);
+
+
 /* the eof signal */
 #if SDL_VERSION_ATLEAST(2,0,0)
 
@@ -901,11 +1377,200 @@ extern int dynamic_wv_eof_event;  //dynamic, see waave_engine_flags.c
  * WV_BLOCKING_STREAM | When the stream reach *end of file* it stops (default)
  * WV_LOOPING_STREAM  | When the stream reach *end of file* it restart playing at the beginning
  *
+ * At *end of file* the frames delayed by the codecs are decoded before the loop, so
+ * a looping stream play all its samples and frames. To continue with another file without
+ * gap, see ::WV_preloadNext.
+ *
  */
 int WV_setEOFMethod(WVStream* stream, int loopingFlag);
 
 
 
+/**
+ * \brief Set when the video frames are converted to the streaming object format
+ *
+ * \param stream  The video stream you want to set the conversion method
+ * \param conversionFlag  The wanted conversion behavior
+ *
+ * By default each decoded frame is converted and loaded in the streaming object
+ * buffers as soon as it is decoded. With the lazy conversion the decoded frames are kept in 
+ * the codec format and only the frames that will be displayed are converted. Frames
+ * that are never displayed (late frames, frames flushed by a seek) don't cost any
+ * conversion. This must be set before loading the stream.
+ * Possible behavior are :
+ *
+ * Conversion method   |   Description 
+ * --------------------|--------------------------------
+ * WV_EARLY_CONVERSION | The frames are converted when decoded (default)
+ * WV_LAZY_CONVERSION  | The frames are converted just before being displayed
+ *
+ */
+int WV_setConversionMethod(WVStream* stream, int conversionFlag);
+
+
+/**
+ * \brief Keep the packets of a short looping file in memory
+ *
+ * \param stream  The stream you want to set the loop cache
+ * \param cacheFlag  WV_LOOP_CACHE to keep the packets
+ *
+ * With the loop cache, the demuxed packets of the first pass are kept in memory and
+ * the next loops are replayed from them, without reading, seeking or demuxing the file.
+ * Only the files smaller than the size limit are cached, and the caching stops if the
+ * memory limit is reached, see ::WV_setLoopCacheLimits. After a seek the file is read
+ * until its end, then the cache is replayed again. This must be set before loading the
+ * stream. Possible behavior are :
+ *
+ * Loop cache       |   Description 
+ * -----------------|--------------------------------
+ * WV_NO_LOOP_CACHE | Each loop read the file (default)
+ * WV_LOOP_CACHE    | The loops are replayed from memory
+ *
+ */
+int WV_setLoopCache(WVStream* stream, int cacheFlag);
+
+/**
+ * \brief Bound the loop cache memory
+ *
+ * \param maxFileSize  The size of the biggest cached file, in bytes (16 MB by default)
+ * \param maxSize  The memory taken by all the cached packets, in bytes (64 MB by default)
+ *
+ * The file size limit is checked when the stream is loaded. The memory limit is shared
+ * by all the engines, their cached packets take at most maxSize together.
+ *
+ */
+void WV_setLoopCacheLimits(uint32_t maxFileSize, uint32_t maxSize);
+
+/**
+ * \brief Give the memory taken by the loop cache
+ *
+ * \return The size of all the cached packets of the default engine, in bytes.
+ *
+ */
+uint32_t WV_getLoopCacheSize(void);
+
+/**
+ * \brief Keep the converted frames of a short looping video in memory
+ *
+ * \param stream  The video stream you want to set the frame cache
+ * \param cacheFlag  WV_FRAME_CACHE to keep the frames
+ *
+ * Made for the short animations looping forever. With the frame cache, the frames of
+ * the first loop are kept as converted for the streaming object, and the next loops
+ * are copied from them without decoding nor converting. The buffer filter is still
+ * applied at each loop. The late frames are not dropped while the first loop is
+ * recorded. The caching stops if the memory limits are reached, see
+ * ::WV_setFrameCacheLimits. After a seek or a trick play the frames are decoded until
+ * the stream end, then the cache is replayed again. The streaming objects uploading
+ * the native frames are not cached. This must be set before loading the stream.
+ * Possible behavior are :
+ *
+ * Frame cache       |   Description 
+ * ------------------|--------------------------------
+ * WV_NO_FRAME_CACHE | Each loop is decoded (default)
+ * WV_FRAME_CACHE    | The loops are replayed from memory
+ *
+ */
+int WV_setFrameCache(WVStream* stream, int cacheFlag);
+
+/**
+ * \brief Bound the frame cache memory
+ *
+ * \param maxStreamSize  The memory taken by the frames of one stream, in bytes (32 MB by default)
+ * \param maxSize  The memory taken by all the cached frames, in bytes (128 MB by default)
+ *
+ * The limits are the same for all the engines, maxSize bound the cached frames of
+ * all the engines together.
+ *
+ */
+void WV_setFrameCacheLimits(uint32_t maxStreamSize, uint32_t maxSize);
+
+/**
+ * \brief Give the memory taken by the frame cache
+ *
+ * \return The size of all the cached frames of the default engine, in bytes.
+ *
+ */
+uint32_t WV_getFrameCacheSize(void);
+
+
+
+/**
+ * \brief Set how the video frames are displayed
+ *
+ * \param stream  The video stream you want to set the present method
+ * \param presentFlag  The wanted present behavior
+ *
+ * By default the Waave engine send a *WV_REFRESH_EVENT* each time a frame need
+ * to be displayed. With the pull method no event are sent and the frames are displayed
+ * when you call ::WV_presentDue or ::WV_acquireFrame. This must be set before loading 
+ * the stream. Possible behavior are :
+ *
+ * Present method   |   Description 
+ * -----------------|--------------------------------
+ * WV_PUSH_PRESENT  | A *WV_REFRESH_EVENT* is sent when the frame is due (default)
+ * WV_PULL_PRESENT  | The due frames are displayed by ::WV_presentDue or ::WV_acquireFrame
+ *
+ */
+int WV_setPresentMethod(WVStream* stream, int presentFlag);
+
+
+
+/**
+ * \brief Set in how many slices the video frames are converted
+ *
+ * \param stream  The video stream you want to set the conversion slices
+ * \param nbSlices  The number of horizontal slices, 1 to convert the frames in one time (default)
+ *
+ * Large frames can be converted to the streaming object format in several
+ * horizontal slices processed in parallel by the Waave task workers. The result
+ * is always identical to the conversion in one time : each slice is converted with
+ * some overlapping lines, so the frames are sliced only when the vertical scaling
+ * step exactly in the source lines and chroma lines (for example 1080 to 720 or
+ * 540 lines, or no vertical scaling). Other frames are converted in one time. This can be set before or after loading the stream.
+ * Return -1 if nbSlices is not valid.
+ *
+ */
+int WV_setConversionSlices(WVStream* stream, int nbSlices);
+
+
+
+/**
+ * \brief Display only a part of the video frames
+ *
+ * \param stream  The video stream you want to crop
+ * \param cropRect  The visible part of the frames in source pixels, NULL for the entire frames (default)
+ *
+ * Only the visible part of the decoded frames is converted and given to the
+ * streaming object, so the streaming object buffers and the conversion are
+ * reduced to the cropped region. The rect is clamped to the frames and aligned
+ * on even coordinates. Must be set before loading the stream.
+ * Return -1 if the rect is not valid.
+ *
+ */
+int WV_setSourceCrop(WVStream* stream, SDL_Rect* cropRect);
+
+
+
+/**
+ * \brief Give the size the video will be displayed
+ *
+ * \param stream  The video stream
+ * \param width  The displayed width, 0 to keep the source size (default)
+ * \param height  The displayed height, 0 to keep the source size (default)
+ *
+ * When the video is displayed smaller than its source, the decoder downscale
+ * the frames to the smallest size at or above the output size keeping the
+ * aspect ratio, so the streaming object buffers and the conversion are smaller.
+ * When the codec support it, the frames are directly decoded at a lower
+ * resolution. The frames are never upscaled. Must be set before loading
+ * the stream. Return -1 if the size is not valid.
+ *
+ */
+int WV_setOutputSize(WVStream* stream, int width, int height);
+
+
+
 /**
  * \brief Associate a streaming object with an opened stream.
  *
@@ -922,6 +1587,23 @@ int WV_setEOFMethod(WVStream* stream, int loopingFlag);
 int WV_setStreamingMethod(WVStream* stream, WVStreamingObject* streamObj);
 
 
+/**
+ * \brief Add a streaming object to a video stream
+ *
+ * \param stream A video stream
+ * \param streamObj The added streaming object
+ *
+ * Like ::WV_setStreamingMethod for the first object. When several objects are added,
+ * the stream use a fan-out object (see ::WV_getStreamFanoutObj) that feed all of them :
+ * each frame is decoded one time and each object get its own conversion and its own
+ * refresh, all synchronized on the same clock. The fan-out object is freed with the stream,
+ * the added objects are freed by the user. Must be called before loading the stream.
+ * Return -1 if the stream is loaded or if there is too many objects.
+ *
+ */
+int WV_addStreamingMethod(WVStream* stream, WVStreamingObject* streamObj);
+
+
 
 /**
  * \brief Return the streaming object associated with the stream.
@@ -1092,6 +1774,34 @@ int WV_stopStream(WVStream* stream);
 int WV_rewindStream(WVStream* stream);
 
 
+/**
+ * \brief Continue a stream with another file without gap
+ *
+ * \param stream The loaded stream
+ * \param nextStream The next file, opened with ::WV_getStream but not loaded
+ *
+ * The codecs of *nextStream* are opened and its packets are read ahead, while *stream*
+ * is playing. At the *end of file* of *stream*, the decoders continue with *nextStream*
+ * at the exact sample and frame boundary, like a looping stream, and the *end of file* is
+ * signaled as usual. *stream* then play the next file with its own settings : streaming
+ * object, sync object, volume, EOF method and EOF signal. When all the decoders have
+ * switched, the engine push a *WV_REFRESH_EVENT* and the previous file is closed by
+ * ::WV_refreshVideoFrame in the main thread. So give all the refresh events to
+ * ::WV_refreshVideoFrame, even for audio streams or with the pull present method. Until
+ * then the stream functions still see the previous file.
+ *
+ * *nextStream* belongs now to *stream*, don't use or close it. If *stream* is closed before
+ * the splice, *nextStream* is closed with it.
+ *
+ * The two files need to have the same type and only the master audio track is played, so
+ * *stream* can't have other audio tracks loaded. Only one next file can be set at a time,
+ * set the following one when the *end of file* is signaled. Preload the next file well
+ * before the end and don't seek around the splice. Return -1 if the files can't be spliced.
+ *
+ */
+int WV_preloadNext(WVStream* stream, WVStream* nextStream);
+
+
 /**
  * \brief Relative seek command
  *
@@ -1130,6 +1840,54 @@ int WV_rseekStream(WVStream* stream, uint32_t seekShift, int seekDirection);
 int WV_seekStream(WVStream* stream, uint32_t clock);
 
 
+/**
+ * \brief Fast forward and rewind
+ *
+ * \param stream The loaded video stream
+ * \param rate The playback rate, 1 for normal play, 2 to 32 to fast forward, -1 to -32 to rewind
+ *
+ * Play the video at *rate* times the normal speed. Up to 4x all the frames are decoded
+ * and the late ones are dropped. Above, and for rewind, only the keyframes are decoded
+ * and the engine seek from keyframe to keyframe, so the CPU cost stay bounded whatever
+ * the rate. The audio is muted during trick play. Setting the rate back to 1 resume the
+ * normal play at the trick play position, in the play state the stream had before. Play,
+ * pause and seek commands also return to normal play. Return -1 if the rate is not valid
+ * or the stream doesn't play video. As the normal play is resumed with a seek, return -1
+ * too if the stream is synced by a user sync object without *seek* function.
+ *
+ */
+int WV_setPlaybackRate(WVStream* stream, int rate);
+
+
+/**
+ * \brief Give the current playback rate
+ *
+ * \param stream The stream
+ *
+ * Give the rate set by ::WV_setPlaybackRate, 1 for normal play.
+ *
+ */
+int WV_getPlaybackRate(WVStream* stream);
+
+
+/**
+ * \brief Switch an audio track on or off
+ *
+ * \param stream The loaded stream
+ * \param track The track number, loaded with ::WV_setAudioTracks
+ * \param activeFlag 1 to play the track, 0 to mute it
+ *
+ * The loaded tracks start active. An inactive track is paused and its packets are 
+ * discarded by the demuxer so it cost nothing. When a track is activated the stream
+ * do an accurate seek to the current clock, so the track join the others in sync. To
+ * switch between two tracks, activate the new one before deactivating the old one. 
+ * Deactivating the master give the clock to another active track. Return -1 if the 
+ * track is not loaded or if it is the last active one.
+ *
+ */
+int WV_setAudioTrackActive(WVStream* stream, int track, int activeFlag);
+
+
 /**
  * \brief Give total stream duration 
  *
@@ -1154,6 +1912,71 @@ uint32_t WV_getStreamDuration(WVStream* stream);
 uint32_t WV_getStreamClock(WVStream* stream);
 
 
+/**
+ * \brief Give the number of dropped video frames
+ *
+ * \param stream The stream
+ *
+ * When the video fall behind the clock, the late frames are dropped before
+ * being displayed and the decoder skip more and more frames until the video
+ * is back in sync. Give the total number of dropped frames since the stream
+ * was loaded or 0 if the stream doesn't play video.
+ *
+ */
+uint32_t WV_getDroppedFrames(WVStream* stream);
+
+
+/**
+ * \brief Give the conversion time of the last video frame
+ *
+ * \param stream The stream
+ *
+ * Give the time, in microseconds, taken to convert the last loaded video frame 
+ * to the streaming object format or 0 if the stream doesn't play video.
+ *
+ */
+uint32_t WV_getConversionTime(WVStream* stream);
+
+
+/**
+ * \brief Give the latency of the last seek
+ *
+ * \param stream The stream
+ *
+ * Give the time, in microseconds, between the last *seek* command and the 
+ * decoding of its first displayed video frame or 0 if the stream doesn't 
+ * play video.
+ *
+ */
+uint32_t WV_getSeekLatency(WVStream* stream);
+
+
+/**
+ * \brief Give the time taken to open the stream
+ *
+ * \param stream The stream
+ *
+ * Give the time, in microseconds, taken by *WV_getStream* to open the file and
+ * read the stream information, with or without the probe cache.
+ *
+ */
+uint32_t WV_getStreamOpenTime(WVStream* stream);
+
+
+/**
+ * \brief Give the latency of the first frame
+ *
+ * \param stream The stream
+ *
+ * Give the time, in microseconds, between the *WV_loadStream* command and the 
+ * decoding of the first video frame, or 0 if the stream doesn't play video or if
+ * the first frame is not decoded yet. Added to ::WV_getStreamOpenTime this give
+ * the time to first frame.
+ *
+ */
+uint32_t WV_getFirstFrameLatency(WVStream* stream);
+
+
 /** @} */
 
 
@@ -1240,6 +2063,20 @@ int WV_getDBVolume(WVStream* stream);
 int WV_shiftDBVolume(WVStream* stream, int shift);
 
 
+/**
+ * \brief Set the volume of an audio track
+ *
+ * \param stream The stream
+ * \param track The track number
+ * \param volume The track volume, 1.0 by default
+ *
+ * The track volume is multiplied by the stream volume. It can be set before or 
+ * after loading the stream.
+ *
+ */
+int WV_setAudioTrackVolume(WVStream* stream, int track, double volume);
+
+
 /** @} */
 
 
@@ -1312,16 +2149,22 @@ void WV_freeStreamOverlayObj(WVStreamingObject* streamObj);
   /*   surface    */
   /****************/
 
+/* the surface update flag */
+//the update rects are collected and updated in one time by WV_updateStreamSurfaces
+#define WV_DEFERRED_UPDATE 2
+
 /**
  * \brief Get a new surface streaming object
  * 
  * \param targetSurface The sdl surface where we want to stream video data.
  * ** The surface you want ! **
  * \param destRect The destination rectangle. All the surface if NULL;
- * \param updateFlag Set it if you want that waave update the target surface with SDL_UpdateRect 
+ * \param updateFlag Set it if you want that waave update the target surface with SDL_UpdateRect,
+ * or set it to WV_DEFERRED_UPDATE to update it with ::WV_updateStreamSurfaces
  * 
  * Create a new streaming object for an sdl surface. Be carefull to 
- * use it only for one video stream !
+ * use it only for one video stream ! The frames are decoded in the target surface
+ * pixel format when possible so the blits doesn't need conversion.
  *
  */
 WVStreamingObject* WV_getStreamSurfaceObj(SDL_Surface* targetSurface, SDL_Rect* destRect, int updateFlag);
@@ -1335,11 +2178,26 @@ WVStreamingObject* WV_getStreamSurfaceObj(SDL_Surface* targetSurface, SDL_Rect*
  *
  * It's possible to change the target surface of a streaming object without
  * recreate it. This can be done at any time ! Even if the stream is playing.
+ * The new surfaces are created without waiting the decoder, the frames already
+ * decoded are displayed with the previous size.
  *
  */
 void WV_resetStreamSurfaceOutput(WVStreamingObject* streamObj, SDL_Surface* targetSurface, SDL_Rect* destRect);
 
 
+/**
+ * \brief Update the target surface of the surface streaming objects
+ *
+ * The surface streaming objects created with the WV_DEFERRED_UPDATE update flag
+ * doesn't update the target surface at each refresh. Their rects are collected
+ * and this function update them with one SDL_UpdateRects call. Call it one time per frame, 
+ * after handling the refresh events. Return 1 if the surface was updated, 0 if
+ * there was nothing to update.
+ *
+ */
+int WV_updateStreamSurfaces(void);
+
+
 /**
  * \brief Free an surface streaming object
  *
@@ -1392,7 +2250,10 @@ void WV_freeStreamSurfaceObj(WVStreamingObject* streamObj);
  * \param updateFlag Set it if you want that waave update the target surface with SDL_RenderPresent 
  * 
  * Create a new streaming object for a sdl renderer. Be carefull to 
- * use it only for one video stream !
+ * use it only for one video stream ! When the video is decoded in YUV420P, NV12,
+ * NV21, YUYV422 or UYVY422 the textures are created in the same format and the decoded
+ * frames are uploaded without conversion, the renderer do the color conversion and
+ * the scaling. Other formats are converted by the decoder to the cheapest texture format.
  *
  */
   WVStreamingObject* WV_getStreamRendererObj(SDL_Renderer* targetRenderer, SDL_Rect* destRect, int updateFlag);
@@ -1425,12 +2286,220 @@ void WV_resetStreamRendererOutput(WVStreamingObject* streamObj, SDL_Renderer* ta
  */
 void WV_freeStreamRendererObj(WVStreamingObject* streamObj);
 
+
+
+/* the compositor */
+struct WVRendererCompositor;
+typedef struct WVRendererCompositor WVRendererCompositor;
+
+
+/**
+ * \brief Get a new renderer compositor
+ * 
+ * \param targetRenderer The sdl renderer where the streams are composited
+ * 
+ * When many streams are displayed on the same renderer, rendering and presenting each
+ * frame independently cost one present per frame. A compositor collect the last frame
+ * of each stream and render them in one pass with only one present. Create 
+ * the streaming objects with ::WV_getStreamCompositorObj and call ::WV_renderCompositor
+ * one time per display frame.
+ *
+ */
+WVRendererCompositor* WV_getRendererCompositor(SDL_Renderer* targetRenderer);
+
+
+/**
+ * \brief Get a new renderer streaming object that render with a compositor
+ * 
+ * \param compositor The compositor that will render the stream
+ * \param destRect The destination rectangle. The entire rendering target if NULL;
+ * \param zOrder The streams are rendered by increasing zOrder
+ * 
+ * Create a renderer streaming object that doesn't render itself but give its frames to 
+ * the compositor. Free it with ::WV_freeStreamRendererObj. When the compositor already
+ * render 30 streams the stream using the object can't be loaded.
+ *
+ */
+WVStreamingObject* WV_getStreamCompositorObj(WVRendererCompositor* compositor, SDL_Rect* destRect, int zOrder);
+
+
+/**
+ * \brief Render all the streams of a compositor
+ * 
+ * \param compositor The compositor
+ * 
+ * Clear the renderer, render the last frame of each stream in zOrder
+ * and present. Call it one time per display frame, after the refresh events 
+ * are threaded or after ::WV_presentDue. Return 0 if no stream have a new frame, in this 
+ * case nothing is rendered.
+ *
+ */
+int WV_renderCompositor(WVRendererCompositor* compositor);
+
+
+/**
+ * \brief Free a renderer compositor
+ * 
+ * \param compositor The released compositor
+ * 
+ * Free the compositor. Be carefull to close the streams that use it before.
+ *
+ */
+void WV_freeRendererCompositor(WVRendererCompositor* compositor);
+
 #endif
 
 /** @} */
 
 
 
+
+/*****************************/
+/* The fan-out stream object */
+/*****************************/
+
+/** 
+ * \defgroup streamfanout Fan-out streaming object
+ *
+ * The fan-out object feed several streaming objects with only one video 
+ * decoder. Each frame is decoded one time, and converted for each output 
+ * by the decoder thread. The outputs that upload the frames, or that are not thread
+ * safe, are fed just before the refresh. When an upload fails the frame is converted
+ * like the other outputs. When two outputs use the same buffer format and size 
+ * the conversion is done one time and copied. All the outputs are refreshed 
+ * together so they share the stream synchronisation.
+ *  
+ * @{
+ */
+
+/* the maximum number of outputs fed by a fan-out object */
+#define WV_STREAM_FANOUT_MAX_OUTPUTS 8
+
+/**
+ * \brief Get a new fan-out streaming object
+ * 
+ * Create an empty fan-out object. Add the outputs with ::WV_addStreamFanoutOutput
+ * and give it to the stream with ::WV_setStreamingMethod. Be carefull to 
+ * use it only for one video stream ! ::WV_addStreamingMethod do it for you.
+ *
+ */
+WVStreamingObject* WV_getStreamFanoutObj(void);
+
+
+/**
+ * \brief Add an output to a fan-out streaming object
+ * 
+ * \param fanoutObj The fan-out object
+ * \param outputObj The streaming object fed by the fan-out
+ * 
+ * The output is initialized, refreshed and closed by the fan-out object, so
+ * don't give it to a stream. Must be done before loading the stream. Return -1 
+ * if the fan-out object is full. 
+ *
+ */
+int WV_addStreamFanoutOutput(WVStreamingObject* fanoutObj, WVStreamingObject* outputObj);
+
+
+/**
+ * \brief Free a fan-out streaming object
+ *
+ * \param streamObj The released streaming object
+ *
+ * Free a streaming object created with ::WV_getStreamFanoutObj. The outputs are
+ * not freed. Be carefull that the streaming object pointer is not reset.
+ *
+ */
+void WV_freeStreamFanoutObj(WVStreamingObject* streamObj);
+
+/** @} */
+
+
+
+/*****************************/
+/* The memory stream object  */
+/*****************************/
+
+/** 
+ * \defgroup streammemory Memory streaming object
+ *
+ * The memory object keep the decoded frames in memory without any display, so 
+ * the video streams can be decoded on a machine without display or used offscreen.
+ * The buffers are got without lock so the whole conversion is done by the decoder
+ * thread. Each refresh call an optional user callback with the refreshed frame.
+ * With the WV_PULL_PRESENT method (see ::WV_setPresentMethod) the frames are
+ * refreshed as fast as ::WV_presentDue is called with a forwarded clock.
+ *  
+ * @{
+ */
+
+/* the memory object slots */
+#define WV_STREAM_MEMORY_DEFAULT_SLOTS 3
+#define WV_STREAM_MEMORY_MAX_SLOTS 16
+
+/**
+ * \brief The refresh callback of the memory objects
+ *
+ * Called by the refreshing thread with the refreshed frame. The frame buffer stay 
+ * valid until the next refresh.
+ */
+typedef void (*WVMemoryFrameCall)(WVStreamingBuffer* frame, void* param);
+
+/**
+ * \brief Get a new memory streaming object
+ * 
+ * \param format The frame pixel format, PIX_FMT_NONE to keep the decoded format
+ * \param width The frame width, 0 to keep the decoded size
+ * \param height The frame height, 0 to keep the decoded size
+ * \param nbSlots The number of decoded frames kept in advance, 0 for the default
+ * \param frameCall Called at each refresh, can be NULL
+ * \param param Given to frameCall
+ *
+ * Give it to only one video stream with ::WV_setStreamingMethod. Return NULL if the 
+ * parameters are not valid.
+ *
+ */
+WVStreamingObject* WV_getStreamMemoryObj(enum PixelFormat format, int width, int height, int nbSlots, \
+					 WVMemoryFrameCall frameCall, void* param);
+
+
+/**
+ * \brief Get the number of refreshed frames
+ * 
+ * \param streamObj A memory streaming object
+ * 
+ * Return the number of frames refreshed since the stream was loaded.
+ *
+ */
+uint32_t WV_getStreamMemoryFrames(WVStreamingObject* streamObj);
+
+
+/**
+ * \brief Get the last refreshed frame
+ * 
+ * \param streamObj A memory streaming object
+ * 
+ * Return the last refreshed frame or NULL if none. The frame is only valid 
+ * until the next refresh, so read it from the refreshing thread.
+ *
+ */
+WVStreamingBuffer* WV_getStreamMemoryLastFrame(WVStreamingObject* streamObj);
+
+
+/**
+ * \brief Free a memory streaming object
+ *
+ * \param streamObj The released streaming object
+ *
+ * Free a streaming object created with ::WV_getStreamMemoryObj. Be carefull 
+ * that the streaming object pointer is not reset.
+ *
+ */
+void WV_freeStreamMemoryObj(WVStreamingObject* streamObj);
+
+/** @} */
+
+
+
 #ifdef __cplusplus
 }
 #endif
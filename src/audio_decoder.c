@@ -37,6 +37,8 @@
 #include "audio_decoder_eofs.h"
 #include "audio_decoder_mods.h"
 #include "eof_signal.h"
+#include "task_runtime.h"
+#include "time_source.h"
 
 
 /**********************************/
@@ -45,6 +47,7 @@
 /**********************************/
 
 typedef struct AudioBitStream{
+  struct AudioDecoder* decoder; //the decoder thread of the stream
   WVQueueHandle queueHdl;  //the queue where we get pkts
   AVCodecContext* codec;   //the codec needed to decode pkts
   AVRational timeBase;     //need to read pts values
@@ -77,6 +80,12 @@ typedef struct AudioBitStream{
   /* seek */
   int seekingDoneFlag;  //to know if the decoder have already seek
   int blockingSeekFlag; //if this flag is set, a paused stream stay paused after the seek
+  uint32_t accurateSeekClock; //the seek target given by the user, UINT32_MAX for a keyframe seek
+
+  /* accurate seek */
+  /* the samples before the target are trimmed */
+  uint32_t trimClock;      //the seek target, UINT32_MAX when the trimming is done
+  double trimPosClock;     //the clock of the next decoded sample (ms), <0 if unknown
 
   /* decoding */
   AVPacket* pkt;           //the pkt we actually decoding
@@ -102,29 +111,116 @@ typedef struct AudioBitStream{
   WVADEOFList* eofL;
   void* eofSignalHandle;
 
+  /* gapless eof */
+  /* the delayed frames are drained before threading the eof pkt */
+  AVPacket* eofPkt;          //the eof pkt held while draining, NULL otherwise
+  int drainGotFrame;         //the last drain pkt gave a frame
+  int drainDoneFlag;         //the codec is drained, the eof pkt can be threaded
+
+  /* next source */
+  /* at eof the stream continue with another queue and codec */
+  WVQueueHandle nextQueueHdl;     //NULL if there are no next source
+  AVCodecContext* nextCodec;
+  AVRational nextTimeBase;
+  WVSpliceSignalCall spliceCall;  //called by the decoder when the source is switched
+  void* spliceParam;
+
 }AudioBitStream;
 
   
 /*********************************************/
 /* The decoder works like a state machine so */
 /* here the internal variables               */
+/* each engine has its own decoder, with its */
+/* thread and its audio device               */
 /*********************************************/
 
+typedef struct AudioDecoder{
+
+  /* the audio device */
+  #if SDL_VERSION_ATLEAST(2,0,0)
+  SDL_AudioDeviceID audioDevice;
+  #endif
+  unsigned int audioBlockSize;   //the audio block size we get when we init the audio 
+
+  /* denoise callback times */
+  uint32_t* callbackTimes;
+  int callbackTWritePos;
+  int callbackTSize;
+
+  /* this the main mutex */
+  int stateUpdatedFlag;    
+  SDL_mutex* stateUpdatedMutex;
+  SDL_cond*  stateUpdated;   //WAIT (decoder):"I have nothing to do, wait for mixer getting 
+                             //               blocks or client sending command"
+                             //SIGNAL (Mix or cli) : "A commans was send" or "A pkt was get"
+
+  SDL_Thread* thread;
+
+  /* the streams used by the decoder */
+  /* to send decoded data to the mixer */
+  AudioBitStream* audioStreams[WV_AUDIO_DECODER_MAX_STREAMS];
+  int nbAudioStream;
+
+  SDL_mutex* audioStreamMutex;
+  SDL_cond* audioStreamUpdated;
+
+  /* if the mixer have started his job */
+  int playFlag;               //protected by the audioStreamMutex
+  SDL_cond* playingFinished;  //decoder may want to wait for playing finished
 
-//the size of the audio block 
-static unsigned int audioBlockSize;   //the audio block size we get when we init the audio 
+  /* buffer for calculation */
+  double* calcBuffer;  //same nb of double than int in the audio buffer 
+
+  /* the decoder start/pause the audio */
+  int audioRunningFlag;
+
+  /* the lacking streams are decoded in parallel */
+  /* by the task runtime workers */
+  WVTaskGroupHandle decodeGroup;
+
+  /* the command, see below */
+  int decoderCommand;        //where the client put the command
+  SDL_mutex* clientMutex;    //the commands can be sent by several threads (API and loaders)
+                             //the params and the command are set under this lock
+
+  SDL_mutex* cmdMutex;
+  SDL_cond* cmdExecuted;     //the client need to wait for command execution 
+                             //before continuing
+                             //WAIT (client) : "I have sent you a command say me 
+                             //                 the work is done"
+                             //SIGNAL (decoder) : "Well, command terminated"
+
+  /* the command parameters */
+  int deleteStreamIdx;               //when we delete we give the stream idx to the decoder
+  WVAudioStreamHandle seekingStreamHandle;  //when we seek we give the stream to the decoder 
+
+  WVAudioStreamHandle nextSourceStreamHandle; //when we set the next source
+  WVQueueHandle nextSourceQueueHdl;
+  AVCodecContext* nextSourceCodec;
+  AVRational nextSourceTimeBase;
+  WVSpliceSignalCall nextSourceSpliceCall;
+  void* nextSourceSpliceParam;
+
+}AudioDecoder;
 
 
 //this is the space needed to decode one audio frame 
 //in the case where we can have a partial block in the buffer
-#define DECODE_SEGMENT_SIZE (WV_DECODE_TARGET_SIZE + audioBlockSize)
+#define DECODE_SEGMENT_SIZE(decoder) (WV_DECODE_TARGET_SIZE + (decoder)->audioBlockSize)
 
 //the decoder need two segment 
-#define AUDIO_DECODER_BUFFER_SIZE 2*DECODE_SEGMENT_SIZE
+#define AUDIO_DECODER_BUFFER_SIZE(decoder) (2*DECODE_SEGMENT_SIZE(decoder))
 
 //this is the byte limit where the decoder need to return to the beginning of the buffer
 //because we don't have enough space to decode a frame
-#define AUDIO_DECODER_RETURN_LIMIT (DECODE_SEGMENT_SIZE + audioBlockSize)
+#define AUDIO_DECODER_RETURN_LIMIT(decoder) (DECODE_SEGMENT_SIZE(decoder) + (decoder)->audioBlockSize)
+
+
+#if !SDL_VERSION_ATLEAST(2,0,0)
+/* SDL 1.2 have only one audio device */
+static int legacyAudioOpenFlag = 0;
+#endif
 
 
 
@@ -132,16 +228,11 @@ static unsigned int audioBlockSize;   //the audio block size we get when we init
 /* denoise callback times */
 /**************************/
 
-/* store the callback times */ 
-static uint32_t* callbackTimes;
-static int callbackTWritePos;
-static int callbackTSize;
-
 
 /* avoid round error */
-static uint32_t getBlockDuration(int nbBlocks)
+static uint32_t getBlockDuration(AudioDecoder* decoder, int nbBlocks)
 {
-  unsigned int blockSamples = audioBlockSize/2;       //we use int16_t
+  unsigned int blockSamples = decoder->audioBlockSize/2;       //we use int16_t
   unsigned int nbSamples = nbBlocks * blockSamples;   //the overflow is after 13 hour
                                                       // with 32 bit ints
 
@@ -159,9 +250,9 @@ static uint32_t getBlockDuration(int nbBlocks)
 }  
 
 /* to init the filter size */
-static void initCallbackFilter(void)
+static void initCallbackFilter(AudioDecoder* decoder)
 {
-  uint32_t blockDuration = getBlockDuration(1);
+  uint32_t blockDuration = getBlockDuration(decoder, 1);
   uint32_t filterDuration = WV_CALLBACK_DENOISE_FILTER_SIZE;
 
   int filterSize = filterDuration / blockDuration;
@@ -171,25 +262,25 @@ static void initCallbackFilter(void)
     filterSize++;
 
   /* alloc the buffer */
-  callbackTSize = filterSize;
-  callbackTWritePos = 0;
-  callbackTimes = (uint32_t*)malloc(filterSize*sizeof(uint32_t));
+  decoder->callbackTSize = filterSize;
+  decoder->callbackTWritePos = 0;
+  decoder->callbackTimes = (uint32_t*)malloc(filterSize*sizeof(uint32_t));
   
   int i;
   for(i=0; i<filterSize; i++)
-    callbackTimes[i] = 0;
+    decoder->callbackTimes[i] = 0;
 }
 
 
 /* mean filter calculation */
-static uint32_t getMeanCallbackT(void)
+static uint32_t getMeanCallbackT(AudioDecoder* decoder)
 {
   int i;
   double sum = 0;
-  double size = (double)callbackTSize;
+  double size = (double)decoder->callbackTSize;
 
-  for(i=0; i<callbackTSize; i++)
-    sum += (double)callbackTimes[i]/size;
+  for(i=0; i<decoder->callbackTSize; i++)
+    sum += (double)decoder->callbackTimes[i]/size;
 
   return (uint32_t)sum;
 }
@@ -198,19 +289,21 @@ static uint32_t getMeanCallbackT(void)
 /* give the audio drift : drift -> standard */
 static int getAudioDrift(AudioBitStream* audioStream)
 {
+  AudioDecoder* decoder = audioStream->decoder;
+
   /* if noMixingCallbacks > 1 the audio is not playing */
   if(audioStream->noMixingCallbacks > 1)
     return 0;
 
   /* check if we have enough callbacks for this stream */
   /* to fill the mean filter */ 
-  if(audioStream->nbMixedBlocks < callbackTSize)
+  if(audioStream->nbMixedBlocks < decoder->callbackTSize)
     return 0; //not enough blocks
   
   /************************************************/
   /* compute the "theorical" time (with data use) */
   /************************************************/
-  int midSize = callbackTSize/2;
+  int midSize = decoder->callbackTSize/2;
   int filterCenter = audioStream->nbMixedBlocks + audioStream->noMixingCallbacks;
   filterCenter -= midSize;
   filterCenter -= 2;  //the audio start when nb=2
@@ -219,13 +312,13 @@ static int getAudioDrift(AudioBitStream* audioStream)
     return 0;
 
   uint32_t linearTime = audioStream->audioStartTime;
-  linearTime += getBlockDuration(filterCenter); //the center of the filter
+  linearTime += getBlockDuration(decoder, filterCenter); //the center of the filter
 
 
   /*******************************/
   /* compute the "filtered" time */
   /*******************************/
-  uint32_t meanTime = getMeanCallbackT();
+  uint32_t meanTime = getMeanCallbackT(decoder);
 
 
 
@@ -239,31 +332,6 @@ static int getAudioDrift(AudioBitStream* audioStream)
 
 
 
-/***********************/
-/* this the main mutex */
-/***********************/
-static int stateUpdatedFlag;    
-static SDL_mutex* stateUpdatedMutex;
-static SDL_cond*  stateUpdated;   //WAIT (decoder):"I have nothing to do, wait for mixer getting 
-                                  //               blocks or client sending command"
-                                  //SIGNAL (Mix or cli) : "A commans was send" or "A pkt was get"
-
-
-
-
-
-/*************************************/
-/* the streams used by the decoder   */
-/* to send decoded data to the mixer */
-/*************************************/
-
-static AudioBitStream* audioStreams[WV_AUDIO_DECODER_MAX_STREAMS];
-
-static int nbAudioStream;
-
-static SDL_mutex* audioStreamMutex;
-static SDL_cond* audioStreamUpdated;
-
 
 
 
@@ -279,6 +347,7 @@ static SDL_cond* audioStreamUpdated;
 WVReferenceClock WV_getAudioClock(WVAudioStreamHandle streamHdl)
 {
   AudioBitStream* stream = (AudioBitStream*)streamHdl;
+  AudioDecoder* decoder = stream->decoder;
   
 
   WVReferenceClock newClock;
@@ -291,18 +360,18 @@ WVReferenceClock WV_getAudioClock(WVAudioStreamHandle streamHdl)
   /*************/
   /* get ticks */
   /*************/
-  uint32_t currentTime = SDL_GetTicks();
+  uint32_t currentTime = WV_getEngineTicks();
   
   
   /* lock*/
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
 
   /****************************/
   /* the audio is not played  */
   /* while nbMixedBlocks != 2 */
   /****************************/
   if(stream->nbMixedBlocks < 2){
-    SDL_mutexV(audioStreamMutex);
+    SDL_mutexV(decoder->audioStreamMutex);
     newClock.clock = stream->audioClockRef;
     newClock.pauseFlag = 1;
     return newClock;
@@ -316,7 +385,7 @@ WVReferenceClock WV_getAudioClock(WVAudioStreamHandle streamHdl)
   /* for a given nbMixedBlocks            */
   /* the audio can't play after this time */
   /****************************************/
-  uint32_t maxTime = stream->audioStartTime + getBlockDuration(stream->nbMixedBlocks) - 1;
+  uint32_t maxTime = stream->audioStartTime + getBlockDuration(decoder, stream->nbMixedBlocks) - 1;
   
 
   /***********************/
@@ -367,7 +436,7 @@ WVReferenceClock WV_getAudioClock(WVAudioStreamHandle streamHdl)
    
 
   /* unlock and return */
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
   return newClock;
 } 
     
@@ -393,29 +462,18 @@ static inline int16_t floatClamp(double srcVal)
 }
 
 
-/***********************************************************/
-/* this flag is for know if the mixer have started his job */
-/***********************************************************/
-static int playFlag;               //protected by the audioStreamMutex
-static SDL_cond* playingFinished;  //decoder may want to wait for playing finished
-
-
-/**************************/
-/* buffer for calculation */
-/**************************/
-static double* calcBuffer;  //same nb of double than int in the audio buffer 
-
-
 /**********************/
 /* the mixer function */
 /**********************/
 /* mix all the streams and send it to the audio device */
 static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
 {
+  /* the device userdata is the decoder */
+  AudioDecoder* decoder = (AudioDecoder*)userdata;
   
   /* first save the actual time */
   /* SDL call this function when it start to read the previous block */
-  uint32_t callTime = SDL_GetTicks();
+  uint32_t callTime = WV_getEngineTicks();
   
   
   /* this flag is used when the the decoder need to be relaunched */
@@ -427,15 +485,15 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
       
   /*____________________________*/
   /* !!! we lock the streams !!!*/
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
   
   /**********************************/
   /* save time for mean calculation */
   /**********************************/
-  callbackTimes[callbackTWritePos] = callTime;
-  callbackTWritePos++;
-  if(callbackTWritePos >= callbackTSize)
-    callbackTWritePos = 0;
+  decoder->callbackTimes[decoder->callbackTWritePos] = callTime;
+  decoder->callbackTWritePos++;
+  if(decoder->callbackTWritePos >= decoder->callbackTSize)
+    decoder->callbackTWritePos = 0;
 
 
   /* loop while we can't play silence and we have a lack of block */
@@ -448,12 +506,12 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
   while(1){
     noBlockFlag = 0; 
     nbMixingStream = 0;
-    snbAudioStream = nbAudioStream;      //we save nbAudioStream
+    snbAudioStream = decoder->nbAudioStream;      //we save nbAudioStream
                                          //the user can add a stream during mixing
                                          //but this stream will not be mixed this time 
 
     for(streamIdx=0; streamIdx<snbAudioStream; streamIdx++){
-      currStream = audioStreams[streamIdx];
+      currStream = decoder->audioStreams[streamIdx];
     
       /* check if paused */
       /* is the first stop equal to the actual reading position ? */
@@ -471,7 +529,7 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
     
     /* if there are a lack of block we wait before recheck */
     if(noBlockFlag){  //there are a lack of blocks on a playing stream
-      SDL_CondWait(audioStreamUpdated, audioStreamMutex);
+      SDL_CondWait(decoder->audioStreamUpdated, decoder->audioStreamMutex);
       /* we recheck */
     }
     else{
@@ -484,7 +542,7 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
   /* now the clock part */
   /**********************/
   for(streamIdx=0; streamIdx<snbAudioStream; streamIdx++){
-    currStream = audioStreams[streamIdx];
+    currStream = decoder->audioStreams[streamIdx];
     
     /* check for clock reference modificator */
     if(WVAD_needRefMod(currStream->modL, currStream->readPos)){
@@ -526,9 +584,9 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
   /* now is time to play */
   /***********************/
   if(nbMixingStream)
-    playFlag = 1;
+    decoder->playFlag = 1;
   
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
   /*______________________________*/
   /*!!! we release the streams !!!*/
 
@@ -556,10 +614,10 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
     int searchIdx = 0;
     
     /* search for the playing stream */
-    while(!audioStreams[searchIdx]->mixingFlag)
+    while(!decoder->audioStreams[searchIdx]->mixingFlag)
       searchIdx++;
 
-    playingStream = audioStreams[searchIdx];
+    playingStream = decoder->audioStreams[searchIdx];
     srcData = playingStream->readPos;
     
 
@@ -584,25 +642,25 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
 
     /* we load the first playing stream */
     streamIdx = 0;
-    while(!audioStreams[streamIdx]->mixingFlag)
+    while(!decoder->audioStreams[streamIdx]->mixingFlag)
       streamIdx++;
 
-    playingVolume = audioStreams[streamIdx]->volume;
-    srcData = audioStreams[streamIdx]->readPos;
+    playingVolume = decoder->audioStreams[streamIdx]->volume;
+    srcData = decoder->audioStreams[streamIdx]->readPos;
     if(playingVolume <= WV_VOLUME_SKIP_HIGH_THRESHOLD  &&\
        playingVolume >= WV_VOLUME_SKIP_LOW_THRESHOLD){
       for(i=0; i<len; i++)
-	calcBuffer[i] = (double)srcData[i];
+	decoder->calcBuffer[i] = (double)srcData[i];
     }
     else{
       for(i=0; i<len; i++)
-	calcBuffer[i] = (double)srcData[i]*playingVolume;
+	decoder->calcBuffer[i] = (double)srcData[i]*playingVolume;
     }
 
     /* we mix with the other streams */
     streamIdx++;
     while(streamIdx<snbAudioStream){
-      currStream = audioStreams[streamIdx];
+      currStream = decoder->audioStreams[streamIdx];
       if(currStream->mixingFlag){
 	playingVolume = currStream->volume;
 	srcData = currStream->readPos;
@@ -610,11 +668,11 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
 	if(playingVolume <= WV_VOLUME_SKIP_HIGH_THRESHOLD  &&\
 	   playingVolume >= WV_VOLUME_SKIP_LOW_THRESHOLD){
 	  for(i=0; i<len; i++)
-	    calcBuffer[i] += (double)srcData[i];
+	    decoder->calcBuffer[i] += (double)srcData[i];
 	}
 	else{
 	  for(i=0; i<len; i++)
-	    calcBuffer[i] += (double)srcData[i]*playingVolume;
+	    decoder->calcBuffer[i] += (double)srcData[i]*playingVolume;
 	}
       }
       streamIdx++;
@@ -622,7 +680,7 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
 
     /* now we send to the audio buffer */
     for(i=0; i<len; i++)
-      mixedStream[i] = floatClamp(calcBuffer[i]);
+      mixedStream[i] = floatClamp(decoder->calcBuffer[i]);
   }
 
   
@@ -630,14 +688,14 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
 
   /*_____________________*/
   /* we lock the streams */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
 
 
   /*********************************************/
   /* now we update the stream reading position */
   /*********************************************/
   for(streamIdx=0; streamIdx<snbAudioStream; streamIdx++){
-    currStream = audioStreams[streamIdx];
+    currStream = decoder->audioStreams[streamIdx];
     
     /* if the stream was played */
     if(currStream->mixingFlag){
@@ -661,8 +719,8 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
 
 
   /* playing is finished */
-  playFlag = 0;
-  SDL_CondSignal(playingFinished); //if the decoder wait 
+  decoder->playFlag = 0;
+  SDL_CondSignal(decoder->playingFinished); //if the decoder wait 
 
   
   /* we decrease the number of blocks */
@@ -670,7 +728,7 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
   //need to be relaunched
 
   for(streamIdx=0; streamIdx<snbAudioStream; streamIdx++){
-    currStream = audioStreams[streamIdx];
+    currStream = decoder->audioStreams[streamIdx];
     if(currStream->mixingFlag){
       currStream->nbBlocks--;
       if(currStream->nbBlocks < 2)
@@ -678,17 +736,17 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
     }
   }
 
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
   /*________________________*/
   /* we release the streams */
 
 
   /* signal if the decoder need to be relaunched */
   if(relaunchDecoderFlag){
-    SDL_mutexP(stateUpdatedMutex);
-    stateUpdatedFlag = 1;
-    SDL_mutexV(stateUpdatedMutex);
-    SDL_CondSignal(stateUpdated);
+    SDL_mutexP(decoder->stateUpdatedMutex);
+    decoder->stateUpdatedFlag = 1;
+    SDL_mutexV(decoder->stateUpdatedMutex);
+    SDL_CondSignal(decoder->stateUpdated);
   }
 }
 
@@ -697,7 +755,9 @@ static void mixerCallback(void* userdata, Uint8* buffer, int bufferSize)
 /* !!! lock the audioStreams first !!! */
 static int streamIsMixed(AudioBitStream* stream)
 {
-  if(!playFlag || (playFlag && !stream->mixingFlag))
+  AudioDecoder* decoder = stream->decoder;
+
+  if(!decoder->playFlag || (decoder->playFlag && !stream->mixingFlag))
     return 0;
   else 
     return 1;
@@ -719,12 +779,14 @@ static int streamIsMixed(AudioBitStream* stream)
 /*********************************************************/
 
 /*blocking flag say if a paused stream need to stay paused after seeking */
-void WV_startAudioSeeking(WVAudioStreamHandle streamHdl, int blockingFlag)
+/*accurate clock say where the first played sample is, UINT32_MAX to start at the keyframe */
+void WV_startAudioSeeking(WVAudioStreamHandle streamHdl, int blockingFlag, uint32_t accurateClock)
 {
   AudioBitStream* seekingStream = (AudioBitStream*)streamHdl;
   
   seekingStream->seekingDoneFlag = 0;
   seekingStream->blockingSeekFlag = blockingFlag;
+  seekingStream->accurateSeekClock = accurateClock;
 }
 
 
@@ -736,12 +798,14 @@ void WV_startAudioSeeking(WVAudioStreamHandle streamHdl, int blockingFlag)
 
 void seekAudioStream(AudioBitStream* seekingStream)
 {
+  AudioDecoder* decoder = seekingStream->decoder;
+
   /*_________*/
   /* we lock */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
   
   
-  unsigned int blockLen = audioBlockSize/2;
+  unsigned int blockLen = decoder->audioBlockSize/2;
 
   /***********************************/
   /* we delete all the stops         */
@@ -814,7 +878,7 @@ void seekAudioStream(AudioBitStream* seekingStream)
     seekingStream->writePos = seekingStream->readPos + blockLen;  //after the last block
     seekingStream->bytePos = (uint8_t*)seekingStream->writePos - (uint8_t*)seekingStream->data;
     /* time to return ? */
-    if(seekingStream->bytePos > AUDIO_DECODER_RETURN_LIMIT){
+    if(seekingStream->bytePos > AUDIO_DECODER_RETURN_LIMIT(decoder)){
       seekingStream->streamEnd = seekingStream->writePos;  //we are at the end of a block
       seekingStream->writePos = seekingStream->data;
       seekingStream->bytePos = 0;
@@ -831,6 +895,13 @@ void seekAudioStream(AudioBitStream* seekingStream)
     seekingStream->pkt = NULL;
   }
 
+  /* the eof held while draining is obsolete */
+  if(seekingStream->eofPkt){
+    free(seekingStream->eofPkt);
+    seekingStream->eofPkt = NULL;
+  }
+  seekingStream->drainDoneFlag = 0;
+
 
   /* free the codec internal buffers */
   avcodec_flush_buffers(seekingStream->codec);
@@ -843,14 +914,19 @@ void seekAudioStream(AudioBitStream* seekingStream)
 
 
   /* we will put a mod at the next block */
-  seekingStream->saveClockModPos = seekingStream->writePos + (audioBlockSize/2); //writePos is at a block start
+  seekingStream->saveClockModPos = seekingStream->writePos + (decoder->audioBlockSize/2); //writePos is at a block start
+
+  /* accurate seek : trim the samples before the target */
+  //the mod will be saved when the first sample is kept
+  seekingStream->trimClock = seekingStream->accurateSeekClock;
+  seekingStream->trimPosClock = -1.0;
   
     
 
   /* ok seeking is done */
   /* say it and release the streams */
   seekingStream->seekingDoneFlag = 1;
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
 
   /*_________________*/
   /*streams released */
@@ -864,6 +940,129 @@ void seekAudioStream(AudioBitStream* seekingStream)
 
   
 
+/***********************************************/
+/* save the clock mod at saveClockModPos       */
+/* refClock is the clock of the sample at      */
+/* writePos, the next sample to be written     */
+/***********************************************/
+static void saveClockMod(AudioBitStream* decodingStream, double refClock)
+{
+  AudioDecoder* decoder = decodingStream->decoder;
+
+  /* compute the time shift if we not decode a the beginning of a block */
+  int lackingSamples = decodingStream->saveClockModPos - decodingStream->writePos;
+  lackingSamples -= decoder->audioBlockSize/2; 
+
+  if(lackingSamples > 0){
+    double lackingTime = lackingSamples / (double)(WV_DECODER_SAMPLE_RATE * 2);
+    lackingTime *= 1000;
+    refClock += lackingTime;
+  }
+
+  /* save the mod */
+  uint32_t modValue = (uint32_t)refClock;
+  WVAD_saveRefMod(decodingStream->modL,\
+		  decodingStream->saveClockModPos,\
+		  modValue);
+	
+  /* ok it's saved */
+  decodingStream->saveClockModPos = NULL;
+}
+
+
+/***********************************************/
+/* accurate seek : trim the decoded frame      */
+/* written at writePos if it start before the  */
+/* seek target. frameSize is in samples and    */
+/* updated with the kept samples               */
+/* return 1 if all the frame need to be droped */
+/***********************************************/
+static int trimAudioFrame(AudioBitStream* decodingStream, int* frameSize)
+{
+  /* we can't trim without pts */
+  if(decodingStream->trimPosClock < 0){
+    decodingStream->trimClock = UINT32_MAX;
+    return 0;
+  }
+
+  /* the samples before the target */
+  double trimTime = decodingStream->trimClock - decodingStream->trimPosClock;
+  int trimSamples = 0;
+  if(trimTime > 0)
+    trimSamples = (int)(trimTime * WV_DECODER_SAMPLE_RATE / 1000 + 0.5);
+
+  /* drop all the frame */
+  if(trimSamples >= *frameSize){
+    decodingStream->trimPosClock += (*frameSize * 1000.0) / WV_DECODER_SAMPLE_RATE;
+    return 1;
+  }
+
+  /* keep the end of the frame */
+  if(trimSamples > 0){
+    int i;
+    int16_t* writePos = decodingStream->writePos;
+    int16_t* keptPos = writePos + trimSamples*WV_DECODER_CHANNELS;
+    *frameSize -= trimSamples;
+    for(i=0; i<(*frameSize)*WV_DECODER_CHANNELS; i++)
+      writePos[i] = keptPos[i];
+  }
+
+  /* the trimming is done */
+  //the clock now start exactly at the target
+  decodingStream->trimClock = UINT32_MAX;
+  if(decodingStream->saveClockModPos)
+    saveClockMod(decodingStream, decodingStream->trimPosClock + trimTime);
+
+  return 0;
+}
+
+
+/***********************************************/
+/* get the next pkt to decode                  */
+/* while draining, the eof pkt is held and the */
+/* codec get drain pkts until it give nothing  */
+/***********************************************/
+static AVPacket* getAudioPacket(AudioBitStream* decodingStream)
+{
+  if(decodingStream->eofPkt){
+    /* the codec may have more frames */
+    if(decodingStream->drainGotFrame)
+      return WV_getDrainPacket();
+
+    /* drained, give back the eof pkt */
+    AVPacket* eofPkt = decodingStream->eofPkt;
+    decodingStream->eofPkt = NULL;
+    decodingStream->drainDoneFlag = 1;
+    return eofPkt;
+  }
+
+  return WV_packetQueueGet(decodingStream->queueHdl, WV_QUEUE_GET_WAIT);
+}
+
+
+/***********************************************/
+/* at eof, continue with the next source       */
+/* the old queue and codec are no longer used  */
+/* the splice signal can free them             */
+/***********************************************/
+static void spliceAudioSource(AudioBitStream* decodingStream)
+{
+  decodingStream->queueHdl = decodingStream->nextQueueHdl;
+  decodingStream->codec = decodingStream->nextCodec;
+  decodingStream->timeBase = decodingStream->nextTimeBase;
+  decodingStream->nextQueueHdl = NULL;
+  decodingStream->nextCodec = NULL;
+
+  /* the resampler follow the new codec */
+  if(decodingStream->swrCtx)
+    WV_freeResampleContext(&decodingStream->swrCtx);
+  decodingStream->swrCtx = WV_getResampleContext(decodingStream->codec);
+
+  /* signal */
+  decodingStream->spliceCall(decodingStream->spliceParam);
+}
+
+
 /*********************************************/
 /* this is the function that decode the pkts */
 /* and return audio blocks for the feeder    */
@@ -871,6 +1070,10 @@ void seekAudioStream(AudioBitStream* seekingStream)
 /* if the decoder read a eof pkt and is looping flag is not set */
 /* he put a stop at the last block */
 
+/* before the eof pkt, the delayed frames are drained */
+/* and if a next source is set, the decoder continue */
+/* with it like a looping stream */
+
 /* if the decoder read a seek pkt he flush as possible */
 /* the blocks (the mixer may read some of them) */
 
@@ -879,6 +1082,8 @@ void seekAudioStream(AudioBitStream* seekingStream)
 /*********************************************/
 static int decodeAudio(AudioBitStream* decodingStream)
 {
+  AudioDecoder* decoder = decodingStream->decoder;
+
   /*****************************************/
   /* we decode while we not have new block */
   /*****************************************/
@@ -917,20 +1122,51 @@ static int decodeAudio(AudioBitStream* decodingStream)
       if(!decodingStream->pkt){
       
 	/* we get a new packet */
-	AVPacket* pkt = WV_packetQueueGet(decodingStream->queueHdl, WV_QUEUE_GET_WAIT);
+	AVPacket* pkt = getAudioPacket(decodingStream);
 
 	/* we check if is a speciak pkt */
 	/* if this is the case, do the corresponding job */
-	while(pkt->data == NULL){
+	//the drain pkts are decoded
+	while(pkt->data == NULL && pkt->flags != WV_PACKET_FLAG_DRAIN){
 	  
 	  /*--------------*/
 	  /* the eof case */
 	  /*--------------*/
 	  if(pkt->flags == WV_PACKET_FLAG_EOF){
+
+	    /* first get the delayed frames */
+	    //the eof pkt is threaded again when the codec is drained
+	    if(!decodingStream->drainDoneFlag &&			\
+	       (decodingStream->codec->codec->capabilities & CODEC_CAP_DELAY)){
+	      decodingStream->eofPkt = pkt;
+	      pkt = WV_getDrainPacket();
+	      break;
+	    }
+	    decodingStream->drainDoneFlag = 0;
+
+	    /* accurate seek after the last sample */
+	    //all was trimmed, stop here so the next loop is not trimmed
+	    //and save the seek mod at the stream end
+	    if(decodingStream->trimClock != UINT32_MAX){
+	      double endClock = decodingStream->trimPosClock;
+	      if(endClock < 0)
+		endClock = decodingStream->trimClock;
+	      
+	      decodingStream->trimClock = UINT32_MAX;
+	      if(decodingStream->saveClockModPos)
+		saveClockMod(decodingStream, endClock);
+	    }
 	    
 	    /* flush codec */
 	    avcodec_flush_buffers(decodingStream->codec);
 
+	    /* continue with the next source */
+	    int spliceFlag = 0;
+	    if(decodingStream->nextQueueHdl){
+	      spliceAudioSource(decodingStream);
+	      spliceFlag = 1;
+	    }
+
 	    /****************/
 	    /* thread stops */
 	    /****************/
@@ -944,18 +1180,19 @@ static int decodeAudio(AudioBitStream* decodingStream)
 
 	    /* if looping flag is set just ignore that pkt */
 	    /* else we complete the block with silence and put a stop at the end */
-	    if( loopingFlag == WV_BLOCKING_STREAM ){
+	    //the splice is threaded like a loop
+	    if( loopingFlag == WV_BLOCKING_STREAM && !spliceFlag ){
 	      /* complete the last block if needed*/
 	      if(decodingStream->decodedBytes){//! need decodedBytes is less than one block here(ok)
-		int lackingInts = (audioBlockSize - decodingStream->decodedBytes)/2;
+		int lackingInts = (decoder->audioBlockSize - decodingStream->decodedBytes)/2;
 		writePos = decodingStream->writePos;
 		for(i=0; i<lackingInts; i++)
 		  writePos[i] = 0;
 	
 		/* return to buffer start if needed */
-		decodingStream->decodedBytes = audioBlockSize; //we have now a complete block
+		decodingStream->decodedBytes = decoder->audioBlockSize; //we have now a complete block
 		decodingStream->bytePos += lackingInts*2;
-		if(decodingStream->bytePos > AUDIO_DECODER_RETURN_LIMIT){
+		if(decodingStream->bytePos > AUDIO_DECODER_RETURN_LIMIT(decoder)){
 		  decodingStream->streamEnd = decodingStream->writePos;//we're at the end of a block
 		  decodingStream->writePos = decodingStream->data;
 		  decodingStream->bytePos = 0;
@@ -975,9 +1212,9 @@ static int decodeAudio(AudioBitStream* decodingStream)
 	    /**********************/
 
 	    /* check if the current block is not completed */
-	    unsigned int blockShift = decodingStream->bytePos % audioBlockSize;
+	    unsigned int blockShift = decodingStream->bytePos % decoder->audioBlockSize;
 	    if(blockShift)
-	      blockShift = audioBlockSize - blockShift;
+	      blockShift = decoder->audioBlockSize - blockShift;
 	    
 	    
 	    /* save eof signal pos */
@@ -992,7 +1229,7 @@ static int decodeAudio(AudioBitStream* decodingStream)
 	    /* at a beginning of a block */
 	    
 	    /* go to the next block */
-	    blockShift += audioBlockSize;
+	    blockShift += decoder->audioBlockSize;
 
 	    /* save the position */
 	    decodingStream->saveClockModPos = decodingStream->writePos + (blockShift/2);
@@ -1016,13 +1253,20 @@ static int decodeAudio(AudioBitStream* decodingStream)
 	  /* free the special pkt and get another */
 	  //don't use av_free_packet !!!
 	  free(pkt);
-	  pkt = WV_packetQueueGet(decodingStream->queueHdl, WV_QUEUE_GET_WAIT);
+	  pkt = getAudioPacket(decodingStream);
 	}
 
 	/* now put own new pkt in the stream struct */
 	decodingStream->pkt = pkt;
 	decodingStream->srcPktData = pkt->data; //seems we need to restore the pkt to free it
 	decodingStream->srcPktSize = pkt->size;
+
+	/* while trimming follow the pkt clock */
+	if(decodingStream->trimClock != UINT32_MAX && pkt->pts != AV_NOPTS_VALUE){
+	  decodingStream->trimPosClock = (double)(pkt->pts);
+	  decodingStream->trimPosClock *= av_q2d(decodingStream->timeBase);
+	  decodingStream->trimPosClock *= 1000;
+	}
       }
 
 
@@ -1030,31 +1274,17 @@ static int decodeAudio(AudioBitStream* decodingStream)
       /* THREAD CLOCK REF MODS */
       /*************************/
       /* if we have a mod to save, do it now */
-      if(decodingStream->saveClockModPos){
+      //when trimming, the mod is saved at the first kept sample
+      //the drain pkts have no data and no pts
+      if(decodingStream->saveClockModPos && decodingStream->trimClock == UINT32_MAX && \
+	 decodingStream->pkt->data){
 	/* get the clock given by the pts */
 	double newRefClock;
 	newRefClock = (double)(decodingStream->pkt->pts);
 	newRefClock *= av_q2d(decodingStream->timeBase);
 	newRefClock *= 1000;
 
-	/* compute the time shift if we not decode a the beginning of a block */
-	int lackingSamples = decodingStream->saveClockModPos - decodingStream->writePos;
-	lackingSamples -= audioBlockSize/2; 
-
-	if(lackingSamples > 0){
-	  double lackingTime = lackingSamples / (double)(WV_DECODER_SAMPLE_RATE * 2);
-	  lackingTime *= 1000;
-	  newRefClock += lackingTime;
-	}
-
-	/* save the mod */
-	uint32_t modValue = (uint32_t)newRefClock;
-	WVAD_saveRefMod(decodingStream->modL,\
-			decodingStream->saveClockModPos,\
-			modValue);
-	
-	/* ok it's saved */
-	decodingStream->saveClockModPos = NULL;
+	saveClockMod(decodingStream, newRefClock);
       }
 	
       
@@ -1072,6 +1302,10 @@ static int decodeAudio(AudioBitStream* decodingStream)
       /* decode */
       decodedBytes = WV_decodeAudio(decodingStream->codec, decodingStream->decodedFrame, &gotFrame, pkt);
 
+      /* while draining, continue until the codec give nothing */
+      if(decodingStream->eofPkt)
+	decodingStream->drainGotFrame = gotFrame;
+
 
       /* check decode */
       if(decodedBytes < 0)
@@ -1111,6 +1345,11 @@ static int decodeAudio(AudioBitStream* decodingStream)
     if(frameSize < 0)
       continue;
 
+    /* accurate seek : drop the samples before the target */
+    if(decodingStream->trimClock != UINT32_MAX)
+      if(trimAudioFrame(decodingStream, &frameSize))
+	continue;
+
     /* the size in bytes */
     frameSize *= WV_DECODER_CHANNELS; //stereo
     frameSize *= 2;                   //s16 audio
@@ -1126,9 +1365,9 @@ static int decodeAudio(AudioBitStream* decodingStream)
     decodingStream->decodedBytes += frameSize;
       
     /* maybe we need to restart at the begining of the buffer */
-    if(decodingStream->bytePos > AUDIO_DECODER_RETURN_LIMIT){
+    if(decodingStream->bytePos > AUDIO_DECODER_RETURN_LIMIT(decoder)){
       //compute the number of bytes after the last block
-      unsigned int decreaseByte = decodingStream->bytePos % audioBlockSize;
+      unsigned int decreaseByte = decodingStream->bytePos % decoder->audioBlockSize;
       //and set stream end 
       decodingStream->streamEnd = decodingStream->writePos - (decreaseByte/2);
       decodingStream->writePos = decodingStream->data;
@@ -1145,8 +1384,8 @@ static int decodeAudio(AudioBitStream* decodingStream)
     /*******************************************/
     /* now check if we have decoded new blocks */
     /*******************************************/
-    newBlocks = decodingStream->decodedBytes/audioBlockSize;
-    decodingStream->decodedBytes = decodingStream->decodedBytes % audioBlockSize;
+    newBlocks = decodingStream->decodedBytes/decoder->audioBlockSize;
+    decodingStream->decodedBytes = decodingStream->decodedBytes % decoder->audioBlockSize;
   }
 
   /*************************/
@@ -1172,43 +1411,33 @@ static int decodeAudio(AudioBitStream* decodingStream)
 //pauseStream doesn't need to send a command to the decoder
 //playStream doesn't need to send a command to the decoder
 #define AUDIO_DECODER_QUIT 4
+#define AUDIO_DECODER_NEXT_SOURCE 5
 
-static int decoderCommand;    //where the client put the command
-
-static SDL_mutex* cmdMutex;
-static SDL_cond* cmdExecuted;  //the client need to wait for command execution 
-                               //before continuing
-                               //WAIT (client) : "I have sent you a command say me 
-                               //                 the work is done"
-                               //SIGNAL (decoder) : "Well, command terminated"
-
-
-static int deleteStreamIdx;               //when we delete we give the stream idx to the decoder
-static WVAudioStreamHandle seekingStreamHandle;  //when we seek we give the stream to the decoder 
+//the command and its parameters are in the AudioDecoder struct
 
 /* !!! very important function !!! */
 /* used each time we send a command to the decoder */
 /* send a command, signal state change, and wait for execution */
-static void sendDecoderCommand(int cmd)
+static void sendDecoderCommand(AudioDecoder* decoder, int cmd)
 {
   /* send the command to the decoder */
-  SDL_mutexP(cmdMutex);
-  decoderCommand = cmd;
+  SDL_mutexP(decoder->cmdMutex);
+  decoder->decoderCommand = cmd;
   
   /* signal that state is updated */
-  SDL_mutexP(stateUpdatedMutex);    //change the state flag
-  stateUpdatedFlag = 1;
-  SDL_mutexV(stateUpdatedMutex);
+  SDL_mutexP(decoder->stateUpdatedMutex);    //change the state flag
+  decoder->stateUpdatedFlag = 1;
+  SDL_mutexV(decoder->stateUpdatedMutex);
 
-  SDL_CondSignal(stateUpdated);  //say to the decoder that it can thread commands
+  SDL_CondSignal(decoder->stateUpdated);  //say to the decoder that it can thread commands
                                  //or restart decoding                                  
                                  //if he was waiting 
   
   /* wait for command execution */
-  SDL_CondWait(cmdExecuted, cmdMutex); 
+  SDL_CondWait(decoder->cmdExecuted, decoder->cmdMutex); 
   
   /* release command variable  */
-  SDL_mutexV(cmdMutex);
+  SDL_mutexV(decoder->cmdMutex);
 }
 
 
@@ -1220,17 +1449,19 @@ static void sendDecoderCommand(int cmd)
 /***************************************************/
 
 /* return a stream handle */
-WVAudioStreamHandle WV_addAudioStream(WVQueueHandle queueHdl,\
+WVAudioStreamHandle WV_addAudioStream(WVAudioDecoderHandle decoderHdl, \
+				      WVQueueHandle queueHdl,\
 				      AVCodecContext* codec, \
 				      AVRational timeBase,   \
 				      double volume)				
 {
+  AudioDecoder* decoder = (AudioDecoder*)decoderHdl;
   
   /* alloc space for the structure */
   AudioBitStream* newStream;
 
   int structSize = sizeof(AudioBitStream);        //size of the structure 
-  int dataSize = AUDIO_DECODER_BUFFER_SIZE;       //size of the stream->data, already in bytes
+  int dataSize = AUDIO_DECODER_BUFFER_SIZE(decoder);     //size of the stream->data, already in bytes
   int stopListSize = sizeof(WVADStopList);        //size of the stop list
   int eofListSize = sizeof(WVADEOFList);
   int modListSize = sizeof(WVADModList);          //size of the mod list 
@@ -1254,6 +1485,7 @@ WVAudioStreamHandle WV_addAudioStream(WVQueueHandle queueHdl,\
   newStream->modL = (WVADModList*)currP;
 
   /* set the structure variables */
+  newStream->decoder = decoder;
   newStream->queueHdl = queueHdl;
   newStream->codec = codec;
   newStream->timeBase = timeBase;
@@ -1279,6 +1511,9 @@ WVAudioStreamHandle WV_addAudioStream(WVQueueHandle queueHdl,\
 
   newStream->seekingDoneFlag = 0;
   newStream->blockingSeekFlag = 0;
+  newStream->accurateSeekClock = UINT32_MAX;
+  newStream->trimClock = UINT32_MAX;
+  newStream->trimPosClock = -1.0;
   
   newStream->pkt = NULL;
   newStream->srcPktData = NULL;
@@ -1305,7 +1540,7 @@ WVAudioStreamHandle WV_addAudioStream(WVQueueHandle queueHdl,\
   /* a mod will be put at the end of the first block */
   /* it is at this position than audio start playing */
   int16_t* nextBlock = newStream->writePos;
-  nextBlock += audioBlockSize/2;
+  nextBlock += decoder->audioBlockSize/2;
   
   newStream->saveClockModPos = nextBlock; //the decoder will put the mod
   
@@ -1313,13 +1548,25 @@ WVAudioStreamHandle WV_addAudioStream(WVQueueHandle queueHdl,\
   /* init eof */
   WVAD_initEOFS(newStream->eofL);
   newStream->eofSignalHandle = NULL;
+
+  newStream->eofPkt = NULL;
+  newStream->drainGotFrame = 0;
+  newStream->drainDoneFlag = 0;
+
+  /* no next source */
+  newStream->nextQueueHdl = NULL;
+  newStream->nextCodec = NULL;
+  newStream->spliceCall = NULL;
+  newStream->spliceParam = NULL;
   
 
   /* put the stream on te list */
-  audioStreams[nbAudioStream] = newStream; //the decoder doesn't access this space
+  SDL_mutexP(decoder->clientMutex);
+  decoder->audioStreams[decoder->nbAudioStream] = newStream; //the decoder doesn't access this space
 
   /* send the command */
-  sendDecoderCommand(AUDIO_DECODER_ADD_STREAM);
+  sendDecoderCommand(decoder, AUDIO_DECODER_ADD_STREAM);
+  SDL_mutexV(decoder->clientMutex);
 
   // the decoder increase nbAudioStream
 
@@ -1328,10 +1575,10 @@ WVAudioStreamHandle WV_addAudioStream(WVQueueHandle queueHdl,\
 }
 
 
-static void audioDecoderAddStream(void)
+static void audioDecoderAddStream(AudioDecoder* decoder)
 {
   /* update the stream count */
-  nbAudioStream++;
+  decoder->nbAudioStream++;
 }
 
 
@@ -1351,6 +1598,12 @@ static void freeAudioStream(AudioBitStream* audioStream)
     audioStream->pkt = NULL;
   }    
 
+  /* free the held eof pkt */
+  if(audioStream->eofPkt){
+    free(audioStream->eofPkt);
+    audioStream->eofPkt = NULL;
+  }
+
   /* free the swr context */
   if(audioStream->swrCtx)
     WV_freeResampleContext(&audioStream->swrCtx);
@@ -1366,50 +1619,56 @@ static void freeAudioStream(AudioBitStream* audioStream)
 
 int WV_delAudioStream(WVAudioStreamHandle streamHdl)
 {
+  AudioDecoder* decoder = ((AudioBitStream*)streamHdl)->decoder;
+
   /* find the stream */
   AudioBitStream* searchedStream = (AudioBitStream*)streamHdl;
   
+  SDL_mutexP(decoder->clientMutex);
   int i = 0;
-  while(audioStreams[i] != searchedStream && i<nbAudioStream)
+  while(decoder->audioStreams[i] != searchedStream && i<decoder->nbAudioStream)
     i++;
 
   /* found ? */
-  if(i == nbAudioStream)
+  if(i == decoder->nbAudioStream){
+    SDL_mutexV(decoder->clientMutex);
     return -1;              //cannot find the stream
+  }
   //else the stream is in audioStreams[i]
 
   /* give the command parameter */
-  deleteStreamIdx = i;
+  decoder->deleteStreamIdx = i;
 
   /* and send the command */
-  sendDecoderCommand(AUDIO_DECODER_DEL_STREAM);
+  sendDecoderCommand(decoder, AUDIO_DECODER_DEL_STREAM);
+  SDL_mutexV(decoder->clientMutex);
   
   /* ok the stream is deleted */
   return 0;
 }
 
-static void audioDecoderDelStream(void)
+static void audioDecoderDelStream(AudioDecoder* decoder)
 {
-  AudioBitStream* deletedStream = audioStreams[deleteStreamIdx];
+  AudioBitStream* deletedStream = decoder->audioStreams[decoder->deleteStreamIdx];
 
   /* first we wait if the stream is mixed */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
   if(streamIsMixed(deletedStream))
-    SDL_CondWait(playingFinished, audioStreamMutex);
+    SDL_CondWait(decoder->playingFinished, decoder->audioStreamMutex);
   
   /* free the stream */
   freeAudioStream(deletedStream);
 
   /* now shift the other streams */
   /* we use the variable deleteStreamIdx to do the job */
-  nbAudioStream--;     //update the stream count now !
-  while(deleteStreamIdx < nbAudioStream){  //shift the list  
-    audioStreams[deleteStreamIdx] = audioStreams[deleteStreamIdx+1];
-    deleteStreamIdx++;
+  decoder->nbAudioStream--;     //update the stream count now !
+  while(decoder->deleteStreamIdx < decoder->nbAudioStream){  //shift the list  
+    decoder->audioStreams[decoder->deleteStreamIdx] = decoder->audioStreams[decoder->deleteStreamIdx+1];
+    decoder->deleteStreamIdx++;
   }
 
   /* ok the stream is deleted */
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
 }
 
 
@@ -1421,26 +1680,28 @@ static void audioDecoderDelStream(void)
 void WV_setAudioMasterSync(WVAudioStreamHandle streamHdl, WVSyncObject* AVSync)
 {
   AudioBitStream* stream = (AudioBitStream*)streamHdl;
+  AudioDecoder* decoder = stream->decoder;
 
   /* set the AVSync */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
   
   stream->AVSync = AVSync;
 
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
 
 }
 
 void WV_stopAudioMasterSync(WVAudioStreamHandle streamHdl)
 {
   AudioBitStream* stream = (AudioBitStream*)streamHdl;
+  AudioDecoder* decoder = stream->decoder;
 
   /* set the AVSync */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
   
   stream->AVSync = NULL;
 
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
 
 }
 
@@ -1451,13 +1712,14 @@ void WV_stopAudioMasterSync(WVAudioStreamHandle streamHdl)
 void setAudioDefaultLoopingFlag(WVAudioStreamHandle streamHdl, int loopingFlag)
 {
   AudioBitStream* stream = (AudioBitStream*)streamHdl;
+  AudioDecoder* decoder = stream->decoder;
 
   /* set the default looping flag  */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
   
   stream->defaultLoopingFlag = loopingFlag;
 
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
 }
 
 
@@ -1470,13 +1732,14 @@ void setAudioDefaultLoopingFlag(WVAudioStreamHandle streamHdl, int loopingFlag)
 void WV_setAudioEOFSignalHandle(WVAudioStreamHandle streamHdl, void* eofSignalHandle)
 {
   AudioBitStream* stream = (AudioBitStream*)streamHdl;
+  AudioDecoder* decoder = stream->decoder;
 
   /* set the eof handle */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
   
   stream->eofSignalHandle = eofSignalHandle;
 
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
 }
 
 
@@ -1486,13 +1749,14 @@ void WV_setAudioEOFSignalHandle(WVAudioStreamHandle streamHdl, void* eofSignalHa
 void WV_stopAudioEOFSignalHandle(WVAudioStreamHandle streamHdl)
 {
 AudioBitStream* stream = (AudioBitStream*)streamHdl;
+  AudioDecoder* decoder = stream->decoder;
 
   /* set the AVSync */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
   
   stream->eofSignalHandle = NULL;
 
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
 }
 
 
@@ -1512,11 +1776,15 @@ AudioBitStream* stream = (AudioBitStream*)streamHdl;
 
 int WV_seekAudio(WVAudioStreamHandle streamHdl)
 {
+  AudioDecoder* decoder = ((AudioBitStream*)streamHdl)->decoder;
+
   /* recast the pointer */
-  seekingStreamHandle = streamHdl;
+  SDL_mutexP(decoder->clientMutex);
+  decoder->seekingStreamHandle = streamHdl;
 
   /* send the command */
-  sendDecoderCommand(AUDIO_DECODER_SEEK);
+  sendDecoderCommand(decoder, AUDIO_DECODER_SEEK);
+  SDL_mutexV(decoder->clientMutex);
 
   //the decoder remove the seeking pkt (if needed)
   // and seek (if not already done)
@@ -1526,10 +1794,10 @@ int WV_seekAudio(WVAudioStreamHandle streamHdl)
 }
 
 
-static void audioDecoderSeek(void)
+static void audioDecoderSeek(AudioDecoder* decoder)
 {
   /* read command parameter */
-  AudioBitStream* seekingStream = (AudioBitStream*)seekingStreamHandle; 
+  AudioBitStream* seekingStream = (AudioBitStream*)decoder->seekingStreamHandle; 
   
   /* if seeking is already done by reading a seeking pkt return */
   if(seekingStream->seekingDoneFlag)
@@ -1549,6 +1817,51 @@ static void audioDecoderSeek(void)
 }
 
 
+/***************************************************/
+/*  The command : AUDIO_DECODER_NEXT_SOURCE        */
+/*  -first the user space function                 */
+/*  -next the decoder space function               */
+/***************************************************/
+int WV_setAudioNextSource(WVAudioStreamHandle streamHdl, WVQueueHandle queueHdl, \
+			  AVCodecContext* codec, AVRational timeBase,	\
+			  WVSpliceSignalCall spliceCall, void* spliceParam)
+{
+  AudioDecoder* decoder = ((AudioBitStream*)streamHdl)->decoder;
+
+  /* the splice need to be signaled */
+  if(queueHdl && !spliceCall)
+    return -1;
+  
+  /* set the command params */
+  SDL_mutexP(decoder->clientMutex);
+  decoder->nextSourceStreamHandle = streamHdl;
+  decoder->nextSourceQueueHdl = queueHdl;
+  decoder->nextSourceCodec = codec;
+  decoder->nextSourceTimeBase = timeBase;
+  decoder->nextSourceSpliceCall = spliceCall;
+  decoder->nextSourceSpliceParam = spliceParam;
+
+  /* send the command */
+  sendDecoderCommand(decoder, AUDIO_DECODER_NEXT_SOURCE);
+  SDL_mutexV(decoder->clientMutex);
+
+  return 0;
+}
+
+
+static void audioDecoderNextSource(AudioDecoder* decoder)
+{
+  /* read command parameter */
+  AudioBitStream* stream = (AudioBitStream*)decoder->nextSourceStreamHandle;
+
+  stream->nextQueueHdl = decoder->nextSourceQueueHdl;
+  stream->nextCodec = decoder->nextSourceCodec;
+  stream->nextTimeBase = decoder->nextSourceTimeBase;
+  stream->spliceCall = decoder->nextSourceSpliceCall;
+  stream->spliceParam = decoder->nextSourceSpliceParam;
+}
+
+
 /**************************************/
 /* The PAUSE command                  */
 /* -> only executed by the user       */
@@ -1557,9 +1870,10 @@ static void audioDecoderSeek(void)
 int WV_pauseAudio(WVAudioStreamHandle streamHdl)
 {
   AudioBitStream* pausingStream = (AudioBitStream*)streamHdl;
+  AudioDecoder* decoder = pausingStream->decoder;
   
   /* lock the stream */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
   
   
   /* if the stream is not mixed, put the stop directly at readPos */
@@ -1569,16 +1883,16 @@ int WV_pauseAudio(WVAudioStreamHandle streamHdl)
   /* else we put the stop at the next block */
   else{
     uint8_t* pausePos;
-    pausePos = (uint8_t*)(pausingStream->readPos) + audioBlockSize;
+    pausePos = (uint8_t*)(pausingStream->readPos) + decoder->audioBlockSize;
     WVAD_putStopAtStart(pausingStream->stopL, (int16_t*)pausePos);
   }
 
   /* release the stream */
   /* and signal in the case the mixer is waiting for blocks */
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
 
   /* signal to the mixer */
-  SDL_CondSignal(audioStreamUpdated);  //in the case where callback waiting for pkt
+  SDL_CondSignal(decoder->audioStreamUpdated);  //in the case where callback waiting for pkt
 
   /* useless to signal to the decoder */
   /* the mixer will do it when we can stop the audio */
@@ -1597,9 +1911,10 @@ int WV_pauseAudio(WVAudioStreamHandle streamHdl)
 int WV_playAudio(WVAudioStreamHandle streamHdl)
 {
   AudioBitStream* playingStream = (AudioBitStream*)streamHdl;
+  AudioDecoder* decoder = playingStream->decoder;
   
   /* lock the stream */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
   int stopDeletedFlag = 0;
 
   /* if the stream is not mixed just check the readPos for stops */
@@ -1613,7 +1928,7 @@ int WV_playAudio(WVAudioStreamHandle streamHdl)
   /* if the stream is mixed check at readPos + block size */
   else{
     uint8_t* pausePos;
-    pausePos = (uint8_t*)(playingStream->readPos) + audioBlockSize;
+    pausePos = (uint8_t*)(playingStream->readPos) + decoder->audioBlockSize;
     if(WVAD_firstStop(playingStream->stopL) == (int16_t*)pausePos){
       WVAD_deleteFirstStop(playingStream->stopL);
       stopDeletedFlag = 1;
@@ -1632,7 +1947,7 @@ int WV_playAudio(WVAudioStreamHandle streamHdl)
     uint32_t modNextBlockValue = 0;
 
     if(WVAD_haveMod(playingStream->modL)){
-      int16_t* checkPos = playingStream->readPos + (audioBlockSize/2);
+      int16_t* checkPos = playingStream->readPos + (decoder->audioBlockSize/2);
       if(checkPos == playingStream->streamEnd)
 	checkPos = playingStream->data;
       
@@ -1647,7 +1962,7 @@ int WV_playAudio(WVAudioStreamHandle streamHdl)
     /* update */
     /**********/
     if(!modNextBlockFlag){
-      playingStream->audioClockRef += getBlockDuration(playingStream->nbMixedBlocks);
+      playingStream->audioClockRef += getBlockDuration(decoder, playingStream->nbMixedBlocks);
     }
     else{
       playingStream->audioClockRef = modNextBlockValue;
@@ -1658,11 +1973,11 @@ int WV_playAudio(WVAudioStreamHandle streamHdl)
 
     
   /* release the stream */
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
 
   /* signal to the decoder if a stop is deleted */
   if(stopDeletedFlag){
-    SDL_CondSignal(stateUpdated);
+    SDL_CondSignal(decoder->stateUpdated);
     return 0;
   }
   
@@ -1678,14 +1993,15 @@ int WV_playAudio(WVAudioStreamHandle streamHdl)
 int WV_setAudioVolume(WVAudioStreamHandle streamHdl, double volume)
 {
   AudioBitStream* audioStream = (AudioBitStream*)streamHdl;
+  AudioDecoder* decoder = audioStream->decoder;
   
   /* lock the stream */
-  SDL_mutexP(audioStreamMutex);
+  SDL_mutexP(decoder->audioStreamMutex);
 
   audioStream->volume = volume;
 
   /* release the stream */
-  SDL_mutexV(audioStreamMutex);
+  SDL_mutexV(decoder->audioStreamMutex);
 
   return 0;
 }
@@ -1701,47 +2017,64 @@ int WV_setAudioVolume(WVAudioStreamHandle streamHdl, double volume)
 /*  -next the decoder space function               */
 /***************************************************/
 
-int WV_audioDecoderShutdown(void)
+int WV_audioDecoderShutdown(WVAudioDecoderHandle decoderHdl)
 {
+  AudioDecoder* decoder = (AudioDecoder*)decoderHdl;
+
   /* send directly the command */
-  sendDecoderCommand(AUDIO_DECODER_QUIT);
+  SDL_mutexP(decoder->clientMutex);
+  sendDecoderCommand(decoder, AUDIO_DECODER_QUIT);
+  SDL_mutexV(decoder->clientMutex);
 
   //the decoder free all the streams,
   //close the audio,
   //and stop his thread
+  SDL_WaitThread(decoder->thread, NULL);
 
   /* now close thread communication */
-  SDL_DestroyMutex(stateUpdatedMutex);
-  SDL_DestroyCond(stateUpdated);
+  SDL_DestroyMutex(decoder->stateUpdatedMutex);
+  SDL_DestroyCond(decoder->stateUpdated);
 
-  SDL_DestroyMutex(audioStreamMutex);
-  SDL_DestroyCond(audioStreamUpdated);
+  SDL_DestroyMutex(decoder->audioStreamMutex);
+  SDL_DestroyCond(decoder->audioStreamUpdated);
 
-  SDL_DestroyCond(playingFinished);
+  SDL_DestroyCond(decoder->playingFinished);
 
-  SDL_DestroyMutex(cmdMutex);
-  SDL_DestroyCond(cmdExecuted);
+  SDL_DestroyMutex(decoder->clientMutex);
+  SDL_DestroyMutex(decoder->cmdMutex);
+  SDL_DestroyCond(decoder->cmdExecuted);
   
 
   /* the mixer was stopped by the decoder we can free the calcBuffer */
-  free(calcBuffer);
+  free(decoder->calcBuffer);
 
   /* the callback filter */
-  free(callbackTimes);
+  free(decoder->callbackTimes);
+
+  /* the decode tasks */
+  WV_freeTaskGroup(decoder->decodeGroup);
+  WV_taskRuntimeShutdown();
+
+  free(decoder);
 
   /* it's ok */
   return 0;
 }
 
-void audioDecoderQuit(void)
+static void audioDecoderQuit(AudioDecoder* decoder)
 {
   /* close the audio */
+  #if SDL_VERSION_ATLEAST(2,0,0)
+  SDL_CloseAudioDevice(decoder->audioDevice);
+  #else
   SDL_CloseAudio();
+  legacyAudioOpenFlag = 0;
+  #endif
 
   /* free all the streams */
   int i;
-  for(i=0; i<nbAudioStream; i++)
-    freeAudioStream(audioStreams[i]);
+  for(i=0; i<decoder->nbAudioStream; i++)
+    freeAudioStream(decoder->audioStreams[i]);
 }
 
 
@@ -1751,10 +2084,28 @@ void audioDecoderQuit(void)
 /*       THE DECODER THREAD         */
 /*||||||||||||||||||||||||||||||||||*/
 /************************************/
-static int audioRunningFlag;  //the decoder start/pause the audio
+
+/* the decode task */
+//the lacking streams are decoded in parallel
+static void decodeAudioTask(void* param)
+{
+  AudioBitStream* decodingStream = (AudioBitStream*)param;
+  AudioDecoder* decoder = decodingStream->decoder;
+
+  /* decode */
+  int newBlocks = decodeAudio(decodingStream);
+
+  /* update blocks count */
+  SDL_mutexP(decoder->audioStreamMutex);
+  decodingStream->nbBlocks += newBlocks;
+  SDL_mutexV(decoder->audioStreamMutex);
+}
+
 
 static int audioDecoderThread(void* opaque)
 {
+  AudioDecoder* decoder = (AudioDecoder*)opaque;
+
   int streamLackingFlag = 0;  //when a stream have less than 2 blocks we need to decode
                               //At start we have no streams so there are no lacking
 
@@ -1762,62 +2113,66 @@ static int audioDecoderThread(void* opaque)
     /*********************/
     /* check for waiting */
     /*********************/
-    SDL_mutexP(stateUpdatedMutex);
+    SDL_mutexP(decoder->stateUpdatedMutex);
 
-    if(!stateUpdatedFlag){
+    if(!decoder->stateUpdatedFlag){
       /* if nothing append during the last loop, we can mix ! */
       /* signal if the mixer is waiting */
-      SDL_CondSignal(audioStreamUpdated);
+      SDL_CondSignal(decoder->audioStreamUpdated);
 
       if(!streamLackingFlag){
 	/* if nothing append and we have no lacking, wait */
-	SDL_CondWait(stateUpdated, stateUpdatedMutex);
+	SDL_CondWait(decoder->stateUpdated, decoder->stateUpdatedMutex);
       }
     }
 
     /* reinit state variables */
-    stateUpdatedFlag = 0;            //we will see if something append during the loop
+    decoder->stateUpdatedFlag = 0;            //we will see if something append during the loop
     streamLackingFlag = 0;       
 
-    SDL_mutexV(stateUpdatedMutex);
+    SDL_mutexV(decoder->stateUpdatedMutex);
     
     
     /**************************/
     /* check for user command */
     /**************************/
-    SDL_mutexP(cmdMutex);
+    SDL_mutexP(decoder->cmdMutex);
     
-    if(decoderCommand){
-      switch(decoderCommand){
+    if(decoder->decoderCommand){
+      switch(decoder->decoderCommand){
 	
       case AUDIO_DECODER_ADD_STREAM:
-	audioDecoderAddStream();
+	audioDecoderAddStream(decoder);
 	break;
 
       case AUDIO_DECODER_DEL_STREAM:
-	audioDecoderDelStream();
+	audioDecoderDelStream(decoder);
 	break;
 
       case AUDIO_DECODER_SEEK:
-	audioDecoderSeek();
+	audioDecoderSeek(decoder);
+	break;
+
+      case AUDIO_DECODER_NEXT_SOURCE:
+	audioDecoderNextSource(decoder);
 	break;
 
       case AUDIO_DECODER_QUIT:
-	audioDecoderQuit();
-	decoderCommand = AUDIO_DECODER_NO_COMMAND;
-	SDL_mutexV(cmdMutex);
-	SDL_CondSignal(cmdExecuted);
+	audioDecoderQuit(decoder);
+	decoder->decoderCommand = AUDIO_DECODER_NO_COMMAND;
+	SDL_mutexV(decoder->cmdMutex);
+	SDL_CondSignal(decoder->cmdExecuted);
 	return 0;                  //get out of this loop !!!
 	break;
       }
       
       /* the command is executed, say this to the client */
-      decoderCommand = AUDIO_DECODER_NO_COMMAND;
-      SDL_mutexV(cmdMutex);                     
-      SDL_CondSignal(cmdExecuted);
+      decoder->decoderCommand = AUDIO_DECODER_NO_COMMAND;
+      SDL_mutexV(decoder->cmdMutex);                     
+      SDL_CondSignal(decoder->cmdExecuted);
     }
     else{    //else just release the cmd mutex 
-      SDL_mutexV(cmdMutex);
+      SDL_mutexV(decoder->cmdMutex);
     }
 
     
@@ -1836,7 +2191,7 @@ static int audioDecoderThread(void* opaque)
     int i;
     AudioBitStream* currStream;
     
-    SDL_mutexP(audioStreamMutex);
+    SDL_mutexP(decoder->audioStreamMutex);
     
 
     /***************************************************/
@@ -1849,8 +2204,8 @@ static int audioDecoderThread(void* opaque)
     int streamToPlayFlag = 0;
     
     i=0;
-    while(i<nbAudioStream){
-      currStream = audioStreams[i];
+    while(i<decoder->nbAudioStream){
+      currStream = decoder->audioStreams[i];
       /* if stream not paused */
       if(WVAD_firstStop(currStream->stopL) != currStream->readPos){
 	streamToPlayFlag = 1;             //we need running the audio
@@ -1861,15 +2216,23 @@ static int audioDecoderThread(void* opaque)
     }
     
     /* if we need to play and the audio system not running, start the audio */
-    if(streamToPlayFlag && !audioRunningFlag){
+    if(streamToPlayFlag && !decoder->audioRunningFlag){
+      #if SDL_VERSION_ATLEAST(2,0,0)
+      SDL_PauseAudioDevice(decoder->audioDevice, 0);
+      #else
       SDL_PauseAudio(0);
-      audioRunningFlag = 1;
+      #endif
+      decoder->audioRunningFlag = 1;
     }
     
     /*if we have nothing to play and the audio system is running, stop the audio */
-    else if(!streamToPlayFlag && audioRunningFlag){
+    else if(!streamToPlayFlag && decoder->audioRunningFlag){
+      #if SDL_VERSION_ATLEAST(2,0,0)
+      SDL_PauseAudioDevice(decoder->audioDevice, 1);
+      #else
       SDL_PauseAudio(1);
-      audioRunningFlag = 0;
+      #endif
+      decoder->audioRunningFlag = 0;
     }
     
     /********************************************/
@@ -1883,8 +2246,8 @@ static int audioDecoderThread(void* opaque)
     /* !!! else stream->lackingFlag is set to 0 */
 
     
-    for(i=0; i<nbAudioStream; i++){
-      currStream = audioStreams[i];
+    for(i=0; i<decoder->nbAudioStream; i++){
+      currStream = decoder->audioStreams[i];
       
       /* have no block and no paused */
       if(currStream->nbBlocks == 0 && (WVAD_firstStop(currStream->stopL)!=currStream->readPos)){
@@ -1901,7 +2264,7 @@ static int audioDecoderThread(void* opaque)
 	
     }
 
-    SDL_mutexV(audioStreamMutex);
+    SDL_mutexV(decoder->audioStreamMutex);
 
 
     /**************/
@@ -1918,30 +2281,44 @@ static int audioDecoderThread(void* opaque)
       else
 	decoderTarget = 1;
 
-      /* ckeck all the stream for decoding */
-      int newBlocks;
+      /* count the decoding targets */
+      int nbTargets = 0;
       
-      for(i=0; i<nbAudioStream; i++){
-	currStream = audioStreams[i];
+      for(i=0; i<decoder->nbAudioStream; i++){
+	if(decoder->audioStreams[i]->lackingFlag == decoderTarget)
+	  nbTargets++;
+      }
+
+      /* ckeck all the stream for decoding */
+      //the targets are decoded in parallel
+      for(i=0; i<decoder->nbAudioStream; i++){
+	currStream = decoder->audioStreams[i];
 	
 	/* if it is a decoding target */
 	if(currStream->lackingFlag == decoderTarget){
-	  
-	  /* decode */
-	  newBlocks = decodeAudio(currStream);
-	  
-	  /* update blocks count */
-	  SDL_mutexP(audioStreamMutex);
+	  if(nbTargets > 1 && decoder->decodeGroup)
+	    WV_submitTask(decoder->decodeGroup, WV_TASK_PRIORITY_AUDIO, \
+			  decodeAudioTask, currStream);
+	  else
+	    decodeAudioTask(currStream);
+	}
+      }
 
-	  currStream->nbBlocks += newBlocks;
-	  if(currStream->nbBlocks < 2)
-	    streamLackingFlag = 1;    //if we don't get enough blocks
-                                      //we need to decode enother time
+      if(nbTargets > 1 && decoder->decodeGroup)
+	WV_waitTaskGroup(decoder->decodeGroup);
 
-	  SDL_mutexV(audioStreamMutex);
-	}
+      /* check the blocks count */
+      SDL_mutexP(decoder->audioStreamMutex);
+
+      for(i=0; i<decoder->nbAudioStream; i++){
+	currStream = decoder->audioStreams[i];
+	if(currStream->lackingFlag == decoderTarget && currStream->nbBlocks < 2)
+	  streamLackingFlag = 1;    //if we don't get enough blocks
+                                    //we need to decode enother time
       }
 
+      SDL_mutexV(decoder->audioStreamMutex);
+
       /* check if the decoder let lacking streams */
       /* it is the case when we priorize decoding and have streams with 1 block */
       if(priorizedDecodingFlag && noPriorizedDecodingFlag)
@@ -1964,12 +2341,23 @@ static int audioDecoderThread(void* opaque)
 /*||||||||||||||||||||||||||||||||||*/
 /************************************/
 
-int WV_initAudioDecoder(void)
+WVAudioDecoderHandle WV_initAudioDecoder(const char* deviceName)
 {
+  #if !SDL_VERSION_ATLEAST(2,0,0)
+  /* only one decoder can open the audio */
+  if(legacyAudioOpenFlag || deviceName)
+    return NULL;
+  #endif
+
+  /* alloc the decoder */
+  AudioDecoder* decoder = (AudioDecoder*)malloc(sizeof(AudioDecoder));
+  if(!decoder)
+    return NULL;
+
   /*******************************/
   /* first init the audio system */
   /*******************************/
-  playFlag = 0;  //can do this after opening the audio
+  decoder->playFlag = 0;  //can do this after opening the audio
 
   /* set audio parameters */
   SDL_AudioSpec desiredSpec;
@@ -1980,13 +2368,25 @@ int WV_initAudioDecoder(void)
   desiredSpec.channels = WV_DECODER_CHANNELS;                        //stereo
   desiredSpec.samples = WV_WANTED_AUDIO_BLOCK_SIZE/(WV_DECODER_CHANNELS * 2); //size is in byte
   desiredSpec.callback = mixerCallback;
-  desiredSpec.userdata = NULL;
+  desiredSpec.userdata = decoder;                  //the mixer get its decoder
 
   /* open audio */
+  #if SDL_VERSION_ATLEAST(2,0,0)
+  //a NULL device name open the default device
+  decoder->audioDevice = SDL_OpenAudioDevice(deviceName, 0, &desiredSpec, &obtainedSpec, 0);
+  if(decoder->audioDevice == 0){
+    fprintf(stderr, "Couldn't open audio: %s\n", SDL_GetError());
+    free(decoder);
+    return NULL;
+  }
+  #else
   if(SDL_OpenAudio(&desiredSpec, &obtainedSpec) < 0){
     fprintf(stderr, "Couldn't open audio: %s\n", SDL_GetError());
-    return -1;
+    free(decoder);
+    return NULL;
   }
+  legacyAudioOpenFlag = 1;
+  #endif
 
   /* check obtained */
   /* only block size can be as the system want */
@@ -1994,82 +2394,81 @@ int WV_initAudioDecoder(void)
      obtainedSpec.format != AUDIO_S16SYS ||\
      obtainedSpec.channels != 2){
     printf("Couldn't get the requiered audio sytem\n");
-    return -1;
+    #if SDL_VERSION_ATLEAST(2,0,0)
+    SDL_CloseAudioDevice(decoder->audioDevice);
+    #else
+    SDL_CloseAudio();
+    legacyAudioOpenFlag = 0;
+    #endif
+    free(decoder);
+    return NULL;
   }
 
   /* save the block size calculated by OpenAudio */
-  audioBlockSize = obtainedSpec.size;
+  decoder->audioBlockSize = obtainedSpec.size;
 
   /* compute block samples */
-  unsigned int nbSamples = audioBlockSize/2;   //we use int16_t samples
+  unsigned int nbSamples = decoder->audioBlockSize/2;   //we use int16_t samples
     
   
   /* audio is not running yet */
-  audioRunningFlag = 0;
+  decoder->audioRunningFlag = 0;
 
   /*****************************/
   /* init communication system */
   /*****************************/
-  stateUpdatedMutex = SDL_CreateMutex();
-  stateUpdated = SDL_CreateCond();
-  stateUpdatedFlag = 0;   //wait at start
+  decoder->stateUpdatedMutex = SDL_CreateMutex();
+  decoder->stateUpdated = SDL_CreateCond();
+  decoder->stateUpdatedFlag = 0;   //wait at start
 
-  audioStreamMutex = SDL_CreateMutex();
-  audioStreamUpdated = SDL_CreateCond();
+  decoder->audioStreamMutex = SDL_CreateMutex();
+  decoder->audioStreamUpdated = SDL_CreateCond();
 
-  playingFinished = SDL_CreateCond();
+  decoder->playingFinished = SDL_CreateCond();
 
-  cmdMutex = SDL_CreateMutex();
-  cmdExecuted = SDL_CreateCond();
+  decoder->clientMutex = SDL_CreateMutex();
+  decoder->cmdMutex = SDL_CreateMutex();
+  decoder->cmdExecuted = SDL_CreateCond();
     
   
   /*******************************/
   /* init the calculation buffer */
   /* used by the mixer           */
   /*******************************/
-  calcBuffer = (double*)malloc(nbSamples*sizeof(double));
+  decoder->calcBuffer = (double*)malloc(nbSamples*sizeof(double));
   
   /********************/
   /* init mean filter */
   /********************/
-  initCallbackFilter();
+  initCallbackFilter(decoder);
   
 
   /************************/
   /* init state variables */
   /************************/
-  nbAudioStream = 0;
-  decoderCommand = AUDIO_DECODER_NO_COMMAND;
+  decoder->nbAudioStream = 0;
+  decoder->decoderCommand = AUDIO_DECODER_NO_COMMAND;
+
+
+  /****************************/
+  /* the decode tasks         */
+  /* the runtime is shared by */
+  /* all the decoders         */
+  /****************************/
+  decoder->decodeGroup = WV_getTaskGroup();
+  WV_initTaskRuntime();
 
   
   /*****************************/
   /* launch the decoder thread */
   /*****************************/
   #if SDL_VERSION_ATLEAST(2,0,0)
-  SDL_CreateThread(audioDecoderThread, "audioThread", NULL);
+  decoder->thread = SDL_CreateThread(audioDecoderThread, "audioThread", decoder);
   #else
-  SDL_CreateThread(audioDecoderThread, NULL);
+  decoder->thread = SDL_CreateThread(audioDecoderThread, decoder);
   #endif
 
-
-  
-
   
   /* all is ok */
-  return 0;
+  return (WVAudioDecoderHandle)decoder;
 }
-
-  
-
-  
-
-
-  
-     
-
-     
-
-
-
-
-
@@ -43,14 +43,22 @@
 
 /* abstract pointer for the user */
 typedef void* WVAudioStreamHandle;
+typedef void* WVAudioDecoderHandle;
 
 
 
 /****************************/
 /* INIT                     */
 /* first launch the decoder */
+/* one per engine, each has */
+/* its own thread and audio */
+/* device                   */
 /****************************/
-int WV_initAudioDecoder(void);
+
+/* NULL deviceName open the default device */
+/* !!! with SDL 1.2 only one decoder can be launched !!! */
+/* !!! on the default device                         !!! */
+WVAudioDecoderHandle WV_initAudioDecoder(const char* deviceName);
 
 
 /****************************************/
@@ -60,7 +68,8 @@ int WV_initAudioDecoder(void);
 /****************************************/
 
 /* add a stream and return a stream handle */
-WVAudioStreamHandle WV_addAudioStream(WVQueueHandle queueHdl,\
+WVAudioStreamHandle WV_addAudioStream(WVAudioDecoderHandle decoderHdl, \
+				      WVQueueHandle queueHdl,\
 				      AVCodecContext* codec,	\
 				      AVRational timeBase,	\
 				      double volume);     
@@ -114,7 +123,8 @@ int WV_pauseAudio(WVAudioStreamHandle streamHdl);
 /*!!! to seek you need to follow three step !!!*/
 
 /* 1) set if stream will preserve pause (blockingFlag) */
-void WV_startAudioSeeking(WVAudioStreamHandle streamHdl, int blockingFlag);
+/*    and where start playing for accurate seek (UINT32_MAX for keyframe seek) */
+void WV_startAudioSeeking(WVAudioStreamHandle streamHdl, int blockingFlag, uint32_t accurateClock);
 
 /* 2) send a seek command to the packet feeder */
 // it's here you set where seek
@@ -123,6 +133,20 @@ void WV_startAudioSeeking(WVAudioStreamHandle streamHdl, int blockingFlag);
 int WV_seekAudio(WVAudioStreamHandle streamHdl);
 
 
+/*****************************************/
+/* NEXT SOURCE                           */
+/* at the next eof, after the codec is   */
+/* drained, the stream continue with the */
+/* given queue and codec without gap     */
+/* spliceCall is called by the decoder   */
+/* when the source is switched           */
+/* (a NULL queueHdl remove the source)   */
+/*****************************************/
+int WV_setAudioNextSource(WVAudioStreamHandle streamHdl, WVQueueHandle queueHdl, \
+			  AVCodecContext* codec, AVRational timeBase,	\
+			  WVSpliceSignalCall spliceCall, void* spliceParam);
+
+
 /**************/
 /* GET CLOCK  */
 /**************/
@@ -139,7 +163,7 @@ int WV_setAudioVolume(WVAudioStreamHandle streamHdl, double volume);
 /**********/
 /* CLOSE  */
 /**********/
-int WV_audioDecoderShutdown(void);
+int WV_audioDecoderShutdown(WVAudioDecoderHandle decoderHdl);
 
 
 
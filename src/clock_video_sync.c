@@ -29,6 +29,7 @@
 
 #include "sync_object.h"
 #include "video_decoder.h"
+#include "time_source.h"
 
 
 typedef struct CVSyncPrivate{
@@ -57,7 +58,7 @@ static void CVSync_getRefClock(WVSyncObject* sync, WVReferenceClock* refClock)
   CVSyncPrivate* objPrivate = (CVSyncPrivate*)sync->objPrivate;
 
   /* get ticks */
-  uint32_t currentTime = SDL_GetTicks();
+  uint32_t currentTime = WV_getEngineTicks();
 
 
   /*************************/
@@ -110,7 +111,7 @@ int CVSync_play(WVSyncObject* sync)
   if(!objPrivate->pauseFlag)
     return -1;
 
-  uint32_t currentTime = SDL_GetTicks();
+  uint32_t currentTime = WV_getEngineTicks();
   
   objPrivate->baseTime = currentTime;
   
@@ -134,7 +135,7 @@ int CVSync_pause(WVSyncObject* sync)
     return -1; 
  
 
-  uint32_t currentTime = SDL_GetTicks();
+  uint32_t currentTime = WV_getEngineTicks();
   uint32_t currentClock = objPrivate->baseClock + (currentTime - objPrivate->baseTime);
 
   objPrivate->pauseFlag = 1;
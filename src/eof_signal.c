@@ -69,6 +69,21 @@ void WV_signalEOF(void* streamHdl)
 }
 
 
+/* the splice is committed by the main thread */
+//with the refresh event, as it is handled for all the streams
+void WV_signalSplice(void)
+{
+  SDL_Event event;
+
+  event.type = WV_REFRESH_EVENT;
+  event.user.code = WV_SPLICE_REFRESH_CODE;
+  event.user.data1 = NULL;
+  event.user.data2 = NULL;
+
+  SDL_PushEvent(&event);
+}
+
+
 
 
 
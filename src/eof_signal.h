@@ -35,4 +35,12 @@
 /* the decoders will send the stream pointer */
 void WV_signalEOF(void* streamHdl);
 
+/* the decoders switched to the next items */
+//push the splice refresh event
+void WV_signalSplice(void);
+
+/* swap the sources of the switched streams */
+//called by the main thread with the splice event, see waave.c
+void WV_commitSplices(void);
+
 #endif
@@ -48,6 +48,7 @@ typedef struct PacketQueue{
   PacketQueueElement *firstPkt, *lastPkt;  
   int nbPackets;
   int size;         // the size of the queue
+  struct PacketFeeder* feeder;  //the feeder signaled when a pkt is get
   
   /* wait */
   int waitFlag;
@@ -60,14 +61,61 @@ typedef struct PacketQueue{
 /*********************************************/
 /* The feeder works like a state machine so  */
 /* here the internal variables               */
+/* each engine has its own feeder and thread */
 /*********************************************/
+typedef struct PacketFeeder{
 
+  int stateUpdatedFlag;          //Feeder stop working if all the queues are full
+  SDL_mutex* stateUpdatedMutex;  // and if no command was send (see later)
+  SDL_cond*  stateUpdated;       //WAIT (feeder):"I have nothing to do, wait for client getting 
+                                 //               pkt or sending command"
+                                 //SIGNAL (client) : "A commans was send" or "A pkt was get"
 
-static int stateUpdatedFlag = 0;        //Feeder stop working if all the queues are full
-static SDL_mutex* stateUpdatedMutex;// and if no command was send (see later)
-static SDL_cond*  stateUpdated;    //WAIT (feeder):"I have nothing to do, wait for client getting 
-                                    //               pkt or sending command"
-                                    //SIGNAL (client) : "A commans was send" or "A pkt was get"
+  SDL_Thread* thread;
+
+  /* the feeder contexts, see later */
+  int nbFeederContext;
+  struct PacketFeederContext* feederCtx[WV_PACKET_FEEDER_MAX_CONTEXT];
+  struct PacketFeederContext* buildingCtx; //the context we are building
+
+  /* the memory taken by the loop cache */
+  //only changed by the feeder
+  uint32_t loopCacheSize;
+
+  /* the commands, see later */
+  int feederCommand;          //where the client put the command
+
+  SDL_mutex* clientMutex;     //the commands can be sent by several threads (seek and step)
+                              //protect the command and its params, recursive
+  SDL_mutex* cmdMutex;
+  SDL_cond* cmdExecuted;      //the client need to wait for command execution 
+                              //before continuing
+                              //WAIT (client) : "I have sent you a command say me 
+                              //                 the work is done"
+                              //SIGNAL (feeder) : "Well, command terminated"
+
+  /* the command parameters */
+  int removingCtxIdx;         //for DEL_CONTEXT
+                              //the index of the context that the client wants to remove
+                              //it is recognized by his AVFormatContext (see below)
+
+  int delQueueCtxIdx;         //for DEL_QUEUE
+  int delQueueIdx;
+  WVQueueHandle delQueueHdl;
+
+  int seekingCtxIdx;          //for SEEK, the context where we seek
+  int seekingStreamIdx;
+  uint64_t seekingTimestamp;  //the time timestamp where we seek
+  int seekingFlags;
+  int seekingPktFlag;         //WV_PACKET_FLAG_SEEK or WV_PACKET_FLAG_STEP
+
+  AVFormatContext* discardFormatCtx;  //for DISCARD, the stream read by the feeder
+  int discardStreamIdx;
+  enum AVDiscard discard;
+
+  struct PacketFeederContext* freeingCtx; //the feeder let the client freeing the context
+                                          //for minimal disturbance of the feeder
+}PacketFeeder;
 
 
 /***********************************************/
@@ -75,9 +123,10 @@ static SDL_cond*  stateUpdated;    //WAIT (feeder):"I have nothing to do, wait f
 /***********************************************/
 
 /* !!! alloc space for the structure before calling !!!*/
-static int packetQueueInit(PacketQueue* newQueue)
+static int packetQueueInit(PacketQueue* newQueue, PacketFeeder* feeder)
 {
   /* init internal variables */
+  newQueue->feeder = feeder;
   newQueue->nbPackets = 0;
   newQueue->size = 0;
   newQueue->waitFlag = 0;
@@ -132,6 +181,7 @@ static int packetQueuePut(PacketQueue* queue, PacketQueueElement* inPkt, int for
 AVPacket* WV_packetQueueGet(WVQueueHandle queueHdl, int waitFlag) 
 {
   PacketQueue* queue = (PacketQueue*)queueHdl; //recast the void* handle
+  PacketFeeder* feeder = queue->feeder;
 
   /* get access to the queue */
   SDL_mutexP(queue->mutex);
@@ -143,11 +193,11 @@ AVPacket* WV_packetQueueGet(WVQueueHandle queueHdl, int waitFlag)
       queue->waitFlag = 1;
       
       /* signal to the feeder */
-      SDL_mutexP(stateUpdatedMutex);    //change the state flag
-      stateUpdatedFlag = 1;
-      SDL_mutexV(stateUpdatedMutex);
+      SDL_mutexP(feeder->stateUpdatedMutex);    //change the state flag
+      feeder->stateUpdatedFlag = 1;
+      SDL_mutexV(feeder->stateUpdatedMutex);
       
-      SDL_CondSignal(stateUpdated);
+      SDL_CondSignal(feeder->stateUpdated);
 
       /* wait for packet */
       SDL_CondWait(queue->queueUpdated, queue->mutex);
@@ -178,11 +228,11 @@ AVPacket* WV_packetQueueGet(WVQueueHandle queueHdl, int waitFlag)
   SDL_mutexV(queue->mutex);
   
   /* signal that state is updated */
-  SDL_mutexP(stateUpdatedMutex);    //change the state flag
-  stateUpdatedFlag = 1;
-  SDL_mutexV(stateUpdatedMutex);
+  SDL_mutexP(feeder->stateUpdatedMutex);    //change the state flag
+  feeder->stateUpdatedFlag = 1;
+  SDL_mutexV(feeder->stateUpdatedMutex);
 
-  SDL_CondSignal(stateUpdated);  //say to the feeder that it can restart feeding
+  SDL_CondSignal(feeder->stateUpdated);  //say to the feeder that it can restart feeding
                                  //if all the queues was full. See the declaration
                                  //of stateUpdate
 
@@ -191,6 +241,20 @@ AVPacket* WV_packetQueueGet(WVQueueHandle queueHdl, int waitFlag)
 }
 
 
+/* the drain pkt is built like the queued pkts */
+AVPacket* WV_getDrainPacket(void)
+{
+  PacketQueueElement* drainPkt = (PacketQueueElement*)malloc(sizeof(PacketQueueElement));
+  
+  av_init_packet((AVPacket*)drainPkt);
+  ((AVPacket*)drainPkt)->data = NULL;
+  ((AVPacket*)drainPkt)->size = 0;
+  ((AVPacket*)drainPkt)->flags = WV_PACKET_FLAG_DRAIN;
+
+  return (AVPacket*)drainPkt;
+}
+
+
 
 
 /* empty a queue without sending any signal */
@@ -267,15 +331,30 @@ typedef struct PacketFeederContext{
                              //we cannot put it in the queue
   
   PacketQueue* destQueue;      //where we need to put the saved pkt (avoid search again)     
+
+  /* the loop cache */
+  int cacheState;                  //LOOP_CACHE_NONE ... LOOP_CACHE_REPLAY
+  PacketQueueElement* cacheFirst;  //the pkts of the first pass
+  PacketQueueElement* cacheLast;
+  PacketQueueElement* cachePos;    //the next replayed pkt
+  uint32_t cacheSize;              //the size of the cached pkts (bytes)
 }PacketFeederContext;
 
 
+/* the loop cache state */
+#define LOOP_CACHE_NONE 0      //the pkts are read from the file
+#define LOOP_CACHE_WAIT 1      //record when the file restart at the beginning
+#define LOOP_CACHE_RECORD 2    //the read pkts are kept
+#define LOOP_CACHE_READ 3      //the cache is complete but the file is read until eof (after a seek)
+#define LOOP_CACHE_REPLAY 4    //the pkts come from the cache
 
-/**************************************************/
-/* now state variables relative to feeder context */
-/**************************************************/
-static int nbFeederContext;
-static PacketFeederContext* feederCtx[WV_PACKET_FEEDER_MAX_CONTEXT];
+/* the loop cache limits */
+//shared by all the feeders, each feeder count its own cache size
+//and the total size of all the feeders is bounded by loopCacheMaxSize
+static uint32_t loopCacheMaxFileSize = WV_LOOP_CACHE_MAX_FILE_SIZE;
+static uint32_t loopCacheMaxSize = WV_LOOP_CACHE_MAX_SIZE;
+static uint32_t loopCacheTotalSize = 0;
+static SDL_mutex* loopCacheMutex = NULL;   //the feeders record in parallel
 
 
 
@@ -289,60 +368,38 @@ static PacketFeederContext* feederCtx[WV_PACKET_FEEDER_MAX_CONTEXT];
 #define PACKET_FEEDER_DEL_QUEUE 3 
 #define PACKET_FEEDER_SEEK 4 
 #define PACKET_FEEDER_QUIT 5
+#define PACKET_FEEDER_DISCARD 6
 
-static int feederCommand;    //where the client put the command
-
-static SDL_mutex* cmdMutex;
-static SDL_cond* cmdExecuted;  //the client need to wait for command execution 
-                               //before continuing
-                               //WAIT (client) : "I have sent you a command say me 
-                               //                 the work is done"
-                               //SIGNAL (feeder) : "Well, command terminated"
-
-/* here the command parameters */
-static int removingCtxIdx;       //for DEL_CONTEXT
-                                 //the index of the context that the client wants to remove
-                                 //it is recognized by his AVFormatContext (see below)
-
-
-static int delQueueCtxIdx;      //for DEL_QUEUE
-static int delQueueIdx;
-static WVQueueHandle delQueueHdl;
-
-
-
-static int seekingCtxIdx;         //for SEEK, the context where we seek
-static int seekingStreamIdx;
-static uint64_t seekingTimestamp;    //the time timestamp where we seek
-static int seekingFlags;
-
-static PacketFeederContext* freeingCtx; //the feeder let the client freeing the context
-                                        //for minimal disturbance of the feeder
+//the command, its parameters and the mutexes are in the PacketFeeder struct
 
 
 /* !!! very important function !!! */
 /* used each time we send a command to the feeder */
 /* send a command, signal state change, and wait for execution */
-static void sendFeederCommand(int cmd)
+static void sendFeederCommand(PacketFeeder* feeder, int cmd)
 {
+  /* one client at a time */
+  SDL_mutexP(feeder->clientMutex);
+  
   /* send the command to the feeder */
-  SDL_mutexP(cmdMutex);
-  feederCommand = cmd;
+  SDL_mutexP(feeder->cmdMutex);
+  feeder->feederCommand = cmd;
   
   /* signal that state is updated */
-  SDL_mutexP(stateUpdatedMutex);    //change the state flag
-  stateUpdatedFlag = 1;
-  SDL_mutexV(stateUpdatedMutex);
+  SDL_mutexP(feeder->stateUpdatedMutex);    //change the state flag
+  feeder->stateUpdatedFlag = 1;
+  SDL_mutexV(feeder->stateUpdatedMutex);
 
-  SDL_CondSignal(stateUpdated);  //say to the feeder that it can thread commands
+  SDL_CondSignal(feeder->stateUpdated);  //say to the feeder that it can thread commands
                                  //or restart feeding queues                                 
                                  //if he was waiting (all the queues are full)
   
   /* wait for command execution */
-  SDL_CondWait(cmdExecuted, cmdMutex); 
+  SDL_CondWait(feeder->cmdExecuted, feeder->cmdMutex); 
   
   /* release command variable  */
-  SDL_mutexV(cmdMutex);
+  SDL_mutexV(feeder->cmdMutex);
+  SDL_mutexV(feeder->clientMutex);
 }
 
 
@@ -351,14 +408,14 @@ static void sendFeederCommand(int cmd)
 /* a context before sending the command         */
 /************************************************/ 
 
-static PacketFeederContext* buildingCtx; //the context we are building
-
 /* first the user create the context while giving the */
 /* number of streams he want to send to the queues    */
 
-int WV_buildFeederContext(AVFormatContext* formatCtx, int nbStreams)
+int WV_buildFeederContext(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, int nbStreams)
 {
-  if(nbFeederContext >= WV_PACKET_FEEDER_MAX_CONTEXT)
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
+  if(feeder->nbFeederContext >= WV_PACKET_FEEDER_MAX_CONTEXT)
     return -1;
   
   /* alloc space for the structure, the stream indexes, the queue pointers, and the queues */
@@ -369,30 +426,36 @@ int WV_buildFeederContext(AVFormatContext* formatCtx, int nbStreams)
 
   int contextSize = structSize + streamIdxSize + queuePtSize + queuesSize;
   
-  buildingCtx = (PacketFeederContext*)malloc(contextSize);
+  feeder->buildingCtx = (PacketFeederContext*)malloc(contextSize);
 
   /* set the pointers */
-  void* calcP = (void*)buildingCtx;
+  void* calcP = (void*)feeder->buildingCtx;
 
   calcP += structSize;                    //after the structure
-  buildingCtx->streamIdx = (int*)calcP;  //we have the stream Idxs
+  feeder->buildingCtx->streamIdx = (int*)calcP;  //we have the stream Idxs
 
   calcP += streamIdxSize;                            //after the stream idxs
-  buildingCtx->queue = (PacketQueue**)calcP;         //we have the queue pointers
+  feeder->buildingCtx->queue = (PacketQueue**)calcP;         //we have the queue pointers
 
   calcP += queuePtSize;                                    //after the queue pointers
   int i;                                                   //we have the queues
   for(i=0; i<nbStreams; i++){
-    buildingCtx->queue[i] = (PacketQueue*)calcP;
+    feeder->buildingCtx->queue[i] = (PacketQueue*)calcP;
     calcP += sizeof(PacketQueue);
   }
 
   /* fill the structure */
-  buildingCtx->formatCtx = formatCtx;
-  buildingCtx->nbPipe = nbStreams;
-  buildingCtx->currentPipe = 0;
-  buildingCtx->fullFlag = 0;
-  buildingCtx->pkt = NULL;
+  feeder->buildingCtx->formatCtx = formatCtx;
+  feeder->buildingCtx->nbPipe = nbStreams;
+  feeder->buildingCtx->currentPipe = 0;
+  feeder->buildingCtx->fullFlag = 0;
+  feeder->buildingCtx->pkt = NULL;
+
+  feeder->buildingCtx->cacheState = LOOP_CACHE_NONE;
+  feeder->buildingCtx->cacheFirst = NULL;
+  feeder->buildingCtx->cacheLast = NULL;
+  feeder->buildingCtx->cachePos = NULL;
+  feeder->buildingCtx->cacheSize = 0;
 
   return 0;
 }
@@ -402,37 +465,66 @@ int WV_buildFeederContext(AVFormatContext* formatCtx, int nbStreams)
 /* nbStreams times !!! the feeder return the correponding        */
 /* queue Handle while building the queues                        */
 
-WVQueueHandle WV_getStreamQueue(int streamIdx)
+WVQueueHandle WV_getStreamQueue(WVPacketFeederHandle feederHdl, int streamIdx)
 {
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
   /* build the queue at the actual position */
   /* the feeder doesn't access this memory space for now */
-  packetQueueInit(buildingCtx->queue[buildingCtx->currentPipe]); 
+  packetQueueInit(feeder->buildingCtx->queue[feeder->buildingCtx->currentPipe], feeder); 
   
   /* save the stream in the context */
-  buildingCtx->streamIdx[buildingCtx->currentPipe] = streamIdx;
+  feeder->buildingCtx->streamIdx[feeder->buildingCtx->currentPipe] = streamIdx;
   
   /* prepare to the next pipe */
-  buildingCtx->currentPipe++;
+  feeder->buildingCtx->currentPipe++;
     
   /* it is just a void* cast */
-  return (WVQueueHandle)buildingCtx->queue[buildingCtx->currentPipe - 1];
+  return (WVQueueHandle)feeder->buildingCtx->queue[feeder->buildingCtx->currentPipe - 1];
 }
 
 
 
+/* the context start at the beginning of the file */
+/* so the first pass can be recorded */
+int WV_setFeederLoopCache(WVPacketFeederHandle feederHdl, int cacheFlag)
+{
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
+  feeder->buildingCtx->cacheState = LOOP_CACHE_NONE;
+
+  if(cacheFlag != WV_LOOP_CACHE)
+    return 0;
+
+  /* check the file size */
+  AVFormatContext* formatCtx = feeder->buildingCtx->formatCtx;
+  if(!formatCtx->pb)
+    return -1;
+
+  int64_t fileSize = avio_size(formatCtx->pb);
+  if(fileSize <= 0 || fileSize > loopCacheMaxFileSize)
+    return -1;
+  
+  feeder->buildingCtx->cacheState = LOOP_CACHE_RECORD;
+  return 0;
+}
+
+
 /***************************************************/
 /*  The first command : PACKET_FEEDER_ADD_CONTEXT  */
 /*  -first the user space function                 */
 /*  -next the feeder space function                */
 /***************************************************/
 
-int WV_addFeederContext(void)
+int WV_addFeederContext(WVPacketFeederHandle feederHdl)
 {
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
   /* save the builded context */
-  feederCtx[nbFeederContext] = buildingCtx; //the feeder doesn't access on this space
+  feeder->feederCtx[feeder->nbFeederContext] = feeder->buildingCtx; //the feeder doesn't access on this space
   
   /* send the command to the feeder */
-  sendFeederCommand( PACKET_FEEDER_ADD_CONTEXT );
+  sendFeederCommand(feeder, PACKET_FEEDER_ADD_CONTEXT );
 
   // the feeder update and nbFeederContext
   
@@ -443,13 +535,219 @@ int WV_addFeederContext(void)
 
 /* the feeder part of the job */
 /* just update nbFeederContext */
-static void packetFeederAddContext(void)
+static void packetFeederAddContext(PacketFeeder* feeder)
 {
   /* update the context count */
-  nbFeederContext++;
+  feeder->nbFeederContext++;
 }
 
 
+/**************************************************/
+/* The loop cache                                 */
+/* the first pass is recorded and replayed by the */
+/* feeder, the cached pkts are copied in the      */
+/* queues (with refcounted pkts the data are      */
+/* shared)                                        */
+/**************************************************/
+static PacketQueueElement* copyPacket(AVPacket* srcPkt)
+{
+  PacketQueueElement* newPkt = (PacketQueueElement*)malloc(sizeof(PacketQueueElement));
+  AVPacket* dstPkt = (AVPacket*)newPkt;
+  
+#if HAVE_AV_PACKET_REF
+  if(av_packet_ref(dstPkt, srcPkt) < 0){
+    free(newPkt);
+    return NULL;
+  }
+#elif HAVE_AV_COPY_PACKET
+  if(av_copy_packet(dstPkt, srcPkt) < 0){
+    free(newPkt);
+    return NULL;
+  }
+#else
+  //av_dup_packet copy the data and the side data
+  //of a pkt that don't own them
+  *dstPkt = *srcPkt;
+  dstPkt->destruct = NULL;
+  if(av_dup_packet(dstPkt) < 0){
+    free(newPkt);
+    return NULL;
+  }
+#endif
+
+  return newPkt;
+}
+
+
+/* free the cached pkts */
+/* !!! the size need to be updated by the feeder !!! */
+static void freeLoopCache(PacketFeederContext* pfCtx)
+{
+  PacketQueueElement* currPkt = pfCtx->cacheFirst;
+  PacketQueueElement* nextFreedPkt;
+
+  while(currPkt){
+    nextFreedPkt = currPkt->nextPkt;
+    av_free_packet((AVPacket*)currPkt);
+    free(currPkt);
+    currPkt = nextFreedPkt;
+  }
+
+  pfCtx->cacheFirst = NULL;
+  pfCtx->cacheLast = NULL;
+  pfCtx->cachePos = NULL;
+}
+
+
+/* take memory for the cached pkts */
+/* return -1 if the limit of all the feeders is reached */
+static int reserveLoopCache(PacketFeeder* feeder, uint32_t size)
+{
+  int ret = -1;
+  
+  SDL_mutexP(loopCacheMutex);
+  if(loopCacheTotalSize + size <= loopCacheMaxSize){
+    loopCacheTotalSize += size;
+    ret = 0;
+  }
+  SDL_mutexV(loopCacheMutex);
+
+  if(ret == 0)
+    feeder->loopCacheSize += size;
+
+  return ret;
+}
+
+
+/* give back the memory of the cached pkts */
+static void releaseLoopCache(PacketFeeder* feeder, uint32_t size)
+{
+  SDL_mutexP(loopCacheMutex);
+  loopCacheTotalSize -= size;
+  SDL_mutexV(loopCacheMutex);
+  
+  feeder->loopCacheSize -= size;
+}
+
+
+/* feeder space, drop the cache of a context */
+static void dropLoopCache(PacketFeeder* feeder, PacketFeederContext* pfCtx)
+{
+  releaseLoopCache(feeder, pfCtx->cacheSize);
+  pfCtx->cacheSize = 0;
+  freeLoopCache(pfCtx);
+}
+
+
+/* keep a pkt of the first pass */
+/* stop caching if the memory limit is reached */
+static void recordPacket(PacketFeeder* feeder, PacketFeederContext* pfCtx, AVPacket* pkt)
+{
+  /* check the limits */
+  uint32_t pktSize = pkt->size;
+  if(pfCtx->cacheSize + pktSize > loopCacheMaxFileSize || \
+     reserveLoopCache(feeder, pktSize) < 0){
+    dropLoopCache(feeder, pfCtx);
+    pfCtx->cacheState = LOOP_CACHE_NONE;
+    return;
+  }
+
+  /* keep a copy */
+  PacketQueueElement* cachedPkt = copyPacket(pkt);
+  if(!cachedPkt){
+    releaseLoopCache(feeder, pktSize);
+    dropLoopCache(feeder, pfCtx);
+    pfCtx->cacheState = LOOP_CACHE_NONE;
+    return;
+  }
+
+  cachedPkt->nextPkt = NULL;
+  if(pfCtx->cacheLast)
+    pfCtx->cacheLast->nextPkt = cachedPkt;
+  else
+    pfCtx->cacheFirst = cachedPkt;
+  pfCtx->cacheLast = cachedPkt;
+
+  pfCtx->cacheSize += pktSize;   //reserved above
+}
+
+
+/* get the next cached pkt, NULL at the cache end */
+static PacketQueueElement* replayPacket(PacketFeederContext* pfCtx)
+{
+  if(!pfCtx->cachePos)
+    return NULL;
+
+  PacketQueueElement* replayedPkt = copyPacket((AVPacket*)pfCtx->cachePos);
+  pfCtx->cachePos = pfCtx->cachePos->nextPkt;
+
+  return replayedPkt;
+}
+
+
+/* at eof, restart the loop from the cache */
+/* return -1 if the file need to be seeked */
+static int restartLoopCache(PacketFeederContext* pfCtx)
+{
+  switch(pfCtx->cacheState){
+
+  case LOOP_CACHE_WAIT:
+    pfCtx->cacheState = LOOP_CACHE_RECORD;
+    return -1;
+
+  case LOOP_CACHE_RECORD:
+  case LOOP_CACHE_READ:
+  case LOOP_CACHE_REPLAY:
+    //nothing was cached
+    if(!pfCtx->cacheFirst){
+      pfCtx->cacheState = LOOP_CACHE_NONE;
+      return -1;
+    }
+    pfCtx->cacheState = LOOP_CACHE_REPLAY;
+    pfCtx->cachePos = pfCtx->cacheFirst;
+    return 0;
+  }
+
+  return -1;
+}
+
+
+/* after a seek, the pkts are read from the file */
+static void seekLoopCache(PacketFeeder* feeder, PacketFeederContext* pfCtx)
+{
+  switch(pfCtx->cacheState){
+
+  /* the first pass is not complete */
+  //record at the next loop
+  case LOOP_CACHE_RECORD:
+    dropLoopCache(feeder, pfCtx);
+    pfCtx->cacheState = LOOP_CACHE_WAIT;
+    break;
+
+  /* replay at the next loop */
+  case LOOP_CACHE_REPLAY:
+    pfCtx->cacheState = LOOP_CACHE_READ;
+    break;
+  }
+}
+
+
+void WV_setFeederLoopCacheLimits(uint32_t maxFileSize, uint32_t maxSize)
+{
+  loopCacheMaxFileSize = maxFileSize;
+  loopCacheMaxSize = maxSize;
+}
+
+
+uint32_t WV_getFeederLoopCacheSize(WVPacketFeederHandle feederHdl)
+{
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
+  return feeder->loopCacheSize;
+}
+
+
+
 /**************************************************/
 /* The command : PACKET_FEEDER_DEL_CONTEXT        */
 /* -first how free the context                    */
@@ -472,38 +770,43 @@ static void freeFeederContext(PacketFeederContext* pfCtx)
     free(pfCtx->pkt);
   }
 
+  /* free the cached pkts */
+  freeLoopCache(pfCtx);
+
   /* now free the structure */
   /* the structure, the streamIdx, the queue pointers and queues was allocated in one time */
   free(pfCtx);
 }
 
 
-int WV_delFeederContext(AVFormatContext* formatCtx)
+int WV_delFeederContext(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx)
 {
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
   /* search for the feeder context containing the formatCtx */
   /*!!! we suppose we can read while the feeder use the context !!!*/
   /*!!! maybe we can do this with the feeder !!!*/
   int i = 0;
-  while(feederCtx[i]->formatCtx != formatCtx && i<nbFeederContext)
+  while(feeder->feederCtx[i]->formatCtx != formatCtx && i<feeder->nbFeederContext)
     i++;
 
   /* found ? */
-  if(i == nbFeederContext)
+  if(i == feeder->nbFeederContext)
     return -1;              //cannot find the format context
   //else the context is in feederCtx[i]
   
   /* the command param */
-  removingCtxIdx = i;
+  feeder->removingCtxIdx = i;
   
   /* Send the command to the feeder */
-  sendFeederCommand(PACKET_FEEDER_DEL_CONTEXT);
+  sendFeederCommand(feeder, PACKET_FEEDER_DEL_CONTEXT);
   
   // the feeder remove the context of the list while not letting holes
   // he doesn't free the structure, he just put its pointer in freeingCtx
   // This is for minimal disturbing of the feeder
 
   /* free the feeder context */
-  freeFeederContext(freeingCtx);
+  freeFeederContext(feeder->freeingCtx);
 
   /* it's ok, return */
   return 0;
@@ -511,18 +814,22 @@ int WV_delFeederContext(AVFormatContext* formatCtx)
 
 
 /* the feeder side */
-static void packetFeederDelContext(void)
+static void packetFeederDelContext(PacketFeeder* feeder)
 {
   /* save the struct pointer, the user will free the structure */
-  freeingCtx = feederCtx[removingCtxIdx];
+  feeder->freeingCtx = feeder->feederCtx[feeder->removingCtxIdx];
+
+  /* the cache memory is released now */
+  releaseLoopCache(feeder, feeder->freeingCtx->cacheSize);
+  feeder->freeingCtx->cacheSize = 0;
   
   /* remove the context given in the cmd param of the list */
   /* by shifting the contexts */
   /* we use the variable removingCtxIdx to do the job */
-  nbFeederContext--;     //update the context count now !
-  while(removingCtxIdx < nbFeederContext){  //shift the list  
-    feederCtx[removingCtxIdx] = feederCtx[removingCtxIdx+1];
-    removingCtxIdx++;
+  feeder->nbFeederContext--;     //update the context count now !
+  while(feeder->removingCtxIdx < feeder->nbFeederContext){  //shift the list  
+    feeder->feederCtx[feeder->removingCtxIdx] = feeder->feederCtx[feeder->removingCtxIdx+1];
+    feeder->removingCtxIdx++;
   }
 
   /*  it's ok, let the user free the context */
@@ -534,9 +841,11 @@ static void packetFeederDelContext(void)
 /* -first the user space function                 */
 /* -next the feeder space function                */
 /**************************************************/
-int WV_delFeederQueue(AVFormatContext* formatCtx, WVQueueHandle queueHdl)
+int WV_delFeederQueue(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, WVQueueHandle queueHdl)
 {
-  delQueueHdl = queueHdl;
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
+  feeder->delQueueHdl = queueHdl;
 
 
   /**************/
@@ -545,19 +854,19 @@ int WV_delFeederQueue(AVFormatContext* formatCtx, WVQueueHandle queueHdl)
 
   /* search for the context */
   int i = 0;
-  while(feederCtx[i]->formatCtx != formatCtx && i<nbFeederContext)
+  while(feeder->feederCtx[i]->formatCtx != formatCtx && i<feeder->nbFeederContext)
     i++;
 
   /* found ? */
-  if(i == nbFeederContext)
+  if(i == feeder->nbFeederContext)
     return -1;            //cannot found the context
 
 
-  delQueueCtxIdx = i;
+  feeder->delQueueCtxIdx = i;
 
 
   /* search for the queue in the context */
-  PacketFeederContext* fCtx = feederCtx[i];
+  PacketFeederContext* fCtx = feeder->feederCtx[i];
 
   i=0;
   while(fCtx->queue[i] != (PacketQueue*)queueHdl && i<fCtx->nbPipe)
@@ -568,13 +877,13 @@ int WV_delFeederQueue(AVFormatContext* formatCtx, WVQueueHandle queueHdl)
     return -1;           ///cannot found the queue
 
   
-  delQueueIdx = i;
+  feeder->delQueueIdx = i;
 
 
   /* if this is the only queue */
   /* delete the context */
   if( fCtx->nbPipe ==  1){
-    return WV_delFeederContext(formatCtx);
+    return WV_delFeederContext(feederHdl, formatCtx);
   }
 
 
@@ -583,7 +892,7 @@ int WV_delFeederQueue(AVFormatContext* formatCtx, WVQueueHandle queueHdl)
   /****************/
 
   /* Send the command to the feeder */
-  sendFeederCommand(PACKET_FEEDER_DEL_QUEUE);
+  sendFeederCommand(feeder, PACKET_FEEDER_DEL_QUEUE);
   
   //the feeder remove the queue without realloc the struct 
 
@@ -592,11 +901,11 @@ int WV_delFeederQueue(AVFormatContext* formatCtx, WVQueueHandle queueHdl)
 }
 
 
-static void packetFeederDelQueue(void)
+static void packetFeederDelQueue(PacketFeeder* feeder)
 {
   
-  PacketFeederContext* fCtx =feederCtx[delQueueCtxIdx];
-  int queueIdx = delQueueIdx;
+  PacketFeederContext* fCtx =feeder->feederCtx[feeder->delQueueCtxIdx];
+  int queueIdx = feeder->delQueueIdx;
 
 
   /*********************/
@@ -606,7 +915,7 @@ static void packetFeederDelQueue(void)
   packetQueueClose(fCtx->queue[queueIdx]);
   
   /* check the packet */
-  if(fCtx->destQueue == (PacketQueue*)delQueueHdl){
+  if(fCtx->destQueue == (PacketQueue*)feeder->delQueueHdl){
     av_free_packet((AVPacket*)fCtx->pkt);
     free(fCtx->pkt);
     fCtx->pkt = NULL;
@@ -635,38 +944,83 @@ static void packetFeederDelQueue(void)
 /* -first the user space function                 */
 /* -next the feeder space function                */
 /**************************************************/
-int WV_contextSeek(AVFormatContext* formatCtx, int streamIdx, uint64_t timestamp, int flags)
+static int contextSeek(PacketFeeder* feeder, AVFormatContext* formatCtx, int streamIdx, uint64_t timestamp, int flags, int pktFlag)
 {
   /* search for the feeder context containing the formatCtx */
   /*!!! we suppose we can read while the feeder use the context !!!*/
   /*!!! maybe we can do this with the feeder !!!*/
   int i = 0;
-  while(feederCtx[i]->formatCtx != formatCtx && i<nbFeederContext)
+  while(feeder->feederCtx[i]->formatCtx != formatCtx && i<feeder->nbFeederContext)
     i++;
 
   /* found ? */
-  if(i == nbFeederContext)
+  if(i == feeder->nbFeederContext)
     return -1;              //cannot find the format context
   //else the context is in feederCtx[i]
 
   /* set the command params */
-  seekingCtxIdx = i;
-  seekingStreamIdx = streamIdx;
-  seekingTimestamp = timestamp;
-  seekingFlags = flags;
+  feeder->seekingCtxIdx = i;
+  feeder->seekingStreamIdx = streamIdx;
+  feeder->seekingTimestamp = timestamp;
+  feeder->seekingFlags = flags;
+  feeder->seekingPktFlag = pktFlag;
 
   /* and send the command */
-  sendFeederCommand(PACKET_FEEDER_SEEK);
+  sendFeederCommand(feeder, PACKET_FEEDER_SEEK);
 
   /* return */
   return 0;
 }
 
 
-static void packetFeederSeek(void)
+int WV_contextSeek(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, int streamIdx, uint64_t timestamp, int flags)
+{
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
+  SDL_mutexP(feeder->clientMutex);
+  int ret = contextSeek(feeder, formatCtx, streamIdx, timestamp, flags, WV_PACKET_FLAG_SEEK);
+  SDL_mutexV(feeder->clientMutex);
+
+  return ret;
+}
+
+
+int WV_contextStep(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, int streamIdx, uint64_t timestamp, int flags)
+{
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
+  SDL_mutexP(feeder->clientMutex);
+  int ret = contextSeek(feeder, formatCtx, streamIdx, timestamp, flags, WV_PACKET_FLAG_STEP);
+  SDL_mutexV(feeder->clientMutex);
+
+  return ret;
+}
+
+
+int WV_setStreamDiscard(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, int streamIdx, enum AVDiscard discard)
+{
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
+  if(streamIdx < 0 || streamIdx >= (int)formatCtx->nb_streams)
+    return -1;
+
+  /* the feeder read the streams */
+  //so the discard is changed by its thread
+  SDL_mutexP(feeder->clientMutex);
+  feeder->discardFormatCtx = formatCtx;
+  feeder->discardStreamIdx = streamIdx;
+  feeder->discard = discard;
+  sendFeederCommand(feeder, PACKET_FEEDER_DISCARD);
+  SDL_mutexV(feeder->clientMutex);
+
+  return 0;
+}
+
+
+static void packetFeederSeek(PacketFeeder* feeder)
 {
   /* read cmd parameter */
-  PacketFeederContext* seekingCtx = feederCtx[seekingCtxIdx];
+  PacketFeederContext* seekingCtx = feeder->feederCtx[feeder->seekingCtxIdx];
   
   int currIdx;
   PacketQueue* currQ;
@@ -690,13 +1044,16 @@ static void packetFeederSeek(void)
   seekingCtx->fullFlag = 0;
   seekingCtx->pkt = NULL;
 
+  /* the pkts are now read from the file */
+  seekLoopCache(feeder, seekingCtx);
+
   /* send a seeking pkt to all the queue */
   PacketQueueElement* seekingPkt;
   for(currIdx=0; currIdx<seekingCtx->nbPipe; currIdx++){
     /* build a seeking pkt */
     seekingPkt = (PacketQueueElement*)malloc(sizeof(PacketQueueElement));
     ((AVPacket*)seekingPkt)->data = NULL;
-    ((AVPacket*)seekingPkt)->flags = WV_PACKET_FLAG_SEEK;
+    ((AVPacket*)seekingPkt)->flags = feeder->seekingPktFlag;
     ((AVPacket*)seekingPkt)->size = 0;
     
     /*send to the queue */
@@ -705,7 +1062,7 @@ static void packetFeederSeek(void)
   
   /* now seek */
   /*!!!*/
-  if(av_seek_frame(seekingCtx->formatCtx, seekingStreamIdx, seekingTimestamp, seekingFlags) < 0){
+  if(av_seek_frame(seekingCtx->formatCtx, feeder->seekingStreamIdx, feeder->seekingTimestamp, feeder->seekingFlags) < 0){
     av_seek_frame(seekingCtx->formatCtx, -1, 0, AVSEEK_FLAG_BACKWARD); //on error seek to 0
   }
 }
@@ -720,32 +1077,40 @@ static void packetFeederSeek(void)
 /* -next the feeder space function                */
 /**************************************************/
 
-int WV_packetFeederShutdown(void)
+int WV_packetFeederShutdown(WVPacketFeederHandle feederHdl)
 {
+  PacketFeeder* feeder = (PacketFeeder*)feederHdl;
+
   /* send the command to the feeder */
-  sendFeederCommand(PACKET_FEEDER_QUIT);
+  sendFeederCommand(feeder, PACKET_FEEDER_QUIT);
 
   //the feeder destroy all the contexts and stop his thread 
+  SDL_WaitThread(feeder->thread, NULL);
   
   /* we can now destroy the mutex and cond */
-  SDL_DestroyMutex(cmdMutex);
-  SDL_DestroyMutex(stateUpdatedMutex);
-  SDL_DestroyCond(stateUpdated);
-  SDL_DestroyCond(cmdExecuted);
+  SDL_DestroyMutex(feeder->clientMutex);
+  SDL_DestroyMutex(feeder->cmdMutex);
+  SDL_DestroyMutex(feeder->stateUpdatedMutex);
+  SDL_DestroyCond(feeder->stateUpdated);
+  SDL_DestroyCond(feeder->cmdExecuted);
+
+  free(feeder);
 
   /*it's ok, return */
   return 0;
 }
 
 /* the return that stop the thread is in the feeder loop */
-static void packetFeederQuit(void)
+static void packetFeederQuit(PacketFeeder* feeder)
 {
   /* free all the contexts */
-  if(nbFeederContext){
+  if(feeder->nbFeederContext){
     int i;
-    for(i=0; i<nbFeederContext; i++)
-      freeFeederContext(feederCtx[i]);
+    for(i=0; i<feeder->nbFeederContext; i++)
+      freeFeederContext(feeder->feederCtx[i]);
   }
+
+  releaseLoopCache(feeder, feeder->loopCacheSize);
 }
 
 
@@ -758,6 +1123,8 @@ static void packetFeederQuit(void)
 /**********************************************/
 static int packetFeederThread(void* opaque)
 {
+  PacketFeeder* feeder = (PacketFeeder*)opaque;
+  
   int fullQueueFlag = 1;  //when one queue is full per context
                           //or when there are no queue to feed 
                           //wait !
@@ -766,57 +1133,61 @@ static int packetFeederThread(void* opaque)
     /***********************/
     /* ckeck for waiting   */
     /***********************/
-    SDL_mutexP(stateUpdatedMutex);
-    if(fullQueueFlag && !stateUpdatedFlag){ //if we have see that all the queues are full
+    SDL_mutexP(feeder->stateUpdatedMutex);
+    if(fullQueueFlag && !feeder->stateUpdatedFlag){ //if we have see that all the queues are full
                                             // and if nothing append since the last loop
-      SDL_CondWait(stateUpdated, stateUpdatedMutex); //wait for state change
+      SDL_CondWait(feeder->stateUpdated, feeder->stateUpdatedMutex); //wait for state change
     }
     
     fullQueueFlag = 1;             //we will see if if a queue isn't full
-    stateUpdatedFlag = 0;          //state return to 0
-    SDL_mutexV(stateUpdatedMutex);
+    feeder->stateUpdatedFlag = 0;          //state return to 0
+    SDL_mutexV(feeder->stateUpdatedMutex);
 
 
     /**************************/
     /* check for user command */
     /**************************/
-    SDL_mutexP(cmdMutex);
+    SDL_mutexP(feeder->cmdMutex);
     
-    if(feederCommand){   //if we have a command execute it 
-      switch(feederCommand){
+    if(feeder->feederCommand){   //if we have a command execute it 
+      switch(feeder->feederCommand){
 	
       case PACKET_FEEDER_ADD_CONTEXT:
-	packetFeederAddContext();
+	packetFeederAddContext(feeder);
 	break;
 
       case PACKET_FEEDER_DEL_CONTEXT:
-	packetFeederDelContext();
+	packetFeederDelContext(feeder);
 	break;
 
       case PACKET_FEEDER_DEL_QUEUE:
-	packetFeederDelQueue();
+	packetFeederDelQueue(feeder);
 	break;
 
       case PACKET_FEEDER_SEEK:
-	packetFeederSeek();
+	packetFeederSeek(feeder);
+	break;
+
+      case PACKET_FEEDER_DISCARD:
+	feeder->discardFormatCtx->streams[feeder->discardStreamIdx]->discard = feeder->discard;
 	break;
 	
       case PACKET_FEEDER_QUIT:
-	packetFeederQuit();
-	feederCommand = PACKET_FEEDER_NO_COMMAND;
-	SDL_mutexV(cmdMutex);
-	SDL_CondSignal(cmdExecuted);
+	packetFeederQuit(feeder);
+	feeder->feederCommand = PACKET_FEEDER_NO_COMMAND;
+	SDL_mutexV(feeder->cmdMutex);
+	SDL_CondSignal(feeder->cmdExecuted);
 	return 0;                  //get out of this loop !!!
 	break;
       }
       
       /*the command is executed, say this to the client */
-      feederCommand = PACKET_FEEDER_NO_COMMAND;
-      SDL_mutexV(cmdMutex);                     
-      SDL_CondSignal(cmdExecuted);
+      feeder->feederCommand = PACKET_FEEDER_NO_COMMAND;
+      SDL_mutexV(feeder->cmdMutex);                     
+      SDL_CondSignal(feeder->cmdExecuted);
     }
     else{    //else just release the cmd mutex 
-      SDL_mutexV(cmdMutex);
+      SDL_mutexV(feeder->cmdMutex);
     }
     
   
@@ -830,8 +1201,8 @@ static int packetFeederThread(void* opaque)
 
 
     /* for each context */
-    for(fdIdx=0; fdIdx<nbFeederContext; fdIdx++){
-      currFCtx = feederCtx[fdIdx];
+    for(fdIdx=0; fdIdx<feeder->nbFeederContext; fdIdx++){
+      currFCtx = feeder->feederCtx[fdIdx];
 
       /**************************/
       /* force packet put if a  */
@@ -853,8 +1224,17 @@ static int packetFeederThread(void* opaque)
       /* try to reput the pkt we have saved*/
       /*************************************/
       if(currFCtx->fullFlag){
+	/* the stream was discarded since, its queue may stay full */
+	int savedStream = ((AVPacket*)currFCtx->pkt)->stream_index;
+	if(currFCtx->formatCtx->streams[savedStream]->discard == AVDISCARD_ALL){
+	  av_free_packet((AVPacket*)currFCtx->pkt);
+	  free(currFCtx->pkt);
+	  currFCtx->fullFlag = 0;
+	  currFCtx->pkt = NULL;
+	  fullQueueFlag = 0;
+	}
 	/* retry */
-	if(packetQueuePut(currFCtx->destQueue, currFCtx->pkt, forceFlag)>= 0){  //if the pkt was put
+	else if(packetQueuePut(currFCtx->destQueue, currFCtx->pkt, forceFlag)>= 0){  //if the pkt was put
 	  currFCtx->fullFlag = 0;  //the context is not full anymore
   	  currFCtx->pkt = NULL;    //this say that no pkt are waiting
 	  fullQueueFlag = 0;       //no wait at the end of the loop !
@@ -866,15 +1246,24 @@ static int packetFeederThread(void* opaque)
       /******************************/
       else{
 	/* get the next pkt */
-	currPkt = (PacketQueueElement*)malloc(sizeof(PacketQueueElement));
+	/* from the loop cache or from the file */
+	if(currFCtx->cacheState == LOOP_CACHE_REPLAY){
+	  currPkt = replayPacket(currFCtx);
+	}
+	else{
+	  currPkt = (PacketQueueElement*)malloc(sizeof(PacketQueueElement));
+	  if(av_read_frame(currFCtx->formatCtx, (AVPacket*)currPkt)<0){
+	    free(currPkt);
+	    currPkt = NULL;
+	  }
+	}
 	
-	if(av_read_frame(currFCtx->formatCtx, (AVPacket*)currPkt)<0){
+	if(!currPkt){
 	    
 	  /*________________________*/
 	  /* if we can't read a pkt */
 	  /* 1) send a eof pkt to all the queues */
 	  /* TODO error type check */
-	  free(currPkt);
 	  
 	  int sendIdx;
 	  PacketQueueElement* eofPkt;
@@ -889,7 +1278,9 @@ static int packetFeederThread(void* opaque)
 	  }
 
 	  /* 2) seek to the file start */
-	  av_seek_frame(currFCtx->formatCtx, -1, 0, AVSEEK_FLAG_BACKWARD);
+	  //not needed if the loop is replayed from the cache
+	  if(restartLoopCache(currFCtx) < 0)
+	    av_seek_frame(currFCtx->formatCtx, -1, 0, AVSEEK_FLAG_BACKWARD);
 	  fullQueueFlag = 0;   //we can now read the first pkt
 
 	  /* go to the next context */
@@ -911,8 +1302,16 @@ static int packetFeederThread(void* opaque)
 	  if(currFCtx->streamIdx[searchIdx] == searchStream)
 	    break;
 
+	/* the first pass keep the pkts of the queued streams */
+	//even discarded, a track can be enabled later
+	if(currFCtx->cacheState == LOOP_CACHE_RECORD && searchIdx < currFCtx->nbPipe)
+	  recordPacket(feeder, currFCtx, (AVPacket*)currPkt);
+
 	/* found ? */
-	if(searchIdx == currFCtx->nbPipe){            //if not 
+	/* the streams discarded by the user are not queued */
+	//some demuxers still return their pkts
+	if(searchIdx == currFCtx->nbPipe ||					\
+	   currFCtx->formatCtx->streams[searchStream]->discard == AVDISCARD_ALL){            //if not 
 	  av_free_packet((AVPacket*)currPkt);  //free the pkt
 	  free(currPkt);
 	  fullQueueFlag = 0;                //this context is not full !!!
@@ -948,28 +1347,39 @@ static int packetFeederThread(void* opaque)
 /*||||||||||||||||||||||||||||||||||||||||||||||||||||||*/
 /********************************************************/
 
-void WV_initPacketFeeder(void)
+WVPacketFeederHandle WV_initPacketFeeder(void)
 {
-  /* init state variables (in the case where the feeder is restarted) */
-  stateUpdatedFlag = 0;
-  nbFeederContext = 0;
-  feederCommand = PACKET_FEEDER_NO_COMMAND;
+  /* the loop cache memory of all the feeders */
+  if(!loopCacheMutex)
+    loopCacheMutex = SDL_CreateMutex();
+  
+  /* alloc the feeder */
+  PacketFeeder* feeder = (PacketFeeder*)malloc(sizeof(PacketFeeder));
+  if(!feeder)
+    return NULL;
+  
+  /* init state variables */
+  feeder->stateUpdatedFlag = 0;
+  feeder->nbFeederContext = 0;
+  feeder->buildingCtx = NULL;
+  feeder->loopCacheSize = 0;
+  feeder->feederCommand = PACKET_FEEDER_NO_COMMAND;
+  feeder->freeingCtx = NULL;
 
   /* init thread communication */
-  stateUpdatedMutex = SDL_CreateMutex();
-  stateUpdated = SDL_CreateCond();
+  feeder->stateUpdatedMutex = SDL_CreateMutex();
+  feeder->stateUpdated = SDL_CreateCond();
 
-  cmdMutex = SDL_CreateMutex();
-  cmdExecuted = SDL_CreateCond();
+  feeder->clientMutex = SDL_CreateMutex();
+  feeder->cmdMutex = SDL_CreateMutex();
+  feeder->cmdExecuted = SDL_CreateCond();
   
   /* launch the feeder thread */
   #if SDL_VERSION_ATLEAST(2,0,0)
-  SDL_CreateThread(packetFeederThread, "packetThread", NULL);
+  feeder->thread = SDL_CreateThread(packetFeederThread, "packetThread", feeder);
   #else
-  SDL_CreateThread(packetFeederThread, NULL);
+  feeder->thread = SDL_CreateThread(packetFeederThread, feeder);
   #endif
 
+  return (WVPacketFeederHandle)feeder;
 }
-   
-
-
@@ -32,11 +32,16 @@
 #include "waave_engine_flags.h"
 
 
+/* abstract pointer for the user */
+typedef void* WVPacketFeederHandle;
+
+
 /*********************************/
 /* first, launch the pkt feeder  */
 /* this launch a new thread      */
+/* each engine has its own feeder*/
 /*********************************/
-void WV_initPacketFeeder(void);
+WVPacketFeederHandle WV_initPacketFeeder(void);
 
 /*****************************************/
 /* next build a feeder context           */
@@ -44,17 +49,26 @@ void WV_initPacketFeeder(void);
 /*****************************************/
 
 /* give the Format Context and say the number of streams you want to queue */
-int WV_buildFeederContext(AVFormatContext* formatCtx, int nbStreams);
+int WV_buildFeederContext(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, int nbStreams);
 
 /* for each stream index, query the corresponding queue Handle  */
 /* (the return value) */
 /*!!! you need to call this function nbStreams times !!!*/
 typedef void* WVQueueHandle;
 
-WVQueueHandle WV_getStreamQueue(int streamIdx);
+WVQueueHandle WV_getStreamQueue(WVPacketFeederHandle feederHdl, int streamIdx);
+
+/* the loop cache, before adding the context */
+/* the pkts of the first pass are kept in memory */
+/* and the next loops are replayed from them without reading the file */
+#define WV_NO_LOOP_CACHE 0
+#define WV_LOOP_CACHE 1
+
+//only the files smaller than the limit are cached
+int WV_setFeederLoopCache(WVPacketFeederHandle feederHdl, int cacheFlag);
 
 /* start feeding the context */
-int WV_addFeederContext(void);
+int WV_addFeederContext(WVPacketFeederHandle feederHdl);
 
 
 /******************************************************/
@@ -93,16 +107,52 @@ AVPacket* WV_packetQueueGet(WVQueueHandle queueHdl, int waitFlag);
 #define WV_PACKET_FLAG_EOF 1  
 //when the feeder seek
 #define WV_PACKET_FLAG_SEEK 2 
+//when the feeder seek by step (trick play), the decoders keep their state
+#define WV_PACKET_FLAG_STEP 3
+//never sent by the feeder, the decoders use it to get the delayed frames at eof
+#define WV_PACKET_FLAG_DRAIN 4
 
 /* !!! free those pkts with !!!*/
 /* free(pkt) */
 
 
+/* the drain pkt, empty, to give to the codec */
+AVPacket* WV_getDrainPacket(void);
+
+/* !!! free it like the others pkts !!!*/
+/* av_free_packet(pkt) */
+/* free(pkt) */
+
+
+/***************************************/
+/* the decoders can switch to the      */
+/* queue of another context at eof     */
+/* they signal it with this function   */
+/***************************************/
+typedef void (*WVSpliceSignalCall)(void* param);
+
+
 
 /****************/
 /* you can seek */
 /****************/
-int WV_contextSeek(AVFormatContext* formatCtx, int streamIdx, uint64_t timestamp, int flags);
+int WV_contextSeek(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, \
+		   int streamIdx, uint64_t timestamp, int flags);
+
+/* seek but send step pkts */
+/* used by the decoders to move by steps (trick play) */
+int WV_contextStep(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, \
+		   int streamIdx, uint64_t timestamp, int flags);
+
+
+/*********************************************/
+/* change which pkts of a stream are read    */
+/* !!! the streams of an added context must  */
+/* be changed by this function, the feeder   */
+/* thread read them !!!                      */
+/*********************************************/
+int WV_setStreamDiscard(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, \
+			int streamIdx, enum AVDiscard discard);
 
 
 
@@ -111,20 +161,32 @@ int WV_contextSeek(AVFormatContext* formatCtx, int streamIdx, uint64_t timestamp
 /* you can remove a context at any time */
 /****************************************/
 /*!!! be sure you are not getting pkt from the context you want to delete !!!*/
-int WV_delFeederContext(AVFormatContext* formatCtx);
+int WV_delFeederContext(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx);
 
 
 /*******************/
 /* or just a queue */
 /*******************/
-int WV_delFeederQueue(AVFormatContext* formatCtx, WVQueueHandle queueHdl);
+int WV_delFeederQueue(WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, WVQueueHandle queueHdl);
+
+
+
+/*****************************************/
+/* the loop cache memory                 */
+/* bounded by the file size and the size */
+/* of all the cached pkts (bytes)        */
+/* the limits are shared by the feeders, */
+/* the memory limit bound them all       */
+/*****************************************/
+void WV_setFeederLoopCacheLimits(uint32_t maxFileSize, uint32_t maxSize);
 
+uint32_t WV_getFeederLoopCacheSize(WVPacketFeederHandle feederHdl);
 
 
 /*********************************************/
 /* when the job is done, shutdown the feeder */
 /*********************************************/
-int WV_packetFeederShutdown(void);
+int WV_packetFeederShutdown(WVPacketFeederHandle feederHdl);
 
 
 
@@ -0,0 +1,692 @@
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "probe_cache.h"
+
+#include "common.h"
+#include "config_sdl.h"
+#include "config_ffmpeg.h"
+
+#include "waave_engine_flags.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+/* the info of a stream */
+/* what the decoders need to open the codecs */
+typedef struct ProbeStream{
+  int codecType;
+  int codecId;
+  unsigned int codecTag;
+  int bitRate;
+
+  /* video */
+  int width;
+  int height;
+  int pixFmt;
+  int hasBFrames;
+  AVRational frameRate;
+  AVRational avgFrameRate;
+  
+  /* audio */
+  int sampleRate;
+  int channels;
+  uint64_t channelLayout;
+  int sampleFmt;
+
+  /* timing */
+  int64_t duration;
+  int64_t startTime;
+
+  /* codec private data */
+  int extradataSize;
+  uint8_t* extradata;
+  
+}ProbeStream;
+
+
+/* a cached file */
+typedef struct ProbeEntry{
+  /* the key */
+  char* filename;
+  int64_t fileSize;
+  int64_t fileTime;
+
+  /* the stream selection */
+  int audioStreamIdx;
+  int videoStreamIdx;
+
+  /* the format */
+  int64_t duration;
+  int64_t startTime;
+  int nbStreams;
+  ProbeStream* streams;
+
+  struct ProbeEntry* next;
+  
+}ProbeEntry;
+
+
+/* the cache */
+//protected by cacheMutex, the streams are opened by the loader workers
+static char* cacheFilename = NULL;   //NULL when disabled
+static ProbeEntry* entries = NULL;   //the newest first
+static int nbEntries = 0;
+static int nbFileEntries = 0;        //the entries in the file, with the replaced ones
+static SDL_mutex* cacheMutex = NULL;
+
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*           THE ENTRIES          */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* the key of the file */
+static int getFileKey(const char* filename, int64_t* fileSize, int64_t* fileTime)
+{
+  struct stat fileStat;
+
+  //the urls are not cached
+  if(stat(filename, &fileStat) < 0)
+    return -1;
+
+  *fileSize = (int64_t)fileStat.st_size;
+  *fileTime = (int64_t)fileStat.st_mtime;
+  
+  return 0;
+}
+
+
+static ProbeEntry* allocEntry(const char* filename, int nbStreams)
+{
+  if(nbStreams < 0 || nbStreams > WV_PROBE_CACHE_MAX_STREAMS)
+    return NULL;
+  
+  /* alloc the struct and the streams */
+  /* in one time */
+  ProbeEntry* entry = (ProbeEntry*)malloc(sizeof(ProbeEntry) + nbStreams * sizeof(ProbeStream));
+  if(!entry)
+    return NULL;
+  
+  void* structP = (void*)entry;
+  structP += sizeof(ProbeEntry);
+  entry->streams = (ProbeStream*)structP;
+  entry->nbStreams = nbStreams;
+
+  int i;
+  for(i=0; i<nbStreams; i++){
+    entry->streams[i].extradataSize = 0;
+    entry->streams[i].extradata = NULL;
+  }
+
+  /* copy the filename */
+  entry->filename = SDL_strdup(filename);
+  entry->next = NULL;
+  if(!entry->filename){
+    free(entry);
+    return NULL;
+  }
+
+  return entry;
+}
+
+
+static void freeEntry(ProbeEntry* entry)
+{
+  int i;
+  for(i=0; i<entry->nbStreams; i++)
+    if(entry->streams[i].extradata)
+      free(entry->streams[i].extradata);
+
+  SDL_free(entry->filename);
+  free(entry);
+}
+
+
+/* !!! need cacheMutex !!! */
+static ProbeEntry* findEntry(const char* filename)
+{
+  ProbeEntry* entry;
+  for(entry = entries; entry; entry = entry->next)
+    if(!SDL_strcmp(entry->filename, filename))
+      return entry;
+
+  return NULL;
+}
+
+
+/* !!! need cacheMutex !!! */
+/* replace the previous entry of the file */
+/* and drop the oldest entries */
+static void insertEntry(ProbeEntry* newEntry)
+{
+  ProbeEntry** entryP = &entries;
+  
+  while(*entryP){
+    if(!SDL_strcmp((*entryP)->filename, newEntry->filename)){
+      ProbeEntry* oldEntry = *entryP;
+      *entryP = oldEntry->next;
+      freeEntry(oldEntry);
+      nbEntries--;
+    }
+    else{
+      entryP = &(*entryP)->next;
+    }
+  }
+
+  newEntry->next = entries;
+  entries = newEntry;
+  nbEntries++;
+
+  /* the cache size */
+  if(nbEntries > WV_PROBE_CACHE_MAX_ENTRIES){
+    int i;
+    entryP = &entries;
+    for(i=0; i<WV_PROBE_CACHE_MAX_ENTRIES; i++)
+      entryP = &(*entryP)->next;
+
+    while(*entryP){
+      ProbeEntry* oldEntry = *entryP;
+      *entryP = oldEntry->next;
+      freeEntry(oldEntry);
+      nbEntries--;
+    }
+  }
+}
+
+
+/* !!! need cacheMutex !!! */
+static void freeEntries(void)
+{
+  ProbeEntry* entry;
+  while(entries){
+    entry = entries;
+    entries = entry->next;
+    freeEntry(entry);
+  }
+  nbEntries = 0;
+  nbFileEntries = 0;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*          THE CACHE FILE        */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* one line per file */
+/* followed by one line per stream */
+
+static void writeEntry(FILE* file, ProbeEntry* entry)
+{
+  int i, j;
+  
+  fprintf(file, "%lld %lld %d %d %d %lld %lld %d ",			\
+	  (long long)entry->fileSize, (long long)entry->fileTime,	\
+	  entry->nbStreams, entry->audioStreamIdx, entry->videoStreamIdx, \
+	  (long long)entry->duration, (long long)entry->startTime,	\
+	  (int)SDL_strlen(entry->filename));
+  fprintf(file, "%s\n", entry->filename);
+
+  for(i=0; i<entry->nbStreams; i++){
+    ProbeStream* stream = &entry->streams[i];
+    
+    fprintf(file, "%d %d %u %d %d %d %d %d %d %d %d %d %d %d %llu %d %lld %lld %d ", \
+	    stream->codecType, stream->codecId, stream->codecTag, stream->bitRate, \
+	    stream->width, stream->height, stream->pixFmt, stream->hasBFrames, \
+	    stream->frameRate.num, stream->frameRate.den,		\
+	    stream->avgFrameRate.num, stream->avgFrameRate.den,	\
+	    stream->sampleRate, stream->channels,			\
+	    (unsigned long long)stream->channelLayout, stream->sampleFmt, \
+	    (long long)stream->duration, (long long)stream->startTime,	\
+	    stream->extradataSize);
+
+    for(j=0; j<stream->extradataSize; j++)
+      fprintf(file, "%02x", stream->extradata[j]);
+    fprintf(file, "\n");
+  }
+}
+
+
+/* NULL if the file is corrupted */
+static ProbeEntry* readEntry(FILE* file)
+{
+  long long fileSize, fileTime, duration, startTime;
+  int nbStreams, audioStreamIdx, videoStreamIdx, nameSize;
+  int i, j;
+
+  if(fscanf(file, "%lld %lld %d %d %d %lld %lld %d ",			\
+	    &fileSize, &fileTime, &nbStreams, &audioStreamIdx, &videoStreamIdx, \
+	    &duration, &startTime, &nameSize) != 8)
+    return NULL;
+
+  /* the file can be truncated or corrupted */
+  if(nbStreams < 0 || nbStreams > WV_PROBE_CACHE_MAX_STREAMS)
+    return NULL;
+  if(audioStreamIdx < -1 || audioStreamIdx >= nbStreams || videoStreamIdx < -1 || videoStreamIdx >= nbStreams)
+    return NULL;
+  if(nameSize <= 0 || nameSize > WV_PROBE_CACHE_MAX_NAME_SIZE)
+    return NULL;
+
+  /* the filename */
+  char* filename = (char*)malloc(nameSize + 1);
+  if(!filename)
+    return NULL;
+  
+  for(i=0; i<nameSize; i++){
+    int c = fgetc(file);
+    if(c == EOF){
+      free(filename);
+      return NULL;
+    }
+    filename[i] = (char)c;
+  }
+  filename[nameSize] = '\0';
+
+  ProbeEntry* entry = allocEntry(filename, nbStreams);
+  free(filename);
+  if(!entry)
+    return NULL;
+
+  entry->fileSize = fileSize;
+  entry->fileTime = fileTime;
+  entry->audioStreamIdx = audioStreamIdx;
+  entry->videoStreamIdx = videoStreamIdx;
+  entry->duration = duration;
+  entry->startTime = startTime;
+
+  /* the streams */
+  for(i=0; i<nbStreams; i++){
+    ProbeStream* stream = &entry->streams[i];
+    unsigned long long channelLayout;
+    
+    if(fscanf(file, "%d %d %u %d %d %d %d %d %d %d %d %d %d %d %llu %d %lld %lld %d ", \
+	      &stream->codecType, &stream->codecId, &stream->codecTag, &stream->bitRate, \
+	      &stream->width, &stream->height, &stream->pixFmt, &stream->hasBFrames, \
+	      &stream->frameRate.num, &stream->frameRate.den,		\
+	      &stream->avgFrameRate.num, &stream->avgFrameRate.den,	\
+	      &stream->sampleRate, &stream->channels,			\
+	      &channelLayout, &stream->sampleFmt,			\
+	      &duration, &startTime, &stream->extradataSize) != 19 || \
+       stream->extradataSize < 0 || stream->extradataSize > WV_PROBE_CACHE_MAX_EXTRADATA_SIZE){
+      stream->extradataSize = 0;
+      freeEntry(entry);
+      return NULL;
+    }
+
+    stream->channelLayout = (uint64_t)channelLayout;
+    stream->duration = duration;
+    stream->startTime = startTime;
+
+    if(stream->extradataSize){
+      stream->extradata = (uint8_t*)malloc(stream->extradataSize);
+      if(!stream->extradata){
+	freeEntry(entry);
+	return NULL;
+      }
+      
+      for(j=0; j<stream->extradataSize; j++){
+	unsigned int byte;
+	if(fscanf(file, "%2x", &byte) != 1){
+	  freeEntry(entry);
+	  return NULL;
+	}
+	stream->extradata[j] = (uint8_t)byte;
+      }
+    }
+  }
+
+  return entry;
+}
+
+
+/* !!! need cacheMutex !!! */
+/* write only the current entries */
+static void rewriteCacheFile(void)
+{
+  int i;
+  ProbeEntry* entry;
+
+  //the last entry of a file is the newest
+  ProbeEntry** oldestFirst = (ProbeEntry**)malloc((nbEntries + 1) * sizeof(ProbeEntry*));
+  if(!oldestFirst)
+    return;
+
+  i = nbEntries;
+  for(entry = entries; entry; entry = entry->next)
+    oldestFirst[--i] = entry;
+
+  FILE* file = fopen(cacheFilename, "w");
+  if(!file){
+    free(oldestFirst);
+    return;
+  }
+
+  for(i=0; i<nbEntries; i++)
+    writeEntry(file, oldestFirst[i]);
+  fclose(file);
+  free(oldestFirst);
+
+  nbFileEntries = nbEntries;
+}
+
+
+/* !!! need cacheMutex !!! */
+static void loadCacheFile(void)
+{
+  FILE* file = fopen(cacheFilename, "r");
+  if(!file)
+    return;   //a new cache
+
+  //the last entry of a file is the newest
+  ProbeEntry* entry;
+  int corruptedFlag = 0;
+  
+  while(1){
+    /* the end of the file */
+    if(fscanf(file, " ") == EOF || feof(file))
+      break;
+
+    //the entries after a corruption are lost
+    entry = readEntry(file);
+    if(!entry){
+      corruptedFlag = 1;
+      break;
+    }
+    
+    insertEntry(entry);
+    nbFileEntries++;
+  }
+  fclose(file);
+
+  /* compact the file */
+  if(corruptedFlag || nbFileEntries != nbEntries)
+    rewriteCacheFile();
+}
+
+
+/* !!! need cacheMutex !!! */
+static void appendCacheFile(ProbeEntry* entry)
+{
+  /* too many replaced entries */
+  if(nbFileEntries >= 2 * nbEntries){
+    rewriteCacheFile();
+    return;
+  }
+  
+  FILE* file = fopen(cacheFilename, "a");
+  if(!file)
+    return;
+
+  writeEntry(file, entry);
+  fclose(file);
+  nbFileEntries++;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*           THE CLIENT           */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+int WV_initProbeCache(void)
+{
+  if(!cacheMutex)
+    cacheMutex = SDL_CreateMutex();
+
+  return 0;
+}
+
+
+int WV_setProbeCache(const char* filename)
+{
+  if(!cacheMutex)
+    return -1;
+
+  SDL_mutexP(cacheMutex);
+
+  /* close the previous cache */
+  freeEntries();
+  if(cacheFilename){
+    SDL_free(cacheFilename);
+    cacheFilename = NULL;
+  }
+
+  /* load the new one */
+  if(filename){
+    cacheFilename = SDL_strdup(filename);
+    loadCacheFile();
+  }
+  
+  SDL_mutexV(cacheMutex);
+
+  return 0;
+}
+
+
+int WV_applyProbeCache(AVFormatContext* formatCtx, const char* filename,	\
+		       int* audioStreamIdx, int* videoStreamIdx)
+{
+  if(!cacheMutex)
+    return -1;
+
+  int64_t fileSize, fileTime;
+  if(getFileKey(filename, &fileSize, &fileTime) < 0)
+    return -1;
+
+  SDL_mutexP(cacheMutex);
+
+  /* find the file */
+  ProbeEntry* entry = NULL;
+  if(cacheFilename)
+    entry = findEntry(filename);
+
+  if(!entry || entry->fileSize != fileSize || entry->fileTime != fileTime || \
+     entry->nbStreams != (int)formatCtx->nb_streams){
+    SDL_mutexV(cacheMutex);
+    return -1;
+  }
+
+  /* the demuxer must give the same streams */
+  int i;
+  for(i=0; i<entry->nbStreams; i++){
+    AVCodecContext* codec = formatCtx->streams[i]->codec;
+    if(codec->codec_id != CODEC_ID_NONE && codec->codec_id != (enum CodecID)entry->streams[i].codecId){
+      SDL_mutexV(cacheMutex);
+      return -1;
+    }
+  }
+
+  /* fill the stream info */
+  for(i=0; i<entry->nbStreams; i++){
+    ProbeStream* cached = &entry->streams[i];
+    AVStream* stream = formatCtx->streams[i];
+    AVCodecContext* codec = stream->codec;
+
+    codec->codec_type = (enum AVMediaType)cached->codecType;
+    codec->codec_id = (enum CodecID)cached->codecId;
+    codec->codec_tag = cached->codecTag;
+    codec->bit_rate = cached->bitRate;
+    
+    codec->width = cached->width;
+    codec->height = cached->height;
+    codec->pix_fmt = (enum PixelFormat)cached->pixFmt;
+    codec->has_b_frames = cached->hasBFrames;
+    stream->r_frame_rate = cached->frameRate;
+    stream->avg_frame_rate = cached->avgFrameRate;
+    
+    codec->sample_rate = cached->sampleRate;
+    codec->channels = cached->channels;
+    codec->channel_layout = cached->channelLayout;
+    codec->sample_fmt = (enum AVSampleFormat)cached->sampleFmt;
+
+    stream->duration = cached->duration;
+    stream->start_time = cached->startTime;
+
+    //keep the demuxer data if given
+    if(!codec->extradata_size && cached->extradataSize){
+      codec->extradata = (uint8_t*)av_mallocz(cached->extradataSize + FF_INPUT_BUFFER_PADDING_SIZE);
+      if(!codec->extradata)
+	continue;
+      int j;
+      for(j=0; j<cached->extradataSize; j++)
+	codec->extradata[j] = cached->extradata[j];
+      codec->extradata_size = cached->extradataSize;
+    }
+  }
+
+  formatCtx->duration = entry->duration;
+  formatCtx->start_time = entry->startTime;
+
+  /* the stream selection */
+  *audioStreamIdx = entry->audioStreamIdx;
+  *videoStreamIdx = entry->videoStreamIdx;
+
+  SDL_mutexV(cacheMutex);
+
+  return 0;
+}
+
+
+void WV_saveProbeCache(AVFormatContext* formatCtx, const char* filename,	\
+		       int audioStreamIdx, int videoStreamIdx)
+{
+  if(!cacheMutex)
+    return;
+  
+  int64_t fileSize, fileTime;
+  if(getFileKey(filename, &fileSize, &fileTime) < 0)
+    return;
+
+  SDL_mutexP(cacheMutex);
+
+  if(!cacheFilename){
+    SDL_mutexV(cacheMutex);
+    return;
+  }
+
+  /* the entry must be readable */
+  //from the cache file
+  int i, j;
+  int nameSize = SDL_strlen(filename);
+  if(nameSize <= 0 || nameSize > WV_PROBE_CACHE_MAX_NAME_SIZE){
+    SDL_mutexV(cacheMutex);
+    return;
+  }
+  
+  for(i=0; i<(int)formatCtx->nb_streams; i++){
+    if(formatCtx->streams[i]->codec->extradata_size > WV_PROBE_CACHE_MAX_EXTRADATA_SIZE){
+      SDL_mutexV(cacheMutex);
+      return;
+    }
+  }
+  
+  /* fill the entry */
+  //too many streams are not cached
+  ProbeEntry* entry = allocEntry(filename, formatCtx->nb_streams);
+  if(!entry){
+    SDL_mutexV(cacheMutex);
+    return;
+  }
+
+  entry->fileSize = fileSize;
+  entry->fileTime = fileTime;
+  entry->audioStreamIdx = audioStreamIdx;
+  entry->videoStreamIdx = videoStreamIdx;
+  entry->duration = formatCtx->duration;
+  entry->startTime = formatCtx->start_time;
+
+  for(i=0; i<entry->nbStreams; i++){
+    ProbeStream* cached = &entry->streams[i];
+    AVStream* stream = formatCtx->streams[i];
+    AVCodecContext* codec = stream->codec;
+
+    cached->codecType = (int)codec->codec_type;
+    cached->codecId = (int)codec->codec_id;
+    cached->codecTag = codec->codec_tag;
+    cached->bitRate = codec->bit_rate;
+    
+    cached->width = codec->width;
+    cached->height = codec->height;
+    cached->pixFmt = (int)codec->pix_fmt;
+    cached->hasBFrames = codec->has_b_frames;
+    cached->frameRate = stream->r_frame_rate;
+    cached->avgFrameRate = stream->avg_frame_rate;
+
+    cached->sampleRate = codec->sample_rate;
+    cached->channels = codec->channels;
+    cached->channelLayout = codec->channel_layout;
+    cached->sampleFmt = (int)codec->sample_fmt;
+
+    cached->duration = stream->duration;
+    cached->startTime = stream->start_time;
+
+    if(codec->extradata_size > 0 && codec->extradata){
+      cached->extradata = (uint8_t*)malloc(codec->extradata_size);
+      if(!cached->extradata){
+	freeEntry(entry);
+	SDL_mutexV(cacheMutex);
+	return;
+      }
+      
+      cached->extradataSize = codec->extradata_size;
+      for(j=0; j<cached->extradataSize; j++)
+	cached->extradata[j] = codec->extradata[j];
+    }
+  }
+
+  /* save it */
+  insertEntry(entry);
+  appendCacheFile(entry);
+  
+  SDL_mutexV(cacheMutex);
+}
+
+
+int WV_probeCacheShutdown(void)
+{
+  if(!cacheMutex)
+    return 0;
+
+  SDL_mutexP(cacheMutex);
+  freeEntries();
+  if(cacheFilename){
+    SDL_free(cacheFilename);
+    cacheFilename = NULL;
+  }
+  SDL_mutexV(cacheMutex);
+
+  SDL_DestroyMutex(cacheMutex);
+  cacheMutex = NULL;
+
+  return 0;
+}
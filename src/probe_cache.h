@@ -0,0 +1,83 @@
+#ifndef PROBE_CACHE_H
+#define PROBE_CACHE_H
+
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "common.h"
+#include "config_sdl.h"
+#include "config_ffmpeg.h"
+
+#include "waave_engine_flags.h"
+
+
+/*****************************************/
+/* the probe cache save the stream info  */
+/* of the opened files, so a reopen      */
+/* doesn't need avformat_find_stream_info*/
+/* the files are recognized by their     */
+/* path, size and modification time      */
+/*****************************************/
+
+/*******************************/
+/* INIT                        */
+/* the cache is disabled       */
+/*******************************/
+int WV_initProbeCache(void);
+
+
+/***************************************/
+/* ENABLE / DISABLE                    */
+/* load the cache file, the new probes */
+/* are appended to it                  */
+/* NULL disable the cache              */
+/***************************************/
+int WV_setProbeCache(const char* cacheFilename);
+
+
+/*******************************************/
+/* APPLY                                   */
+/* fill the stream info of an opened file  */
+/* and give the selected streams           */
+/* return -1 if the file is not cached     */
+/*******************************************/
+int WV_applyProbeCache(AVFormatContext* formatCtx, const char* filename,	\
+		       int* audioStreamIdx, int* videoStreamIdx);
+
+
+/*******************************************/
+/* SAVE                                    */
+/* after avformat_find_stream_info         */
+/*******************************************/
+void WV_saveProbeCache(AVFormatContext* formatCtx, const char* filename,	\
+		       int audioStreamIdx, int videoStreamIdx);
+
+
+/**********/
+/* CLOSE  */
+/**********/
+int WV_probeCacheShutdown(void);
+
+
+#endif
@@ -0,0 +1,393 @@
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "refresh_scheduler.h"
+
+#include "common.h"
+#include "config_sdl.h"
+
+#include "waave_engine_flags.h"
+#include "time_source.h"
+
+#if HAVE_WINDOWS_H
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*         THE TIME BASE          */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+uint64_t WV_getMicroTime(void)
+{
+#if HAVE_WINDOWS_H
+  LARGE_INTEGER counter;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  
+  /* avoid overflow */
+  uint64_t seconds = counter.QuadPart / frequency.QuadPart;
+  uint64_t remainder = counter.QuadPart % frequency.QuadPart;
+  
+  return seconds * 1000000 + (remainder * 1000000) / frequency.QuadPart;
+#else
+  struct timespec currentTime;
+  clock_gettime(CLOCK_MONOTONIC, &currentTime);
+
+  return (uint64_t)currentTime.tv_sec * 1000000 + (uint64_t)currentTime.tv_nsec / 1000;
+#endif
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*        THE REFRESH HEAP        */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* a scheduled refresh */
+typedef struct RefreshEntry{
+
+  uint64_t dueTime;           //when call, in us
+  WVRefreshCall refreshCall;  
+  void* param;
+
+}RefreshEntry;
+
+
+/* the min heap of due times */
+/* the first entry is the next refresh */
+static RefreshEntry refreshHeap[WV_REFRESH_SCHEDULER_MAX_ENTRIES];
+static int nbRefreshEntries;
+
+
+static void swapEntries(int i, int j)
+{
+  RefreshEntry tmpEntry = refreshHeap[i];
+  refreshHeap[i] = refreshHeap[j];
+  refreshHeap[j] = tmpEntry;
+}
+
+
+/* move the entry up while it is before its parent */
+static void siftUp(int i)
+{
+  int parent;
+  
+  while(i > 0){
+    parent = (i-1)/2;
+    if(refreshHeap[parent].dueTime <= refreshHeap[i].dueTime)
+      break;
+
+    swapEntries(i, parent);
+    i = parent;
+  }
+}
+
+
+/* move the entry down while a child is before it */
+static void siftDown(int i)
+{
+  int child;
+  
+  while(1){
+    child = 2*i + 1;
+    if(child >= nbRefreshEntries)
+      break;
+
+    /* take the first child */
+    if(child+1 < nbRefreshEntries && refreshHeap[child+1].dueTime < refreshHeap[child].dueTime)
+      child++;
+
+    if(refreshHeap[i].dueTime <= refreshHeap[child].dueTime)
+      break;
+
+    swapEntries(i, child);
+    i = child;
+  }
+}
+
+
+/* remove the entry at position i */
+static void removeEntry(int i)
+{
+  nbRefreshEntries--;
+  if(i == nbRefreshEntries)
+    return;
+
+  /* put the last in the hole */
+  refreshHeap[i] = refreshHeap[nbRefreshEntries];
+  siftUp(i);
+  siftDown(i);
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*     THE SCHEDULER THREAD       */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+static SDL_mutex* schedulerMutex;
+static SDL_cond* scheduleUpdated;   //WAIT (scheduler) : "I wait for the next refresh"
+                                    //SIGNAL (client) : "A refresh was added, check the due time"
+static SDL_Thread* schedulerThread;
+static int schedulerQuitFlag;
+
+
+/* the time we need to spin before a refresh */
+/* it's the time the system can oversleep */
+static uint64_t spinMargin;
+
+
+/* measure how the system oversleep */
+static void calibrateSpinMargin(void)
+{
+  int i;
+  uint64_t startTime;
+  uint64_t sleepTime;
+  uint64_t maxOversleep = 0;
+
+  for(i=0; i<WV_REFRESH_SCHEDULER_CALIBRATION_LOOPS; i++){
+    startTime = WV_getMicroTime();
+    SDL_Delay(1);
+    sleepTime = WV_getMicroTime() - startTime;
+  
+    if(sleepTime > 1000 && sleepTime - 1000 > maxOversleep)
+      maxOversleep = sleepTime - 1000;
+  }
+
+  /* clamp */
+  if(maxOversleep < WV_REFRESH_SCHEDULER_MIN_SPIN)
+    maxOversleep = WV_REFRESH_SCHEDULER_MIN_SPIN;
+  if(maxOversleep > WV_REFRESH_SCHEDULER_MAX_SPIN)
+    maxOversleep = WV_REFRESH_SCHEDULER_MAX_SPIN;
+  
+  spinMargin = maxOversleep;
+}
+
+
+static int refreshSchedulerThread(void* opaque)
+{
+  uint64_t currentTime;
+  uint64_t dueTime;
+  uint64_t remainingTime;
+  uint32_t sleepDelay;
+  
+  SDL_mutexP(schedulerMutex);
+  
+  while(!schedulerQuitFlag){
+
+    /**************************/
+    /* nothing to do, wait    */
+    /**************************/
+    if(nbRefreshEntries == 0){
+      SDL_CondWait(scheduleUpdated, schedulerMutex);
+      continue;
+    }
+
+    /**********************/
+    /* check the due time */
+    /**********************/
+    currentTime = WV_getEngineTime();
+    dueTime = refreshHeap[0].dueTime;
+    
+    /* launch the refresh */
+    //!!! done with the mutex, so a cancel can't be done during the call !!! 
+    if(currentTime >= dueTime){
+      RefreshEntry dueEntry = refreshHeap[0];
+      removeEntry(0);
+      dueEntry.refreshCall(dueEntry.param);
+      continue;
+    }
+
+    /*****************************/
+    /* the virtual time only     */
+    /* move when it's advanced   */
+    /*****************************/
+    if(WV_getTimeSource() == WV_VIRTUAL_TIME){
+      //woken by WV_wakeRefreshScheduler
+      SDL_CondWait(scheduleUpdated, schedulerMutex);
+      continue;
+    }
+    
+    /*****************************/
+    /* sleep if the due time is  */
+    /* after the spin margin     */
+    /*****************************/
+    remainingTime = dueTime - currentTime;
+    sleepDelay = 0;
+    if(remainingTime > spinMargin)
+      sleepDelay = (uint32_t)((remainingTime - spinMargin) / 1000);
+
+    if(sleepDelay > 0){
+      //wake up if a new refresh is scheduled
+      SDL_CondWaitTimeout(scheduleUpdated, schedulerMutex, sleepDelay);
+      continue;
+    }
+    
+    /**************************/
+    /* else spin without lock */
+    /**************************/
+    SDL_mutexV(schedulerMutex);
+    while(WV_getMicroTime() < dueTime);
+    SDL_mutexP(schedulerMutex);
+  }
+
+  SDL_mutexV(schedulerMutex);
+
+  return 0;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*      THE CLIENT FUNCTIONS      */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+int WV_scheduleRefresh(uint64_t dueTime, WVRefreshCall refreshCall, void* param)
+{
+  SDL_mutexP(schedulerMutex);
+
+  /* check space */
+  if(nbRefreshEntries >= WV_REFRESH_SCHEDULER_MAX_ENTRIES){
+    SDL_mutexV(schedulerMutex);
+    return -1;
+  }
+
+  /* add the entry */
+  int i = nbRefreshEntries;
+  nbRefreshEntries++;
+  
+  refreshHeap[i].dueTime = dueTime;
+  refreshHeap[i].refreshCall = refreshCall;
+  refreshHeap[i].param = param;
+  siftUp(i);
+  
+  SDL_mutexV(schedulerMutex);
+
+  /* the scheduler need to check the new due time */
+  SDL_CondSignal(scheduleUpdated);
+
+  return 0;
+}
+
+
+SDL_bool WV_cancelRefresh(void* param)
+{
+  SDL_mutexP(schedulerMutex);
+
+  /* search the entry */
+  int i = 0;
+  while(i < nbRefreshEntries && refreshHeap[i].param != param)
+    i++;
+
+  /* already launched ? */
+  if(i == nbRefreshEntries){
+    SDL_mutexV(schedulerMutex);
+    return SDL_FALSE;
+  }
+
+  /* remove */
+  removeEntry(i);
+  
+  SDL_mutexV(schedulerMutex);
+  //useless to signal, the scheduler will see that there is nothing to do
+
+  return SDL_TRUE;
+}
+
+
+void WV_wakeRefreshScheduler(void)
+{
+  if(!schedulerThread)
+    return;
+  
+  SDL_mutexP(schedulerMutex);
+  SDL_mutexV(schedulerMutex);
+  SDL_CondSignal(scheduleUpdated);
+}
+
+
+
+/************************************/
+/*||||||||||||||||||||||||||||||||||*/
+/*     the init/close functions     */
+/*||||||||||||||||||||||||||||||||||*/
+/************************************/
+
+int WV_initRefreshScheduler(void)
+{
+  /* init communication system */
+  schedulerMutex = SDL_CreateMutex();
+  scheduleUpdated = SDL_CreateCond();
+  
+  /* init state variables */
+  nbRefreshEntries = 0;
+  schedulerQuitFlag = 0;
+
+  /* measure the system sleep precision */
+  calibrateSpinMargin();
+
+  /* launch the scheduler thread */
+  #if SDL_VERSION_ATLEAST(2,0,0)
+  schedulerThread = SDL_CreateThread(refreshSchedulerThread, "refreshScheduler", NULL);
+  #else
+  schedulerThread = SDL_CreateThread(refreshSchedulerThread, NULL);
+  #endif
+
+  if(!schedulerThread)
+    return -1;
+
+  return 0;
+}
+
+
+int WV_refreshSchedulerShutdown(void)
+{
+  /* stop the thread */
+  SDL_mutexP(schedulerMutex);
+  schedulerQuitFlag = 1;
+  nbRefreshEntries = 0;
+  SDL_mutexV(schedulerMutex);
+  SDL_CondSignal(scheduleUpdated);
+
+  SDL_WaitThread(schedulerThread, NULL);
+  schedulerThread = NULL;
+
+  /* close thread communication */
+  SDL_DestroyMutex(schedulerMutex);
+  SDL_DestroyCond(scheduleUpdated);
+
+  return 0;
+}
@@ -0,0 +1,86 @@
+#ifndef REFRESH_SCHEDULER_H
+#define REFRESH_SCHEDULER_H
+
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "common.h"
+#include "config_sdl.h"
+
+#include "waave_engine_flags.h"
+
+
+/***********************************/
+/* the refresh scheduler launch    */
+/* the refreshs at the right time  */
+/* one thread for all the streams  */
+/***********************************/
+
+/* the function called when the refresh is due */
+/* !!! called by the scheduler thread, do it quickly !!! */
+typedef void (*WVRefreshCall)(void* param);
+
+
+/*****************/
+/* the time base */
+/*****************/
+
+/* monotonic clock in microseconds */
+uint64_t WV_getMicroTime(void);
+
+
+/*******************************/
+/* INIT                        */
+/* calibrate and launch thread */
+/*******************************/
+int WV_initRefreshScheduler(void);
+
+
+/*********************************************/
+/* SCHEDULE                                  */
+/* call refreshCall(param) at dueTime (us)   */
+/* the due time is given in engine time      */
+/* (see time_source.h)                       */
+/* !!! only one schedule per param !!!       */
+/*********************************************/
+int WV_scheduleRefresh(uint64_t dueTime, WVRefreshCall refreshCall, void* param);
+
+
+/* remove a schedule */
+/* return SDL_TRUE if the refresh was not already launched */
+SDL_bool WV_cancelRefresh(void* param);
+
+
+/* check the due times again */
+//used when the virtual time is advanced
+void WV_wakeRefreshScheduler(void);
+
+
+/**********/
+/* CLOSE  */
+/**********/
+int WV_refreshSchedulerShutdown(void);
+
+
+#endif
@@ -0,0 +1,650 @@
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+
+#include "slice_scaler.h"
+
+#include "common.h"
+#include "config_sdl.h"
+#include "config_ffmpeg.h"
+
+#include "waave_engine_flags.h"
+#include "task_runtime.h"
+
+
+/* the maximum number of slices */
+/* the calling thread convert the first slice */
+#define MAX_SLICES WV_SLICE_SCALER_MAX_SLICES
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*        THE SLICE LAYOUT        */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* give the plane layout of the pixel formats */
+/* that can be sliced safely */
+/* return the number of planes or -1 if unknown */
+static int getPlaneLayout(enum PixelFormat format, int* planeShift)
+{
+  planeShift[0] = planeShift[1] = planeShift[2] = planeShift[3] = 0;
+
+  switch(format){
+  
+  case PIX_FMT_YUV420P :
+  case PIX_FMT_YUVJ420P :
+    planeShift[1] = planeShift[2] = 1;
+    return 3;
+
+  case PIX_FMT_YUV422P :
+  case PIX_FMT_YUVJ422P :
+  case PIX_FMT_YUV444P :
+  case PIX_FMT_YUVJ444P :
+    return 3;
+
+  case PIX_FMT_NV12 :
+  case PIX_FMT_NV21 :
+    planeShift[1] = 1;
+    return 2;
+
+  case PIX_FMT_YUYV422 :
+  case PIX_FMT_UYVY422 :
+  case PIX_FMT_RGB24 :
+  case PIX_FMT_BGR24 :
+  case PIX_FMT_ARGB :
+  case PIX_FMT_RGBA :
+  case PIX_FMT_ABGR :
+  case PIX_FMT_BGRA :
+  case PIX_FMT_GRAY8 :
+    return 1;
+
+  default :
+    return -1;
+  }
+}
+
+
+/* the vertical chroma subsampling */
+static int getChromaShift(int nbPlanes, int* planeShift)
+{
+  int i;
+  int shift = 0;
+  
+  for(i=0; i<nbPlanes; i++){
+    if(planeShift[i] > shift)
+      shift = planeShift[i];
+  }
+
+  return shift;
+}
+
+
+static int getGcd(int a, int b)
+{
+  int r;
+
+  while(b){
+    r = a % b;
+    a = b;
+    b = r;
+  }
+
+  return a;
+}
+
+static int getLcm(int a, int b)
+{
+  return a / getGcd(a, b) * b;
+}
+
+
+/* the half width of the swscale filters */
+/* in source lines, without downscaling */
+static int getFilterRadius(int swsFlags)
+{
+  if(swsFlags & (SWS_SINC | SWS_SPLINE))
+    return 10;
+  if(swsFlags & (SWS_X | SWS_GAUSS))
+    return 4;
+  if(swsFlags & SWS_LANCZOS)
+    return 3;   //the default lanczos parameter
+  if(swsFlags & (SWS_BICUBIC | SWS_BICUBLIN))
+    return 2;
+
+  return 1;
+}
+
+
+/* how the output frame is sliced */
+typedef struct SliceLayout{
+
+  int srcRatio;       //the vertical ratio srcRatio/dstRatio, reduced
+  int dstRatio;
+  int sliceLines;     //the output lines of a slice, the last take the remaining lines
+  int margin;         //the output lines converted over the slice boundaries
+
+}SliceLayout;
+
+
+/* each slice is converted as an independent picture */
+/* containing the slice and some margin lines, with */
+/* the same vertical ratio than the entire frame. */
+/* The slice lines give the same result as the entire */
+/* frame if : */
+/* -> swscale step exactly in the source lines, for the */
+/*    luma AND the chroma (16 bits fixed point increments) */
+/* -> the pictures start on a source line, a chroma line */
+/*    and a dither pattern */
+/* -> the margins hide the filters clipped at the picture */
+/*    edges and the last lines converted in C by swscale */
+static int canSlice(int nbSlices,					\
+		    int srcWidth, int srcHeight, enum PixelFormat srcFormat, \
+		    int dstWidth, int dstHeight, enum PixelFormat dstFormat, \
+		    int swsFlags, SliceLayout* layout)
+{
+  int srcShift[4];
+  int dstShift[4];
+  int srcPlanes = getPlaneLayout(srcFormat, srcShift);
+  int dstPlanes = getPlaneLayout(dstFormat, dstShift);
+
+  if(nbSlices <= 1)
+    return 0;
+
+  /* known layout */
+  if(srcPlanes < 0 || dstPlanes < 0)
+    return 0;
+
+  /* whole chroma lines */
+  int srcChromaShift = getChromaShift(srcPlanes, srcShift);
+  int dstChromaShift = getChromaShift(dstPlanes, dstShift);
+  if((srcHeight % (1 << srcChromaShift)) != 0 || (dstHeight % (1 << dstChromaShift)) != 0)
+    return 0;
+
+  /* exact vertical increments */
+  int srcChromaHeight = srcHeight >> srcChromaShift;
+  int dstChromaHeight = dstHeight >> dstChromaShift;
+  if((((int64_t)srcHeight << 16) % dstHeight) != 0)
+    return 0;
+  if((((int64_t)srcChromaHeight << 16) % dstChromaHeight) != 0)
+    return 0;
+
+  /* the reduced ratio */
+  int ratioGcd = getGcd(srcHeight, dstHeight);
+  int srcRatio = srcHeight / ratioGcd;
+  int dstRatio = dstHeight / ratioGcd;
+
+  /* the pictures start on output lines multiple of unit */
+  //source line, source chroma line, dither pattern and output chroma line
+  int unit = (dstRatio << srcChromaShift) / getGcd(srcRatio, 1 << srcChromaShift);
+  unit = getLcm(unit, WV_SLICE_SCALER_ALIGN);
+  unit = getLcm(unit, 1 << dstChromaShift);
+
+  /* the source lines reached by the filters */
+  //in luma lines, the chroma filters are wider when the chroma is subsampled
+  int radius = getFilterRadius(swsFlags);
+  int chromaSrcRatio = srcRatio << dstChromaShift;
+  int chromaDstRatio = dstRatio << srcChromaShift;
+  int lumaReach = radius * ((srcRatio + dstRatio - 1) / dstRatio) + 2;
+  int chromaReach = (radius * ((chromaSrcRatio + chromaDstRatio - 1) / chromaDstRatio) + 2) << srcChromaShift;
+  int srcReach = lumaReach > chromaReach ? lumaReach : chromaReach;
+
+  /* the margins in output lines */
+  int margin = (srcReach * dstRatio + srcRatio - 1) / srcRatio;
+  margin = (margin + unit - 1) / unit * unit;
+
+  /* the slices are not too small */
+  int sliceLines = (dstHeight / nbSlices) / unit * unit;
+  if(sliceLines < WV_SLICE_SCALER_MIN_HEIGHT || sliceLines < margin)
+    return 0;
+
+  layout->srcRatio = srcRatio;
+  layout->dstRatio = dstRatio;
+  layout->sliceLines = sliceLines;
+  layout->margin = margin;
+
+  return 1;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*        THE SLICE TASKS         */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* a slice to convert */
+//the slices are converted by the task runtime workers
+typedef struct SliceJob{
+
+  struct SwsContext* swsCtx;   //the context of the slice
+  const uint8_t* srcData[4];   //the slice and its margins in the source picture
+  int srcLinesize[4];
+  int srcLines;
+  uint8_t* dstData[4];         //the slice in the output picture or the scratch picture
+  int dstLinesize[4];
+
+  /* the slice lines are copied from */
+  /* the scratch picture when there are margins */
+  int marginFlag;
+  AVPicture sliceSrc;
+  AVPicture sliceDst;
+  int sliceWidth;
+  int sliceLines;
+  enum PixelFormat sliceFormat;
+
+  /* the scratch picture */
+  int scratchFlag;
+  AVPicture scratch;
+  int scratchWidth;
+  int scratchHeight;
+  enum PixelFormat scratchFormat;
+  
+}SliceJob;
+
+
+static void convertSlice(void* param)
+{
+  SliceJob* job = (SliceJob*)param;
+
+  sws_scale(job->swsCtx,						\
+	    (const uint8_t* const*)job->srcData, job->srcLinesize,	\
+	    0, job->srcLines,						\
+	    job->dstData, job->dstLinesize);
+
+  /* drop the margins */
+  if(job->marginFlag)
+    av_picture_copy(&job->sliceDst, (const AVPicture*)&job->sliceSrc, \
+		    job->sliceFormat, job->sliceWidth, job->sliceLines);
+}
+
+
+/* the picture where the slice and its margins are converted */
+static int getSliceScratch(SliceJob* job, int width, int height, enum PixelFormat format)
+{
+  if(job->scratchFlag){
+    if(job->scratchWidth == width && job->scratchHeight == height && job->scratchFormat == format)
+      return 0;
+
+    avpicture_free(&job->scratch);
+    job->scratchFlag = 0;
+  }
+
+  if(avpicture_alloc(&job->scratch, format, width, height) < 0)
+    return -1;
+
+  job->scratchFlag = 1;
+  job->scratchWidth = width;
+  job->scratchHeight = height;
+  job->scratchFormat = format;
+
+  return 0;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*         THE SCALERS            */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+typedef struct SliceScaler{
+
+  int nbSlices;                  //the wanted number of slices
+  
+  /* one context per slice */
+  /* the first is used to convert the entire frame */
+  struct SwsContext* swsCtx[MAX_SLICES];
+  SliceJob jobs[MAX_SLICES];
+
+  /* wait the slices of the frame */
+  WVTaskGroupHandle sliceGroup;
+
+}SliceScaler;
+
+
+WVSliceScalerHandle WV_getSliceScaler(void)
+{
+  int i;
+  
+  SliceScaler* newScaler = (SliceScaler*)malloc(sizeof(SliceScaler));
+  if(!newScaler)
+    return NULL;
+
+  newScaler->sliceGroup = WV_getTaskGroup();
+  if(!newScaler->sliceGroup){
+    free(newScaler);
+    return NULL;
+  }
+
+  newScaler->nbSlices = 1;
+  for(i=0; i<MAX_SLICES; i++){
+    newScaler->swsCtx[i] = NULL;  //use getCachedContext
+    newScaler->jobs[i].scratchFlag = 0;
+  }
+
+  return (WVSliceScalerHandle)newScaler;
+}
+
+
+void WV_freeSliceScaler(WVSliceScalerHandle scalerHdl)
+{
+  int i;
+  SliceScaler* scaler = (SliceScaler*)scalerHdl;
+
+  for(i=0; i<MAX_SLICES; i++){
+    if(scaler->swsCtx[i])
+      sws_freeContext(scaler->swsCtx[i]);
+    if(scaler->jobs[i].scratchFlag)
+      avpicture_free(&scaler->jobs[i].scratch);
+  }
+
+  WV_freeTaskGroup(scaler->sliceGroup);
+  free(scaler);
+}
+
+
+void WV_setSliceScalerSlices(WVSliceScalerHandle scalerHdl, int nbSlices)
+{
+  SliceScaler* scaler = (SliceScaler*)scalerHdl;
+
+  if(nbSlices < 1)
+    nbSlices = 1;
+  if(nbSlices > MAX_SLICES)
+    nbSlices = MAX_SLICES;
+
+  scaler->nbSlices = nbSlices;
+}
+
+
+/* convert the entire frame with the first context */
+static int scaleFrame(SliceScaler* scaler,				\
+		      uint8_t** srcData, int* srcLinesize,		\
+		      int srcWidth, int srcHeight, enum PixelFormat srcFormat, \
+		      uint8_t** dstData, int* dstLinesize,		\
+		      int dstWidth, int dstHeight, enum PixelFormat dstFormat, \
+		      int swsFlags)
+{
+  /* check if we can use the context */
+  /* we see that we can change buffer size and format */
+  scaler->swsCtx[0] = sws_getCachedContext(scaler->swsCtx[0],		\
+					   srcWidth, srcHeight, srcFormat, \
+					   dstWidth, dstHeight, dstFormat, \
+					   swsFlags, NULL, NULL, NULL);
+  if(!scaler->swsCtx[0])
+    return -1;
+
+  /* scale */
+  sws_scale(scaler->swsCtx[0],						\
+	    (const uint8_t* const*)srcData, srcLinesize,		\
+	    0, srcHeight,						\
+	    dstData, dstLinesize);
+
+  return 0;
+}
+
+
+int WV_sliceScale(WVSliceScalerHandle scalerHdl,				\
+		  uint8_t** srcData, int* srcLinesize,			\
+		  int srcWidth, int srcHeight, enum PixelFormat srcFormat,	\
+		  uint8_t** dstData, int* dstLinesize,			\
+		  int dstWidth, int dstHeight, enum PixelFormat dstFormat,	\
+		  int swsFlags)
+{
+  int i, p;
+  SliceScaler* scaler = (SliceScaler*)scalerHdl;
+  int nbSlices = scaler->nbSlices;
+  
+  /*******************************/
+  /* check if we can slice       */
+  /*******************************/
+  SliceLayout layout;
+  if(!canSlice(nbSlices,						\
+	       srcWidth, srcHeight, srcFormat,				\
+	       dstWidth, dstHeight, dstFormat,				\
+	       swsFlags, &layout))
+    return scaleFrame(scaler,						\
+		      srcData, srcLinesize, srcWidth, srcHeight, srcFormat, \
+		      dstData, dstLinesize, dstWidth, dstHeight, dstFormat, \
+		      swsFlags);
+
+  /***********************/
+  /* prepare the slices  */
+  /***********************/
+  int srcShift[4];
+  int dstShift[4];
+  int srcPlanes = getPlaneLayout(srcFormat, srcShift);
+  int dstPlanes = getPlaneLayout(dstFormat, dstShift);
+  
+  int sliceStart, sliceEnd;
+  int topMargin, bottomMargin;
+  int pictureStart, pictureLines;
+  int srcStart;
+    
+  for(i=0; i<nbSlices; i++){
+    SliceJob* job = &scaler->jobs[i];
+
+    /* the slice output lines */
+    //the last slice take the remaining lines
+    sliceStart = i * layout.sliceLines;
+    sliceEnd = sliceStart + layout.sliceLines;
+    if(i == nbSlices - 1)
+      sliceEnd = dstHeight;
+
+    /* the margins stop at the frame edges */
+    topMargin = layout.margin;
+    if(topMargin > sliceStart)
+      topMargin = sliceStart;
+    bottomMargin = layout.margin;
+    if(bottomMargin > dstHeight - sliceEnd)
+      bottomMargin = dstHeight - sliceEnd;
+
+    /* the converted picture and its source lines */
+    //exact as the picture edges are multiples of the reduced ratio
+    pictureStart = sliceStart - topMargin;
+    pictureLines = sliceEnd + bottomMargin - pictureStart;
+    srcStart = pictureStart / layout.dstRatio * layout.srcRatio;
+    job->srcLines = pictureLines / layout.dstRatio * layout.srcRatio;
+
+    /* each slice is converted as an independent picture */
+    scaler->swsCtx[i] = sws_getCachedContext(scaler->swsCtx[i],	\
+					     srcWidth, job->srcLines, srcFormat, \
+					     dstWidth, pictureLines, dstFormat, \
+					     swsFlags, NULL, NULL, NULL);
+    if(!scaler->swsCtx[i])
+      return -1;
+    job->swsCtx = scaler->swsCtx[i];
+
+    /* the picture position in the source planes */
+    for(p=0; p<4; p++){
+      job->srcData[p] = NULL;
+      job->srcLinesize[p] = 0;
+      job->dstData[p] = NULL;
+      job->dstLinesize[p] = 0;
+    }
+    for(p=0; p<srcPlanes; p++){
+      job->srcData[p] = srcData[p] + (srcStart >> srcShift[p]) * srcLinesize[p];
+      job->srcLinesize[p] = srcLinesize[p];
+    }
+
+    /* without margins, convert directly in the output */
+    job->marginFlag = (topMargin || bottomMargin);
+    if(!job->marginFlag){
+      for(p=0; p<dstPlanes; p++){
+	job->dstData[p] = dstData[p] + (sliceStart >> dstShift[p]) * dstLinesize[p];
+	job->dstLinesize[p] = dstLinesize[p];
+      }
+      continue;
+    }
+
+    /* else convert in the scratch picture */
+    //and copy the slice lines
+    if(getSliceScratch(job, dstWidth, pictureLines, dstFormat) < 0)
+      return -1;
+
+    for(p=0; p<4; p++){
+      job->sliceSrc.data[p] = NULL;
+      job->sliceSrc.linesize[p] = 0;
+      job->sliceDst.data[p] = NULL;
+      job->sliceDst.linesize[p] = 0;
+    }
+    for(p=0; p<dstPlanes; p++){
+      job->dstData[p] = job->scratch.data[p];
+      job->dstLinesize[p] = job->scratch.linesize[p];
+      job->sliceSrc.data[p] = job->scratch.data[p] + (topMargin >> dstShift[p]) * job->scratch.linesize[p];
+      job->sliceSrc.linesize[p] = job->scratch.linesize[p];
+      job->sliceDst.data[p] = dstData[p] + (sliceStart >> dstShift[p]) * dstLinesize[p];
+      job->sliceDst.linesize[p] = dstLinesize[p];
+    }
+    job->sliceWidth = dstWidth;
+    job->sliceLines = sliceEnd - sliceStart;
+    job->sliceFormat = dstFormat;
+  }
+
+  /**************************/
+  /* give the slices to the */
+  /* task runtime           */
+  /**************************/
+  for(i=1; i<nbSlices; i++)
+    WV_submitTask(scaler->sliceGroup, WV_TASK_PRIORITY_VIDEO, convertSlice, &scaler->jobs[i]);
+
+  /* convert the first slice ourself */
+  convertSlice(&scaler->jobs[0]);
+
+  /* wait the workers */
+  WV_waitTaskGroup(scaler->sliceGroup);
+
+  return 0;
+}
+
+
+
+/* the output picture in a contiguous buffer */
+static uint8_t* getPictureBytes(AVPicture* picture, int width, int height, enum PixelFormat format, int* size)
+{
+  *size = avpicture_get_size(format, width, height);
+  if(*size < 0)
+    return NULL;
+  
+  uint8_t* bytes = (uint8_t*)malloc(*size);
+  if(!bytes)
+    return NULL;
+
+  if(avpicture_layout(picture, format, width, height, bytes, *size) < 0){
+    free(bytes);
+    return NULL;
+  }
+
+  return bytes;
+}
+
+
+int WV_checkSliceScaler(int nbSlices,					\
+			uint8_t** srcData, int* srcLinesize,		\
+			int srcWidth, int srcHeight, enum PixelFormat srcFormat, \
+			int dstWidth, int dstHeight, enum PixelFormat dstFormat, \
+			int swsFlags)
+{
+  int i;
+  int result = -1;
+  
+  /* check that the frame is really sliced */
+  SliceLayout layout;
+  if(!canSlice(nbSlices,						\
+	       srcWidth, srcHeight, srcFormat,				\
+	       dstWidth, dstHeight, dstFormat,				\
+	       swsFlags, &layout))
+    return -1;
+
+  /**************************************/
+  /* convert in one time and in slices  */
+  /**************************************/
+  WVSliceScalerHandle scalers[2];
+  AVPicture pictures[2];
+  uint8_t* bytes[2] = {NULL, NULL};
+  int size[2];
+  int nbPictures = 0;
+  
+  for(i=0; i<2; i++){
+    scalers[i] = WV_getSliceScaler();
+    if(!scalers[i])
+      break;
+
+    if(avpicture_alloc(&pictures[i], dstFormat, dstWidth, dstHeight) < 0){
+      WV_freeSliceScaler(scalers[i]);
+      break;
+    }
+    nbPictures++;
+
+    WV_setSliceScalerSlices(scalers[i], i ? nbSlices : 1);
+    if(WV_sliceScale(scalers[i],					\
+		     srcData, srcLinesize, srcWidth, srcHeight, srcFormat, \
+		     pictures[i].data, pictures[i].linesize, dstWidth, dstHeight, dstFormat, \
+		     swsFlags) < 0)
+      break;
+
+    bytes[i] = getPictureBytes(&pictures[i], dstWidth, dstHeight, dstFormat, &size[i]);
+    if(!bytes[i])
+      break;
+  }
+
+  /*****************/
+  /* compare       */
+  /*****************/
+  if(bytes[0] && bytes[1])
+    result = (size[0] == size[1] && !memcmp(bytes[0], bytes[1], size[0]));
+
+  for(i=0; i<nbPictures; i++){
+    avpicture_free(&pictures[i]);
+    WV_freeSliceScaler(scalers[i]);
+    if(bytes[i])
+      free(bytes[i]);
+  }
+
+  return result;
+}
+
+
+
+/************************************/
+/*||||||||||||||||||||||||||||||||||*/
+/*     the init/close functions     */
+/*||||||||||||||||||||||||||||||||||*/
+/************************************/
+
+int WV_initSliceScaler(void)
+{
+  /* the slices are converted by */
+  /* the task runtime workers    */
+  return WV_initTaskRuntime();
+}
+
+
+int WV_sliceScalerShutdown(void)
+{
+  return WV_taskRuntimeShutdown();
+}
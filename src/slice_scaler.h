@@ -0,0 +1,103 @@
+#ifndef SLICE_SCALER_H
+#define SLICE_SCALER_H
+
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "common.h"
+#include "config_sdl.h"
+#include "config_ffmpeg.h"
+
+#include "waave_engine_flags.h"
+
+
+/*****************************************/
+/* the slice scaler convert the frames   */
+/* in horizontal slices, in parallel     */
+/* with the task runtime workers         */
+/*****************************************/
+
+/* abstract pointer for the user */
+typedef void* WVSliceScalerHandle;
+
+
+/*******************************/
+/* INIT                        */
+/* start the task runtime      */
+/*******************************/
+int WV_initSliceScaler(void);
+
+
+/************************************/
+/* GET / FREE                       */
+/* one scaler per converted stream  */
+/************************************/
+WVSliceScalerHandle WV_getSliceScaler(void);
+
+void WV_freeSliceScaler(WVSliceScalerHandle scalerHdl);
+
+
+/* set the wanted number of slices */
+/* 1 to convert in one time */
+void WV_setSliceScalerSlices(WVSliceScalerHandle scalerHdl, int nbSlices);
+
+
+/**************************************************/
+/* SCALE                                          */
+/* like sws_scale for the entire frame            */
+/* each slice is converted with some margin lines */
+/* !!! the frame is sliced only when the output   */
+/* is identical to the entire frame conversion,   */
+/* so when the vertical increments are exact,     */
+/* else the frame is converted in one time !!!    */
+/**************************************************/
+int WV_sliceScale(WVSliceScalerHandle scalerHdl,				\
+		  uint8_t** srcData, int* srcLinesize,			\
+		  int srcWidth, int srcHeight, enum PixelFormat srcFormat,	\
+		  uint8_t** dstData, int* dstLinesize,			\
+		  int dstWidth, int dstHeight, enum PixelFormat dstFormat,	\
+		  int swsFlags);
+
+
+/**************************************************/
+/* CHECK                                          */
+/* convert the frame in one time and in slices    */
+/* return 1 if the outputs are identical, 0 if    */
+/* they differ, -1 if the frame can't be sliced   */
+/* or on error                                    */
+/**************************************************/
+int WV_checkSliceScaler(int nbSlices,					\
+			uint8_t** srcData, int* srcLinesize,		\
+			int srcWidth, int srcHeight, enum PixelFormat srcFormat, \
+			int dstWidth, int dstHeight, enum PixelFormat dstFormat, \
+			int swsFlags);
+
+
+/**********/
+/* CLOSE  */
+/**********/
+int WV_sliceScalerShutdown(void);
+
+
+#endif
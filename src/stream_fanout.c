@@ -0,0 +1,538 @@
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "stream_fanout.h"
+
+#include "common.h"
+#include "config_ffmpeg.h"
+
+#include "streaming_object.h"
+#include "waave_engine_flags.h"
+#include "slice_scaler.h"
+#include "video_decoder.h"
+
+
+/* the scale filter of the output conversions */
+static int swsFlags = WV_VIDEO_DECODER_SCALE_FILTER;
+
+
+/* an object fed by the fan-out */
+typedef struct FanoutOutput{
+  WVStreamingObject* streamObj;
+  
+  /* the output slots */
+  //the fan-out slot i is written in the output slot i % nbSlots
+  int refreshPos;                //the last written slot, -1 if none
+  WVStreamingBuffer* slotBuffer; //the buffers of the output
+  int* getFlag;                  //for static get, say the slot buffer is got
+
+  /* the output conversion */
+  WVSliceScalerHandle scaler;
+  WVStreamingBuffer* convertedBuffer;  //the buffer converted for the current frame
+  int decodeFeedFlag;                  //converted by the decoder thread, else at refresh
+  
+}FanoutOutput;
+
+
+typedef struct StreamFanoutPrivate{
+  /* the outputs */
+  int nbOutputs;
+  FanoutOutput outputs[WV_STREAM_FANOUT_MAX_OUTPUTS];
+
+  /* the fan-out slots */
+  /* when the decoder can't upload the native frames */
+  /* it write the frames here in the src format */
+  AVPicture* slotPicture;
+  WVStreamingBuffer* slotFrame;
+  int* slotNewFlag;             //the slot have a frame not yet given to the outputs
+
+}StreamFanoutPrivate;
+
+
+/* used to recognize the fan-out objects */
+static int refreshFrame_streamFanout(WVStreamingObject* streamObj, int slotIdx);
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*     FEED THE OUTPUTS           */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* the frame is already converted by a previous output ? */
+//share the conversion when the buffers have the same format
+//!!! only with the outputs fed by the same thread !!!
+static WVStreamingBuffer* findConvertedBuffer(StreamFanoutPrivate* objPrivate, int outputIdx, WVStreamingBuffer* buffer)
+{
+  int feedFlag = objPrivate->outputs[outputIdx].decodeFeedFlag;
+  int i;
+  WVStreamingBuffer* converted;
+  
+  for(i=0; i<outputIdx; i++){
+    if(objPrivate->outputs[i].decodeFeedFlag != feedFlag)
+      continue;
+    
+    converted = objPrivate->outputs[i].convertedBuffer;
+    if(converted &&					\
+       converted->width == buffer->width &&		\
+       converted->height == buffer->height &&		\
+       converted->format == buffer->format)
+      return converted;
+  }
+
+  return NULL;
+}
+
+
+/* copy a converted buffer */
+static void copyBuffer(WVStreamingBuffer* dstBuffer, WVStreamingBuffer* srcBuffer)
+{
+  AVPicture dstPicture;
+  AVPicture srcPicture;
+  int i;
+
+  for(i=0; i<4; i++){
+    dstPicture.data[i] = dstBuffer->data[i];
+    dstPicture.linesize[i] = dstBuffer->linesize[i];
+    srcPicture.data[i] = srcBuffer->data[i];
+    srcPicture.linesize[i] = srcBuffer->linesize[i];
+  }
+
+  av_picture_copy(&dstPicture, (const AVPicture*)&srcPicture,	\
+		  srcBuffer->format, srcBuffer->width, srcBuffer->height);
+}
+
+
+/* the source can change during the stream */
+//renegotiate like the decoder do
+static void renegotiateOutput(FanoutOutput* output, WVStreamingBuffer* frame)
+{
+  WVStreamingObject* outputObj = output->streamObj;
+  int i;
+
+  if(outputObj->srcWidth == frame->width &&		\
+     outputObj->srcHeight == frame->height &&		\
+     outputObj->srcFormat == frame->format)
+    return;
+
+  outputObj->srcWidth = frame->width;
+  outputObj->srcHeight = frame->height;
+  outputObj->srcFormat = frame->format;
+  WV_negotiateStreamingFormat(outputObj);
+
+  /* the static buffers may change with the format */
+  for(i=0; i<outputObj->nbSlots; i++)
+    output->getFlag[i] = 0;
+}
+
+
+/* get/lock/convert/release a frame in one output slot */
+static void convertOutput(StreamFanoutPrivate* objPrivate, int outputIdx, int slotPos, WVStreamingBuffer* frame)
+{
+  FanoutOutput* output = &objPrivate->outputs[outputIdx];
+  WVStreamingObject* outputObj = output->streamObj;
+  
+  if(outputObj->getBufferMethod == WV_DYNAMIC_GET || !output->getFlag[slotPos]){
+    output->slotBuffer[slotPos] = outputObj->getBuffer(outputObj, slotPos);
+    output->getFlag[slotPos] = 1;
+  }
+    
+  if(outputObj->lockBuffer)
+    outputObj->lockBuffer(outputObj, slotPos);
+
+  WVStreamingBuffer* outputBuffer = &output->slotBuffer[slotPos];
+  WVStreamingBuffer* converted = findConvertedBuffer(objPrivate, outputIdx, outputBuffer);
+    
+  if(converted){
+    copyBuffer(outputBuffer, converted);
+  }
+  else{
+    WV_sliceScale(output->scaler,					\
+		  frame->data, frame->linesize,				\
+		  frame->width, frame->height, frame->format,		\
+		  outputBuffer->data, outputBuffer->linesize,		\
+		  outputBuffer->width, outputBuffer->height, outputBuffer->format, \
+		  swsFlags);
+  }
+
+  /* the filtered buffer can't be shared */
+  if(outputObj->filterBuffer)
+    outputObj->filterBuffer(outputObj, slotPos, outputBuffer);
+  else
+    output->convertedBuffer = outputBuffer;
+
+  if(outputObj->releaseBuffer)
+    outputObj->releaseBuffer(outputObj, slotPos);
+}
+
+
+/* !!! called by the refresh !!! */
+/* give a fan-out slot frame to one output */
+static void feedOutput(StreamFanoutPrivate* objPrivate, int outputIdx, int slotIdx, WVStreamingBuffer* frame)
+{
+  FanoutOutput* output = &objPrivate->outputs[outputIdx];
+  WVStreamingObject* outputObj = output->streamObj;
+  int slotPos = slotIdx % outputObj->nbSlots;
+  
+  output->convertedBuffer = NULL;   //NULL if uploaded
+  renegotiateOutput(output, frame);
+
+  /* native upload */
+  //if the object refuse the frame, convert it
+  if(outputObj->uploadFrame && outputObj->uploadFrame(outputObj, slotPos, frame) >= 0){
+    output->refreshPos = slotPos;
+    return;
+  }
+
+  /* get/lock/convert/release */
+  if(!outputObj->getBuffer)
+    return;
+
+  convertOutput(objPrivate, outputIdx, slotPos, frame);
+  output->refreshPos = slotPos;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*     THE STREAMING OBJECT       */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* close the nbOutputs first outputs */
+static void closeOutputs(StreamFanoutPrivate* objPrivate, int nbOutputs)
+{
+  int i;
+  
+  for(i=0; i<nbOutputs; i++){
+    FanoutOutput* output = &objPrivate->outputs[i];
+    
+    if(output->streamObj->close)
+      output->streamObj->close(output->streamObj);
+
+    if(output->scaler){
+      WV_freeSliceScaler(output->scaler);
+      output->scaler = NULL;
+    }
+    free(output->slotBuffer);  //allocated with the get flags
+    output->slotBuffer = NULL;
+  }
+}
+
+
+static int init_streamFanout(WVStreamingObject* streamObj)
+{
+  StreamFanoutPrivate* objPrivate = (StreamFanoutPrivate*)streamObj->objPrivate;
+  int nbSlots = streamObj->nbSlots;
+  int i;
+
+  /* alloc the fan-out slots */
+  /* in one time */
+  int picturesSize = nbSlots * sizeof(AVPicture);
+  int framesSize = nbSlots * sizeof(WVStreamingBuffer);
+  int flagsSize = nbSlots * sizeof(int);
+
+  void* structP = malloc(picturesSize + framesSize + flagsSize);
+  if(!structP)
+    return -1;
+  
+  objPrivate->slotPicture = (AVPicture*)structP;
+  structP += picturesSize;
+  objPrivate->slotFrame = (WVStreamingBuffer*)structP;
+  structP += framesSize;
+  objPrivate->slotNewFlag = (int*)structP;
+
+  for(i=0; i<nbSlots; i++){
+    objPrivate->slotFrame[i].width = 0;   //not allocated
+    objPrivate->slotFrame[i].height = 0;
+    objPrivate->slotFrame[i].format = PIX_FMT_NONE;
+    objPrivate->slotNewFlag[i] = 0;
+  }
+
+  /* init the outputs */
+  /* with the same src */
+  for(i=0; i<objPrivate->nbOutputs; i++){
+    FanoutOutput* output = &objPrivate->outputs[i];
+    WVStreamingObject* outputObj = output->streamObj;
+
+    outputObj->srcWidth = streamObj->srcWidth;
+    outputObj->srcHeight = streamObj->srcHeight;
+    outputObj->srcFormat = streamObj->srcFormat;
+    WV_negotiateStreamingFormat(outputObj);
+
+    //the fan-out can't feed an output that failed
+    if(outputObj->init && outputObj->init(outputObj) < 0){
+      closeOutputs(objPrivate, i);
+      free(objPrivate->slotPicture);   //nothing allocated in the slots yet
+      objPrivate->slotPicture = NULL;
+      return -1;
+    }
+
+    /* the output slots */
+    int bufferSize = outputObj->nbSlots * sizeof(WVStreamingBuffer);
+    int getFlagSize = outputObj->nbSlots * sizeof(int);
+
+    output->slotBuffer = (WVStreamingBuffer*)malloc(bufferSize + getFlagSize);
+    output->scaler = WV_getSliceScaler();
+    if(!output->slotBuffer || !output->scaler){
+      closeOutputs(objPrivate, i+1);   //this output is initialized
+      free(objPrivate->slotPicture);
+      objPrivate->slotPicture = NULL;
+      return -1;
+    }
+    
+    output->getFlag = (int*)((void*)output->slotBuffer + bufferSize);
+
+    int j;
+    for(j=0; j<outputObj->nbSlots; j++)
+      output->getFlag[j] = 0;
+
+    output->refreshPos = -1;
+    output->convertedBuffer = NULL;
+
+    /* convert in the decoder thread when the object allow it */
+    //the written output slot need to be free until the refresh
+    output->decodeFeedFlag = (!outputObj->uploadFrame &&		\
+			      outputObj->getBuffer &&			\
+			      outputObj->getThreadSafety == WV_THREAD_SAFE && \
+			      (!(outputObj->lockBuffer || outputObj->releaseBuffer) || \
+			       outputObj->LRThreadSafety == WV_THREAD_SAFE) && \
+			      outputObj->nbSlots >= nbSlots);
+  }
+    
+  return 0;
+}
+
+
+/* the decoder write the frame in the src format */
+static WVStreamingBuffer getBuffer_streamFanout(WVStreamingObject* streamObj, int slotIdx)
+{
+  StreamFanoutPrivate* objPrivate = (StreamFanoutPrivate*)streamObj->objPrivate;
+  WVStreamingBuffer* slotFrame = &objPrivate->slotFrame[slotIdx];
+  AVPicture* slotPicture = &objPrivate->slotPicture[slotIdx];
+  int i;
+
+  /* realloc the slot if the src change */
+  //the slot is not refreshed while the decoder write it
+  if(slotFrame->width != streamObj->srcWidth ||		\
+     slotFrame->height != streamObj->srcHeight ||		\
+     slotFrame->format != streamObj->srcFormat){
+
+    if(slotFrame->format != PIX_FMT_NONE)
+      avpicture_free(slotPicture);
+    
+    slotFrame->width = streamObj->srcWidth;
+    slotFrame->height = streamObj->srcHeight;
+    slotFrame->format = streamObj->srcFormat;
+    
+    if(avpicture_alloc(slotPicture, slotFrame->format, slotFrame->width, slotFrame->height) < 0)
+      slotFrame->format = PIX_FMT_NONE;
+    
+    for(i=0; i<4; i++){
+      slotFrame->data[i] = slotPicture->data[i];
+      slotFrame->linesize[i] = slotPicture->linesize[i];
+    }
+  }
+
+  return *slotFrame;
+}
+
+
+/* !!! called by the decoder thread !!! */
+/* the frame is written, convert it for the outputs that allow it */
+//the decoder call it without its object lock, the outputs fed
+//here are thread safe and don't block the other streams
+static int releaseBuffer_streamFanout(WVStreamingObject* streamObj, int slotIdx)
+{
+  StreamFanoutPrivate* objPrivate = (StreamFanoutPrivate*)streamObj->objPrivate;
+  WVStreamingBuffer* slotFrame = &objPrivate->slotFrame[slotIdx];
+  int i;
+
+  if(slotFrame->format == PIX_FMT_NONE)
+    return 0;
+
+  for(i=0; i<objPrivate->nbOutputs; i++){
+    FanoutOutput* output = &objPrivate->outputs[i];
+    if(output->decodeFeedFlag){
+      output->convertedBuffer = NULL;
+      renegotiateOutput(output, slotFrame);
+      convertOutput(objPrivate, i, slotIdx % output->streamObj->nbSlots, slotFrame);
+    }
+  }
+
+  /* the other outputs will be fed at refresh */
+  objPrivate->slotNewFlag[slotIdx] = 1;
+
+  return 0;
+}
+
+
+/* all the outputs are refreshed together */
+/* so they share the stream sync clock */
+static int refreshFrame_streamFanout(WVStreamingObject* streamObj, int slotIdx)
+{
+  StreamFanoutPrivate* objPrivate = (StreamFanoutPrivate*)streamObj->objPrivate;
+  int i;
+
+  /* a new frame in the slot */
+  //upload or convert it for the outputs not fed by the decoder
+  if(objPrivate->slotNewFlag[slotIdx]){
+    objPrivate->slotNewFlag[slotIdx] = 0;
+
+    for(i=0; i<objPrivate->nbOutputs; i++){
+      FanoutOutput* output = &objPrivate->outputs[i];
+      
+      if(output->decodeFeedFlag)
+	output->refreshPos = slotIdx % output->streamObj->nbSlots;
+      else
+	feedOutput(objPrivate, i, slotIdx, &objPrivate->slotFrame[slotIdx]);
+    }
+  }
+
+  /* refresh the outputs */
+  for(i=0; i<objPrivate->nbOutputs; i++){
+    FanoutOutput* output = &objPrivate->outputs[i];
+    if(output->refreshPos >= 0)
+      output->streamObj->refreshFrame(output->streamObj, output->refreshPos);
+  }
+
+  return 0;
+}
+
+
+static int close_streamFanout(WVStreamingObject* streamObj)
+{
+  StreamFanoutPrivate* objPrivate = (StreamFanoutPrivate*)streamObj->objPrivate;
+  int i;
+
+  /* close the outputs */
+  closeOutputs(objPrivate, objPrivate->nbOutputs);
+
+  /* free the fan-out slots */
+  if(!objPrivate->slotPicture)
+    return 0;
+  
+  for(i=0; i<streamObj->nbSlots; i++){
+    if(objPrivate->slotFrame[i].format != PIX_FMT_NONE)
+      avpicture_free(&objPrivate->slotPicture[i]);
+  }
+
+  //allocated in one time
+  free(objPrivate->slotPicture);
+  objPrivate->slotPicture = NULL;
+
+  return 0;
+}
+
+
+WVStreamingObject* WV_getStreamFanoutObj(void)
+{
+  /* alloc the struct */
+  WVStreamingObject* streamObj;
+  streamObj = (WVStreamingObject*)malloc(sizeof(WVStreamingObject) + sizeof(StreamFanoutPrivate));
+  if(!streamObj)
+    return NULL;
+  
+  void* structP = (void*)streamObj;
+  structP += sizeof(WVStreamingObject);
+  streamObj->objPrivate = structP;
+
+  StreamFanoutPrivate* objPrivate = (StreamFanoutPrivate*)streamObj->objPrivate;
+  objPrivate->nbOutputs = 0;
+  objPrivate->slotPicture = NULL;  //allocated by init
+  
+  /**********************/
+  /* fill object params */
+  /**********************/
+  
+  /* we use 3 slots */
+  //the outputs use their own slots
+  streamObj->nbSlots = 3;
+  
+  /* methods params */
+  streamObj->getBufferMethod = WV_DYNAMIC_GET;    //the src may change
+  streamObj->GLRMethod = WV_ASYNC_GLR;            //async
+  streamObj->getThreadSafety = WV_THREAD_SAFE;    //only touch the got slot
+  streamObj->LRThreadSafety = WV_THREAD_SAFE;
+
+  /* no negotiation */
+  //the slots are in the src format
+  streamObj->nbFormats = 0;
+  streamObj->formatIdx = -1;
+  
+  /* methods */
+  streamObj->init = &init_streamFanout;
+  streamObj->getBuffer = &getBuffer_streamFanout;
+  streamObj->lockBuffer = NULL;
+  streamObj->filterBuffer = NULL;                 //done by the outputs
+  streamObj->releaseBuffer = &releaseBuffer_streamFanout;  //feed the outputs in the decoder thread
+  streamObj->uploadFrame = NULL;                  //the outputs upload at refresh
+  streamObj->refreshFrame = &refreshFrame_streamFanout;
+  streamObj->close = &close_streamFanout;
+
+
+  /*********************/
+  /* return the object */
+  /*********************/
+  return streamObj;
+}
+
+
+void WV_freeStreamFanoutObj(WVStreamingObject* streamObj)
+{
+  free(streamObj);
+}
+
+
+int WV_addStreamFanoutOutput(WVStreamingObject* fanoutObj, WVStreamingObject* outputObj)
+{
+  /* check objects */
+  if(!WV_isStreamFanoutObj(fanoutObj) || !outputObj || outputObj == fanoutObj)
+    return -1;
+
+  if(!outputObj->refreshFrame || (!outputObj->getBuffer && !outputObj->uploadFrame))
+    return -1;
+
+  StreamFanoutPrivate* objPrivate = (StreamFanoutPrivate*)fanoutObj->objPrivate;
+
+  if(objPrivate->nbOutputs >= WV_STREAM_FANOUT_MAX_OUTPUTS)
+    return -1;
+
+  /* add the output */
+  FanoutOutput* output = &objPrivate->outputs[objPrivate->nbOutputs];
+  output->streamObj = outputObj;
+  output->slotBuffer = NULL;
+  output->scaler = NULL;
+  objPrivate->nbOutputs++;
+
+  return 0;
+}
+
+
+int WV_isStreamFanoutObj(WVStreamingObject* streamObj)
+{
+  return (streamObj && streamObj->refreshFrame == &refreshFrame_streamFanout);
+}
@@ -0,0 +1,59 @@
+#ifndef STREAM_FANOUT_H
+#define STREAM_FANOUT_H
+
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "common.h"
+#include "config_ffmpeg.h"
+
+#include "streaming_object.h"
+#include "waave_engine_flags.h"
+
+
+/*****************************************/
+/* the fan-out object feed several       */
+/* streaming objects with one decoder    */
+/* each frame is decoded one time and    */
+/* converted for each output by the      */
+/* decoder thread, the outputs that      */
+/* upload or are not thread safe are fed */
+/* at refresh                            */
+/*****************************************/
+ 
+/* the maximum number of outputs, as in WAAVE.h */
+#define WV_STREAM_FANOUT_MAX_OUTPUTS 8
+
+WVStreamingObject* WV_getStreamFanoutObj(void);
+void WV_freeStreamFanoutObj(WVStreamingObject* streamObj);
+
+/* add an output, before loading the stream */
+//return -1 if the object is full
+int WV_addStreamFanoutOutput(WVStreamingObject* fanoutObj, WVStreamingObject* outputObj);
+
+/* check if a streaming object is a fan-out object */
+int WV_isStreamFanoutObj(WVStreamingObject* streamObj);
+
+
+#endif
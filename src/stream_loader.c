@@ -0,0 +1,193 @@
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "stream_loader.h"
+
+#include "common.h"
+#include "config_sdl.h"
+
+#include "waave_engine_flags.h"
+
+
+/* a pending job */
+typedef struct LoaderJob{
+  WVLoaderJobCall jobCall;
+  void* jobParam;
+  struct LoaderJob* next;
+}LoaderJob;
+
+
+/* the job list */
+//FIFO, protected by jobMutex
+static LoaderJob* firstJob;
+static LoaderJob* lastJob;
+static SDL_mutex* jobMutex;
+static SDL_cond* jobPushed;      //WAIT (worker) : "I have no job, wake me up"
+                                 //SIGNAL (client) : "Here a new job"
+
+/* the workers */
+static SDL_Thread* workers[WV_STREAM_LOADER_WORKERS];
+static int nbWorkers = 0;
+static int quitFlag = 0;
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*           THE WORKERS          */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* wait for a job */
+/* NULL when the loader quit */
+static LoaderJob* takeJob(void)
+{
+  LoaderJob* job;
+  
+  SDL_mutexP(jobMutex);
+
+  while(!firstJob && !quitFlag)
+    SDL_CondWait(jobPushed, jobMutex);
+
+  job = firstJob;
+  if(job){
+    firstJob = job->next;
+    if(!firstJob)
+      lastJob = NULL;
+  }
+  
+  SDL_mutexV(jobMutex);
+
+  return job;
+}
+
+
+static int loaderWorkerThread(void* opaque)
+{
+  LoaderJob* job;
+
+  //the pending jobs are done even if we quit
+  while((job = takeJob()) != NULL){
+    job->jobCall(job->jobParam);
+    free(job);
+  }
+
+  return 0;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*           THE CLIENT           */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+int WV_initStreamLoader(void)
+{
+  firstJob = NULL;
+  lastJob = NULL;
+  quitFlag = 0;
+  
+  jobMutex = SDL_CreateMutex();
+  jobPushed = SDL_CreateCond();
+
+  /* the workers */
+  //without the ffmpeg lock manager the codecs can't be opened in parallel
+  int maxWorkers = 1;
+
+#if HAVE_AV_LOCKMGR_REGISTER
+  maxWorkers = WV_STREAM_LOADER_WORKERS;
+#endif
+  
+  int i;
+  nbWorkers = 0;
+  for(i=0; i<maxWorkers; i++){
+    #if SDL_VERSION_ATLEAST(2,0,0)
+    workers[nbWorkers] = SDL_CreateThread(loaderWorkerThread, "loaderWorker", NULL);
+    #else
+    workers[nbWorkers] = SDL_CreateThread(loaderWorkerThread, NULL);
+    #endif
+
+    if(workers[nbWorkers])
+      nbWorkers++;
+  }
+
+  if(!nbWorkers)
+    return -1;
+
+  return 0;
+}
+
+
+int WV_pushStreamLoaderJob(WVLoaderJobCall jobCall, void* jobParam)
+{
+  if(!nbWorkers || !jobCall)
+    return -1;
+  
+  LoaderJob* job = (LoaderJob*)malloc(sizeof(LoaderJob));
+  if(!job)
+    return -1;
+  
+  job->jobCall = jobCall;
+  job->jobParam = jobParam;
+  job->next = NULL;
+
+  /* add at the end of the list */
+  SDL_mutexP(jobMutex);
+
+  if(lastJob)
+    lastJob->next = job;
+  else
+    firstJob = job;
+  lastJob = job;
+
+  SDL_CondSignal(jobPushed);
+  
+  SDL_mutexV(jobMutex);
+
+  return 0;
+}
+
+
+int WV_streamLoaderShutdown(void)
+{
+  /* say the workers to quit */
+  SDL_mutexP(jobMutex);
+  quitFlag = 1;
+  SDL_CondBroadcast(jobPushed);
+  SDL_mutexV(jobMutex);
+
+  /* wait them */
+  int i;
+  for(i=0; i<nbWorkers; i++)
+    SDL_WaitThread(workers[i], NULL);
+  nbWorkers = 0;
+
+  /* close */
+  SDL_DestroyCond(jobPushed);
+  SDL_DestroyMutex(jobMutex);
+  
+  return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef STREAM_LOADER_H
+#define STREAM_LOADER_H
+
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "common.h"
+#include "config_sdl.h"
+
+#include "waave_engine_flags.h"
+
+
+/*****************************************/
+/* the stream loader run the open and    */
+/* load jobs on a pool of worker threads */
+/* so the caller is never blocked        */
+/*****************************************/
+
+/* a job, with its param */
+typedef void (*WVLoaderJobCall)(void* jobParam);
+
+
+/*******************************/
+/* INIT                        */
+/* launch the loader workers   */
+/*******************************/
+int WV_initStreamLoader(void);
+
+
+/*****************************************/
+/* PUSH                                  */
+/* the jobs are processed in order, in   */
+/* parallel by the workers               */
+/* return -1 if the loader is not started*/
+/*****************************************/
+int WV_pushStreamLoaderJob(WVLoaderJobCall jobCall, void* jobParam);
+
+
+/***************************************/
+/* CLOSE                               */
+/* the pending jobs are processed      */
+/* before the workers exit             */
+/***************************************/
+int WV_streamLoaderShutdown(void);
+
+
+/*****************************************/
+/* the loads of the video streams are    */
+/* finished by the main thread, with the */
+/* load refresh event, see waave.c       */
+/*****************************************/
+void WV_finishStreamLoads(void);
+
+
+#endif
@@ -0,0 +1,308 @@
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "stream_memory.h"
+
+#include "common.h"
+#include "config_ffmpeg.h"
+
+#include "streaming_object.h"
+#include "waave_engine_flags.h"
+
+
+typedef struct StreamMemoryPrivate{
+  /* the requested buffers */
+  enum PixelFormat format;      //PIX_FMT_NONE for the src format
+  int width;                    //0 for the src size
+  int height;
+
+  /* the slots */
+  AVPicture* slotPicture;
+  WVStreamingBuffer* slotBuffer; //format PIX_FMT_NONE if not allocated
+
+  /* the refreshs */
+  uint32_t nbFrames;
+  int lastSlot;                  //-1 if none
+  WVMemoryFrameCall frameCall;
+  void* callParam;
+
+}StreamMemoryPrivate;
+
+
+/* used to recognize the memory objects */
+static int refreshFrame_streamMemory(WVStreamingObject* streamObj, int slotIdx);
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*     THE STREAMING OBJECT       */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* the buffer format for the current src */
+static void getWantedBuffer(WVStreamingObject* streamObj, int* width, int* height, enum PixelFormat* format)
+{
+  StreamMemoryPrivate* objPrivate = (StreamMemoryPrivate*)streamObj->objPrivate;
+
+  if(streamObj->formatIdx >= 0)
+    *format = streamObj->formats[streamObj->formatIdx].format;
+  else
+    *format = streamObj->srcFormat;
+
+  if(objPrivate->width && objPrivate->height){
+    *width = objPrivate->width;
+    *height = objPrivate->height;
+  }
+  else{
+    *width = streamObj->srcWidth;
+    *height = streamObj->srcHeight;
+  }
+}
+
+
+static int init_streamMemory(WVStreamingObject* streamObj)
+{
+  StreamMemoryPrivate* objPrivate = (StreamMemoryPrivate*)streamObj->objPrivate;
+  int nbSlots = streamObj->nbSlots;
+  int i;
+
+  /* alloc the slots */
+  /* in one time */
+  int picturesSize = nbSlots * sizeof(AVPicture);
+  int buffersSize = nbSlots * sizeof(WVStreamingBuffer);
+
+  void* structP = malloc(picturesSize + buffersSize);
+  if(!structP)
+    return -1;
+  
+  objPrivate->slotPicture = (AVPicture*)structP;
+  structP += picturesSize;
+  objPrivate->slotBuffer = (WVStreamingBuffer*)structP;
+
+  //the pictures are allocated at the first get
+  for(i=0; i<nbSlots; i++){
+    objPrivate->slotBuffer[i].width = 0;
+    objPrivate->slotBuffer[i].height = 0;
+    objPrivate->slotBuffer[i].format = PIX_FMT_NONE;
+  }
+
+  objPrivate->nbFrames = 0;
+  objPrivate->lastSlot = -1;
+
+  return 0;
+}
+
+
+/* each slot is only touched by its get */
+//so the decoder thread can get without lock
+static WVStreamingBuffer getBuffer_streamMemory(WVStreamingObject* streamObj, int slotIdx)
+{
+  StreamMemoryPrivate* objPrivate = (StreamMemoryPrivate*)streamObj->objPrivate;
+  WVStreamingBuffer* slotBuffer = &objPrivate->slotBuffer[slotIdx];
+  AVPicture* slotPicture = &objPrivate->slotPicture[slotIdx];
+  int width, height;
+  enum PixelFormat format;
+  int i;
+
+  /* realloc the slot if the src change */
+  //the slot is not refreshed while the decoder write it
+  getWantedBuffer(streamObj, &width, &height, &format);
+  
+  if(slotBuffer->width != width ||		\
+     slotBuffer->height != height ||		\
+     slotBuffer->format != format){
+
+    if(slotBuffer->format != PIX_FMT_NONE)
+      avpicture_free(slotPicture);
+    
+    slotBuffer->width = width;
+    slotBuffer->height = height;
+    slotBuffer->format = format;
+    
+    if(avpicture_alloc(slotPicture, format, width, height) < 0){
+      slotBuffer->format = PIX_FMT_NONE;
+      for(i=0; i<4; i++){
+	slotPicture->data[i] = NULL;
+	slotPicture->linesize[i] = 0;
+      }
+    }
+    
+    for(i=0; i<4; i++){
+      slotBuffer->data[i] = slotPicture->data[i];
+      slotBuffer->linesize[i] = slotPicture->linesize[i];
+    }
+  }
+
+  return *slotBuffer;
+}
+
+
+/* nothing to display */
+/* count and give the frame to the user */
+static int refreshFrame_streamMemory(WVStreamingObject* streamObj, int slotIdx)
+{
+  StreamMemoryPrivate* objPrivate = (StreamMemoryPrivate*)streamObj->objPrivate;
+  WVStreamingBuffer* slotBuffer = &objPrivate->slotBuffer[slotIdx];
+
+  if(slotBuffer->format == PIX_FMT_NONE)
+    return -1;
+
+  objPrivate->nbFrames++;
+  objPrivate->lastSlot = slotIdx;
+
+  if(objPrivate->frameCall)
+    objPrivate->frameCall(slotBuffer, objPrivate->callParam);
+
+  return 0;
+}
+
+
+static int close_streamMemory(WVStreamingObject* streamObj)
+{
+  StreamMemoryPrivate* objPrivate = (StreamMemoryPrivate*)streamObj->objPrivate;
+  int i;
+
+  if(!objPrivate->slotPicture)
+    return 0;
+  
+  for(i=0; i<streamObj->nbSlots; i++){
+    if(objPrivate->slotBuffer[i].format != PIX_FMT_NONE)
+      avpicture_free(&objPrivate->slotPicture[i]);
+  }
+
+  //allocated in one time
+  free(objPrivate->slotPicture);
+  objPrivate->slotPicture = NULL;
+  objPrivate->slotBuffer = NULL;
+  objPrivate->lastSlot = -1;
+
+  return 0;
+}
+
+
+WVStreamingObject* WV_getStreamMemoryObj(enum PixelFormat format, int width, int height, int nbSlots, \
+					 WVMemoryFrameCall frameCall, void* param)
+{
+  /* check params */
+  if(width < 0 || height < 0 || nbSlots < 0 || nbSlots > WV_STREAM_MEMORY_MAX_SLOTS)
+    return NULL;
+  
+  /* alloc the struct */
+  WVStreamingObject* streamObj;
+  streamObj = (WVStreamingObject*)malloc(sizeof(WVStreamingObject) + sizeof(StreamMemoryPrivate));
+  if(!streamObj)
+    return NULL;
+  
+  void* structP = (void*)streamObj;
+  structP += sizeof(WVStreamingObject);
+  streamObj->objPrivate = structP;
+
+  StreamMemoryPrivate* objPrivate = (StreamMemoryPrivate*)streamObj->objPrivate;
+  objPrivate->format = format;
+  objPrivate->width = width;
+  objPrivate->height = height;
+  objPrivate->slotPicture = NULL;  //allocated by init
+  objPrivate->slotBuffer = NULL;
+  objPrivate->nbFrames = 0;
+  objPrivate->lastSlot = -1;
+  objPrivate->frameCall = frameCall;
+  objPrivate->callParam = param;
+  
+  /**********************/
+  /* fill object params */
+  /**********************/
+  
+  /* the slots */
+  if(nbSlots)
+    streamObj->nbSlots = nbSlots;
+  else
+    streamObj->nbSlots = WV_STREAM_MEMORY_DEFAULT_SLOTS;
+  
+  /* methods params */
+  streamObj->getBufferMethod = WV_DYNAMIC_GET;    //the src may change
+  streamObj->GLRMethod = WV_ASYNC_GLR;            //the last frame stay readable
+  streamObj->getThreadSafety = WV_THREAD_SAFE;    //only touch the got slot
+  streamObj->LRThreadSafety = WV_THREAD_SAFE;
+
+  /* the accepted format */
+  //without format the slots are in the src format
+  if(format != PIX_FMT_NONE){
+    streamObj->nbFormats = 1;
+    streamObj->formats[0].format = format;
+    streamObj->formats[0].width = width;
+    streamObj->formats[0].height = height;
+    streamObj->formats[0].cost = 0;
+  }
+  else{
+    streamObj->nbFormats = 0;
+  }
+  streamObj->formatIdx = -1;
+  
+  /* methods */
+  streamObj->init = &init_streamMemory;
+  streamObj->getBuffer = &getBuffer_streamMemory;
+  streamObj->lockBuffer = NULL;
+  streamObj->filterBuffer = NULL;
+  streamObj->releaseBuffer = NULL;
+  streamObj->uploadFrame = NULL;
+  streamObj->refreshFrame = &refreshFrame_streamMemory;
+  streamObj->close = &close_streamMemory;
+
+
+  /*********************/
+  /* return the object */
+  /*********************/
+  return streamObj;
+}
+
+
+void WV_freeStreamMemoryObj(WVStreamingObject* streamObj)
+{
+  free(streamObj);
+}
+
+
+uint32_t WV_getStreamMemoryFrames(WVStreamingObject* streamObj)
+{
+  if(!streamObj || streamObj->refreshFrame != &refreshFrame_streamMemory)
+    return 0;
+
+  StreamMemoryPrivate* objPrivate = (StreamMemoryPrivate*)streamObj->objPrivate;
+  return objPrivate->nbFrames;
+}
+
+
+WVStreamingBuffer* WV_getStreamMemoryLastFrame(WVStreamingObject* streamObj)
+{
+  if(!streamObj || streamObj->refreshFrame != &refreshFrame_streamMemory)
+    return NULL;
+
+  StreamMemoryPrivate* objPrivate = (StreamMemoryPrivate*)streamObj->objPrivate;
+  if(objPrivate->lastSlot < 0)
+    return NULL;
+  
+  return &objPrivate->slotBuffer[objPrivate->lastSlot];
+}
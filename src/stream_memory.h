@@ -0,0 +1,63 @@
+#ifndef STREAM_MEMORY_H
+#define STREAM_MEMORY_H
+
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "common.h"
+#include "config_ffmpeg.h"
+
+#include "streaming_object.h"
+#include "waave_engine_flags.h"
+
+
+/*****************************************/
+/* the memory object keep the frames in  */
+/* memory without display, for the       */
+/* benchmarks and the offscreen use      */
+/* get/lock/release are thread safe so   */
+/* the decoder thread convert the frames */
+/*****************************************/
+
+/* called at each refresh with the refreshed frame */
+/* !!! the frame is valid only during the call !!! */
+typedef void (*WVMemoryFrameCall)(WVStreamingBuffer* frame, void* param);
+
+/* PIX_FMT_NONE keep the src format */
+/* 0 width or height keep the src size */
+/* 0 nbSlots use the default */
+WVStreamingObject* WV_getStreamMemoryObj(enum PixelFormat format, int width, int height, int nbSlots, \
+					 WVMemoryFrameCall frameCall, void* param);
+void WV_freeStreamMemoryObj(WVStreamingObject* streamObj);
+
+/* the number of refreshed frames */
+uint32_t WV_getStreamMemoryFrames(WVStreamingObject* streamObj);
+
+/* the last refreshed frame, NULL if none */
+//!!! only valid until the next refresh !!!
+WVStreamingBuffer* WV_getStreamMemoryLastFrame(WVStreamingObject* streamObj);
+
+
+#endif
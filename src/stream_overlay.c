@@ -124,18 +124,38 @@ static int init_streamOverlay(WVStreamingObject* streamObj)
 }
 
 
+/* the negotiated buffer format */
+static enum PixelFormat getOverlayFormat(WVStreamingObject* streamObj)
+{
+  if(streamObj->formatIdx < 0)
+    return PIX_FMT_YUV420P;
+
+  return streamObj->formats[streamObj->formatIdx].format;
+}
+
+
 static WVStreamingBuffer getBuffer_streamOverlay(WVStreamingObject* streamObj, int slotIdx)
 {
   StreamOverlayPrivate* objPrivate = (StreamOverlayPrivate*)streamObj->objPrivate;
+  enum PixelFormat overlayFormat = getOverlayFormat(streamObj);
 
   /* create an overlay */
   /* we use native size */
   SDL_Overlay* newOverlay;
+  Uint32 overlayType;
   
   if(!objPrivate->slotOverlay[slotIdx]){
+
+    /* the overlay format */
+    if(overlayFormat == PIX_FMT_YUYV422)
+      overlayType = SDL_YUY2_OVERLAY;
+    else if(overlayFormat == PIX_FMT_UYVY422)
+      overlayType = SDL_UYVY_OVERLAY;
+    else
+      overlayType = SDL_YV12_OVERLAY;
     
     newOverlay = SDL_CreateYUVOverlay(streamObj->srcWidth, streamObj->srcHeight, \
-						 SDL_YV12_OVERLAY, objPrivate->targetSurface);
+						 overlayType, objPrivate->targetSurface);
     /* save */
     objPrivate->slotOverlay[slotIdx] = newOverlay;
   }
@@ -148,6 +168,16 @@ static WVStreamingBuffer getBuffer_streamOverlay(WVStreamingObject* streamObj, i
   
   newBuff.width = streamObj->srcWidth;
   newBuff.height = streamObj->srcHeight;
+
+  /* packed overlays */
+  if(overlayFormat == PIX_FMT_YUYV422 || overlayFormat == PIX_FMT_UYVY422){
+    newBuff.format = overlayFormat;
+    newBuff.data[0] = newOverlay->pixels[0];
+    newBuff.linesize[0] = newOverlay->pitches[0];
+    return newBuff;
+  }
+  
+  /* YV12 overlays */
   newBuff.format = PIX_FMT_YUV420P;
   
   /* fill frame plane */
@@ -252,6 +282,22 @@ WVStreamingObject* WV_getStreamOverlayObj(SDL_Surface* targetSurface, SDL_Rect*
   streamObj->GLRMethod = WV_ASYNC_GLR;         //async
   streamObj->getThreadSafety = WV_NO_THREAD_SAFE;
   streamObj->LRThreadSafety = WV_THREAD_SAFE;   //assume that lockSurface is thread safe
+
+  /* the overlay formats */
+  //the video card convert them 
+  streamObj->nbFormats = 3;
+  streamObj->formatIdx = -1;
+  
+  streamObj->formats[0].format = PIX_FMT_YUV420P;
+  streamObj->formats[1].format = PIX_FMT_YUYV422;
+  streamObj->formats[2].format = PIX_FMT_UYVY422;
+  
+  int i;
+  for(i=0; i<streamObj->nbFormats; i++){
+    streamObj->formats[i].width = 0;    //native size
+    streamObj->formats[i].height = 0;
+    streamObj->formats[i].cost = 0;
+  }
   
   
   /* methods */
@@ -260,6 +306,7 @@ WVStreamingObject* WV_getStreamOverlayObj(SDL_Surface* targetSurface, SDL_Rect*
   streamObj->lockBuffer = &lockBuffer_streamOverlay;
   streamObj->filterBuffer = NULL;
   streamObj->releaseBuffer = &releaseBuffer_streamOverlay;
+  streamObj->uploadFrame = NULL;
   streamObj->refreshFrame = &refreshFrame_streamOverlay;
   streamObj->close = &close_streamOverlay;
 
@@ -28,12 +28,28 @@
 #include "config_sdl.h"
 
 #include "streaming_object.h"
+#include "waave_engine_flags.h"
 
 /*!!!!!!!!!!!!!!!!!!!!!!!*/
 /*    only for SDL >2.0  */
 /*!!!!!!!!!!!!!!!!!!!!!!!*/
 #if SDL_VERSION_ATLEAST(2,0,0)
 
+/* the compositor */
+/* render many streams with one present */
+struct WVRendererCompositor{
+  SDL_Renderer* targetRenderer;
+  
+  /* the streaming objects */
+  /* sorted by zOrder */
+  int nbTiles;
+  WVStreamingObject* tiles[WV_RENDERER_COMPOSITOR_MAX_TILES];
+
+  /* say if a tile have a new frame */
+  int updatedFlag;
+};
+
+
 typedef struct StreamRendererPrivate{
   /* user params */
   SDL_Renderer* targetRenderer;
@@ -43,6 +59,11 @@ typedef struct StreamRendererPrivate{
   /* the object textures */
   SDL_Rect targetRect;
   SDL_Texture** slotTexture;
+
+  /* compositing */
+  WVRendererCompositor* compositor;  //NULL if the object render itself
+  int zOrder;                        //the tiles are rendered by increasing zOrder
+  int currentSlot;                   //the last refreshed slot, -1 if none
 }StreamRendererPrivate;
 
 
@@ -110,37 +131,226 @@ static void setOutputRect(WVStreamingObject* streamObj)
   
     
 
-static int init_streamRenderer(WVStreamingObject* streamObj)
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*       THE COMPOSITOR           */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* add a tile, keep the zOrder */
+static int addCompositorTile(WVRendererCompositor* compositor, WVStreamingObject* streamObj)
 {
   StreamRendererPrivate* objPrivate = (StreamRendererPrivate*)streamObj->objPrivate;
   
-  /* set output rect */
-  setOutputRect(streamObj);
+  /* check space */
+  if(compositor->nbTiles >= WV_RENDERER_COMPOSITOR_MAX_TILES)
+    return -1;
+
+  /* search the position, after the tiles with the same zOrder */
+  int i = compositor->nbTiles;
+  while(i > 0 && ((StreamRendererPrivate*)compositor->tiles[i-1]->objPrivate)->zOrder > objPrivate->zOrder){
+    compositor->tiles[i] = compositor->tiles[i-1];
+    i--;
+  }
+
+  compositor->tiles[i] = streamObj;
+  compositor->nbTiles++;
+
+  return 0;
+}
+
+
+static void delCompositorTile(WVRendererCompositor* compositor, WVStreamingObject* streamObj)
+{
+  /* find the tile */
+  int i = 0;
+  while(i < compositor->nbTiles && compositor->tiles[i] != streamObj)
+    i++;
+
+  if(i == compositor->nbTiles)
+    return;
+
+  /* shift the others */
+  compositor->nbTiles--;
+  while(i < compositor->nbTiles){
+    compositor->tiles[i] = compositor->tiles[i+1];
+    i++;
+  }
+
+  /* the tile disappear */
+  compositor->updatedFlag = 1;
+}
+
+
+WVRendererCompositor* WV_getRendererCompositor(SDL_Renderer* targetRenderer)
+{
+  WVRendererCompositor* compositor = (WVRendererCompositor*)malloc(sizeof(WVRendererCompositor));
+
+  compositor->targetRenderer = targetRenderer;
+  compositor->nbTiles = 0;
+  compositor->updatedFlag = 0;
+
+  return compositor;
+}
+
+
+int WV_renderCompositor(WVRendererCompositor* compositor)
+{
+  /* nothing new */
+  if(!compositor->updatedFlag)
+    return 0;
+
+  /* one render pass */
+  SDL_RenderClear(compositor->targetRenderer);
 
-  /* alloc space for the textures */
-  objPrivate->slotTexture = (SDL_Texture**)malloc(streamObj->nbSlots*sizeof(SDL_Texture*));
-  
-  /* create textures */
   int i;
-  for(i=0; i<streamObj->nbSlots; i++){
-    objPrivate->slotTexture[i] = SDL_CreateTexture(objPrivate->targetRenderer, \
-						SDL_PIXELFORMAT_YV12,	\
-						SDL_TEXTUREACCESS_STREAMING, \
-						streamObj->srcWidth,	\
-						streamObj->srcHeight);
+  WVStreamingObject* streamObj;
+  StreamRendererPrivate* objPrivate;
+  
+  for(i=0; i<compositor->nbTiles; i++){
+    streamObj = compositor->tiles[i];
+    objPrivate = (StreamRendererPrivate*)streamObj->objPrivate;
+
+    /* check if the tile have a frame */
+    if(objPrivate->currentSlot < 0)
+      continue;
+
+    SDL_RenderCopy(compositor->targetRenderer,			\
+		   objPrivate->slotTexture[objPrivate->currentSlot],	\
+		   NULL,						\
+		   &objPrivate->targetRect);
   }
 
-  return 0;
+  /* and one present */
+  SDL_RenderPresent(compositor->targetRenderer);
+  compositor->updatedFlag = 0;
+
+  return 1;
+}
+
+
+void WV_freeRendererCompositor(WVRendererCompositor* compositor)
+{
+  free(compositor);
 }
 
 
 
-static WVStreamingBuffer getBuffer_streamRenderer(WVStreamingObject* streamObj, int slotIdx)
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*     THE STREAMING OBJECT       */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* the SDL texture format of a buffer format, 0 if none */
+static Uint32 getTextureFormat(enum PixelFormat format)
+{
+  switch(format){
+
+  case PIX_FMT_YUV420P :
+    return SDL_PIXELFORMAT_YV12;
+
+  #if SDL_VERSION_ATLEAST(2,0,4)
+  case PIX_FMT_NV12 :
+    return SDL_PIXELFORMAT_NV12;
+
+  case PIX_FMT_NV21 :
+    return SDL_PIXELFORMAT_NV21;
+  #endif
+
+  case PIX_FMT_YUYV422 :
+    return SDL_PIXELFORMAT_YUY2;
+
+  case PIX_FMT_UYVY422 :
+    return SDL_PIXELFORMAT_UYVY;
+
+  default :
+    return 0;
+  }
+}
+
+
+/* check if the decoded frames can be uploaded */
+/* without conversion */
+//!!! the full range formats (YUVJ) need a conversion !!!
+static int canUpload(enum PixelFormat format)
+{
+  switch(format){
+
+  #if SDL_VERSION_ATLEAST(2,0,1)
+  case PIX_FMT_YUV420P :
+    return 1;
+  #endif
+
+  #if SDL_VERSION_ATLEAST(2,0,16)
+  case PIX_FMT_NV12 :
+  case PIX_FMT_NV21 :
+    return 1;
+  #endif
+
+  case PIX_FMT_YUYV422 :
+  case PIX_FMT_UYVY422 :
+    return 1;
+
+  default :
+    return 0;
+  }
+}
+
+
+/* the negotiated buffer format */
+static enum PixelFormat getBufferFormat(WVStreamingObject* streamObj)
+{
+  if(streamObj->formatIdx < 0)
+    return PIX_FMT_YUV420P;
+
+  return streamObj->formats[streamObj->formatIdx].format;
+}
+
+
+/* check that the slot texture have the wanted format and size */
+/* else recreate it */
+static SDL_Texture* checkSlotTexture(WVStreamingObject* streamObj, int slotIdx,	\
+				     Uint32 textureFormat, int width, int height)
 {
   StreamRendererPrivate* objPrivate = (StreamRendererPrivate*)streamObj->objPrivate;
+  SDL_Texture* currentTexture = objPrivate->slotTexture[slotIdx];
+  Uint32 currentFormat;
+  int currentWidth;
+  int currentHeight;
+
+  if(currentTexture){
+    SDL_QueryTexture(currentTexture, &currentFormat, NULL, &currentWidth, &currentHeight);
+    if(currentFormat == textureFormat && currentWidth == width && currentHeight == height)
+      return currentTexture;
+
+    SDL_DestroyTexture(currentTexture);
+  }
+
+  /* the compositor may render the old slot texture */
+  if(objPrivate->currentSlot == slotIdx)
+    objPrivate->currentSlot = -1;
+  
+  currentTexture = SDL_CreateTexture(objPrivate->targetRenderer,	\
+				     textureFormat,			\
+				     SDL_TEXTUREACCESS_STREAMING,	\
+				     width,				\
+				     height);
+  objPrivate->slotTexture[slotIdx] = currentTexture;
+
+  return currentTexture;
+}
+
 
+static WVStreamingBuffer getBuffer_streamRenderer(WVStreamingObject* streamObj, int slotIdx)
+{
   /* get the texture */
-  SDL_Texture* currentTexture = objPrivate->slotTexture[slotIdx];
+  //the src or the negotiated format may have changed
+  enum PixelFormat bufferFormat = getBufferFormat(streamObj);
+  SDL_Texture* currentTexture = checkSlotTexture(streamObj, slotIdx,	\
+						 getTextureFormat(bufferFormat), \
+						 streamObj->srcWidth,	\
+						 streamObj->srcHeight);
   
   /* lock for pixel access */
   uint8_t* pixels;
@@ -157,19 +367,41 @@ static WVStreamingBuffer getBuffer_streamRenderer(WVStreamingObject* streamObj,
   /* the format */
   newBuff.width = streamObj->srcWidth;
   newBuff.height = streamObj->srcHeight;
-  newBuff.format = PIX_FMT_YUV420P;
-  
-  /* fill frame plane */
-  newBuff.data[0] = pixels;
-  pixels += frameSize;
-  newBuff.data[2] = pixels;
-  pixels += frameSize/4;
-  newBuff.data[1] = pixels;
-
-  /* fill plane linesize */
-  newBuff.linesize[0] = pitch;
-  newBuff.linesize[1] = pitch/2;
-  newBuff.linesize[2] = pitch/2;
+  newBuff.format = bufferFormat;
+
+  switch(bufferFormat){
+
+  /* YV12 texture */
+  case PIX_FMT_YUV420P :
+    /* fill frame plane */
+    newBuff.data[0] = pixels;
+    pixels += frameSize;
+    newBuff.data[2] = pixels;
+    pixels += frameSize/4;
+    newBuff.data[1] = pixels;
+
+    /* fill plane linesize */
+    newBuff.linesize[0] = pitch;
+    newBuff.linesize[1] = pitch/2;
+    newBuff.linesize[2] = pitch/2;
+    break;
+
+  /* NV textures */
+  //Y plane and interleaved chroma
+  case PIX_FMT_NV12 :
+  case PIX_FMT_NV21 :
+    newBuff.data[0] = pixels;
+    newBuff.data[1] = pixels + frameSize;
+    newBuff.linesize[0] = pitch;
+    newBuff.linesize[1] = pitch;
+    break;
+    
+  /* packed textures */
+  default :
+    newBuff.data[0] = pixels;
+    newBuff.linesize[0] = pitch;
+    break;
+  }
 
   /* return the buffer */
   return newBuff;
@@ -187,10 +419,107 @@ static int releaseBuffer_streamRenderer(WVStreamingObject* streamObj, int slotId
 }
 
 
+/* upload the decoded planes */
+/* the renderer do the color conversion and the scaling */
+static int uploadFrame_streamRenderer(WVStreamingObject* streamObj, int slotIdx, WVStreamingBuffer* frame)
+{
+  /* the src may have changed */
+  if(!canUpload(frame->format))
+    return -1;
+
+  Uint32 textureFormat = getTextureFormat(frame->format);
+  SDL_Texture* currentTexture = checkSlotTexture(streamObj, slotIdx,	\
+						 textureFormat,		\
+						 frame->width,		\
+						 frame->height);
+
+  switch(textureFormat){
+
+  #if SDL_VERSION_ATLEAST(2,0,1)
+  case SDL_PIXELFORMAT_YV12 :
+    return SDL_UpdateYUVTexture(currentTexture, NULL,			\
+				frame->data[0], frame->linesize[0],	\
+				frame->data[1], frame->linesize[1],	\
+				frame->data[2], frame->linesize[2]);
+  #endif
+
+  #if SDL_VERSION_ATLEAST(2,0,16)
+  case SDL_PIXELFORMAT_NV12 :
+  case SDL_PIXELFORMAT_NV21 :
+    return SDL_UpdateNVTexture(currentTexture, NULL,			\
+			       frame->data[0], frame->linesize[0],	\
+			       frame->data[1], frame->linesize[1]);
+  #endif
+
+  /* packed formats */
+  default :
+    return SDL_UpdateTexture(currentTexture, NULL, frame->data[0], frame->linesize[0]);
+  }
+}
+
+
+static int init_streamRenderer(WVStreamingObject* streamObj)
+{
+  StreamRendererPrivate* objPrivate = (StreamRendererPrivate*)streamObj->objPrivate;
+  
+  /* set output rect */
+  setOutputRect(streamObj);
+
+  /* check the negotiated format */
+  //if it's the src format, upload the decoded frames directly if possible
+  enum PixelFormat bufferFormat = getBufferFormat(streamObj);
+
+  //the buffer methods are kept, the decoder use them when it crop or downscale the frames
+  streamObj->getBuffer = &getBuffer_streamRenderer;
+  streamObj->releaseBuffer = &releaseBuffer_streamRenderer;
+  
+  if(bufferFormat == streamObj->srcFormat && canUpload(bufferFormat) && !streamObj->filterBuffer)
+    streamObj->uploadFrame = &uploadFrame_streamRenderer;
+  else
+    streamObj->uploadFrame = NULL;   //else the decoder convert the frames
+
+  /* alloc space for the textures */
+  objPrivate->slotTexture = (SDL_Texture**)malloc(streamObj->nbSlots*sizeof(SDL_Texture*));
+  
+  /* create textures */
+  int i;
+  for(i=0; i<streamObj->nbSlots; i++){
+    objPrivate->slotTexture[i] = SDL_CreateTexture(objPrivate->targetRenderer, \
+						getTextureFormat(bufferFormat), \
+						SDL_TEXTUREACCESS_STREAMING, \
+						streamObj->srcWidth,	\
+						streamObj->srcHeight);
+  }
+
+  /* add to the compositor */
+  //if it is full the object can't be displayed
+  objPrivate->currentSlot = -1;
+  if(objPrivate->compositor && addCompositorTile(objPrivate->compositor, streamObj) < 0){
+    for(i=0; i<streamObj->nbSlots; i++)
+      if(objPrivate->slotTexture[i])
+	SDL_DestroyTexture(objPrivate->slotTexture[i]);
+    free(objPrivate->slotTexture);
+    objPrivate->slotTexture = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+
 static int refreshFrame_streamRenderer(WVStreamingObject* streamObj, int slotIdx)
 {
   StreamRendererPrivate* objPrivate = (StreamRendererPrivate*)streamObj->objPrivate;
 
+  /* with compositor just save the slot */
+  //the slot is not locked until the next refresh
+  if(objPrivate->compositor){
+    objPrivate->currentSlot = slotIdx;
+    objPrivate->compositor->updatedFlag = 1;
+    return 0;
+  }
+
   /* render texture */
   SDL_RenderCopy(objPrivate->targetRenderer,\
 		 objPrivate->slotTexture[slotIdx],	\
@@ -208,6 +537,15 @@ static int refreshFrame_streamRenderer(WVStreamingObject* streamObj, int slotIdx
 static int close_streamRenderer(WVStreamingObject* streamObj)
 {
   StreamRendererPrivate* objPrivate = (StreamRendererPrivate*)streamObj->objPrivate;
+
+  /* remove from the compositor */
+  if(objPrivate->compositor)
+    delCompositorTile(objPrivate->compositor, streamObj);
+  objPrivate->currentSlot = -1;
+
+  /* init failed, nothing to close */
+  if(!objPrivate->slotTexture)
+    return 0;
   
   /* close all the textures */
   int i;
@@ -220,6 +558,7 @@ static int close_streamRenderer(WVStreamingObject* streamObj)
 
   /* free the textures buffer */
   free(objPrivate->slotTexture);
+  objPrivate->slotTexture = NULL;
 
   return 0;
 }
@@ -249,6 +588,12 @@ WVStreamingObject* WV_getStreamRendererObj(SDL_Renderer* targetRenderer, SDL_Rec
 
   objPrivate->updateFlag = updateFlag;
 
+  /* no compositor */
+  objPrivate->compositor = NULL;
+  objPrivate->zOrder = 0;
+  objPrivate->currentSlot = -1;
+  objPrivate->slotTexture = NULL;  //allocated by init
+
   /**********************/
   /* fill object params */
   /**********************/
@@ -261,6 +606,28 @@ WVStreamingObject* WV_getStreamRendererObj(SDL_Renderer* targetRenderer, SDL_Rec
   streamObj->GLRMethod = WV_ASYNC_GLR;            //async
   streamObj->getThreadSafety = WV_NO_THREAD_SAFE;
   streamObj->LRThreadSafety = WV_NO_THREAD_SAFE;   
+
+  /* the texture formats */
+  //the renderer convert and scale them
+  int nbFormats = 0;
+  
+  streamObj->formats[nbFormats++].format = PIX_FMT_YUV420P;
+  #if SDL_VERSION_ATLEAST(2,0,4)
+  streamObj->formats[nbFormats++].format = PIX_FMT_NV12;
+  streamObj->formats[nbFormats++].format = PIX_FMT_NV21;
+  #endif
+  streamObj->formats[nbFormats++].format = PIX_FMT_YUYV422;
+  streamObj->formats[nbFormats++].format = PIX_FMT_UYVY422;
+
+  int i;
+  for(i=0; i<nbFormats; i++){
+    streamObj->formats[i].width = 0;    //native size
+    streamObj->formats[i].height = 0;
+    streamObj->formats[i].cost = 0;
+  }
+
+  streamObj->nbFormats = nbFormats;
+  streamObj->formatIdx = -1;
   
   
   /* methods */
@@ -269,6 +636,7 @@ WVStreamingObject* WV_getStreamRendererObj(SDL_Renderer* targetRenderer, SDL_Rec
   streamObj->lockBuffer = NULL;
   streamObj->filterBuffer = NULL;
   streamObj->releaseBuffer = &releaseBuffer_streamRenderer;
+  streamObj->uploadFrame = NULL;          //set by init if possible
   streamObj->refreshFrame = &refreshFrame_streamRenderer;
   streamObj->close = &close_streamRenderer;
 
@@ -286,6 +654,21 @@ void WV_freeStreamRendererObj(WVStreamingObject* streamObj)
 }
 
 
+WVStreamingObject* WV_getStreamCompositorObj(WVRendererCompositor* compositor, SDL_Rect* userDestRect, int zOrder)
+{
+  /* a standard renderer object */
+  //the compositor do the present
+  WVStreamingObject* streamObj = WV_getStreamRendererObj(compositor->targetRenderer, userDestRect, 0);
+
+  /* that render with the compositor */
+  StreamRendererPrivate* objPrivate = (StreamRendererPrivate*)streamObj->objPrivate;
+  objPrivate->compositor = compositor;
+  objPrivate->zOrder = zOrder;
+
+  return streamObj;
+}
+
+
 void WV_resetStreamRendererOutput(WVStreamingObject* streamObj, SDL_Renderer* targetRenderer, SDL_Rect* userDestRect)
 {
   StreamRendererPrivate* objPrivate = (StreamRendererPrivate*)streamObj->objPrivate;
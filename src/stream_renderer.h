@@ -45,6 +45,29 @@ void WV_resetStreamRendererOutput(WVStreamingObject* streamObj, SDL_Renderer* ta
 /* free the object */
 void WV_freeStreamRendererObj(WVStreamingObject* streamObj);
 
+
+
+/**************************************/
+/* the compositor                     */
+/* many renderer objects are rendered */
+/* with one present per frame         */
+/**************************************/
+typedef struct WVRendererCompositor WVRendererCompositor;
+
+/* get the compositor */
+WVRendererCompositor* WV_getRendererCompositor(SDL_Renderer* targetRenderer);
+
+/* get a renderer object that render with the compositor */
+WVStreamingObject* WV_getStreamCompositorObj(WVRendererCompositor* compositor, SDL_Rect* destRect, int zOrder);
+
+/* render all the objects and present, one time per display frame */
+/* return 0 if nothing changed (no present) */
+int WV_renderCompositor(WVRendererCompositor* compositor);
+
+/* free the compositor */
+/* !!! after the streams that use it are closed !!! */
+void WV_freeRendererCompositor(WVRendererCompositor* compositor);
+
 #endif
 
 
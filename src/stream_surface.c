@@ -41,12 +41,20 @@ typedef struct StreamSurfacePrivate{
   SDL_Rect userDestRect;
   int updateFlag;
 
-  /* the object surface */
-  SDL_Rect targetRect;
-  SDL_Surface** slotSurface;
+  /* the object surfaces */
+  SDL_Rect targetRect;          //the current output rect
+  SDL_Surface** slotSurface;    //where the decoder write
+  SDL_Rect* slotRect;           //the output rect of each slot surface
+
+  /* double buffered resize */
+  /* the new surfaces are created by the main thread */
+  /* and swapped by the decoder at the next get */
+  SDL_Surface** nextSurface;    //replace the slot surface at the next get, NULL if none
+  SDL_Surface** oldSurface;     //the replaced surface, freed at the next refresh
+  SDL_Rect nextRect;            //the output rect of the next surfaces
 
   /* mutex  */
-  /* for the slot surface */
+  /* only protect the surface swaps */
   SDL_mutex* surfaceMutex;
 
 }StreamSurfacePrivate;
@@ -113,26 +121,239 @@ static void setOutputRect(WVStreamingObject* streamObj)
   
     
 
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*     THE SURFACE FORMAT         */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* give the ffmpeg format corresponding to a sdl surface format */
+/* PIX_FMT_NONE if there is no corresponding format */
+static enum PixelFormat getSurfacePixelFormat(SDL_PixelFormat* format)
+{
+  Uint32 Rmask = format->Rmask;
+  Uint32 Gmask = format->Gmask;
+  Uint32 Bmask = format->Bmask;
+
+  switch(format->BitsPerPixel){
+
+  case 32 :
+    //native endian
+    if(Rmask == 0x00ff0000 && Gmask == 0x0000ff00 && Bmask == 0x000000ff)
+      return PIX_FMT_RGB32;
+    if(Rmask == 0x000000ff && Gmask == 0x0000ff00 && Bmask == 0x00ff0000)
+      return PIX_FMT_BGR32;
+    break;
+
+  case 24 :
+    //byte order
+    #if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    if(Rmask == 0x000000ff && Gmask == 0x0000ff00 && Bmask == 0x00ff0000)
+      return PIX_FMT_RGB24;
+    if(Rmask == 0x00ff0000 && Gmask == 0x0000ff00 && Bmask == 0x000000ff)
+      return PIX_FMT_BGR24;
+    #else
+    if(Rmask == 0x00ff0000 && Gmask == 0x0000ff00 && Bmask == 0x000000ff)
+      return PIX_FMT_RGB24;
+    if(Rmask == 0x000000ff && Gmask == 0x0000ff00 && Bmask == 0x00ff0000)
+      return PIX_FMT_BGR24;
+    #endif
+    break;
+
+  case 16 :
+    //native endian
+    if(Rmask == 0xf800 && Gmask == 0x07e0 && Bmask == 0x001f)
+      return PIX_FMT_RGB565;
+    if(Rmask == 0x001f && Gmask == 0x07e0 && Bmask == 0xf800)
+      return PIX_FMT_BGR565;
+    break;
+
+  case 15 :
+    //native endian
+    if(Rmask == 0x7c00 && Gmask == 0x03e0 && Bmask == 0x001f)
+      return PIX_FMT_RGB555;
+    if(Rmask == 0x001f && Gmask == 0x03e0 && Bmask == 0x7c00)
+      return PIX_FMT_BGR555;
+    break;
+  }
+
+  return PIX_FMT_NONE;
+}
+
+
+/* the format of the slot surfaces */
+/* the target surface format if the decoder can write it */
+/* so the blits doesn't need conversion */
+static enum PixelFormat negotiateSlotFormat(SDL_Surface* targetSurface)
+{
+  enum PixelFormat slotFormat = getSurfacePixelFormat(targetSurface->format);
+
+  /* else 32 bits */
+  if(slotFormat == PIX_FMT_NONE)
+    slotFormat = PIX_FMT_RGB32;
+
+  return slotFormat;
+}
+
+
+static SDL_Surface* createSlotSurface(SDL_Surface* targetSurface, int width, int height)
+{
+  SDL_PixelFormat* targetFormat = targetSurface->format;
+
+  /* same format than the target */
+  //without alpha, the blits are copies
+  if(getSurfacePixelFormat(targetFormat) != PIX_FMT_NONE)
+    return SDL_CreateRGBSurface(SDL_HWSURFACE, width, height,		\
+				targetFormat->BitsPerPixel,		\
+				targetFormat->Rmask,			\
+				targetFormat->Gmask,			\
+				targetFormat->Bmask,			\
+				0);
+
+  /* else the default 32 bits format */
+  return SDL_CreateRGBSurface(SDL_HWSURFACE, width, height, 32, 0, 0, 0, 0);
+}
+
+
+/* check if a slot surface can be used with the current output */
+static int checkSlotSurface(StreamSurfacePrivate* objPrivate, SDL_Surface* surface)
+{
+  SDL_Rect* targetRect = &(objPrivate->targetRect);
+
+  if(surface->w != targetRect->w || surface->h != targetRect->h)
+    return 0;
+
+  if(getSurfacePixelFormat(surface->format) != negotiateSlotFormat(objPrivate->targetSurface))
+    return 0;
+
+  return 1;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*     THE UPDATE RECTS           */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* with WV_DEFERRED_UPDATE the rects of all the */
+/* streams are updated in one time */
+//!!! only used by the main thread, no need of mutex !!!
+static SDL_Surface* updateSurface;     //the surface of the collected rects
+static SDL_Rect updateRects[WV_STREAM_SURFACE_MAX_UPDATE_RECTS];
+static int nbUpdateRects = 0;
+
+
+static void addUpdateRect(SDL_Surface* surface, SDL_Rect* rect)
+{
+  int i;
+  
+  /* nothing to update */
+  if(rect->w == 0 || rect->h == 0)
+    return;
+  
+  /* the rects are collected for one surface */
+  if(nbUpdateRects && surface != updateSurface)
+    WV_updateStreamSurfaces();
+  updateSurface = surface;
+
+  /* check if the rect is already here */
+  for(i=0; i<nbUpdateRects; i++){
+    if(updateRects[i].x == rect->x && updateRects[i].y == rect->y &&	\
+       updateRects[i].w == rect->w && updateRects[i].h == rect->h)
+      return;
+  }
+
+  /* if the list is full, merge all */
+  if(nbUpdateRects == WV_STREAM_SURFACE_MAX_UPDATE_RECTS){
+    int x1 = rect->x;
+    int y1 = rect->y;
+    int x2 = rect->x + rect->w;
+    int y2 = rect->y + rect->h;
+
+    for(i=0; i<nbUpdateRects; i++){
+      if(updateRects[i].x < x1)
+	x1 = updateRects[i].x;
+      if(updateRects[i].y < y1)
+	y1 = updateRects[i].y;
+      if(updateRects[i].x + updateRects[i].w > x2)
+	x2 = updateRects[i].x + updateRects[i].w;
+      if(updateRects[i].y + updateRects[i].h > y2)
+	y2 = updateRects[i].y + updateRects[i].h;
+    }
+
+    updateRects[0].x = x1;
+    updateRects[0].y = y1;
+    updateRects[0].w = x2 - x1;
+    updateRects[0].h = y2 - y1;
+    nbUpdateRects = 1;
+    return;
+  }
+
+  /* add */
+  updateRects[nbUpdateRects] = *rect;
+  nbUpdateRects++;
+}
+
+
+int WV_updateStreamSurfaces(void)
+{
+  /* nothing refreshed */
+  if(nbUpdateRects == 0)
+    return 0;
+
+  /* one update */
+  SDL_UpdateRects(updateSurface, nbUpdateRects, updateRects);
+  nbUpdateRects = 0;
+
+  return 1;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*     THE STREAMING OBJECT       */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
 static int init_streamSurface(WVStreamingObject* streamObj)
 {
   StreamSurfacePrivate* objPrivate = (StreamSurfacePrivate*)streamObj->objPrivate;
+  int nbSlots = streamObj->nbSlots;
   
   /* set output rect */
   setOutputRect(streamObj);
   SDL_Rect* targetRect = &(objPrivate->targetRect);
 
-  /* alloc space for the surface */
-  objPrivate->slotSurface = (SDL_Surface**)malloc(streamObj->nbSlots*sizeof(SDL_Surface*));
+  /* alloc space for the surfaces and rects */
+  /* in one time */
+  int surfacesSize = nbSlots * sizeof(SDL_Surface*);
+  int rectsSize = nbSlots * sizeof(SDL_Rect);
+  
+  void* structP = malloc(3*surfacesSize + rectsSize);
+  objPrivate->slotSurface = (SDL_Surface**)structP;
+  structP += surfacesSize;
+  objPrivate->nextSurface = (SDL_Surface**)structP;
+  structP += surfacesSize;
+  objPrivate->oldSurface = (SDL_Surface**)structP;
+  structP += surfacesSize;
+  objPrivate->slotRect = (SDL_Rect*)structP;
   
   int i;
-  for(i=0; i<streamObj->nbSlots; i++)
+  for(i=0; i<nbSlots; i++){
     objPrivate->slotSurface[i] = NULL;
+    objPrivate->nextSurface[i] = NULL;
+    objPrivate->oldSurface[i] = NULL;
+  }
 
   /* create the surfaces */
-  for(i=0; i<streamObj->nbSlots; i++){
-    objPrivate->slotSurface[i] = SDL_CreateRGBSurface(SDL_HWSURFACE, targetRect->w, targetRect->h, 32, 0, 0, 0, 0);
+  for(i=0; i<nbSlots; i++){
+    objPrivate->slotSurface[i] = createSlotSurface(objPrivate->targetSurface, targetRect->w, targetRect->h);
     if(!objPrivate->slotSurface[i])
       return -1;
+    objPrivate->slotRect[i] = *targetRect;
   }
 
   /* create the mutex */
@@ -147,52 +368,54 @@ static WVStreamingBuffer getBuffer_streamSurface(WVStreamingObject* streamObj, i
 {
   StreamSurfacePrivate* objPrivate = (StreamSurfacePrivate*)streamObj->objPrivate;
 
-  /* lock the mutex */
-  /* we can change the surfaces before release */
+  /* swap the surface if the output was changed */
+  //!!! the mutex is only locked for the swap !!!
+  //!!! if the old surface is not freed, wait the next get !!!
   SDL_mutexP(objPrivate->surfaceMutex);
+  
+  if(objPrivate->nextSurface[slotIdx] && !objPrivate->oldSurface[slotIdx]){
+    objPrivate->oldSurface[slotIdx] = objPrivate->slotSurface[slotIdx];
+    objPrivate->slotSurface[slotIdx] = objPrivate->nextSurface[slotIdx];
+    objPrivate->nextSurface[slotIdx] = NULL;
+    objPrivate->slotRect[slotIdx] = objPrivate->nextRect;
+  }
+
+  SDL_Surface* surface = objPrivate->slotSurface[slotIdx];
+  
+  SDL_mutexV(objPrivate->surfaceMutex);
+
+  /* lock the surface */
+  /* the pixels are only valid when locked */
+  /* seems thread safe */
+  SDL_LockSurface(surface);
     
   /* create the buffer */
   WVStreamingBuffer newBuff;
-  SDL_Surface* surface = objPrivate->slotSurface[slotIdx];
   
   newBuff.width = surface->w;
   newBuff.height = surface->h;
-  newBuff.format = PIX_FMT_RGB32;
+  newBuff.format = getSurfacePixelFormat(surface->format);
   
   /* fill frame plane */
   newBuff.data[0] = surface->pixels;
   
   /* fill plane linesize */
-  newBuff.linesize[0] = surface->w * 4;
+  newBuff.linesize[0] = surface->pitch;
   
   /* return the buffer */
   return newBuff;
 }
 
 
-static int lockBuffer_streamSurface(WVStreamingObject* streamObj, int slotIdx)
-{
-  StreamSurfacePrivate* objPrivate = (StreamSurfacePrivate*)streamObj->objPrivate;
-
-  /* lock the surface */
-  /* seems thread safe */
-  SDL_LockSurface(objPrivate->slotSurface[slotIdx]);
-
-  return 0;
-}
-
-
 static int releaseBuffer_streamSurface(WVStreamingObject* streamObj, int slotIdx)
 {
   StreamSurfacePrivate* objPrivate = (StreamSurfacePrivate*)streamObj->objPrivate;
 
   /* release the surface */
+  /* only the decoder change the slot surface */
   /* seems thread safe */
   SDL_UnlockSurface(objPrivate->slotSurface[slotIdx]);
 
-  /* we can now change the surface if needed */
-  SDL_mutexV(objPrivate->surfaceMutex);
-
   return 0;
 }
 
@@ -200,12 +423,30 @@ static int releaseBuffer_streamSurface(WVStreamingObject* streamObj, int slotIdx
 static int refreshFrame_streamSurface(WVStreamingObject* streamObj, int slotIdx)
 {
   StreamSurfacePrivate* objPrivate = (StreamSurfacePrivate*)streamObj->objPrivate;
-  SDL_Rect* targetRect = &(objPrivate->targetRect);
+
+  /* get the slot surface */
+  SDL_mutexP(objPrivate->surfaceMutex);
+  
+  SDL_Surface* surface = objPrivate->slotSurface[slotIdx];
+  SDL_Rect blitRect = objPrivate->slotRect[slotIdx];
+  SDL_Surface* oldSurface = objPrivate->oldSurface[slotIdx];
+  objPrivate->oldSurface[slotIdx] = NULL;
+  
+  SDL_mutexV(objPrivate->surfaceMutex);
+
+  /* the replaced surface is no longer used */
+  if(oldSurface)
+    SDL_FreeSurface(oldSurface);
 
   /* blit the surface */
-  SDL_BlitSurface(objPrivate->slotSurface[slotIdx], NULL, objPrivate->targetSurface, &(objPrivate->targetRect));
-  if(objPrivate->updateFlag)
-    SDL_UpdateRect(objPrivate->targetSurface, targetRect->x, targetRect->y, targetRect->w, targetRect->h);
+  //the blit rect is clipped
+  SDL_BlitSurface(surface, NULL, objPrivate->targetSurface, &blitRect);
+
+  /* update */
+  if(objPrivate->updateFlag == WV_DEFERRED_UPDATE)
+    addUpdateRect(objPrivate->targetSurface, &blitRect);
+  else if(objPrivate->updateFlag)
+    SDL_UpdateRect(objPrivate->targetSurface, blitRect.x, blitRect.y, blitRect.w, blitRect.h);
   
   return 0;
 }
@@ -224,6 +465,14 @@ static int close_streamSurface(WVStreamingObject* streamObj)
       SDL_FreeSurface(objPrivate->slotSurface[i]);
       objPrivate->slotSurface[i] = NULL;
     }
+    if(objPrivate->nextSurface[i]){
+      SDL_FreeSurface(objPrivate->nextSurface[i]);
+      objPrivate->nextSurface[i] = NULL;
+    }
+    if(objPrivate->oldSurface[i]){
+      SDL_FreeSurface(objPrivate->oldSurface[i]);
+      objPrivate->oldSurface[i] = NULL;
+    }
   }
 
   SDL_mutexV(objPrivate->surfaceMutex);
@@ -231,7 +480,8 @@ static int close_streamSurface(WVStreamingObject* streamObj)
   /* close the mutex */
   SDL_DestroyMutex(objPrivate->surfaceMutex);
 
-  /* free the surface buffer */
+  /* free the surface buffers */
+  //allocated in one time
   free(objPrivate->slotSurface);
 
   
@@ -276,14 +526,24 @@ WVStreamingObject* WV_getStreamSurfaceObj(SDL_Surface* targetSurface, SDL_Rect*
   streamObj->GLRMethod = WV_ASYNC_GLR;            //async
   streamObj->getThreadSafety = WV_THREAD_SAFE;
   streamObj->LRThreadSafety = WV_THREAD_SAFE;     //assume that lockSurface is thread safe
+
+  /* the slot format */
+  //the size is given by the output rect
+  streamObj->nbFormats = 1;
+  streamObj->formatIdx = -1;
+  streamObj->formats[0].format = negotiateSlotFormat(targetSurface);
+  streamObj->formats[0].width = 0;
+  streamObj->formats[0].height = 0;
+  streamObj->formats[0].cost = 0;
   
   
   /* methods */
   streamObj->init = &init_streamSurface;
   streamObj->getBuffer = &getBuffer_streamSurface;
-  streamObj->lockBuffer = &lockBuffer_streamSurface;
+  streamObj->lockBuffer = NULL;                   //done by get
   streamObj->filterBuffer = NULL;
   streamObj->releaseBuffer = &releaseBuffer_streamSurface;
+  streamObj->uploadFrame = NULL;
   streamObj->refreshFrame = &refreshFrame_streamSurface;
   streamObj->close = &close_streamSurface;
 
@@ -317,25 +577,76 @@ void WV_resetStreamSurfaceOutput(WVStreamingObject* streamObj, SDL_Surface* targ
   setOutputRect(streamObj);
   SDL_Rect* targetRect = &(objPrivate->targetRect);
 
-  /* update the slot's surfaces */
-  /* !! lock the mutex !! */
+  /* the new slot format */
+  streamObj->formats[0].format = negotiateSlotFormat(targetSurface);
+
+  /* the rect of the next surfaces */
   SDL_mutexP(objPrivate->surfaceMutex);
+  objPrivate->nextRect = *targetRect;
+  SDL_mutexV(objPrivate->surfaceMutex);
 
+  /* prepare the next slot surfaces */
+  /* !!! the decoder is never blocked during the creation !!! */
   int i;
+  int createFlag;
+  int retryFlag;
+  SDL_Surface* newSurface;
+  SDL_Surface* unusedSurface;
+  
   for(i=0; i<streamObj->nbSlots; i++){
-   
-    SDL_Surface* currentSurface = objPrivate->slotSurface[i];
-
-    if(currentSurface->w != targetRect->w || currentSurface->h != targetRect->h){
-      SDL_LockSurface(currentSurface);
-      SDL_UnlockSurface(currentSurface);
-      SDL_FreeSurface(currentSurface);
-      objPrivate->slotSurface[i] = SDL_CreateRGBSurface(SDL_HWSURFACE, targetRect->w, targetRect->h, 32, 0, 0, 0, 0);
+
+    /* check if we need a new surface */
+    retryFlag = 0;
+    SDL_mutexP(objPrivate->surfaceMutex);
+    createFlag = !checkSlotSurface(objPrivate, objPrivate->slotSurface[i]) &&		\
+      !(objPrivate->nextSurface[i] && checkSlotSurface(objPrivate, objPrivate->nextSurface[i]));
+    SDL_mutexV(objPrivate->surfaceMutex);
+
+    /* create it without lock */
+    newSurface = NULL;
+    if(createFlag)
+      newSurface = createSlotSurface(targetSurface, targetRect->w, targetRect->h);
+
+    /* the decoder may have swapped the surfaces */
+    /* so check again */
+    SDL_mutexP(objPrivate->surfaceMutex);
+
+    /* the slot surface can be used, only move it */
+    if(checkSlotSurface(objPrivate, objPrivate->slotSurface[i])){
+      unusedSurface = objPrivate->nextSurface[i];
+      objPrivate->nextSurface[i] = NULL;
+      objPrivate->slotRect[i] = *targetRect;
+    }
+
+    /* the next surface can be used */
+    else if(objPrivate->nextSurface[i] && checkSlotSurface(objPrivate, objPrivate->nextSurface[i])){
+      unusedSurface = NULL;
+    }
+
+    /* replace the next surface */
+    else if(newSurface){
+      unusedSurface = objPrivate->nextSurface[i];
+      objPrivate->nextSurface[i] = newSurface;
+      newSurface = NULL;
+    }
+    /* the decoder swapped an old next surface */
+    //try again this slot
+    else{
+      unusedSurface = NULL;
+      retryFlag = !createFlag;
     }
+    
+    SDL_mutexV(objPrivate->surfaceMutex);
+
+    /* free the replaced surfaces */
+    if(unusedSurface)
+      SDL_FreeSurface(unusedSurface);
+    if(newSurface)
+      SDL_FreeSurface(newSurface);
+
+    if(retryFlag)
+      i--;
   }
-  
-  /* !! release !! */
-  SDL_mutexV(objPrivate->surfaceMutex);
 }
 
 
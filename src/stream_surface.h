@@ -29,6 +29,7 @@
 #include "config_sdl.h"
 
 #include "streaming_object.h"
+#include "waave_engine_flags.h"
 
 /*!!!!!!!!!!!!!!!!!!!!!!!*/
 /*    only for SDL 1.2   */
@@ -39,6 +40,12 @@ WVStreamingObject* WV_getStreamSurfaceObj(SDL_Surface* targetSurface, SDL_Rect*
 void WV_freeStreamSurfaceObj(WVStreamingObject* streamObj);
 void WV_resetStreamSurfaceOutput(WVStreamingObject* streamObj, SDL_Surface* targetSurface, SDL_Rect* userDestRect);
 
+/* the update flag */
+//the update rects are collected and updated in one time by WV_updateStreamSurfaces
+#define WV_DEFERRED_UPDATE 2
+
+int WV_updateStreamSurfaces(void);
+
 
 #endif
 #endif
@@ -28,6 +28,8 @@
 #include "common.h"
 #include "config_ffmpeg.h"
 
+#include "waave_engine_flags.h"
+
 
 /* the get buffer method */
 //the buffers doesn't change, get is used one time per slot
@@ -67,6 +69,27 @@ typedef struct WVStreamingBuffer{
 }WVStreamingBuffer;
 
 
+/**************************/
+/* an accepted format     */
+/* for format negotiation */
+/**************************/
+typedef struct WVStreamingFormat{
+
+  /* the buffer format */
+  enum PixelFormat format;  //see ffmpeg format
+
+  /* the buffer size */
+  //0 if the object choose the size (scaling, output rect...)
+  int width;
+  int height;
+
+  /* the object cost to display this format */
+  //added to the conversion cost, 0 is the cheapest
+  int cost;
+
+}WVStreamingFormat;
+
+
 /*******************/
 /* the main object */
 /*******************/
@@ -76,6 +99,13 @@ typedef struct WVStreamingObject{
   int srcWidth;
   int srcHeight;
   enum PixelFormat srcFormat;  //ffmpeg src format 
+
+  /* the accepted formats, ordered by preference */
+  /* the decoder choose the cheapest conversion from the src format */
+  /* before init, and again when the src format change */
+  int nbFormats;    //0 if the object doesn't negotiate
+  WVStreamingFormat formats[WV_STREAMING_MAX_FORMATS];
+  int formatIdx;    //the negotiated format, set by the decoder, -1 if none
   
   /* the size of the list where we decode frames */
   int nbSlots;
@@ -114,6 +144,12 @@ typedef struct WVStreamingObject{
   /* !!! NULL if useless !!! */
   int (*releaseBuffer)(struct WVStreamingObject* streamObj, int slotIdx);
 
+  /* upload directly the decoded frame in the codec format */
+  /* the decoder doesn't convert the frames and doesn't use get/lock/release */
+  /* !!! called by the main thread just before refreshFrame !!! */
+  /* !!! NULL if useless, can be set by init !!! */
+  int (*uploadFrame)(struct WVStreamingObject* streamObj, int slotIdx, WVStreamingBuffer* frame);
+
   /* refresh the frame by displaying his content */
   int (*refreshFrame)(struct WVStreamingObject* streamObj, int slotIdx);
 
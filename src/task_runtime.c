@@ -0,0 +1,632 @@
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+/* the cpu pinning */
+#if HAVE_WINDOWS_H
+#include <windows.h>
+#elif HAVE_PTHREAD_SETAFFINITY_NP
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "task_runtime.h"
+
+#include "common.h"
+#include "config_sdl.h"
+
+#include "waave_engine_flags.h"
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*           THE TASKS            */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* a group count its unfinished tasks */
+typedef struct TaskGroup{
+
+  int remainingTasks;       //protected by the runtime mutex
+
+}TaskGroup;
+
+
+typedef struct Task{
+
+  WVTaskCall call;
+  void* param;
+  TaskGroup* group;
+
+}Task;
+
+
+/* the task deque of a worker */
+//one ring for each priority
+typedef struct TaskDeque{
+
+  SDL_mutex* mutex;
+  Task tasks[WV_TASK_PRIORITIES][WV_TASK_RUNTIME_QUEUE_SIZE];
+  int head[WV_TASK_PRIORITIES];      //the first task, stolen by the others
+  int nbTasks[WV_TASK_PRIORITIES];
+
+}TaskDeque;
+
+
+typedef struct TaskWorker{
+
+  TaskDeque deque;
+  SDL_Thread* thread;
+  unsigned long threadID;   //set by the worker itself
+  int cpu;                  //-1 if not pinned
+
+}TaskWorker;
+
+
+static TaskWorker workers[WV_TASK_RUNTIME_MAX_WORKERS];
+static int nbWorkers = 0;
+
+static SDL_mutex* runtimeMutex = NULL;
+static SDL_cond* tasksReady;     //WAIT (worker) : "I wait for a task"
+                                 //SIGNAL (submit) : "A new task is ready"
+static SDL_cond* groupsDone;     //WAIT (waiter) : "I wait the end of my group"
+                                 //SIGNAL (worker) : "A group is done"
+static int pendingTasks;         //the tasks in the deques
+static int workersQuitFlag;
+static int runtimeUsers = 0;
+static int nextDeque;            //the deque of the next task submitted
+                                 //by a thread that is not a worker
+
+/* the config */
+static int wantedWorkers = 0;
+static int wantedCpus[WV_TASK_RUNTIME_MAX_WORKERS];
+static int pinWorkersFlag = 0;
+
+
+/* check that a worker can be pinned on the cpu */
+//-1 let the worker unpinned
+static int isValidCpu(int cpu)
+{
+  if(cpu == -1)
+    return 1;
+
+  if(cpu < 0)
+    return 0;
+
+#if HAVE_WINDOWS_H
+  if(cpu >= (int)(sizeof(DWORD_PTR) * 8))  //the affinity mask bits
+    return 0;
+#elif HAVE_PTHREAD_SETAFFINITY_NP
+  if(cpu >= CPU_SETSIZE)
+    return 0;
+#endif
+
+#if SDL_VERSION_ATLEAST(2,0,0)
+  if(cpu >= SDL_GetCPUCount())
+    return 0;
+#endif
+
+  return 1;
+}
+
+
+int WV_setTaskRuntimeWorkers(int nbWantedWorkers, const int* cpus)
+{
+  int i;
+
+  if(nbWantedWorkers < 0 || nbWantedWorkers > WV_TASK_RUNTIME_MAX_WORKERS)
+    return -1;
+
+  /* check the cpus before changing anything */
+  if(cpus){
+    for(i=0; i<nbWantedWorkers; i++)
+      if(!isValidCpu(cpus[i]))
+	return -1;
+  }
+
+  /* can't change the running workers */
+  if(runtimeMutex){
+    SDL_mutexP(runtimeMutex);
+    int runningFlag = (runtimeUsers > 0);
+    SDL_mutexV(runtimeMutex);
+
+    if(runningFlag)
+      return -1;
+  }
+
+  wantedWorkers = nbWantedWorkers;
+
+  /* the cpus need the number of workers */
+  pinWorkersFlag = 0;
+  if(cpus && nbWantedWorkers > 0){
+    for(i=0; i<nbWantedWorkers; i++)
+      wantedCpus[i] = cpus[i];
+    pinWorkersFlag = 1;
+  }
+
+  return 0;
+}
+
+
+int WV_getTaskRuntimeWorkers(void)
+{
+  if(!runtimeMutex)
+    return 0;
+
+  SDL_mutexP(runtimeMutex);
+  int count = nbWorkers;
+  SDL_mutexV(runtimeMutex);
+
+  return count;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*          THE DEQUES            */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* the task at pos from the head */
+static Task* getDequeTask(TaskDeque* deque, int priority, int pos)
+{
+  return &deque->tasks[priority][(deque->head[priority] + pos) % WV_TASK_RUNTIME_QUEUE_SIZE];
+}
+
+
+/* put a task at the tail */
+/* return -1 if the deque is full */
+static int pushTask(TaskDeque* deque, int priority, Task* task)
+{
+  SDL_mutexP(deque->mutex);
+
+  if(deque->nbTasks[priority] >= WV_TASK_RUNTIME_QUEUE_SIZE){
+    SDL_mutexV(deque->mutex);
+    return -1;
+  }
+
+  *getDequeTask(deque, priority, deque->nbTasks[priority]) = *task;
+  deque->nbTasks[priority]++;
+
+  SDL_mutexV(deque->mutex);
+
+  return 0;
+}
+
+
+/* remove the task at pos */
+/* the order of the others is kept */
+static void removeTask(TaskDeque* deque, int priority, int pos, Task* task)
+{
+  int i;
+
+  *task = *getDequeTask(deque, priority, pos);
+
+  if(pos == 0){
+    deque->head[priority]++;
+    if(deque->head[priority] >= WV_TASK_RUNTIME_QUEUE_SIZE)
+      deque->head[priority] = 0;
+  }
+  else{
+    for(i=pos; i<deque->nbTasks[priority]-1; i++)
+      *getDequeTask(deque, priority, i) = *getDequeTask(deque, priority, i+1);
+  }
+
+  deque->nbTasks[priority]--;
+}
+
+
+/* take a task of the group, any task if group is NULL */
+//the owner take the newest tasks from the tail, they are hot in its cache
+//the thieves take the oldest tasks from the head
+static int takeDequeTask(TaskDeque* deque, int priority, int ownerFlag, TaskGroup* group, Task* task)
+{
+  int i, pos;
+  int takenFlag = 0;
+
+  SDL_mutexP(deque->mutex);
+
+  int nbTasks = deque->nbTasks[priority];
+  for(i=0; i<nbTasks; i++){
+    if(ownerFlag)
+      pos = nbTasks - 1 - i;
+    else
+      pos = i;
+
+    if(!group || getDequeTask(deque, priority, pos)->group == group){
+      removeTask(deque, priority, pos, task);
+      takenFlag = 1;
+      break;
+    }
+  }
+
+  SDL_mutexV(deque->mutex);
+
+  return takenFlag;
+}
+
+
+/* take the task with the highest priority */
+/* first in our deque, next in the others */
+//workerIdx is -1 if the thread is not a worker
+static int takeTask(int workerIdx, TaskGroup* group, Task* task)
+{
+  int p, i, dequeIdx;
+  int firstIdx = workerIdx + 1;     //steal from the next workers first
+
+  for(p=0; p<WV_TASK_PRIORITIES; p++){
+
+    /* our deque */
+    if(workerIdx >= 0 && takeDequeTask(&workers[workerIdx].deque, p, 1, group, task))
+      break;
+
+    /* steal */
+    for(i=0; i<nbWorkers; i++){
+      dequeIdx = (firstIdx + i) % nbWorkers;
+      if(dequeIdx == workerIdx)
+	continue;
+      if(takeDequeTask(&workers[dequeIdx].deque, p, 0, group, task))
+	break;
+    }
+    if(i < nbWorkers)
+      break;
+  }
+
+  /* nothing found */
+  if(p == WV_TASK_PRIORITIES)
+    return 0;
+
+  SDL_mutexP(runtimeMutex);
+  pendingTasks--;
+  SDL_mutexV(runtimeMutex);
+
+  return 1;
+}
+
+
+/* run a task and signal the group end */
+static void runTask(Task* task)
+{
+  task->call(task->param);
+
+  SDL_mutexP(runtimeMutex);
+  task->group->remainingTasks--;
+  if(task->group->remainingTasks == 0)
+    SDL_CondBroadcast(groupsDone);
+  SDL_mutexV(runtimeMutex);
+}
+
+
+/* give the worker running the calling thread */
+/* -1 if the thread is not a worker */
+//need the runtime mutex
+static int getWorkerIdx(void)
+{
+  int i;
+  unsigned long threadID = SDL_ThreadID();
+
+  for(i=0; i<nbWorkers; i++){
+    if(workers[i].threadID == threadID)
+      return i;
+  }
+
+  return -1;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*          THE WORKERS           */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* pin the calling thread on a cpu */
+static void pinWorker(int cpu)
+{
+#if HAVE_WINDOWS_H
+  SetThreadAffinityMask(GetCurrentThread(), ((DWORD_PTR)1) << cpu);
+#elif HAVE_PTHREAD_SETAFFINITY_NP
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(cpu, &cpuSet);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+#endif
+  //else the workers can't be pinned
+}
+
+
+static int taskWorkerThread(void* opaque)
+{
+  TaskWorker* worker = (TaskWorker*)opaque;
+  int workerIdx = worker - workers;
+  int quitFlag;
+  Task task;
+
+  if(worker->cpu >= 0)
+    pinWorker(worker->cpu);
+
+  SDL_mutexP(runtimeMutex);
+  worker->threadID = SDL_ThreadID();
+  SDL_mutexV(runtimeMutex);
+
+  while(1){
+
+    /* run all the tasks we find */
+    if(takeTask(workerIdx, NULL, &task)){
+      runTask(&task);
+      continue;
+    }
+
+    /* wait a task */
+    //the pending tasks are finished before quitting
+    SDL_mutexP(runtimeMutex);
+    while(!workersQuitFlag && pendingTasks == 0)
+      SDL_CondWait(tasksReady, runtimeMutex);
+    quitFlag = (workersQuitFlag && pendingTasks == 0);
+    SDL_mutexV(runtimeMutex);
+
+    if(quitFlag)
+      break;
+  }
+
+  return 0;
+}
+
+
+int WV_initTaskRuntime(void)
+{
+  int i, p;
+
+  if(!runtimeMutex){
+    runtimeMutex = SDL_CreateMutex();
+    tasksReady = SDL_CreateCond();
+    groupsDone = SDL_CreateCond();
+  }
+
+  /* already launched by another user */
+  SDL_mutexP(runtimeMutex);
+  runtimeUsers++;
+  if(runtimeUsers > 1){
+    SDL_mutexV(runtimeMutex);
+    return 0;
+  }
+
+  /********************/
+  /* set the workers  */
+  /********************/
+  int count = wantedWorkers;
+  if(count == 0){
+    #if SDL_VERSION_ATLEAST(2,0,0)
+    count = SDL_GetCPUCount();
+    #else
+    count = WV_TASK_RUNTIME_WORKERS;
+    #endif
+  }
+  if(count < 1)
+    count = 1;
+  if(count > WV_TASK_RUNTIME_MAX_WORKERS)
+    count = WV_TASK_RUNTIME_MAX_WORKERS;
+
+  for(i=0; i<count; i++){
+    TaskWorker* worker = &workers[i];
+
+    worker->deque.mutex = SDL_CreateMutex();
+    for(p=0; p<WV_TASK_PRIORITIES; p++){
+      worker->deque.head[p] = 0;
+      worker->deque.nbTasks[p] = 0;
+    }
+
+    worker->threadID = 0;
+    if(pinWorkersFlag)
+      worker->cpu = wantedCpus[i];
+    else
+      worker->cpu = -1;
+  }
+
+  nbWorkers = count;
+  pendingTasks = 0;
+  workersQuitFlag = 0;
+  nextDeque = 0;
+
+  SDL_mutexV(runtimeMutex);
+
+  /*************************/
+  /* launch the workers    */
+  /*************************/
+  for(i=0; i<count; i++){
+    #if SDL_VERSION_ATLEAST(2,0,0)
+    workers[i].thread = SDL_CreateThread(taskWorkerThread, "taskWorker", &workers[i]);
+    #else
+    workers[i].thread = SDL_CreateThread(taskWorkerThread, &workers[i]);
+    #endif
+  }
+
+  return 0;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*          THE GROUPS            */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+WVTaskGroupHandle WV_getTaskGroup(void)
+{
+  TaskGroup* newGroup = (TaskGroup*)malloc(sizeof(TaskGroup));
+  if(!newGroup)
+    return NULL;
+
+  newGroup->remainingTasks = 0;
+
+  return (WVTaskGroupHandle)newGroup;
+}
+
+
+void WV_freeTaskGroup(WVTaskGroupHandle groupHdl)
+{
+  free(groupHdl);
+}
+
+
+void WV_submitTask(WVTaskGroupHandle groupHdl, int priority, WVTaskCall call, void* param)
+{
+  TaskGroup* group = (TaskGroup*)groupHdl;
+  Task task;
+
+  /* no workers, call it now */
+  if(!runtimeMutex){
+    call(param);
+    return;
+  }
+
+  SDL_mutexP(runtimeMutex);
+
+  if(nbWorkers == 0){
+    SDL_mutexV(runtimeMutex);
+    call(param);
+    return;
+  }
+
+  /* the workers put the tasks in their deque */
+  /* the other threads share them between the workers */
+  int dequeIdx = getWorkerIdx();
+  if(dequeIdx < 0){
+    dequeIdx = nextDeque;
+    nextDeque++;
+    if(nextDeque >= nbWorkers)
+      nextDeque = 0;
+  }
+
+  group->remainingTasks++;
+
+  SDL_mutexV(runtimeMutex);
+
+  /* push it */
+  task.call = call;
+  task.param = param;
+  task.group = group;
+
+  if(pushTask(&workers[dequeIdx].deque, priority, &task) < 0){
+    runTask(&task);    //the deque is full
+    return;
+  }
+
+  /* signal the workers */
+  SDL_mutexP(runtimeMutex);
+  pendingTasks++;
+  SDL_mutexV(runtimeMutex);
+  SDL_CondSignal(tasksReady);
+}
+
+
+void WV_waitTaskGroup(WVTaskGroupHandle groupHdl)
+{
+  TaskGroup* group = (TaskGroup*)groupHdl;
+  Task task;
+
+  if(!runtimeMutex)
+    return;
+
+  SDL_mutexP(runtimeMutex);
+  int workerIdx = getWorkerIdx();
+  SDL_mutexV(runtimeMutex);
+
+  while(1){
+
+    /* check the end */
+    SDL_mutexP(runtimeMutex);
+    int doneFlag = (group->remainingTasks == 0);
+    SDL_mutexV(runtimeMutex);
+
+    if(doneFlag)
+      break;
+
+    /* run the pending tasks of the group */
+    //the other tasks may be long, and a worker waiting
+    //its group can't block the others
+    if(takeTask(workerIdx, group, &task)){
+      runTask(&task);
+      continue;
+    }
+
+    /* the remaining tasks are running, wait them */
+    SDL_mutexP(runtimeMutex);
+    if(group->remainingTasks > 0)
+      SDL_CondWait(groupsDone, runtimeMutex);
+    SDL_mutexV(runtimeMutex);
+  }
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*           SHUTDOWN             */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+int WV_taskRuntimeShutdown(void)
+{
+  int i;
+
+  if(!runtimeMutex)
+    return -1;
+
+  /* the last user stop the workers */
+  SDL_mutexP(runtimeMutex);
+  if(runtimeUsers == 0){
+    SDL_mutexV(runtimeMutex);
+    return -1;
+  }
+
+  runtimeUsers--;
+  if(runtimeUsers > 0){
+    SDL_mutexV(runtimeMutex);
+    return 0;
+  }
+
+  workersQuitFlag = 1;
+  SDL_mutexV(runtimeMutex);
+  SDL_CondBroadcast(tasksReady);
+
+  /* wait the workers */
+  for(i=0; i<nbWorkers; i++)
+    SDL_WaitThread(workers[i].thread, NULL);
+
+  /* the next tasks are called directly */
+  SDL_mutexP(runtimeMutex);
+  int count = nbWorkers;
+  nbWorkers = 0;
+  SDL_mutexV(runtimeMutex);
+
+  for(i=0; i<count; i++)
+    SDL_DestroyMutex(workers[i].deque.mutex);
+
+  return 0;
+}
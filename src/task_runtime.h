@@ -0,0 +1,120 @@
+#ifndef TASK_RUNTIME_H
+#define TASK_RUNTIME_H
+
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "common.h"
+#include "config_sdl.h"
+
+#include "waave_engine_flags.h"
+
+
+/*********************************************/
+/* the task runtime run the short jobs of    */
+/* the decoders and the slice scaler on a    */
+/* pool of workers shared by all the engines */
+/*                                           */
+/* each worker has its own task deque, it    */
+/* take its tasks from the tail and steal    */
+/* the tasks of the others from the head     */
+/* the tasks are taken by priority first     */
+/*********************************************/
+
+/* the task priorities */
+#define WV_TASK_PRIORITY_AUDIO 0        //the highest
+#define WV_TASK_PRIORITY_VIDEO 1
+#define WV_TASK_PRIORITY_BACKGROUND 2
+#define WV_TASK_PRIORITIES 3
+
+/* a task call */
+typedef void (*WVTaskCall)(void* param);
+
+/* abstract pointer for the user */
+typedef void* WVTaskGroupHandle;
+
+
+/*****************************************/
+/* CONFIG                                */
+/* set the number of workers and the cpu */
+/* of each worker, -1 or NULL for no     */
+/* pinning                               */
+/* !!! used at the next runtime start !!!*/
+/*****************************************/
+
+/* 0 workers use the default number of workers */
+/* return -1 if the runtime is running or nbWorkers is too big */
+int WV_setTaskRuntimeWorkers(int nbWorkers, const int* cpus);
+
+/* the number of running workers, 0 if the runtime is stopped */
+int WV_getTaskRuntimeWorkers(void);
+
+
+/********************************/
+/* INIT                         */
+/* launch the workers, the      */
+/* runtime is started by the    */
+/* first user and stopped by    */
+/* the last                     */
+/********************************/
+int WV_initTaskRuntime(void);
+
+
+/******************************/
+/* GET / FREE                 */
+/* the tasks are submitted in */
+/* groups to wait them        */
+/******************************/
+WVTaskGroupHandle WV_getTaskGroup(void);
+
+void WV_freeTaskGroup(WVTaskGroupHandle groupHdl);
+
+
+/****************************************/
+/* SUBMIT                               */
+/* if the runtime is not running or the */
+/* deque is full the task is called     */
+/* immediately by the calling thread    */
+/****************************************/
+void WV_submitTask(WVTaskGroupHandle groupHdl, int priority, WVTaskCall call, void* param);
+
+
+/********************************************/
+/* WAIT                                     */
+/* wait all the tasks of the group, the     */
+/* calling thread run the pending tasks of  */
+/* the group itself                         */
+/* !!! only the submitting thread can wait  */
+/* the group !!!                            */
+/********************************************/
+void WV_waitTaskGroup(WVTaskGroupHandle groupHdl);
+
+
+/**********/
+/* CLOSE  */
+/**********/
+int WV_taskRuntimeShutdown(void);
+
+
+#endif
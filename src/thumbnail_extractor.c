@@ -0,0 +1,390 @@
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "thumbnail_extractor.h"
+
+#include "common.h"
+#include "config_sdl.h"
+#include "config_ffmpeg.h"
+
+#include "waave_engine_flags.h"
+#include "waave_ffmpeg.h"
+#include "streaming_object.h"
+#include "video_decoder.h"
+
+
+/*****************************/
+/* a job is a list of        */
+/* thumbnails from one file  */
+/*****************************/
+typedef struct ThumbnailJob{
+
+  WVThumbnail* thumbnails;
+  int nbThumbnails;
+  int extracted;         //the number of extracted thumbnails
+
+}ThumbnailJob;
+
+
+/* the jobs of a batch */
+/* shared by the workers */
+typedef struct ThumbnailBatch{
+
+  ThumbnailJob* jobs;
+  int nbJobs;
+  int nextJob;           //the next job to process, protected by mutex
+  SDL_mutex* mutex;
+
+}ThumbnailBatch;
+
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*         KEYFRAME DECODE        */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* decode the keyframe before the thumbnail time */
+/* and convert it in the thumbnail buffer */
+static int extractKeyframe(AVFormatContext* formatCtx, int streamIdx,	\
+			   AVFrame* frame, struct SwsContext** swsCtx,	\
+			   WVThumbnail* thumbnail)
+{
+  AVStream* stream = formatCtx->streams[streamIdx];
+  AVCodecContext* codecCtx = stream->codec;
+  AVRational msTimeBase = {1, 1000};
+  
+  /****************************/
+  /* seek to the keyframe     */
+  /* with the demuxer index   */
+  /****************************/
+  int64_t target = av_rescale_q(thumbnail->time, msTimeBase, stream->time_base);
+  if(stream->start_time != AV_NOPTS_VALUE)
+    target += stream->start_time;
+
+  if(av_seek_frame(formatCtx, streamIdx, target, AVSEEK_FLAG_BACKWARD) < 0)
+    return -1;
+
+  avcodec_flush_buffers(codecCtx);
+
+  
+  /**************************/
+  /* decode the first       */
+  /* keyframe               */
+  /**************************/
+  AVPacket pkt;
+  int got_picture = 0;
+  int nbPackets = 0;
+  
+  while(!got_picture && nbPackets < WV_THUMBNAIL_MAX_PACKETS){
+    if(av_read_frame(formatCtx, &pkt) < 0)
+      break;
+    nbPackets++;
+    
+    //the demuxer may not discard the other packets
+    if(pkt.stream_index == streamIdx && (pkt.flags & AV_PKT_FLAG_KEY))
+      WV_decodeVideo(codecCtx, frame, &got_picture, &pkt);
+
+    av_free_packet(&pkt);
+  }
+
+  /* the codec may delay the frames */
+  if(!got_picture){
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+    WV_decodeVideo(codecCtx, frame, &got_picture, &pkt);
+  }
+
+  if(!got_picture)
+    return -1;
+
+  
+  /************************/
+  /* the keyframe time    */
+  /************************/
+  int64_t pts = WV_getFramePts(frame);
+
+  if(pts != AV_NOPTS_VALUE){
+    if(stream->start_time != AV_NOPTS_VALUE)
+      pts -= stream->start_time;
+    if(pts < 0)
+      pts = 0;
+    thumbnail->keyframeTime = (uint32_t)av_rescale_q(pts, stream->time_base, msTimeBase);
+  }
+  else{
+    thumbnail->keyframeTime = thumbnail->time;
+  }
+
+  
+  /*****************************/
+  /* convert in the caller     */
+  /* buffer                    */
+  /*****************************/
+  WVStreamingBuffer* buffer = &thumbnail->buffer;
+
+  *swsCtx = sws_getCachedContext(*swsCtx,				\
+				 codecCtx->width, codecCtx->height, codecCtx->pix_fmt, \
+				 buffer->width, buffer->height, buffer->format, \
+				 WV_VIDEO_DECODER_SCALE_FILTER, NULL, NULL, NULL);
+  if(!*swsCtx)
+    return -1;
+
+  sws_scale(*swsCtx,							\
+	    (const uint8_t* const*)frame->data, frame->linesize,	\
+	    0, codecCtx->height,					\
+	    buffer->data, buffer->linesize);
+
+  return 0;
+}
+
+
+/* open the file and extract */
+/* all the thumbnails of the job */
+static void extractJob(ThumbnailJob* job)
+{
+  int i;
+  
+  job->extracted = 0;
+  for(i=0; i<job->nbThumbnails; i++)
+    job->thumbnails[i].status = -1;
+
+  /***************/
+  /* open file   */
+  /***************/
+  AVFormatContext* formatCtx = NULL;
+  
+  if(avformat_open_input(&formatCtx, job->thumbnails[0].filename, 0, NULL) < 0)
+    return;
+
+  if(avformat_find_stream_info(formatCtx, NULL) < 0){
+    avformat_close_input(&formatCtx);
+    return;
+  }
+
+  int streamIdx = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+  if(streamIdx < 0){
+    avformat_close_input(&formatCtx);
+    return;
+  }
+
+  /* demux only the video keyframes */
+  for(i=0; i<formatCtx->nb_streams; i++)
+    formatCtx->streams[i]->discard = AVDISCARD_ALL;
+  formatCtx->streams[streamIdx]->discard = AVDISCARD_NONKEY;
+
+  
+  /******************/
+  /* open codec     */
+  /******************/
+  AVCodecContext* codecCtx = formatCtx->streams[streamIdx]->codec;
+  AVCodec* codec = avcodec_find_decoder(codecCtx->codec_id);
+  if(!codec){
+    avformat_close_input(&formatCtx);
+    return;
+  }
+
+  /* decode only the keyframes */
+  /* at the smallest size at or above the biggest thumbnail */
+  int maxWidth = 0;
+  int maxHeight = 0;
+  for(i=0; i<job->nbThumbnails; i++){
+    if(job->thumbnails[i].buffer.width > maxWidth)
+      maxWidth = job->thumbnails[i].buffer.width;
+    if(job->thumbnails[i].buffer.height > maxHeight)
+      maxHeight = job->thumbnails[i].buffer.height;
+  }
+  
+  codecCtx->skip_frame = AVDISCARD_NONKEY;
+  codecCtx->lowres = WV_getVideoLowres(codecCtx, codec, NULL, maxWidth, maxHeight);
+  
+  if(avcodec_open2(codecCtx, codec, NULL) < 0){
+    avformat_close_input(&formatCtx);
+    return;
+  }
+
+  
+  /*************/
+  /* extract   */
+  /*************/
+  AVFrame* frame = avcodec_alloc_frame();
+  struct SwsContext* swsCtx = NULL;
+  
+  for(i=0; i<job->nbThumbnails; i++){
+    if(extractKeyframe(formatCtx, streamIdx, frame, &swsCtx, &job->thumbnails[i]) >= 0){
+      job->thumbnails[i].status = 0;
+      job->extracted++;
+    }
+  }
+
+  
+  /**********/
+  /* close  */
+  /**********/
+  if(swsCtx)
+    sws_freeContext(swsCtx);
+  av_free(frame);
+  avcodec_close(codecCtx);
+  avformat_close_input(&formatCtx);
+}
+
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*           THE WORKERS          */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* process the jobs while the batch have ones */
+static int thumbnailWorkerThread(void* opaque)
+{
+  ThumbnailBatch* batch = (ThumbnailBatch*)opaque;
+  int jobIdx;
+
+  while(1){
+    /* take a job */
+    SDL_mutexP(batch->mutex);
+    jobIdx = batch->nextJob;
+    if(jobIdx < batch->nbJobs)
+      batch->nextJob++;
+    SDL_mutexV(batch->mutex);
+
+    if(jobIdx >= batch->nbJobs)
+      break;
+
+    /* process it */
+    extractJob(&batch->jobs[jobIdx]);
+  }
+
+  return 0;
+}
+
+
+/* check the request buffer */
+static int checkThumbnail(WVThumbnail* thumbnail)
+{
+  if(!thumbnail->filename)
+    return -1;
+
+  if(thumbnail->buffer.width <= 0 || thumbnail->buffer.height <= 0 || !thumbnail->buffer.data[0])
+    return -1;
+
+  return 0;
+}
+
+
+int WV_extractThumbnails(WVThumbnail* thumbnails, int nbThumbnails)
+{
+  int i;
+
+  if(!thumbnails || nbThumbnails <= 0)
+    return -1;
+  
+  /********************************/
+  /* one job per consecutive      */
+  /* requests on the same file    */
+  /********************************/
+  ThumbnailBatch batch;
+  WVThumbnail* previous = NULL;  //the previous request of the current job
+
+  batch.jobs = (ThumbnailJob*)malloc(nbThumbnails * sizeof(ThumbnailJob));
+  if(!batch.jobs){
+    for(i=0; i<nbThumbnails; i++)
+      thumbnails[i].status = -1;
+    return -1;
+  }
+  batch.nbJobs = 0;
+  batch.nextJob = 0;
+  
+  for(i=0; i<nbThumbnails; i++){
+    /* the invalid requests break the jobs */
+    if(checkThumbnail(&thumbnails[i]) < 0){
+      thumbnails[i].status = -1;
+      previous = NULL;
+      continue;
+    }
+    
+    /* same file as the previous request */
+    if(previous && !SDL_strcmp(previous->filename, thumbnails[i].filename)){
+      batch.jobs[batch.nbJobs-1].nbThumbnails++;
+    }
+    else{
+      batch.jobs[batch.nbJobs].thumbnails = &thumbnails[i];
+      batch.jobs[batch.nbJobs].nbThumbnails = 1;
+      batch.jobs[batch.nbJobs].extracted = 0;
+      batch.nbJobs++;
+    }
+    previous = &thumbnails[i];
+  }
+
+
+  /*******************************/
+  /* the caller work with the    */
+  /* others workers              */
+  /*******************************/
+  int nbWorkers = 1;
+
+  //else the codecs can't be opened in parallel
+  if(WV_isFFmpegLocked())
+    nbWorkers = (batch.nbJobs < WV_THUMBNAIL_WORKERS)? batch.nbJobs : WV_THUMBNAIL_WORKERS;
+
+  SDL_Thread* workers[WV_THUMBNAIL_WORKERS];
+  int nbThreads = 0;
+  
+  batch.mutex = SDL_CreateMutex();
+  
+  for(i=1; i<nbWorkers; i++){
+    #if SDL_VERSION_ATLEAST(2,0,0)
+    workers[nbThreads] = SDL_CreateThread(thumbnailWorkerThread, "thumbnailWorker", &batch);
+    #else
+    workers[nbThreads] = SDL_CreateThread(thumbnailWorkerThread, &batch);
+    #endif
+
+    //if we can't create the thread, the others do its jobs
+    if(workers[nbThreads])
+      nbThreads++;
+  }
+
+  thumbnailWorkerThread(&batch);
+
+  for(i=0; i<nbThreads; i++)
+    SDL_WaitThread(workers[i], NULL);
+
+  
+  /**************/
+  /* the result */
+  /**************/
+  int extracted = 0;
+  for(i=0; i<batch.nbJobs; i++)
+    extracted += batch.jobs[i].extracted;
+
+  SDL_DestroyMutex(batch.mutex);
+  free(batch.jobs);
+
+  return extracted;
+}
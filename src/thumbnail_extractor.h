@@ -0,0 +1,68 @@
+#ifndef THUMBNAIL_EXTRACTOR_H
+#define THUMBNAIL_EXTRACTOR_H
+
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "common.h"
+#include "config_sdl.h"
+#include "config_ffmpeg.h"
+
+#include "waave_engine_flags.h"
+#include "streaming_object.h"
+
+
+/*****************************************/
+/* the thumbnail extractor decode only   */
+/* the keyframes of the files, directly  */
+/* in the caller buffers                 */
+/*****************************************/
+
+/* a thumbnail request */
+typedef struct WVThumbnail{
+  
+  /* request */
+  const char* filename;
+  uint32_t time;              //the wanted position (ms)
+  WVStreamingBuffer buffer;   //the caller buffer, give the size and the format
+
+  /* result */
+  uint32_t keyframeTime;      //the position of the extracted keyframe (ms)
+  int status;                 //0 if extracted, -1 otherwise
+
+}WVThumbnail;
+
+
+/*************************************************/
+/* EXTRACT                                       */
+/* the consecutive requests on the same file     */
+/* share the same demuxer, the files are         */
+/* processed in parallel                         */
+/* return the number of extracted thumbnails     */
+/* or -1 on error                                */
+/*************************************************/
+int WV_extractThumbnails(WVThumbnail* thumbnails, int nbThumbnails);
+
+
+#endif
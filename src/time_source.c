@@ -0,0 +1,128 @@
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "time_source.h"
+
+#include "common.h"
+#include "config_sdl.h"
+
+#include "waave_engine_flags.h"
+#include "refresh_scheduler.h"
+
+
+static int timeSource = WV_REAL_TIME;
+
+/* the virtual time */
+//the mutex keep the 64 bits reads atomic
+static SDL_mutex* virtualTimeMutex = NULL;
+static uint64_t virtualTime = 0;
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*         THE CONFIG             */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+int WV_setTimeSource(int sourceFlag)
+{
+  if(sourceFlag != WV_REAL_TIME && sourceFlag != WV_VIRTUAL_TIME)
+    return -1;
+
+  /* the virtual time restart at each switch */
+  if(sourceFlag == WV_VIRTUAL_TIME){
+    if(!virtualTimeMutex)
+      virtualTimeMutex = SDL_CreateMutex();
+    virtualTime = 0;
+  }
+  else{
+    if(virtualTimeMutex){
+      SDL_DestroyMutex(virtualTimeMutex);
+      virtualTimeMutex = NULL;
+    }
+  }
+
+  timeSource = sourceFlag;
+
+  return 0;
+}
+
+
+int WV_getTimeSource(void)
+{
+  return timeSource;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*        THE ENGINE TIME         */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+static uint64_t getVirtualTime(void)
+{
+  uint64_t currentTime;
+  
+  SDL_mutexP(virtualTimeMutex);
+  currentTime = virtualTime;
+  SDL_mutexV(virtualTimeMutex);
+
+  return currentTime;
+}
+
+
+uint64_t WV_getEngineTime(void)
+{
+  if(timeSource == WV_VIRTUAL_TIME)
+    return getVirtualTime();
+
+  return WV_getMicroTime();
+}
+
+
+uint32_t WV_getEngineTicks(void)
+{
+  if(timeSource == WV_VIRTUAL_TIME)
+    return (uint32_t)(getVirtualTime() / 1000);
+
+  //keep the SDL time base for the real time
+  return SDL_GetTicks();
+}
+
+
+int WV_addVirtualTime(uint32_t delay)
+{
+  if(timeSource != WV_VIRTUAL_TIME)
+    return -1;
+
+  SDL_mutexP(virtualTimeMutex);
+  virtualTime += delay;
+  SDL_mutexV(virtualTimeMutex);
+
+  return 0;
+}
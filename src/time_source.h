@@ -0,0 +1,85 @@
+#ifndef TIME_SOURCE_H
+#define TIME_SOURCE_H
+
+/*
+ *  waave, a modular audio/video engine
+ * 
+ *  Copyright (C) 2012  Baptiste Pellegrin
+ * 
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "common.h"
+#include "config_sdl.h"
+
+#include "waave_engine_flags.h"
+
+
+/*********************************************/
+/* the time source give the engine time used */
+/* by the sync objects, the mixer and the    */
+/* refresh scheduling                        */
+/*                                           */
+/* the real time follow the system clock,    */
+/* the virtual time only move when the user  */
+/* advance it, so the runs are reproducible  */
+/* and can go faster than real time          */
+/*                                           */
+/* !!! the latency and conversion times are  */
+/* still measured with WV_getMicroTime !!!   */
+/*********************************************/
+
+#define WV_REAL_TIME 0
+#define WV_VIRTUAL_TIME 1
+
+
+/*****************************************/
+/* CONFIG                                */
+/* !!! only when the engines are stopped */
+/*****************************************/
+
+/* return -1 if the flag is not valid */
+int WV_setTimeSource(int sourceFlag);
+
+int WV_getTimeSource(void);
+
+
+/*******************/
+/* the engine time */
+/*******************/
+
+/* in microseconds */
+uint64_t WV_getEngineTime(void);
+
+/* in milliseconds, wrap like SDL_GetTicks */
+uint32_t WV_getEngineTicks(void);
+
+
+/******************************/
+/* ADVANCE                    */
+/* move the virtual time by   */
+/* delay microseconds         */
+/******************************/
+
+/* return -1 if the time is not virtual */
+int WV_addVirtualTime(uint32_t delay);
+
+
+#endif
@@ -35,6 +35,12 @@
 #include "sync_object.h"
 #include "eof_signal.h"
 #include "streaming_object.h"
+#include "refresh_scheduler.h"
+#include "slice_scaler.h"
+#include "stream_fanout.h"
+#include "stream_loader.h"
+#include "task_runtime.h"
+#include "time_source.h"
 
 
 /**************************/
@@ -53,10 +59,53 @@
 #define SLOT_FLAG_NONE 0
 #define SLOT_FLAG_ALLOC 1
 #define SLOT_FLAG_SKIP 2
+#define SLOT_FLAG_NATIVE 4   //the slot wait for the conversion of its native frame
+
+
+/* catch-up level */
+/* say how the codec discard frames when the video is late */
+#define CATCH_UP_NONE 0        //full quality
+#define CATCH_UP_NONREF 1      //skip the non reference frames
+#define CATCH_UP_NONKEY 2      //decode only the key frames
+#define CATCH_UP_NOFILTER 3    //key frames without loop filter
+#define CATCH_UP_MAX_LEVEL CATCH_UP_NOFILTER
+
+
+/* trick play mode */
+/* say how the frames are selected when the rate is not 1 */
+#define TRICK_NONE 0           //normal play, follow the sync object
+#define TRICK_DROP 1           //decode all, drop the late frames
+#define TRICK_KEYFRAME 2       //decode only the keyframes, step forward when late
+#define TRICK_REWIND 3         //decode only the keyframes, step backward
+
+
+/* frame cache state */
+/* say where the frames of a looping stream come from */
+#define FRAME_CACHE_NONE 0     //no cache, or the cache was dropped
+#define FRAME_CACHE_WAIT 1     //record from the next loop start
+#define FRAME_CACHE_RECORD 2   //keep the converted frames of the loop
+#define FRAME_CACHE_READY 3    //the loop is cached, replay it at the next eof
+#define FRAME_CACHE_REPLAY 4   //the frames are copied from the cache
+#define FRAME_CACHE_SKIP 5     //a next source is set, skip the pkts until the eof
+#define FRAME_CACHE_RESYNC 6   //the cached loop ended before the queue, skip the pkts until the eof
+
+
+/* a converted frame kept for the next loops */
+typedef struct CachedFrame{
+  AVPicture picture;
+  int width;
+  int height;
+  enum PixelFormat format;
+  int64_t pts;
+  struct CachedFrame* nextFrame;
+}CachedFrame;
 
 
 typedef struct VideoBitStream{
 
+  /* the decoder thread of the stream */
+  struct VideoDecoder* decoder;
+
   /* stream params */
   WVQueueHandle queueHdl;               //where we need getting packets 
   AVCodecContext* codec;                //the ffmpef codec needed to decode packets
@@ -70,15 +119,49 @@ typedef struct VideoBitStream{
   int LRInRefreshFlag;     //if lock need to be done by the main thread
   int getInDecodeFlag;     //decode thread (case thread safe)
   int LRInDecodeFlag;
-
+  int releaseUnlockedFlag; //the fan-out release convert for its outputs
+                           //it is not serialized with the other objects
  
   /* the frame that receive the decoded frame */
   AVFrame* decodedFrame;
 
-  /* the swscale context */
-  /* needed to load the frame buffers */
-  struct SwsContext* swsCtx;
+  /* the conversion method */
+  /* with lazy conversion the decoded frames are kept in the */
+  /* codec format and converted only before being refreshed */
+  int conversionMethod;       //WV_EARLY_CONVERSION or WV_LAZY_CONVERSION
+  WVNativeFrame* nativeFrames; //one per slot, only for lazy conversion or upload
+
+  /* the native upload */
+  /* the streaming object upload itself the native frames */
+  /* so the decoder doesn't convert them */
+  int uploadFlag;
+  int uploadableFlag;        //the object can take the entire frame, else it is converted
+                             //at refresh, changed with the src by the main thread
 
+  /* the slice scaler */
+  /* needed to load the frame buffers */
+  WVSliceScalerHandle sliceScaler;
+  uint32_t conversionTime;   //the conversion time of the last loaded frame (us)
+
+  /* the source region */
+  /* only the visible part of the frames is converted */
+  /* and the object get it at the output size */
+  SDL_Rect cropRect;         //the user crop in full size coords, w == 0 for none
+  int outputWidth;           //the user output size, 0 for the region size
+  int outputHeight;
+  SDL_Rect srcRect;          //the converted region in codec coords
+  int codecWidth;            //the codec params used to compute the region
+  int codecHeight;
+  enum PixelFormat codecFormat;
+
+  /* the src change */
+  //published by the decoder under the objectMutex, applied to the object
+  //by the thread that call get, so the main thread for the no thread safe objects
+  int srcChangeFlag;
+  int newSrcWidth;
+  int newSrcHeight;
+  enum PixelFormat newSrcFormat;
+  int newUploadableFlag;
 
   /* the frame buffer list */
   int refreshPos;            //the buffer we need to refresh
@@ -88,7 +171,6 @@ typedef struct VideoBitStream{
   int writeAccessFlag;       //when async refresh is set, this say if we can load the 
                              //frame before refreshPos
   int refreshStatus;         //give the refresh status, NO_REFRESH, REFRESH_LAUNCHED, REFRESH_DONE
-  SDL_TimerID lastTimer;
 
   WVStreamingBuffer* frameBuffer;     //the frame buffer list, one per slot
   uint32_t* slotFlag;         //set specials flags SLOT_FLAG_NONE, SLOT_FLAG_ALLOC, SLOT_FLAG_SKIP
@@ -110,38 +192,185 @@ typedef struct VideoBitStream{
   uint32_t startTimerT; //when the timer was launched, used to compute refresh duration 
   uint32_t timerDelay;  //the delay given to the timer
 
+  /* present method */
+  /* in pull mode the refresh are not pushed as events */
+  /* but wait that the user present them */
+  int presentMethod;         //WV_PUSH_PRESENT or WV_PULL_PRESENT
+  int pullPendingFlag;       //a refresh wait to be presented, protected by pullMutex
+  int pullCode;              //like event.user.code, say if is a special refresh
+  uint64_t pullDueTime;      //when the refresh need to be presented (us)
+
+  /* catch-up */
+  /* when the video fall behind the clock */
+  int catchUpLevel;          //CATCH_UP_NONE ... CATCH_UP_MAX_LEVEL
+  int lateCount;             //the number of consecutive late frames
+  int inTimeCount;           //the number of consecutive in time frames
+  int dropSequence;          //the number of consecutive dropped frames
+  uint32_t droppedFrames;    //the total number of dropped frames
+
+  /* trick play */
+  /* the video follow its own clock running at rate */
+  /* times the real time, the sync object is not used */
+  int trickMode;             //TRICK_NONE ... TRICK_REWIND
+  int trickRate;             //the playback rate, negative to rewind
+  uint64_t trickBaseTime;    //when the trick clock was set (us)
+  uint32_t trickBaseClock;   //the trick clock at trickBaseTime
+  uint32_t trickStepClock;   //rewind : the clock of the last kept keyframe
+  int trickStepFlag;         //a step is pending in the packet feeder
+  int trickEndFlag;          //rewind : the stream start is reached, stop decoding
+  WVPacketFeederHandle feederHdl; //needed to seek by steps
+  AVFormatContext* formatCtx;
+  int streamIdx;
+
   /* seek */
   int seekingDoneFlag;
+  uint32_t accurateSeekClock; //the seek target given by the user, UINT32_MAX for a keyframe seek
+  uint64_t seekStartTime;     //when the seek was asked (us)
+  int seekLatencyFlag;        //wait the first frame after the seek
+  uint32_t seekLatency;       //the time between the seek and its first frame (us)
+  uint64_t firstFrameTime;    //when the first frame of the stream was decoded (us), 0 before
+
+  /* accurate seek */
+  /* the frames before the target are decoded but not displayed */
+  uint32_t prerollClock;      //the seek target, UINT32_MAX when the preroll is done
+  int64_t frameDuration;      //the last pkt duration, to find the frame showing the target
   
   /* eof */
   int eofSignalPos;
   void* eofSignalHandle;
 
+  /* gapless eof */
+  /* the delayed frames are drained before threading the eof pkt */
+  AVPacket* eofPkt;          //the eof pkt held while draining, NULL otherwise
+  int drainGotFrame;         //the last drain pkt gave a frame
+  int drainDoneFlag;         //the codec is drained, the eof pkt can be threaded
+
+  /* next source */
+  /* at eof the stream continue with another queue and codec */
+  WVQueueHandle nextQueueHdl;     //NULL if there are no next source
+  AVCodecContext* nextCodec;
+  AVRational nextTimeBase;
+  AVFormatContext* nextFormatCtx;
+  int nextStreamIdx;
+  WVSpliceSignalCall spliceCall;  //called by the decoder when the source is switched
+  void* spliceParam;
+
+  /* frame cache */
+  /* the converted frames of one loop are kept */
+  /* and the next loops are copied from them */
+  int frameCacheFlag;        //WV_NO_FRAME_CACHE or WV_FRAME_CACHE
+  int frameCacheState;       //FRAME_CACHE_NONE ... FRAME_CACHE_RESYNC
+  CachedFrame* cacheFirst;
+  CachedFrame* cacheLast;
+  CachedFrame* cachePos;     //the next replayed frame, NULL at the loop end
+  int replayEofCount;        //the queue eofs dropped before the cache end
+  uint32_t cacheSize;        //the memory taken by the cached frames (bytes)
+
+  /* parallel decoding */
+  int decodeResult;          //the decodeVideo return of the decode task
+
  }VideoBitStream;
 
 
-/*********************/
-/* timer granularity */
-/*********************/
-static uint32_t timerGranularity = WV_TIMER_GRANULARITY; //TODO need to be dynamically determined  
+/*******************************/
+/* the decoder instance        */
+/* each engine has its own     */
+/* decoder thread and streams  */
+/*******************************/
+typedef struct VideoDecoder{
+
+  /* this the main mutex */
+  int stateUpdatedFlag;    
+  SDL_mutex* stateUpdatedMutex;
+  SDL_cond*  stateUpdated;   //WAIT (decoder):"I have nothing to do, wait for command, 
+                             //               open access for writing or refresh done"
+                             //SIGNAL (event or cli): "A commans was send" or "refresh done"
+
+  /* protect the pull refresh of all the streams */
+  SDL_mutex* pullMutex;
+
+  SDL_Thread* thread;
+
+  /* the video streams decoded simultaneoustly */ 
+  VideoBitStream* videoStreams[WV_VIDEO_DECODER_MAX_STREAMS];
+  int nbVideoStream;
+
+  /* the frame cache memory of the streams */
+  //protected by frameCacheMutex
+  uint32_t frameCacheSize;
+
+  /* the streams are decoded in parallel */
+  /* by the task runtime workers */
+  WVTaskGroupHandle decodeGroup;
+  SDL_mutex* objectMutex;      //the streaming object calls are serialized
+
+  /* the command, see below */
+  int decoderCommand;        //where the client put the command
+  SDL_mutex* clientMutex;    //the commands can be sent by several threads (API and loaders)
+                             //the params and the command are set under this lock
+
+  SDL_mutex* cmdMutex;
+  SDL_cond* cmdExecuted;     //the client need to wait for command execution 
+                             //before continuing
+                             //WAIT (client) : "I have sent you a command say me 
+                             //                 the work is done"
+                             //SIGNAL (decoder) : "Well, command terminated"
+
+  /* the command parameters */
+  int deleteStreamIdx;               //when we delete we give the stream idx to the decoder
+  WVVideoStreamHandle seekingStreamHandle;  //when we seek we give the stream to the decoder 
+
+  WVVideoStreamHandle trickStreamHandle;    //when we set the trick play rate
+  int trickRateParam;
+  uint32_t trickClockParam;
+  WVPacketFeederHandle trickFeederHdl;
+  AVFormatContext* trickFormatCtx;
+  int trickStreamIdx;
+
+  WVVideoStreamHandle nextSourceStreamHandle; //when we set the next source
+  WVQueueHandle nextSourceQueueHdl;
+  AVCodecContext* nextSourceCodec;
+  AVRational nextSourceTimeBase;
+  AVFormatContext* nextSourceFormatCtx;
+  int nextSourceStreamIdx;
+  WVSpliceSignalCall nextSourceSpliceCall;
+  void* nextSourceSpliceParam;
+
+}VideoDecoder;
+
+
+/*********************************/
+/* all the running decoders      */
+/* the clocks don't know their   */
+/* streams so they signal them   */
+/* all                           */
+/*********************************/
+static VideoDecoder* videoDecoders[WV_MAX_ENGINES];
+static int nbVideoDecoder = 0;
+static SDL_mutex* videoDecodersMutex = NULL;
+
+
+/* signal a decoder */
+static void signalVideoDecoder(VideoDecoder* decoder)
+{
+  SDL_mutexP(decoder->stateUpdatedMutex);
+  decoder->stateUpdatedFlag = 1;
+  SDL_mutexV(decoder->stateUpdatedMutex);
+  SDL_CondSignal(decoder->stateUpdated);
+}
 
-  
-/***********************/
-/* this the main mutex */
-/***********************/
-static int stateUpdatedFlag;    
-static SDL_mutex* stateUpdatedMutex;
-static SDL_cond*  stateUpdated;   //WAIT (decoder):"I have nothing to do, wait for command, 
-                                  //               open access for writing or refresh done"
-                                  //SIGNAL (event or cli): "A commans was send" or "refresh done"
 
-/* used when clock want signal event to the decoder */
+/* used when clock want signal event to the decoders */
 void WV_videoDecoderSignal(void)
 {
-  SDL_mutexP(stateUpdatedMutex);
-  stateUpdatedFlag = 1;
-  SDL_mutexV(stateUpdatedMutex);
-  SDL_CondSignal(stateUpdated);
+  if(!videoDecodersMutex)
+    return;
+
+  int i;
+  SDL_mutexP(videoDecodersMutex);
+  for(i=0; i<nbVideoDecoder; i++)
+    signalVideoDecoder(videoDecoders[i]);
+  SDL_mutexV(videoDecodersMutex);
 }
 
 
@@ -151,15 +380,18 @@ void WV_videoDecoderSignal(void)
 static int swsFlags = WV_VIDEO_DECODER_SCALE_FILTER; //TODO dynamic
 
 
+/*************************/
+/* the frame cache limit */
+/*************************/
+static uint32_t frameCacheMaxStreamSize = WV_FRAME_CACHE_MAX_STREAM_SIZE;
+static uint32_t frameCacheMaxSize = WV_FRAME_CACHE_MAX_SIZE; //for all the decoders
+
+/* the cached frames of all the decoders */
+static uint32_t frameCacheTotalSize = 0;
+static SDL_mutex* frameCacheMutex = NULL;   //the streams are decoded in parallel
 
 
-/***************************/
-/* the video streams       */ 
-/* decoded simultaneoustly */
-/***************************/ 
-static VideoBitStream* videoStreams[WV_VIDEO_DECODER_MAX_STREAMS];
 
-static int nbVideoStream;
 
 
 
@@ -273,14 +505,14 @@ static uint32_t getRefreshDuration(VideoBitStream* videoStream)
 }    
 
 
-/* get the pts closk of the frame at refreshPos */
-static uint32_t getPtsClock(VideoBitStream* videoStream)
+/* convert a frame pts to a clock value */
+static uint32_t ptsToClock(VideoBitStream* videoStream, int64_t pts)
 {
   /* this say that we don't have valid pts */
-  if(videoStream->framePts[videoStream->refreshPos] == AV_NOPTS_VALUE)
+  if(pts == AV_NOPTS_VALUE)
     return UINT32_MAX;
 
-  double framePts = (double)(videoStream->framePts[videoStream->refreshPos]);
+  double framePts = (double)pts;
   
   framePts *= av_q2d(videoStream->timeBase);
   framePts *= 1000;
@@ -289,263 +521,1124 @@ static uint32_t getPtsClock(VideoBitStream* videoStream)
 }
 
 
+/* get the pts closk of the frame at refreshPos */
+static uint32_t getPtsClock(VideoBitStream* videoStream)
+{
+  return ptsToClock(videoStream, videoStream->framePts[videoStream->refreshPos]);
+}
+
 
-      
-/**********************************/
-/*||||||||||||||||||||||||||||||||*/
-/*       REFRESH TIMER            */
-/*||||||||||||||||||||||||||||||||*/
-/**********************************/
+/* the stream timestamp of a clock */
+static int64_t clockToPts(VideoBitStream* videoStream, uint32_t clock)
+{
+  AVRational msTimeBase = {1, 1000};
+  
+  return av_rescale_q((int64_t)clock, msTimeBase, videoStream->timeBase);
+}
 
 
-/* the timer will call this function */
-/* to refresh the frame by push an event */
-/* the param is the VideoBitStream pointer */
-static uint32_t refreshTimerCallback(uint32_t delay, void* param)
+/* the trick play clock */
+static uint32_t getTrickClock(VideoBitStream* videoStream)
 {
-  /* push the REFRESH_EVENT */
-  SDL_Event event;
+  int64_t elapsed = (int64_t)(WV_getEngineTime() - videoStream->trickBaseTime);
+  int64_t clock = videoStream->trickBaseClock + (elapsed * videoStream->trickRate) / 1000;
+
+  /* rewind stop at start */
+  if(clock < 0)
+    clock = 0;
   
-  event.type = WV_REFRESH_EVENT;
-  event.user.data1 = param;
-  event.user.code = 0; //just a refresh
+  return (uint32_t)clock;
+}
 
-  SDL_PushEvent(&event);
 
-  /* the timer doesn't loop */
-  return 0;
+/* get the reference clock */
+/* from the sync object or the trick clock */
+static void getRefClock(VideoBitStream* videoStream, WVReferenceClock* refClock)
+{
+  if(videoStream->trickMode == TRICK_NONE){
+    videoStream->VSync->getRefClock(videoStream->VSync, refClock);
+    return;
+  }
+
+  /* trick play, the video is its own master */
+  refClock->clock = getTrickClock(videoStream);
+  refClock->pauseFlag = 0;
+  refClock->modIdx = videoStream->modIdx;
 }
 
 
-/* used for no delay refresh (!specialFlag) */
-/* or for alloc or skip (specialFlag) */ 
-static void launchRefreshImmediately(VideoBitStream* videoStream, int specialFlag)
+/* trick play : the delay before the frame is due */
+/* return -1 if the frame is late */
+static int getTrickDelay(VideoBitStream* videoStream, uint32_t ptsClock, uint32_t clock, \
+			 uint32_t refreshDuration, uint32_t* delay)
 {
-  /* push the event */
-  SDL_Event event;
+  int rate = abs(videoStream->trickRate);
+  int64_t clockDelay;
+
+  /* the clock distance to the frame */
+  if(videoStream->trickRate > 0)
+    clockDelay = (int64_t)ptsClock - (int64_t)clock;
+  else
+    clockDelay = (int64_t)clock - (int64_t)ptsClock;
+
+  /* the refresh duration is in real time */
+  clockDelay -= (int64_t)refreshDuration * rate;
   
-  event.type = WV_REFRESH_EVENT;
-  event.user.data1 = videoStream;
-  event.user.code = specialFlag; //say if is a special refresh (alloc or skip)
+  if(clockDelay <= 0)
+    return -1;
 
-  /* launch */
-  videoStream->refreshStatus = REFRESH_LAUNCHED;
-  SDL_PushEvent(&event);
+  *delay = (uint32_t)(clockDelay / rate);
+  return 0;
 }
 
 
-/* the main timer function */
-/* it compute the timer delay to display */
-/* the frame at the right time */
-static void launchRefreshTimer(VideoBitStream* videoStream)
+
+      
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*         SOURCE REGION          */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* compute the converted region of the decoded frames */
+/* and the size given to the streaming object */
+//the crop is given in full size coords, the region is in codec coords
+//the object size is the region fitted in the output size, never upscaled
+static void getSourceRegion(AVCodecContext* codec, SDL_Rect* cropRect,	\
+			    int outputWidth, int outputHeight,		\
+			    SDL_Rect* srcRect, int* width, int* height)
 {
-  /* save when the timer start to compute refresh duration */
-  videoStream->startTimerT = SDL_GetTicks();
+  int lowres = codec->lowres;
   
-
   /***********************/
-  /* check the ref clock */
+  /* the region to crop  */
   /***********************/
-  WVReferenceClock refClock;
-  WVSyncObject* VSync = videoStream->VSync;
+  srcRect->x = 0;
+  srcRect->y = 0;
+  srcRect->w = codec->width;
+  srcRect->h = codec->height;
+
+  if(cropRect && cropRect->w > 0 && cropRect->h > 0){
+    /* the chroma planes need even coords */
+    int x = (cropRect->x >> lowres) & ~1;
+    int y = (cropRect->y >> lowres) & ~1;
+    int w = cropRect->w >> lowres;
+    int h = cropRect->h >> lowres;
+
+    /* clamp to the frame */
+    if(x < 0)
+      x = 0;
+    if(y < 0)
+      y = 0;
+    if(x + w > codec->width)
+      w = codec->width - x;
+    if(y + h > codec->height)
+      h = codec->height - y;
+    w &= ~1;
+    h &= ~1;
+
+    /* keep the entire frame if nothing is visible */
+    if(w > 0 && h > 0){
+      srcRect->x = x;
+      srcRect->y = y;
+      srcRect->w = w;
+      srcRect->h = h;
+    }
+  }
 
-  /* give getRefClock input */
-  uint32_t ptsClock = getPtsClock(videoStream);
-  refClock.clock = ptsClock;
-  refClock.modIdx = videoStream->modIdx;
+  /**************************/
+  /* fit in the output size */
+  /**************************/
+  *width = srcRect->w;
+  *height = srcRect->h;
+  
+  if(outputWidth > 0 && outputHeight > 0 &&				\
+     (outputWidth < srcRect->w || outputHeight < srcRect->h)){
+    int64_t w = srcRect->w;
+    int64_t h = srcRect->h;
+    int fitWidth, fitHeight;
+
+    /* keep the aspect, rounded up */
+    if(outputWidth * h <= outputHeight * w){
+      fitWidth = outputWidth;
+      fitHeight = (int)((h * outputWidth + w - 1) / w);
+    }
+    else{
+      fitWidth = (int)((w * outputHeight + h - 1) / h);
+      fitHeight = outputHeight;
+    }
 
-  /* get the reference clock */
-  VSync->getRefClock(VSync, &refClock);
-  
-  /* don't refresh if the video modIdx is after the clock modIdx */
-  if(videoStream->modIdx > refClock.modIdx)
-    return;
-  
-  /* if the video is in late refresh immediately */
-  if(videoStream->modIdx < refClock.modIdx){
-    videoStream->timerDelay = 0;
-    launchRefreshImmediately(videoStream, 0);
-    return;
+    /* even sizes */
+    fitWidth = (fitWidth + 1) & ~1;
+    fitHeight = (fitHeight + 1) & ~1;
+
+    if(fitWidth < *width)
+      *width = fitWidth;
+    if(fitHeight < *height)
+      *height = fitHeight;
   }
+}
 
-  /* don't refresh if clock is paused */
-  if(refClock.pauseFlag)
-    return;
-  
 
+/* the lowres level that decode the region */
+/* at the smallest size at or above the object size */
+//!!! need to be called before opening the codec !!!
+int WV_getVideoLowres(AVCodecContext* codec, AVCodec* decoder,	\
+		      SDL_Rect* cropRect, int outputWidth, int outputHeight)
+{
+  SDL_Rect srcRect;
+  int width, height;
+  int lowres = 0;
 
-  /*********************/
-  /* delay computation */
-  /*********************/
+  if(!decoder || codec->width <= 0 || codec->height <= 0)
+    return 0;
   
-  /* TARGET DELAY */
-  /* the delay we ideally want */
-  uint32_t targetDelay;
+  /* the full size region */
+  codec->lowres = 0;
+  getSourceRegion(codec, cropRect, outputWidth, outputHeight, &srcRect, &width, &height);
 
-  /* get median refresh duration */
-  uint32_t refreshDuration = getRefreshDuration(videoStream);
+  /* each level halve the decoded size */
+  while(lowres < decoder->max_lowres &&			\
+	(srcRect.w >> (lowres+1)) >= width &&		\
+	(srcRect.h >> (lowres+1)) >= height)
+    lowres++;
+
+  return lowres;
+}
 
-  /* if we doesn't have a valid pts use the last delay */
-  if(ptsClock == UINT32_MAX)
-    targetDelay = videoStream->timerDelay;
-    
-  /* else compute */
-  else{  
-    uint32_t subT = refClock.clock + refreshDuration + 1; //time to remove to get delay 
-                                                      //the +1 is because the timer is launched at
-                                                      //the next ms
-    /* if needed refresh immediately */
-    if(subT > ptsClock){
-      videoStream->timerDelay = 0;
-      launchRefreshImmediately(videoStream, 0);
-      return;
-    }
 
+/* the crop layout of the planes */
+/* return the number of planes or -1 if the format is unknown */
+static int getCropLayout(enum PixelFormat format, int* bytesPerPixel, int* hShift, int* vShift)
+{
+  int i;
   
-    /* else compute target delay */
-    targetDelay = ptsClock - subT;
+  for(i=0; i<4; i++){
+    bytesPerPixel[i] = 1;
+    hShift[i] = 0;
+    vShift[i] = 0;
   }
 
-  /* TIMER DELAY */
-  /* compute the timer delay */
-  /* timer granularity do that it differ of target delay */
-  uint32_t timerDelay;
-  uint32_t delayQ = targetDelay/timerGranularity;
-  uint32_t delayR = targetDelay%timerGranularity;
-
+  switch(format){
+  
+  case PIX_FMT_YUV420P :
+  case PIX_FMT_YUVJ420P :
+    hShift[1] = hShift[2] = 1;
+    vShift[1] = vShift[2] = 1;
+    return 3;
+
+  case PIX_FMT_YUV422P :
+  case PIX_FMT_YUVJ422P :
+    hShift[1] = hShift[2] = 1;
+    return 3;
+
+  case PIX_FMT_YUV444P :
+  case PIX_FMT_YUVJ444P :
+    return 3;
+
+  case PIX_FMT_NV12 :
+  case PIX_FMT_NV21 :
+    bytesPerPixel[1] = 2;   //interleaved chroma pairs
+    hShift[1] = 1;
+    vShift[1] = 1;
+    return 2;
+
+  case PIX_FMT_GRAY8 :
+    return 1;
+  
+  case PIX_FMT_YUYV422 :
+  case PIX_FMT_UYVY422 :
+  case PIX_FMT_RGB565 :
+  case PIX_FMT_BGR565 :
+  case PIX_FMT_RGB555 :
+  case PIX_FMT_BGR555 :
+    bytesPerPixel[0] = 2;
+    return 1;
+
+  case PIX_FMT_RGB24 :
+  case PIX_FMT_BGR24 :
+    bytesPerPixel[0] = 3;
+    return 1;
+
+  case PIX_FMT_ARGB :
+  case PIX_FMT_RGBA :
+  case PIX_FMT_ABGR :
+  case PIX_FMT_BGRA :
+    bytesPerPixel[0] = 4;
+    return 1;
+
+  default :
+    return -1;
+  }
+}
 
-  timerDelay = timerGranularity*delayQ;
 
-  if(delayR <= (timerGranularity/2))  //take the nearest delay 
-    timerDelay += 0;
-  else
-    timerDelay += timerGranularity;
+/* move the planes to the top left corner of the region */
+/* return -1 if the frame can't be cropped */
+static int cropPlanes(uint8_t** srcData, int* srcLinesize,		\
+		      int srcWidth, int srcHeight, enum PixelFormat srcFormat, \
+		      SDL_Rect* srcRect, uint8_t** cropData)
+{
+  int bytesPerPixel[4];
+  int hShift[4];
+  int vShift[4];
+  int i;
 
+  /* the region need to be in the frame */
+  //the frame may come from before a source change
+  if(srcRect->x + srcRect->w > srcWidth || srcRect->y + srcRect->h > srcHeight)
+    return -1;
+  
+  int nbPlanes = getCropLayout(srcFormat, bytesPerPixel, hShift, vShift);
+  if(nbPlanes < 0)
+    return -1;
 
-  /* we need to give the delay to sdl with the +1 delay for timer launching */
-  timerDelay++;
+  for(i=0; i<4; i++)
+    cropData[i] = NULL;
   
-  /* save the delay and launch the timer */
-  videoStream->refreshStatus = REFRESH_LAUNCHED;
-  videoStream->timerDelay = timerDelay;
-  videoStream->lastTimer = SDL_AddTimer(timerDelay, refreshTimerCallback, (void*)videoStream);
+  for(i=0; i<nbPlanes; i++){
+    cropData[i] = srcData[i] +						\
+      (srcRect->y >> vShift[i]) * srcLinesize[i] +			\
+      (srcRect->x >> hShift[i]) * bytesPerPixel[i];
+  }
   
+  return 0;
 }
 
-
+  
 
 
 /**********************************/
 /*||||||||||||||||||||||||||||||||*/
-/*       REFRESH EVENT            */
+/*      FORMAT NEGOTIATION        */
 /*||||||||||||||||||||||||||||||||*/
 /**********************************/
 
-/* the refresh event do two things */
-/* if async GLR is set it open access to the frame before refreshPos */
-/* it refresh the frame and save the refresh duration */
+/* the RGB formats, the others are YUV */
+static int isRGBFormat(enum PixelFormat format)
+{
+  switch(format){
+  case PIX_FMT_RGB24 :
+  case PIX_FMT_BGR24 :
+  case PIX_FMT_ARGB :
+  case PIX_FMT_RGBA :
+  case PIX_FMT_ABGR :
+  case PIX_FMT_BGRA :
+  case PIX_FMT_RGB565 :
+  case PIX_FMT_BGR565 :
+  case PIX_FMT_RGB555 :
+  case PIX_FMT_BGR555 :
+    return 1;
+
+  default :
+    return 0;
+  }
+}
 
 
-/* this function open access the the previous frame */
-static void openAccess(VideoBitStream* videoStream)
+/* the cost to display the src frames with an accepted format */
+static int getFormatCost(WVStreamingObject* streamObj, WVStreamingFormat* format)
 {
-  /* useless to lock data with a mutex, R/W are sequencials */
-  videoStream->writeAccessFlag = 1;
-  
-  /* signal state change */
-  SDL_mutexP(stateUpdatedMutex);
-  stateUpdatedFlag = 1;
-  SDL_mutexV(stateUpdatedMutex);
-  SDL_CondSignal(stateUpdated);
+  int cost = format->cost;
+
+  /* format conversion */
+  if(format->format != streamObj->srcFormat){
+    if(isRGBFormat(format->format) != isRGBFormat(streamObj->srcFormat))
+      cost += WV_NEGOTIATION_COLOR_COST;
+    else
+      cost += WV_NEGOTIATION_REPACK_COST;
+  }
 
+  /* scaling */
+  if(format->width && format->height &&					\
+     (format->width != streamObj->srcWidth || format->height != streamObj->srcHeight))
+    cost += WV_NEGOTIATION_SCALE_COST;
+
+  return cost;
 }
 
 
-/* to signal that refresh is done and save refresh duration */
-static void refreshDone(VideoBitStream* videoStream, uint32_t refreshDoneT)
+/* choose the cheapest accepted format */
+//at same cost keep the object preference
+void WV_negotiateStreamingFormat(WVStreamingObject* streamObj)
 {
-  /* save the refresh duration */
-  uint32_t startTimerT = videoStream->startTimerT;
-  uint32_t timerDelay = videoStream->timerDelay;
-  addRefreshDuration(videoStream, refreshDoneT - startTimerT - timerDelay);
-  
-  /* set the refresh flag */
-  videoStream->refreshStatus = REFRESH_DONE;
+  int i;
+  int cost;
+  int bestCost = 0;
 
-  /* signal state change */
-  SDL_mutexP(stateUpdatedMutex);
-  stateUpdatedFlag = 1;
-  SDL_mutexV(stateUpdatedMutex);
-  SDL_CondSignal(stateUpdated);
+  streamObj->formatIdx = -1;
+  
+  for(i=0; i<streamObj->nbFormats; i++){
+    cost = getFormatCost(streamObj, &streamObj->formats[i]);
+    if(streamObj->formatIdx < 0 || cost < bestCost){
+      streamObj->formatIdx = i;
+      bestCost = cost;
+    }
+  }
 }
 
 
-/* do alloc or skip when event.user.code is set */
-static void specialRefresh(SDL_Event* event)
+/* give the published src to the object */
+/* !!! by the thread that call get !!! */
+static void applySourceChange(VideoBitStream* videoStream)
 {
-  VideoBitStream* videoStream = event->user.data1;
   WVStreamingObject* streamObj = videoStream->streamObj;
-  int refreshPos = videoStream->refreshPos;
-  int writePos = videoStream->writePos;
-  WVStreamingBuffer* frameBuffer = videoStream->frameBuffer;
 
-  /* check for alloc */
-  if((videoStream->slotFlag[writePos] & SLOT_FLAG_ALLOC)){
-      
-    /* alloc */
-    if(videoStream->getInRefreshFlag)
-      frameBuffer[writePos] = streamObj->getBuffer(streamObj, writePos);
-    
-    if(streamObj->lockBuffer && videoStream->LRInRefreshFlag)
-      streamObj->lockBuffer(streamObj, writePos);
-    
-    videoStream->slotFlag[writePos] ^= SLOT_FLAG_ALLOC;
+  SDL_mutexP(videoStream->decoder->objectMutex);
+  if(videoStream->srcChangeFlag){
+    streamObj->srcWidth = videoStream->newSrcWidth;
+    streamObj->srcHeight = videoStream->newSrcHeight;
+    streamObj->srcFormat = videoStream->newSrcFormat;
+    videoStream->uploadableFlag = videoStream->newUploadableFlag;
+    videoStream->srcChangeFlag = 0;
+
+    /* the dynamic get objects give the new format */
+    /* at the next get, the others keep their buffers */
+    WV_negotiateStreamingFormat(streamObj);
   }
+  SDL_mutexV(videoStream->decoder->objectMutex);
+}
 
-  /* check for skip */
-  if((videoStream->slotFlag[refreshPos] & SLOT_FLAG_SKIP)){
-    
-    /* skip */
-    if(streamObj->releaseBuffer && videoStream->LRInRefreshFlag)
-      streamObj->releaseBuffer(streamObj, refreshPos);
-    
-    videoStream->slotFlag[refreshPos] ^= SLOT_FLAG_SKIP;
-    videoStream->slotFlag[refreshPos] ^= SLOT_FLAG_ALLOC;
+
+/* the codec can change the frame size or format */
+/* during the stream, renegotiate */
+static void checkSourceChange(VideoBitStream* videoStream)
+{
+  AVCodecContext* codec = videoStream->codec;
+  WVStreamingObject* streamObj = videoStream->streamObj;
+
+  if(codec->width == videoStream->codecWidth &&	\
+     codec->height == videoStream->codecHeight &&	\
+     codec->pix_fmt == videoStream->codecFormat)
+    return;
+
+  videoStream->codecWidth = codec->width;
+  videoStream->codecHeight = codec->height;
+  videoStream->codecFormat = codec->pix_fmt;
+
+  /* the new src */
+  int srcWidth, srcHeight;
+  getSourceRegion(codec, &videoStream->cropRect,			\
+		  videoStream->outputWidth, videoStream->outputHeight,	\
+		  &videoStream->srcRect, &srcWidth, &srcHeight);
+
+  /* publish it */
+  SDL_mutexP(videoStream->decoder->objectMutex);
+  videoStream->newSrcWidth = srcWidth;
+  videoStream->newSrcHeight = srcHeight;
+  videoStream->newSrcFormat = codec->pix_fmt;
+  videoStream->newUploadableFlag = (streamObj->uploadFrame != NULL &&	\
+				    videoStream->srcRect.w == codec->width && \
+				    videoStream->srcRect.h == codec->height && \
+				    srcWidth == codec->width && srcHeight == codec->height);
+  videoStream->srcChangeFlag = 1;
+  SDL_mutexV(videoStream->decoder->objectMutex);
+
+  /* the thread safe objects can take it now */
+  if(videoStream->getInDecodeFlag)
+    applySourceChange(videoStream);
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*       FRAME CONVERSION         */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* free the cached frames */
+static void dropFrameCache(VideoBitStream* videoStream)
+{
+  CachedFrame* cachedFrame = videoStream->cacheFirst;
+  CachedFrame* nextFrame;
+
+  while(cachedFrame){
+    nextFrame = cachedFrame->nextFrame;
+    avpicture_free(&cachedFrame->picture);
+    free(cachedFrame);
+    cachedFrame = nextFrame;
   }
 
-  /* ok refresh done */
-  videoStream->refreshStatus = NO_REFRESH; //we don't encrease refreshPos
+  videoStream->cacheFirst = NULL;
+  videoStream->cacheLast = NULL;
+  videoStream->cachePos = NULL;
 
-  /* signal */
-  SDL_mutexP(stateUpdatedMutex);
-  stateUpdatedFlag = 1;
-  SDL_mutexV(stateUpdatedMutex);
-  SDL_CondSignal(stateUpdated);
+  SDL_mutexP(frameCacheMutex);
+  videoStream->decoder->frameCacheSize -= videoStream->cacheSize;
+  frameCacheTotalSize -= videoStream->cacheSize;
+  SDL_mutexV(frameCacheMutex);
+  videoStream->cacheSize = 0;
 }
 
 
+/* the seek and the trick play leave the cached loop */
+//a partial record is lost, a complete cache is replayed at the next eof
+static void stopFrameCache(VideoBitStream* videoStream)
+{
+  switch(videoStream->frameCacheState){
+    
+  case FRAME_CACHE_RECORD :
+    dropFrameCache(videoStream);
+    videoStream->frameCacheState = FRAME_CACHE_WAIT;
+    break;
+
+  case FRAME_CACHE_REPLAY :
+  case FRAME_CACHE_SKIP :
+  case FRAME_CACHE_RESYNC :
+    videoStream->frameCacheState = FRAME_CACHE_READY;
+    break;
+  }
+}
+
 
-/* now the public function that refresh the current frame */
-/* and open access to the previous */
-/* it take care to Get/Lock/Release if there are not thread safe */
-void WV_refreshVideoFrame(SDL_Event* event)
+/* keep a converted frame of the recorded loop */
+/* stop caching if the memory limit is reached */
+static void recordCachedFrame(VideoBitStream* videoStream, WVStreamingBuffer* buffer, int64_t pts)
 {
-  /*************************/
-  /* check special refresh */
-  /*************************/
-  if(event->user.code){
-    specialRefresh(event);
-    return;
+  VideoDecoder* decoder = videoStream->decoder;
+  
+  /* check the limits */
+  //the frame size is reserved, the other streams record in parallel
+  int frameSize = avpicture_get_size(buffer->format, buffer->width, buffer->height);
+  int overFlag = 1;
+
+  SDL_mutexP(frameCacheMutex);
+  if(frameSize >= 0 &&							\
+     videoStream->cacheSize + frameSize <= frameCacheMaxStreamSize &&	\
+     frameCacheTotalSize + frameSize <= frameCacheMaxSize){
+    decoder->frameCacheSize += frameSize;
+    frameCacheTotalSize += frameSize;
+    overFlag = 0;
   }
+  SDL_mutexV(frameCacheMutex);
   
+  if(overFlag){
+    dropFrameCache(videoStream);
+    videoStream->frameCacheState = FRAME_CACHE_NONE;
+    return;
+  }
+
+  /* count it in the stream cache */
+  //so it is released with the others on failure
+  videoStream->cacheSize += frameSize;
+
+  /* alloc */
+  CachedFrame* cachedFrame = (CachedFrame*)malloc(sizeof(CachedFrame));
+  if(!cachedFrame){
+    dropFrameCache(videoStream);
+    videoStream->frameCacheState = FRAME_CACHE_NONE;
+    return;
+  }
   
-  /***********/
-  /* refresh */
-  /***********/
-  /* get the stream , the streamingObject and the frame buffer list  */
-  VideoBitStream* videoStream = event->user.data1;
-  WVStreamingObject* streamObj = videoStream->streamObj;
-  WVStreamingBuffer* frameBuffer = videoStream->frameBuffer;
+  if(avpicture_alloc(&cachedFrame->picture, buffer->format, buffer->width, buffer->height) < 0){
+    free(cachedFrame);
+    dropFrameCache(videoStream);
+    videoStream->frameCacheState = FRAME_CACHE_NONE;
+    return;
+  }
+
+  /* copy */
+  AVPicture srcPicture;
+  int i;
+  
+  for(i=0; i<4; i++){
+    srcPicture.data[i] = buffer->data[i];
+    srcPicture.linesize[i] = buffer->linesize[i];
+  }
+
+  av_picture_copy(&cachedFrame->picture, (const AVPicture*)&srcPicture, \
+		  buffer->format, buffer->width, buffer->height);
+
+  cachedFrame->width = buffer->width;
+  cachedFrame->height = buffer->height;
+  cachedFrame->format = buffer->format;
+  cachedFrame->pts = pts;
+  cachedFrame->nextFrame = NULL;
+
+  /* put it at the loop end */
+  if(videoStream->cacheLast)
+    videoStream->cacheLast->nextFrame = cachedFrame;
+  else
+    videoStream->cacheFirst = cachedFrame;
+  videoStream->cacheLast = cachedFrame;
+}
+
+
+/* check the loading method */
+/* and load the source picture in the slot */
+//recordFlag keep the converted frame in the frame cache
+static void loadVideoFrame(VideoBitStream* videoStream, int slotPos,	\
+			   uint8_t** srcData, int* srcLinesize,		\
+			   int srcWidth, int srcHeight, enum PixelFormat srcFormat, \
+			   int recordFlag)
+{
+  WVStreamingObject* streamObj = videoStream->streamObj;
+  
+  /******************************/
+  /*   check getBuffer method   */
+  /******************************/
+  //can't use getInRefreshFlag because may we don't do get at all 
+  //the streams are decoded in parallel, the objects may share their display
+  SDL_mutexP(videoStream->decoder->objectMutex);
+  if(videoStream->getInDecodeFlag){
+    videoStream->frameBuffer[slotPos] = streamObj->getBuffer(streamObj, slotPos);
+  }
+  
+  /*********************/
+  /* check lock method */
+  /*********************/
+  if(streamObj->lockBuffer && videoStream->LRInDecodeFlag){
+    streamObj->lockBuffer(streamObj, slotPos);
+  }
+  SDL_mutexV(videoStream->decoder->objectMutex);
+
+  /********/
+  /* load */
+  /********/
+  WVStreamingBuffer* outputBuffer = &(videoStream->frameBuffer[slotPos]); 
+  
+  /* convert only the visible region */
+  //if the frame can't be cropped convert it entirely
+  SDL_Rect* srcRect = &videoStream->srcRect;
+  uint8_t* cropData[4];
+  
+  if((srcRect->w != srcWidth || srcRect->h != srcHeight) &&		\
+     cropPlanes(srcData, srcLinesize, srcWidth, srcHeight, srcFormat, srcRect, cropData) >= 0){
+    srcData = cropData;
+    srcWidth = srcRect->w;
+    srcHeight = srcRect->h;
+  }
+  
+  /* scale, in slices if possible */
+  uint64_t startTime = WV_getMicroTime();
+  
+  WV_sliceScale(videoStream->sliceScaler,				\
+		srcData, srcLinesize,					\
+		srcWidth, srcHeight, srcFormat,				\
+		outputBuffer->data, outputBuffer->linesize,		\
+		outputBuffer->width, outputBuffer->height, outputBuffer->format, \
+		swsFlags);
+
+  videoStream->conversionTime = (uint32_t)(WV_getMicroTime() - startTime);
+
+  /* keep the frame before the user filter */
+  //the filter is applied again at each loop
+  if(recordFlag)
+    recordCachedFrame(videoStream, outputBuffer, videoStream->framePts[slotPos]);
+  
+
+  /***********************/
+  /* check buffer filter */
+  /***********************/
+  SDL_mutexP(videoStream->decoder->objectMutex);
+  if(streamObj->filterBuffer)
+    streamObj->filterBuffer(streamObj, slotPos, outputBuffer);
+
+
+
+  /************************/
+  /* check release method */
+  /************************/
+  if(streamObj->releaseBuffer && videoStream->LRInDecodeFlag && !videoStream->releaseUnlockedFlag){
+    streamObj->releaseBuffer(streamObj, slotPos);
+  }
+  SDL_mutexV(videoStream->decoder->objectMutex);
+
+  if(streamObj->releaseBuffer && videoStream->LRInDecodeFlag && videoStream->releaseUnlockedFlag){
+    streamObj->releaseBuffer(streamObj, slotPos);
+  }
+
+
+}
+
+
+/* frame cache : copy a cached frame in the slot */
+//scale it if the object changed its buffer
+static void loadCachedFrame(VideoBitStream* videoStream, int slotPos, CachedFrame* cachedFrame)
+{
+  WVStreamingObject* streamObj = videoStream->streamObj;
+
+  /* get and lock like a converted frame */
+  SDL_mutexP(videoStream->decoder->objectMutex);
+  if(videoStream->getInDecodeFlag){
+    videoStream->frameBuffer[slotPos] = streamObj->getBuffer(streamObj, slotPos);
+  }
+  
+  if(streamObj->lockBuffer && videoStream->LRInDecodeFlag){
+    streamObj->lockBuffer(streamObj, slotPos);
+  }
+  SDL_mutexV(videoStream->decoder->objectMutex);
+
+  /* load */
+  WVStreamingBuffer* outputBuffer = &(videoStream->frameBuffer[slotPos]); 
+  uint64_t startTime = WV_getMicroTime();
+  
+  if(outputBuffer->width == cachedFrame->width &&	\
+     outputBuffer->height == cachedFrame->height &&	\
+     outputBuffer->format == cachedFrame->format){
+    AVPicture dstPicture;
+    int i;
+    
+    for(i=0; i<4; i++){
+      dstPicture.data[i] = outputBuffer->data[i];
+      dstPicture.linesize[i] = outputBuffer->linesize[i];
+    }
+    
+    av_picture_copy(&dstPicture, (const AVPicture*)&cachedFrame->picture, \
+		    cachedFrame->format, cachedFrame->width, cachedFrame->height);
+  }
+  else{
+    WV_sliceScale(videoStream->sliceScaler,				\
+		  cachedFrame->picture.data, cachedFrame->picture.linesize, \
+		  cachedFrame->width, cachedFrame->height, cachedFrame->format, \
+		  outputBuffer->data, outputBuffer->linesize,		\
+		  outputBuffer->width, outputBuffer->height, outputBuffer->format, \
+		  swsFlags);
+  }
+
+  videoStream->conversionTime = (uint32_t)(WV_getMicroTime() - startTime);
+
+  /* filter and release */
+  SDL_mutexP(videoStream->decoder->objectMutex);
+  if(streamObj->filterBuffer)
+    streamObj->filterBuffer(streamObj, slotPos, outputBuffer);
+
+  if(streamObj->releaseBuffer && videoStream->LRInDecodeFlag && !videoStream->releaseUnlockedFlag){
+    streamObj->releaseBuffer(streamObj, slotPos);
+  }
+  SDL_mutexV(videoStream->decoder->objectMutex);
+
+  if(streamObj->releaseBuffer && videoStream->LRInDecodeFlag && videoStream->releaseUnlockedFlag){
+    streamObj->releaseBuffer(streamObj, slotPos);
+  }
+}
+
+
+/* lazy conversion : load the native frame */
+/* of the slot that will be refreshed */
+static void loadNativeFrame(VideoBitStream* videoStream)
+{
+  int refreshPos = videoStream->refreshPos;
+  
+  /* with native upload the frame is loaded by the refresh */
+  if(videoStream->uploadFlag)
+    return;
+  
+  /* check if the slot is already loaded */
+  if(!(videoStream->slotFlag[refreshPos] & SLOT_FLAG_NATIVE))
+    return;
+
+  /* convert */
+  WVNativeFrame* nativeFrame = &videoStream->nativeFrames[refreshPos];
+  
+  loadVideoFrame(videoStream, refreshPos,				\
+		 nativeFrame->data, nativeFrame->linesize,		\
+		 nativeFrame->width, nativeFrame->height, nativeFrame->format, 0);
+
+  /* the native frame is no longer needed */
+  WV_releaseNativeFrame(nativeFrame);
+  videoStream->slotFlag[refreshPos] ^= SLOT_FLAG_NATIVE;
+}
+
+
+/* native upload : the frame was not uploaded */
+/* convert it in the object buffer */
+/* !!! called by the main thread !!! */
+static void convertNativeFrame(VideoBitStream* videoStream, int slotPos, WVNativeFrame* nativeFrame)
+{
+  WVStreamingObject* streamObj = videoStream->streamObj;
+
+  //without buffers the slot show the previous frame
+  if(!streamObj->getBuffer)
+    return;
+
+  /* get and lock in the main thread */
+  //the upload streams don't get the buffers while decoding
+  SDL_mutexP(videoStream->decoder->objectMutex);
+  if(streamObj->getBufferMethod == WV_DYNAMIC_GET || !videoStream->frameBuffer[slotPos].data[0])
+    videoStream->frameBuffer[slotPos] = streamObj->getBuffer(streamObj, slotPos);
+
+  if(streamObj->lockBuffer)
+    streamObj->lockBuffer(streamObj, slotPos);
+  SDL_mutexV(videoStream->decoder->objectMutex);
+
+  /* convert and filter */
+  loadVideoFrame(videoStream, slotPos,					\
+		 nativeFrame->data, nativeFrame->linesize,		\
+		 nativeFrame->width, nativeFrame->height, nativeFrame->format, 0);
+
+  /* release */
+  if(streamObj->releaseBuffer){
+    SDL_mutexP(videoStream->decoder->objectMutex);
+    streamObj->releaseBuffer(streamObj, slotPos);
+    SDL_mutexV(videoStream->decoder->objectMutex);
+  }
+}
+
+
+/* native upload : give the native frame to the */
+/* streaming object just before the refresh */
+/* !!! called by the main thread !!! */
+static void uploadNativeFrame(VideoBitStream* videoStream)
+{
+  int refreshPos = videoStream->refreshPos;
+  WVStreamingObject* streamObj = videoStream->streamObj;
+  
+  /* check if the slot have a new frame */
+  //else the object keep the previous one
+  if(!(videoStream->slotFlag[refreshPos] & SLOT_FLAG_NATIVE))
+    return;
+
+  /* describe the native frame */
+  WVNativeFrame* nativeFrame = &videoStream->nativeFrames[refreshPos];
+  WVStreamingBuffer uploadedFrame;
+  int i;
+
+  uploadedFrame.width = nativeFrame->width;
+  uploadedFrame.height = nativeFrame->height;
+  uploadedFrame.format = nativeFrame->format;
+  for(i=0; i<4; i++){
+    uploadedFrame.data[i] = nativeFrame->data[i];
+    uploadedFrame.linesize[i] = nativeFrame->linesize[i];
+  }
+
+  /* upload */
+  //if the object can't take the frame, convert it
+  if(!videoStream->uploadableFlag ||					\
+     streamObj->uploadFrame(streamObj, refreshPos, &uploadedFrame) < 0)
+    convertNativeFrame(videoStream, refreshPos, nativeFrame);
+
+  /* the native frame is no longer needed */
+  WV_releaseNativeFrame(nativeFrame);
+  videoStream->slotFlag[refreshPos] ^= SLOT_FLAG_NATIVE;
+}
+
+
+/* drop the native frames that will never be refreshed */
+/* keepPos is a slot still refreshed or -1 */
+static void dropNativeFrames(VideoBitStream* videoStream, int keepPos)
+{
+  int i;
+  
+  if(!videoStream->nativeFrames)
+    return;
+
+  for(i=0; i<videoStream->streamObj->nbSlots; i++){
+    if(i != keepPos && (videoStream->slotFlag[i] & SLOT_FLAG_NATIVE)){
+      WV_releaseNativeFrame(&videoStream->nativeFrames[i]);
+      videoStream->slotFlag[i] ^= SLOT_FLAG_NATIVE;
+    }
+  }
+}
+
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*       REFRESH TIMER            */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+
+/* the refresh scheduler will call this function */
+/* to refresh the frame by push an event */
+/* the param is the VideoBitStream pointer */
+static void refreshTimerCallback(void* param)
+{
+  /* push the REFRESH_EVENT */
+  SDL_Event event;
+  
+  event.type = WV_REFRESH_EVENT;
+  event.user.data1 = param;
+  event.user.code = 0; //just a refresh
+
+  SDL_PushEvent(&event);
+}
+
+
+/* pull mode : the refresh wait for the user */
+static void setPullRefresh(VideoBitStream* videoStream, uint64_t dueTime, int specialFlag)
+{
+  videoStream->refreshStatus = REFRESH_LAUNCHED;
+  
+  SDL_mutexP(videoStream->decoder->pullMutex);
+  videoStream->pullCode = specialFlag;
+  videoStream->pullDueTime = dueTime;
+  videoStream->pullPendingFlag = 1;
+  SDL_mutexV(videoStream->decoder->pullMutex);
+}
+
+
+/* remove the launched refresh */
+/* return SDL_TRUE if it was not already done */
+static SDL_bool cancelRefresh(VideoBitStream* videoStream)
+{
+  /* push mode */
+  if(videoStream->presentMethod == WV_PUSH_PRESENT)
+    return WV_cancelRefresh(videoStream);
+
+  /* pull mode */
+  SDL_bool cancelFlag = SDL_FALSE;
+  
+  SDL_mutexP(videoStream->decoder->pullMutex);
+  if(videoStream->pullPendingFlag){
+    videoStream->pullPendingFlag = 0;
+    cancelFlag = SDL_TRUE;
+  }
+  SDL_mutexV(videoStream->decoder->pullMutex);
+
+  return cancelFlag;
+}
+
+
+/* used for no delay refresh (!specialFlag) */
+/* or for alloc or skip (specialFlag) */ 
+static void launchRefreshImmediately(VideoBitStream* videoStream, int specialFlag)
+{
+  /* pull mode */
+  if(videoStream->presentMethod == WV_PULL_PRESENT){
+    setPullRefresh(videoStream, 0, specialFlag);   //due now
+    return;
+  }
+  
+  /* push the event */
+  SDL_Event event;
+  
+  event.type = WV_REFRESH_EVENT;
+  event.user.data1 = videoStream;
+  event.user.code = specialFlag; //say if is a special refresh (alloc or skip)
+
+  /* launch */
+  videoStream->refreshStatus = REFRESH_LAUNCHED;
+  SDL_PushEvent(&event);
+}
+
+
+/* the main timer function */
+/* it compute the timer delay to display */
+/* the frame at the right time */
+static void launchRefreshTimer(VideoBitStream* videoStream)
+{
+  /* save when the timer start to compute refresh duration */
+  videoStream->startTimerT = WV_getEngineTicks();
+  uint64_t startTime = WV_getEngineTime();
+  
+
+  /***********************/
+  /* check the ref clock */
+  /***********************/
+  WVReferenceClock refClock;
+
+  /* give getRefClock input */
+  uint32_t ptsClock = getPtsClock(videoStream);
+  refClock.clock = ptsClock;
+  refClock.modIdx = videoStream->modIdx;
+
+  /* get the reference clock */
+  getRefClock(videoStream, &refClock);
+  
+  /* don't refresh if the video modIdx is after the clock modIdx */
+  if(videoStream->modIdx > refClock.modIdx)
+    return;
+  
+  /* if the video is in late refresh immediately */
+  if(videoStream->modIdx < refClock.modIdx){
+    loadNativeFrame(videoStream);
+    videoStream->timerDelay = 0;
+    launchRefreshImmediately(videoStream, 0);
+    return;
+  }
+
+  /* don't refresh if clock is paused */
+  if(refClock.pauseFlag)
+    return;
+  
+  /* lazy conversion */
+  /* now we know that the frame will be refreshed */
+  //the conversion time is included in the refresh duration
+  loadNativeFrame(videoStream);
+
+
+
+  /*********************/
+  /* delay computation */
+  /*********************/
+  
+  /* TARGET DELAY */
+  /* the delay we ideally want */
+  uint32_t targetDelay;
+
+  /* get median refresh duration */
+  uint32_t refreshDuration = getRefreshDuration(videoStream);
+
+  /* if we doesn't have a valid pts use the last delay */
+  if(ptsClock == UINT32_MAX)
+    targetDelay = videoStream->timerDelay;
+
+  /* trick play, the clock is not at rate 1 */
+  else if(videoStream->trickMode != TRICK_NONE){
+    if(getTrickDelay(videoStream, ptsClock, refClock.clock, refreshDuration, &targetDelay) < 0){
+      videoStream->timerDelay = 0;
+      launchRefreshImmediately(videoStream, 0);
+      return;
+    }
+  }
+    
+  /* else compute */
+  else{  
+    uint32_t subT = refClock.clock + refreshDuration; //time to remove to get delay 
+    /* if needed refresh immediately */
+    if(subT > ptsClock){
+      videoStream->timerDelay = 0;
+      launchRefreshImmediately(videoStream, 0);
+      return;
+    }
+
+  
+    /* else compute target delay */
+    targetDelay = ptsClock - subT;
+  }
+
+  /* SCHEDULE */
+  /* the scheduler is precise, the timer delay is the target delay */
+  uint64_t dueTime = startTime + (uint64_t)targetDelay * 1000;
+  
+  /* save the delay and schedule the refresh */
+  videoStream->refreshStatus = REFRESH_LAUNCHED;
+  videoStream->timerDelay = targetDelay;
+
+  /* pull mode */
+  if(videoStream->presentMethod == WV_PULL_PRESENT){
+    setPullRefresh(videoStream, dueTime, 0);
+    return;
+  }
+  
+  if(WV_scheduleRefresh(dueTime, refreshTimerCallback, (void*)videoStream) < 0){
+    videoStream->timerDelay = 0;
+    launchRefreshImmediately(videoStream, 0);
+  }
+  
+}
+
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*       REFRESH EVENT            */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* the refresh event do two things */
+/* if async GLR is set it open access to the frame before refreshPos */
+/* it refresh the frame and save the refresh duration */
+
+
+/* this function open access the the previous frame */
+static void openAccess(VideoBitStream* videoStream)
+{
+  /* useless to lock data with a mutex, R/W are sequencials */
+  videoStream->writeAccessFlag = 1;
+  
+  /* signal state change */
+  SDL_mutexP(videoStream->decoder->stateUpdatedMutex);
+  videoStream->decoder->stateUpdatedFlag = 1;
+  SDL_mutexV(videoStream->decoder->stateUpdatedMutex);
+  SDL_CondSignal(videoStream->decoder->stateUpdated);
+
+}
+
+
+/* to signal that refresh is done and save refresh duration */
+static void refreshDone(VideoBitStream* videoStream, uint32_t refreshDoneT)
+{
+  /* save the refresh duration */
+  uint32_t startTimerT = videoStream->startTimerT;
+  uint32_t timerDelay = videoStream->timerDelay;
+  addRefreshDuration(videoStream, refreshDoneT - startTimerT - timerDelay);
+  
+  /* set the refresh flag */
+  videoStream->refreshStatus = REFRESH_DONE;
+
+  /* signal state change */
+  SDL_mutexP(videoStream->decoder->stateUpdatedMutex);
+  videoStream->decoder->stateUpdatedFlag = 1;
+  SDL_mutexV(videoStream->decoder->stateUpdatedMutex);
+  SDL_CondSignal(videoStream->decoder->stateUpdated);
+}
+
+
+/* do alloc or skip when event.user.code is set */
+static void specialRefresh(VideoBitStream* videoStream)
+{
+  WVStreamingObject* streamObj = videoStream->streamObj;
+  int refreshPos = videoStream->refreshPos;
+  int writePos = videoStream->writePos;
+  WVStreamingBuffer* frameBuffer = videoStream->frameBuffer;
+
+  /* check for alloc */
+  if((videoStream->slotFlag[writePos] & SLOT_FLAG_ALLOC)){
+      
+    /* alloc */
+    if(videoStream->getInRefreshFlag)
+      frameBuffer[writePos] = streamObj->getBuffer(streamObj, writePos);
+    
+    if(streamObj->lockBuffer && videoStream->LRInRefreshFlag)
+      streamObj->lockBuffer(streamObj, writePos);
+    
+    videoStream->slotFlag[writePos] ^= SLOT_FLAG_ALLOC;
+  }
+
+  /* check for skip */
+  if((videoStream->slotFlag[refreshPos] & SLOT_FLAG_SKIP)){
+    
+    /* skip */
+    if(streamObj->releaseBuffer && videoStream->LRInRefreshFlag)
+      streamObj->releaseBuffer(streamObj, refreshPos);
+    
+    videoStream->slotFlag[refreshPos] ^= SLOT_FLAG_SKIP;
+    videoStream->slotFlag[refreshPos] ^= SLOT_FLAG_ALLOC;
+  }
+
+  /* ok refresh done */
+  videoStream->refreshStatus = NO_REFRESH; //we don't encrease refreshPos
+
+  /* signal */
+  SDL_mutexP(videoStream->decoder->stateUpdatedMutex);
+  videoStream->decoder->stateUpdatedFlag = 1;
+  SDL_mutexV(videoStream->decoder->stateUpdatedMutex);
+  SDL_CondSignal(videoStream->decoder->stateUpdated);
+}
+
+
+
+/* refresh the current frame */
+/* and open access to the previous */
+/* it take care to Get/Lock/Release if there are not thread safe */
+static void refreshVideoStream(VideoBitStream* videoStream, int specialFlag)
+{
+  /* the src changes of the objects */
+  /* that get in the main thread */
+  if(!videoStream->getInDecodeFlag)
+    applySourceChange(videoStream);
+
+  /*************************/
+  /* check special refresh */
+  /*************************/
+  if(specialFlag){
+    specialRefresh(videoStream);
+    return;
+  }
+  
+  
+  /***********/
+  /* refresh */
+  /***********/
+  /* get the streamingObject and the frame buffer list  */
+  WVStreamingObject* streamObj = videoStream->streamObj;
+  WVStreamingBuffer* frameBuffer = videoStream->frameBuffer;
   
   /* get the current frame and the previous frame indexes */
   int refreshPos = videoStream->refreshPos;
@@ -565,84 +1658,351 @@ void WV_refreshVideoFrame(SDL_Event* event)
     /* if alloc is needed  */
     if( videoStream->slotFlag[prevPos] & SLOT_FLAG_ALLOC ){
 
-      /* get buffer : previous */
-      //if LR is not thread safe we need to do GET here, even if it is thread safe 
-      if(videoStream->getInRefreshFlag){
-	frameBuffer[prevPos] = streamObj->getBuffer(streamObj, prevPos);  //get the buffer pointer
-      }
+      /* get buffer : previous */
+      //if LR is not thread safe we need to do GET here, even if it is thread safe 
+      if(videoStream->getInRefreshFlag){
+	frameBuffer[prevPos] = streamObj->getBuffer(streamObj, prevPos);  //get the buffer pointer
+      }
+
+      /* lock buffer : previous */
+      if(streamObj->lockBuffer && videoStream->LRInRefreshFlag){
+	streamObj->lockBuffer(streamObj, prevPos);
+      }
+
+      videoStream->slotFlag[prevPos] ^= SLOT_FLAG_ALLOC;
+    }
+
+    /* open access : previous */
+    openAccess(videoStream);
+  }
+  
+  
+  /***************************/
+  /* close the current slot  */
+  /***************************/
+  //useless to check slotFlag
+  if(videoStream->getInRefreshFlag || videoStream->LRInRefreshFlag){
+    if(streamObj->releaseBuffer && videoStream->LRInRefreshFlag){
+      streamObj->releaseBuffer(streamObj, refreshPos);
+    }
+
+    videoStream->slotFlag[refreshPos] |= SLOT_FLAG_ALLOC;
+  }
+  
+
+
+  /****************************/
+  /* upload the native frame  */
+  /****************************/
+  if(videoStream->uploadFlag)
+    uploadNativeFrame(videoStream);
+  
+
+  /****************************/
+  /* refresh the current slot */
+  /****************************/
+  if(streamObj->refreshFrame){
+    streamObj->refreshFrame(streamObj, refreshPos);
+  }
+
+
+  /**************************/
+  /* save refresh done time */
+  /**************************/
+  uint32_t refreshDoneT = WV_getEngineTicks();
+
+  
+
+  /*************************/
+  /* open the current slot */
+  /*************************/
+  if(streamObj->GLRMethod == WV_SYNC_GLR){
+
+    /* if alloc is needed  */
+    if( videoStream->slotFlag[refreshPos] & SLOT_FLAG_ALLOC ){
+
+      /* get buffer : current */
+      //if LR is not thread safe we need to do GET here, even if it is thread safe 
+      if(videoStream->getInRefreshFlag){
+	frameBuffer[refreshPos] = streamObj->getBuffer(streamObj, refreshPos); 
+      }
+    
+
+      /* lock buffer : current */
+      if(streamObj->lockBuffer && videoStream->LRInRefreshFlag){
+	streamObj->lockBuffer(streamObj, refreshPos);
+      }
+      
+      
+      videoStream->slotFlag[refreshPos] ^= SLOT_FLAG_ALLOC;
+    }
+  }
+
+
+  /****************/
+  /* refresh done */
+  /****************/
+  refreshDone(videoStream, refreshDoneT);
+}
+
+
+/* the push mode */
+/* the public function called with the WV_REFRESH_EVENT */
+void WV_refreshVideoFrame(SDL_Event* event)
+{
+  /* the gapless splices use the refresh event */
+  //to swap the sources in the main thread
+  if(event->user.code == WV_SPLICE_REFRESH_CODE){
+    WV_commitSplices();
+    return;
+  }
+
+  /* the async loads init the streaming objects */
+  //in the main thread
+  if(event->user.code == WV_LOAD_REFRESH_CODE){
+    WV_finishStreamLoads();
+    return;
+  }
+
+  refreshVideoStream((VideoBitStream*)event->user.data1, event->user.code);
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*       PULL PRESENT             */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* the pull mode */
+/* the user present the due refresh himself */
+
+
+/* present the stream refresh if it is due */
+/* return 1 if a new frame was refreshed */
+static int presentVideoStream(VideoBitStream* videoStream, uint64_t now)
+{
+  /* check the pending refresh */
+  SDL_mutexP(videoStream->decoder->pullMutex);
+
+  if(!videoStream->pullPendingFlag){
+    SDL_mutexV(videoStream->decoder->pullMutex);
+    return 0;
+  }
+
+  int pullCode = videoStream->pullCode;
+  
+  //the special refresh are always due
+  if(!pullCode && videoStream->pullDueTime > now){
+    SDL_mutexV(videoStream->decoder->pullMutex);
+    return 0;
+  }
+
+  /* take it */
+  videoStream->pullPendingFlag = 0;
+  SDL_mutexV(videoStream->decoder->pullMutex);
+
+  /* refresh */
+  refreshVideoStream(videoStream, pullCode);
+
+  /* special refreshs don't change the frame */
+  if(pullCode)
+    return 0;
+  
+  return 1;
+}
+
+
+int WV_presentVideoFrame(WVVideoStreamHandle streamHdl, uint64_t now)
+{
+  VideoBitStream* videoStream = (VideoBitStream*)streamHdl;
+
+  /* check mode */
+  if(videoStream->presentMethod != WV_PULL_PRESENT)
+    return -1;
+
+  return presentVideoStream(videoStream, now);
+}
+
+
+int WV_presentDueVideoFrames(WVVideoDecoderHandle decoderHdl, uint64_t now)
+{
+  VideoDecoder* decoder = (VideoDecoder*)decoderHdl;
+  int i;
+  int nbPresented = 0;
+
+  for(i=0; i<decoder->nbVideoStream; i++){
+    if(decoder->videoStreams[i]->presentMethod == WV_PULL_PRESENT)
+      nbPresented += presentVideoStream(decoder->videoStreams[i], now);
+  }
+
+  return nbPresented;
+}
+
+
+
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*       CATCH-UP POLICY          */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* when the decoder can't follow the clock */
+/* the late frames are dropped before conversion */
+/* and the codec is asked to discard more and more frames */
+/* while the video stay late */
+
+
+/* apply the catch-up level to the codec */
+static void setCatchUpLevel(VideoBitStream* videoStream, int catchUpLevel)
+{
+  AVCodecContext* codec = videoStream->codec;
+
+  switch(catchUpLevel){
+
+  case CATCH_UP_NONE:
+    codec->skip_frame = AVDISCARD_DEFAULT;
+    codec->skip_loop_filter = AVDISCARD_DEFAULT;
+    break;
+
+  case CATCH_UP_NONREF:
+    codec->skip_frame = AVDISCARD_NONREF;
+    codec->skip_loop_filter = AVDISCARD_DEFAULT;
+    break;
+
+  case CATCH_UP_NONKEY:
+    codec->skip_frame = AVDISCARD_NONKEY;
+    codec->skip_loop_filter = AVDISCARD_DEFAULT;
+    break;
+
+  case CATCH_UP_NOFILTER:
+    codec->skip_frame = AVDISCARD_NONKEY;
+    codec->skip_loop_filter = AVDISCARD_ALL;
+    break;
+  }
+
+  videoStream->catchUpLevel = catchUpLevel;
+}
+
+
+/* go back to full quality */
+static void resetCatchUp(VideoBitStream* videoStream)
+{
+  if(videoStream->catchUpLevel != CATCH_UP_NONE)
+    setCatchUpLevel(videoStream, CATCH_UP_NONE);
+
+  videoStream->lateCount = 0;
+  videoStream->inTimeCount = 0;
+  videoStream->dropSequence = 0;
+}
+
+
+/* check if a decoded frame is too late to be displayed */
+/* and update the catch-up level */
+/* return 1 if the frame need to be dropped */
+static int checkLateFrame(VideoBitStream* videoStream, int64_t pts)
+{
+  /* the virtual time don't wait for the decoders */
+  //a frame late in virtual time is only an advance faster than the decoding,
+  //dropping it would make the runs depend on the decoding speed
+  if(WV_getTimeSource() == WV_VIRTUAL_TIME)
+    return 0;
+
+  /* the keyframe trick play hold the codec on the keyframes */
+  //lowering the catch-up level would decode all the frames again
+  if(videoStream->trickMode == TRICK_KEYFRAME || videoStream->trickMode == TRICK_REWIND)
+    return 0;
+
+  /* we can't say anything without pts */
+  uint32_t ptsClock = ptsToClock(videoStream, pts);
+  if(ptsClock == UINT32_MAX)
+    return 0;
+
+  /* get the reference clock */
+  //!!! modIdx = 0 : we just read the clock, the master must not readjust itself !!!
+  WVReferenceClock refClock;
+  
+  refClock.clock = UINT32_MAX;
+  refClock.modIdx = 0;
+  getRefClock(videoStream, &refClock);
+
+  /* the clock need to run on the same stream chunk */
+  if(refClock.pauseFlag || refClock.modIdx != videoStream->modIdx)
+    return 0;
 
-      /* lock buffer : previous */
-      if(streamObj->lockBuffer && videoStream->LRInRefreshFlag){
-	streamObj->lockBuffer(streamObj, prevPos);
+  /*****************/
+  /* in time frame */
+  /*****************/
+  if(refClock.clock <= ptsClock + WV_VIDEO_DECODER_LATE_THRESHOLD){
+    videoStream->lateCount = 0;
+    videoStream->dropSequence = 0;
+    
+    /* step by step restore full quality */
+    if(videoStream->catchUpLevel != CATCH_UP_NONE){
+      videoStream->inTimeCount++;
+      if(videoStream->inTimeCount >= WV_VIDEO_DECODER_RESYNC_STEP){
+	setCatchUpLevel(videoStream, videoStream->catchUpLevel - 1);
+	videoStream->inTimeCount = 0;
       }
-
-      videoStream->slotFlag[prevPos] ^= SLOT_FLAG_ALLOC;
     }
-
-    /* open access : previous */
-    openAccess(videoStream);
+    
+    return 0;
   }
-  
-  
-  /***************************/
-  /* close the current slot  */
-  /***************************/
-  //useless to check slotFlag
-  if(videoStream->getInRefreshFlag || videoStream->LRInRefreshFlag){
-    if(streamObj->releaseBuffer && videoStream->LRInRefreshFlag){
-      streamObj->releaseBuffer(streamObj, refreshPos);
-    }
 
-    videoStream->slotFlag[refreshPos] |= SLOT_FLAG_ALLOC;
+  /**************/
+  /* late frame */
+  /**************/
+  videoStream->inTimeCount = 0;
+  videoStream->lateCount++;
+
+  /* under sustained lateness discard more frames */
+  if(videoStream->lateCount >= WV_VIDEO_DECODER_CATCH_UP_STEP){
+    if(videoStream->catchUpLevel < CATCH_UP_MAX_LEVEL)
+      setCatchUpLevel(videoStream, videoStream->catchUpLevel + 1);
+    videoStream->lateCount = 0;
   }
-  
-
 
-  /****************************/
-  /* refresh the current slot */
-  /****************************/
-  if(streamObj->refreshFrame){
-    streamObj->refreshFrame(streamObj, refreshPos);
+  /* don't freeze the picture */
+  /* display a frame from time to time */
+  if(videoStream->dropSequence >= WV_VIDEO_DECODER_MAX_DROP_SEQUENCE){
+    videoStream->dropSequence = 0;
+    return 0;
   }
 
+  /* drop */
+  videoStream->dropSequence++;
+  videoStream->droppedFrames++;
+  
+  return 1;
+}
 
-  /**************************/
-  /* save refresh done time */
-  /**************************/
-  uint32_t refreshDoneT = SDL_GetTicks();
 
-  
+uint32_t WV_getVideoDroppedFrames(WVVideoStreamHandle streamHdl)
+{
+  VideoBitStream* videoStream = (VideoBitStream*)streamHdl;
 
-  /*************************/
-  /* open the current slot */
-  /*************************/
-  if(streamObj->GLRMethod == WV_SYNC_GLR){
+  return videoStream->droppedFrames;
+}
 
-    /* if alloc is needed  */
-    if( videoStream->slotFlag[refreshPos] & SLOT_FLAG_ALLOC ){
 
-      /* get buffer : current */
-      //if LR is not thread safe we need to do GET here, even if it is thread safe 
-      if(videoStream->getInRefreshFlag){
-	frameBuffer[refreshPos] = streamObj->getBuffer(streamObj, refreshPos); 
-      }
-    
+/**********************************/
+/* the conversion slices and time */
+/**********************************/
+void WV_setVideoConversionSlices(WVVideoStreamHandle streamHdl, int nbSlices)
+{
+  VideoBitStream* videoStream = (VideoBitStream*)streamHdl;
 
-      /* lock buffer : current */
-      if(streamObj->lockBuffer && videoStream->LRInRefreshFlag){
-	streamObj->lockBuffer(streamObj, refreshPos);
-      }
-      
-      
-      videoStream->slotFlag[refreshPos] ^= SLOT_FLAG_ALLOC;
-    }
-  }
+  //!!! applied at the next conversion !!!
+  WV_setSliceScalerSlices(videoStream->sliceScaler, nbSlices);
+}
 
 
-  /****************/
-  /* refresh done */
-  /****************/
-  refreshDone(videoStream, refreshDoneT);
+uint32_t WV_getVideoConversionTime(WVVideoStreamHandle streamHdl)
+{
+  VideoBitStream* videoStream = (VideoBitStream*)streamHdl;
+
+  return videoStream->conversionTime;
 }
 
 
@@ -653,11 +2013,72 @@ void WV_refreshVideoFrame(SDL_Event* event)
 /* ||||||||||||||||||||||||||| */
 /*******************************/
 
-void WV_startVideoSeeking(WVVideoStreamHandle streamHdl)
+void WV_startVideoSeeking(WVVideoStreamHandle streamHdl, uint32_t accurateClock)
 {
   VideoBitStream* seekingStream = (VideoBitStream*)streamHdl;
   
   seekingStream->seekingDoneFlag = 0;
+  seekingStream->accurateSeekClock = accurateClock;
+  seekingStream->seekStartTime = WV_getMicroTime();
+}
+
+
+/* remove the frames not refreshed */
+static void flushFrameList(VideoBitStream* videoStream)
+{
+  WVStreamingObject* streamObj = videoStream->streamObj;
+  int nbSlots = streamObj->nbSlots;  
+
+  
+  /* if the list is void, nothing to do */
+  if(videoStream->refreshPos == videoStream->writePos && videoStream->fullVoidFlag == 0){
+    dropNativeFrames(videoStream, -1);
+    return;
+  }
+
+  /* try to remove the scheduled refresh */
+  /* the scheduler say if the refresh is already launched */
+  SDL_bool timerFreeFlag;
+
+  if(videoStream->refreshStatus == REFRESH_LAUNCHED){
+    timerFreeFlag = cancelRefresh(videoStream);
+    videoStream->refreshStatus = NO_REFRESH;
+  }
+  else{
+    timerFreeFlag = SDL_TRUE;
+    
+    /* go to the next refreshPos */
+    if(videoStream->refreshStatus == REFRESH_DONE){
+      videoStream->refreshPos++;
+      /* check for return */
+      if(videoStream->refreshPos >= nbSlots)
+	videoStream->refreshPos = 0;
+      /* check for void */
+      if(videoStream->refreshPos == videoStream->writePos)
+	videoStream->fullVoidFlag = 0; //void
+      
+      videoStream->writeAccessFlag = 0; //lock access (for async)
+      videoStream->refreshStatus = NO_REFRESH;
+    }
+  }
+
+  /* the frames not converted are lost */
+  //but a launched refresh can still upload its frame
+  if(timerFreeFlag == SDL_TRUE)
+    dropNativeFrames(videoStream, -1);
+  else
+    dropNativeFrames(videoStream, videoStream->refreshPos);
+  
+  /* reset */
+  if(timerFreeFlag == SDL_TRUE){
+    videoStream->writePos = videoStream->refreshPos;
+    videoStream->fullVoidFlag = 0; //void
+  }
+  else{
+    videoStream->writePos = videoStream->refreshPos + 1;
+    if(videoStream->writePos >= nbSlots)
+      videoStream->writePos = 0;
+  }
 }
 
 
@@ -674,66 +2095,399 @@ static void seekVideoStream(VideoBitStream* videoStream)
   /**********************************/
   videoStream->modIdx++;
 
-  /* delete eof vars */
-  videoStream->eofPos = -1;
-    
+  /* delete eof vars */
+  videoStream->eofPos = -1;
+    
+
+  /* free the codec internal buffers */
+  avcodec_flush_buffers(videoStream->codec);
+
+  /* the eof held while draining is obsolete */
+  if(videoStream->eofPkt){
+    free(videoStream->eofPkt);
+    videoStream->eofPkt = NULL;
+  }
+  videoStream->drainDoneFlag = 0;
+
+  /* the new position start at full quality */
+  resetCatchUp(videoStream);
+
+  /* the seek removed the pending step */
+  videoStream->trickStepFlag = 0;
+
+  /* the frames come from the file again */
+  stopFrameCache(videoStream);
+
+  /* accurate seek : decode until the target */
+  videoStream->prerollClock = videoStream->accurateSeekClock;
+  videoStream->seekLatencyFlag = 1;
+
+  /* remove the old frames */
+  flushFrameList(videoStream);
+}
+
+
+/* accurate seek : before decoding a pkt */
+/* discard the non reference frames before the target */
+static void setPrerollDiscard(VideoBitStream* videoStream, AVPacket* pkt)
+{
+  /* the pkt duration help to find the frame showing the target */
+  if(pkt->duration > 0)
+    videoStream->frameDuration = pkt->duration;
+
+  /* the pts of a non reference frame pkt is its display pts */
+  //the reference frames are always decoded
+  enum AVDiscard skipFrame = AVDISCARD_DEFAULT;
+
+  if(pkt->pts != AV_NOPTS_VALUE && videoStream->frameDuration > 0)
+    if(ptsToClock(videoStream, pkt->pts + videoStream->frameDuration) <= videoStream->prerollClock)
+      skipFrame = AVDISCARD_NONREF;
+
+  videoStream->codec->skip_frame = skipFrame;
+}
+
+
+/* the preroll is done */
+static void endPreroll(VideoBitStream* videoStream)
+{
+  videoStream->prerollClock = UINT32_MAX;
+  videoStream->codec->skip_frame = AVDISCARD_DEFAULT;  //the catch-up was reset by the seek
+}
+
+
+/* accurate seek : check if a decoded frame */
+/* is displayed before the target */
+/* return 1 if the frame need to be dropped */
+static int checkPrerollFrame(VideoBitStream* videoStream, int64_t pts)
+{
+  uint32_t ptsClock = ptsToClock(videoStream, pts);
+  int showTargetFlag;
+
+  /* without pts we can't do better */
+  if(ptsClock == UINT32_MAX)
+    showTargetFlag = 1;
+  else if(videoStream->frameDuration > 0)
+    showTargetFlag = (ptsToClock(videoStream, pts + videoStream->frameDuration) > videoStream->prerollClock);
+  else
+    showTargetFlag = (ptsClock >= videoStream->prerollClock);
+
+  if(!showTargetFlag)
+    return 1;
+  
+  /* this is the first displayed frame */
+  endPreroll(videoStream);
+  return 0;
+}
+
+
+uint32_t WV_getVideoSeekLatency(WVVideoStreamHandle streamHdl)
+{
+  VideoBitStream* videoStream = (VideoBitStream*)streamHdl;
+
+  return videoStream->seekLatency;
+}
+
+
+uint64_t WV_getVideoFirstFrameTime(WVVideoStreamHandle streamHdl)
+{
+  VideoBitStream* videoStream = (VideoBitStream*)streamHdl;
+
+  return videoStream->firstFrameTime;
+}
+
+  
+
+ 
+/**********************************/
+/*||||||||||||||||||||||||||||||||*/
+/*          TRICK PLAY            */
+/*||||||||||||||||||||||||||||||||*/
+/**********************************/
+
+/* ask the packet feeder to move to the clock */
+//the step pkt say to the decoder to keep its frames
+static void requestTrickStep(VideoBitStream* videoStream, uint32_t clock, int flags)
+{
+  /* one step at a time */
+  if(videoStream->trickStepFlag)
+    return;
+
+  if(WV_contextStep(videoStream->feederHdl, videoStream->formatCtx, videoStream->streamIdx, \
+		    clockToPts(videoStream, clock), flags) >= 0)
+    videoStream->trickStepFlag = 1;
+}
+
+
+/* select the keyframes in keyframe and rewind mode */
+/* and step to the next ones */
+/* return 1 if the frame need to be dropped */
+static int checkTrickStep(VideoBitStream* videoStream, int64_t pts)
+{
+  /* we can't say anything without pts */
+  uint32_t ptsClock = ptsToClock(videoStream, pts);
+  if(ptsClock == UINT32_MAX)
+    return 0;
+
+  uint32_t clock = getTrickClock(videoStream);
+  uint32_t stepThreshold = WV_TRICK_PLAY_STEP_DELAY * abs(videoStream->trickRate);
+
+  /***********/
+  /* forward */
+  /***********/
+  /* the keyframes are read in order */
+  if(videoStream->trickRate > 0){
+    if(ptsClock + stepThreshold >= clock)
+      return 0;
+
+    /* too late, jump to the clock */
+    requestTrickStep(videoStream, clock, 0);
+    videoStream->droppedFrames++;
+    return 1;
+  }
+
+  /**********/
+  /* rewind */
+  /**********/
+  /* the seek give the same keyframe, we are at start */
+  if(videoStream->trickStepClock != UINT32_MAX && ptsClock >= videoStream->trickStepClock){
+    videoStream->trickEndFlag = 1;
+    return 1;
+  }
+
+  /* the clock is already before, go to it */
+  if(ptsClock > clock + stepThreshold){
+    requestTrickStep(videoStream, clock, AVSEEK_FLAG_BACKWARD);
+    videoStream->droppedFrames++;
+    return 1;
+  }
+
+  /* keep the frame and go to the previous keyframe */
+  videoStream->trickStepClock = ptsClock;
+  
+  if(ptsClock == 0)
+    videoStream->trickEndFlag = 1;
+  else
+    requestTrickStep(videoStream, (clock < ptsClock)? clock : ptsClock - 1, AVSEEK_FLAG_BACKWARD);
+
+  return 0;
+}
+
+
+/* the step pkt is read */
+static void stepVideoStream(VideoBitStream* videoStream)
+{
+  videoStream->trickStepFlag = 0;
+
+  /* the codec restart from a keyframe */
+  avcodec_flush_buffers(videoStream->codec);
+}
+
+
+/* choose the trick mode and set the codec */
+static void setTrickMode(VideoBitStream* videoStream, int rate, uint32_t clock)
+{
+  int trickMode;
+  
+  if(rate == 1)
+    trickMode = TRICK_NONE;
+  else if(rate < 0)
+    trickMode = TRICK_REWIND;
+  else if(rate <= WV_TRICK_PLAY_DROP_MAX_RATE)
+    trickMode = TRICK_DROP;
+  else
+    trickMode = TRICK_KEYFRAME;
+  
+  /* the trick clock start now */
+  videoStream->trickMode = trickMode;
+  videoStream->trickRate = rate;
+  videoStream->trickBaseTime = WV_getEngineTime();
+  videoStream->trickBaseClock = clock;
+  videoStream->trickStepClock = UINT32_MAX;
+  videoStream->trickStepFlag = 0;   //a pending step is harmless
+  videoStream->trickEndFlag = 0;
+  
+  /* start at full quality */
+  resetCatchUp(videoStream);
+
+  /* the trick play don't show the cached loop */
+  if(trickMode != TRICK_NONE)
+    stopFrameCache(videoStream);
+
+  /* decode only the keyframes */
+  //the demuxer can skip the others
+  enum AVDiscard discard = AVDISCARD_DEFAULT;
+  
+  if(trickMode == TRICK_KEYFRAME || trickMode == TRICK_REWIND){
+    videoStream->codec->skip_frame = AVDISCARD_NONKEY;
+    discard = AVDISCARD_NONKEY;
+  }
+
+  //the catch-up level is already NONE, back to rate 1
+  //the codec need to decode all the frames again
+  if(trickMode == TRICK_NONE)
+    videoStream->codec->skip_frame = AVDISCARD_DEFAULT;
+
+  if(videoStream->formatCtx)
+    WV_setStreamDiscard(videoStream->feederHdl, videoStream->formatCtx, videoStream->streamIdx, discard);
+
+  /* the scheduled refresh use the previous clock */
+  if(videoStream->refreshStatus == REFRESH_LAUNCHED && cancelRefresh(videoStream))
+    videoStream->refreshStatus = NO_REFRESH;
+
+  /* rewind : the decoded frames are after the clock */
+  /* remove them and go to the keyframe before the clock */
+  if(trickMode == TRICK_REWIND){
+    flushFrameList(videoStream);
+    requestTrickStep(videoStream, clock, AVSEEK_FLAG_BACKWARD);
+  }
+}
+
+
+uint32_t WV_getVideoTrickClock(WVVideoStreamHandle streamHdl)
+{
+  VideoBitStream* videoStream = (VideoBitStream*)streamHdl;
+
+  //the trick clock is changed only by the commands
+  return getTrickClock(videoStream);
+}
+
+
+/*******************************/
+/* ||||||||||||||||||||||||||| */
+/*         FRAME CACHE         */
+/* ||||||||||||||||||||||||||| */
+/*******************************/
+
+void WV_setVideoFrameCacheLimits(uint32_t maxStreamSize, uint32_t maxSize)
+{
+  frameCacheMaxStreamSize = maxStreamSize;
+  frameCacheMaxSize = maxSize;
+}
+
+
+uint32_t WV_getVideoFrameCacheSize(WVVideoDecoderHandle decoderHdl)
+{
+  VideoDecoder* decoder = (VideoDecoder*)decoderHdl;
+
+  SDL_mutexP(frameCacheMutex);
+  uint32_t frameCacheSize = decoder->frameCacheSize;
+  SDL_mutexV(frameCacheMutex);
+
+  return frameCacheSize;
+}
+
+
+/* at the loop eof, start recording or replaying */
+static void loopFrameCache(VideoBitStream* videoStream)
+{
+  /* the trick play don't show the entire loop */
+  if(videoStream->trickMode != TRICK_NONE)
+    return;
+
+  switch(videoStream->frameCacheState){
+
+  case FRAME_CACHE_WAIT :
+    videoStream->frameCacheState = FRAME_CACHE_RECORD;
+    break;
+
+  case FRAME_CACHE_RECORD :
+  case FRAME_CACHE_READY :
+    //if nothing was recorded, record the next loop
+    if(videoStream->cacheFirst){
+      videoStream->cachePos = videoStream->cacheFirst;
+      videoStream->replayEofCount = 0;
+      videoStream->frameCacheState = FRAME_CACHE_REPLAY;
+    }
+    else{
+      videoStream->frameCacheState = FRAME_CACHE_RECORD;
+    }
+    break;
+
+  case FRAME_CACHE_RESYNC :
+    //the queue reached the cache end
+    videoStream->cachePos = videoStream->cacheFirst;
+    videoStream->replayEofCount = 0;
+    videoStream->frameCacheState = FRAME_CACHE_REPLAY;
+    break;
+  }
+}
+
 
-  /* free the codec internal buffers */
-  avcodec_flush_buffers(videoStream->codec);
+/* replay : drop the pkts replaced by the cached frames */
+//one per replayed frame, so the feeder keep its pace
+//and the other queues of the context are not blocked.
+//The queue is resynced on its eof at each cache end
+static void dropReplayedPacket(VideoBitStream* videoStream)
+{
+  AVPacket* pkt = WV_packetQueueGet(videoStream->queueHdl, WV_QUEUE_GET_DOESNT_WAIT);
+  if(!pkt)
+    return;
 
-  WVStreamingObject* streamObj = videoStream->streamObj;
-  int nbSlots = streamObj->nbSlots;  
+  /* normal pkt */
+  if(pkt->data){
+    av_free_packet(pkt);
+    free(pkt);
+    return;
+  }
 
+  /* special pkts */
+  //the eof are replaced by the cache end
+  if(pkt->flags == WV_PACKET_FLAG_EOF)
+    videoStream->replayEofCount++;
   
-  /* if the list is void, nothing to do */
-  if(videoStream->refreshPos == videoStream->writePos && videoStream->fullVoidFlag == 0)
-    return;
+  if(pkt->flags == WV_PACKET_FLAG_SEEK)
+    seekVideoStream(videoStream);   //stop the replay
 
-  /* try to remove the last timer */
-  /* we let sdl see if the timer already done */
-  SDL_bool timerFreeFlag;
+  if(pkt->flags == WV_PACKET_FLAG_STEP)
+    stepVideoStream(videoStream);
 
-  if(videoStream->refreshStatus == REFRESH_LAUNCHED){
-    //!!! on some systems, Remove timer return false event if the timer is removed ??
-    timerFreeFlag = SDL_RemoveTimer(videoStream->lastTimer);
-    videoStream->refreshStatus = NO_REFRESH;
-  }
-  else{
-    timerFreeFlag = SDL_TRUE;
-    
-    /* go to the next refreshPos */
-    if(videoStream->refreshStatus == REFRESH_DONE){
-      videoStream->refreshPos++;
-      /* check for return */
-      if(videoStream->refreshPos >= nbSlots)
-	videoStream->refreshPos = 0;
-      /* check for void */
-      if(videoStream->refreshPos == videoStream->writePos)
-	videoStream->fullVoidFlag = 0; //void
-      
-      videoStream->writeAccessFlag = 0; //lock access (for async)
-      videoStream->refreshStatus = NO_REFRESH;
+  free(pkt);
+}
+
+
+/* replay : load the next cached frame */
+/* return -1 if the frames need to be decoded again */
+static int replayCachedFrame(VideoBitStream* videoStream)
+{
+  /* first follow the queue */
+  dropReplayedPacket(videoStream);
+  if(videoStream->frameCacheState != FRAME_CACHE_REPLAY)
+    return -1;
+
+  /* the cache end is the loop eof */
+  if(!videoStream->cachePos){
+    /* the next source start at the file eof */
+    if(videoStream->nextQueueHdl){
+      videoStream->frameCacheState = FRAME_CACHE_SKIP;
+      return -1;
     }
-  }
 
-  /* reset */
-  if(timerFreeFlag == SDL_TRUE){
-    videoStream->writePos = videoStream->refreshPos;
-    videoStream->fullVoidFlag = 0; //void
-  }
-  else{
-    videoStream->writePos = videoStream->refreshPos + 1;
-    if(videoStream->writePos >= nbSlots)
-      videoStream->writePos = 0;
+    /* the queue is behind the cache */
+    //more pkts than frames, skip its pkts until the loop eof
+    //that restart the replay
+    if(!videoStream->replayEofCount){
+      videoStream->frameCacheState = FRAME_CACHE_RESYNC;
+      return -1;
+    }
+    videoStream->replayEofCount--;
+    
+    videoStream->eofPos = videoStream->writePos; //when we increase modIdx
+    videoStream->cachePos = videoStream->cacheFirst;
   }
 
+  /* load */
+  CachedFrame* cachedFrame = videoStream->cachePos;
+  int writePos = videoStream->writePos;
   
-    
+  videoStream->cachePos = cachedFrame->nextFrame;
+  videoStream->framePts[writePos] = cachedFrame->pts;
+  loadCachedFrame(videoStream, writePos, cachedFrame);
+
+  return 0;
 }
 
-  
 
- 
+
 /**********************************/
 /*||||||||||||||||||||||||||||||||*/
 /*       VIDEO DECODER            */
@@ -743,6 +2497,10 @@ static void seekVideoStream(VideoBitStream* videoStream)
 /* the decoder need to know if he can write to the frame buffer */
 static int canWrite(VideoBitStream* videoStream)
 {
+  /* rewind reached the stream start */
+  if(videoStream->trickEndFlag)
+    return 0;
+  
   /* check if the list is full/void */
   if(videoStream->writePos == videoStream->refreshPos){
     if(videoStream->fullVoidFlag == 1)
@@ -767,65 +2525,63 @@ static int canWrite(VideoBitStream* videoStream)
 }
   
 
-/* check the loading method */
-static void loadVideoFrame(VideoBitStream* videoStream, AVFrame* decodedFrame)
+/***********************************************/
+/* get the next pkt to decode                  */
+/* while draining, the eof pkt is held and the */
+/* codec get drain pkts until it give nothing  */
+/***********************************************/
+static AVPacket* getVideoPacket(VideoBitStream* videoStream)
 {
-  WVStreamingObject* streamObj = videoStream->streamObj;
-  
-  /******************************/
-  /*   check getBuffer method   */
-  /******************************/
-  //can't use getInRefreshFlag because may we don't do get at all 
-  if(videoStream->getInDecodeFlag){
-    videoStream->frameBuffer[videoStream->writePos] = streamObj->getBuffer(streamObj, videoStream->writePos);
-  }
-  
-  /*********************/
-  /* check lock method */
-  /*********************/
-  if(streamObj->lockBuffer && videoStream->LRInDecodeFlag){
-    streamObj->lockBuffer(streamObj, videoStream->writePos);
+  if(videoStream->eofPkt){
+    /* the codec may have more frames */
+    if(videoStream->drainGotFrame)
+      return WV_getDrainPacket();
+
+    /* drained, give back the eof pkt */
+    AVPacket* eofPkt = videoStream->eofPkt;
+    videoStream->eofPkt = NULL;
+    videoStream->drainDoneFlag = 1;
+    return eofPkt;
   }
 
-  /********/
-  /* load */
-  /********/
-  WVStreamingBuffer* outputBuffer = &(videoStream->frameBuffer[videoStream->writePos]); 
-  
-  /* check if we can use the context */
-  /* we see that we can change buffer size and format */
-  videoStream->swsCtx = sws_getCachedContext(videoStream->swsCtx,	\
-					     videoStream->codec->width,	\
-					     videoStream->codec->height,\
-					     videoStream->codec->pix_fmt, \
-					     outputBuffer->width,\
-					     outputBuffer->height,\
-					     outputBuffer->format,\
-					     swsFlags, NULL, NULL, NULL);
-
-  /* scale */
-  sws_scale(videoStream->swsCtx,\
-	    (const uint8_t* const*)decodedFrame->data, decodedFrame->linesize,\
-	    0, videoStream->codec->height,\
-	    outputBuffer->data, outputBuffer->linesize);
-
-
-  /***********************/
-  /* check buffer filter */
-  /***********************/
-  if(streamObj->filterBuffer)
-    streamObj->filterBuffer(streamObj, videoStream->writePos, outputBuffer);
-
+  return WV_packetQueueGet(videoStream->queueHdl, WV_QUEUE_GET_WAIT);
+}
 
 
-  /************************/
-  /* check release method */
-  /************************/
-  if(streamObj->releaseBuffer && videoStream->LRInDecodeFlag){
-    streamObj->releaseBuffer(streamObj, videoStream->writePos);
+/***********************************************/
+/* at eof, continue with the next source       */
+/* the old queue and codec are no longer used  */
+/* the splice signal can free them             */
+/***********************************************/
+static void spliceVideoSource(VideoBitStream* videoStream)
+{
+  videoStream->queueHdl = videoStream->nextQueueHdl;
+  videoStream->codec = videoStream->nextCodec;
+  videoStream->timeBase = videoStream->nextTimeBase;
+  videoStream->nextQueueHdl = NULL;
+  videoStream->nextCodec = NULL;
+
+  /* trick play step in the new context */
+  if(videoStream->formatCtx){
+    videoStream->formatCtx = videoStream->nextFormatCtx;
+    videoStream->streamIdx = videoStream->nextStreamIdx;
   }
 
+  /* the new codec start at full quality */
+  //the src change is checked at the next frame
+  resetCatchUp(videoStream);
 
+  /* the cached frames show the old source */
+  dropFrameCache(videoStream);
+  if(!videoStream->frameCacheFlag)
+    videoStream->frameCacheState = FRAME_CACHE_NONE;
+  else if(videoStream->trickMode != TRICK_NONE)
+    videoStream->frameCacheState = FRAME_CACHE_WAIT;
+  else
+    videoStream->frameCacheState = FRAME_CACHE_RECORD;
+
+  /* signal */
+  videoStream->spliceCall(videoStream->spliceParam);
 }
 
 
@@ -840,23 +2596,53 @@ static int decodeVideo(VideoBitStream* videoStream)
   int got_picture = 0;
   AVFrame* decodedFrame = videoStream->decodedFrame;
   
-  while(!got_picture){
+  while(!got_picture && !videoStream->trickEndFlag){
+
+    /******************************/
+    /* the loop is replayed from  */
+    /* the frame cache            */
+    /******************************/
+    if(videoStream->frameCacheState == FRAME_CACHE_REPLAY && replayCachedFrame(videoStream) >= 0)
+      return 0;
   
     /*******************/
     /* get a video pkt */
     /*******************/
-    AVPacket* pkt = WV_packetQueueGet(videoStream->queueHdl, WV_QUEUE_GET_WAIT);
+    AVPacket* pkt = getVideoPacket(videoStream);
 
     /* we check if is a speciak pkt */
     /* if this is the case, do the corresponding job */
-    while(pkt->data == NULL){
+    //the drain pkts are decoded
+    while(pkt->data == NULL && pkt->flags != WV_PACKET_FLAG_DRAIN){
     
       /*--------------*/
       /* the eof case */
       /*--------------*/
       if(pkt->flags == WV_PACKET_FLAG_EOF){
+
+	/* first get the delayed frames */
+	//the eof pkt is threaded again when the codec is drained
+	if(!videoStream->drainDoneFlag &&				\
+	   (videoStream->codec->codec->capabilities & CODEC_CAP_DELAY)){
+	  videoStream->eofPkt = pkt;
+	  pkt = WV_getDrainPacket();
+	  break;
+	}
+	videoStream->drainDoneFlag = 0;
+	
 	videoStream->eofPos = videoStream->writePos; //when we increase modIdx
 	avcodec_flush_buffers(videoStream->codec);
+
+	/* the target is after the last frame */
+	if(videoStream->prerollClock != UINT32_MAX)
+	  endPreroll(videoStream);
+
+	/* continue with the next source */
+	//the mod at eofPos give the new clock
+	if(videoStream->nextQueueHdl)
+	  spliceVideoSource(videoStream);
+	else
+	  loopFrameCache(videoStream);
       }
       
       /*---------------*/
@@ -867,19 +2653,52 @@ static int decodeVideo(VideoBitStream* videoStream)
                                          //is set because if the seeking is done by a command
                                          //the seeking pkt is removed
       }
+
+      /*---------------*/
+      /* the step case */
+      /*---------------*/
+      if(pkt->flags == WV_PACKET_FLAG_STEP){
+	stepVideoStream(videoStream);
+      }
       
       
       /* free the special pkt and get another */
       //don't use av_free_packet !!!
       free(pkt);
-      pkt = WV_packetQueueGet(videoStream->queueHdl, WV_QUEUE_GET_WAIT);
+      pkt = NULL;
+
+      /* the next loop come from the frame cache */
+      if(videoStream->frameCacheState == FRAME_CACHE_REPLAY)
+	break;
+      
+      pkt = getVideoPacket(videoStream);
+    }
+
+    if(!pkt)
+      continue;
+
+    /* a next source is set after the cached loop */
+    /* or the queue is behind the cache */
+    /* skip the file until its eof */
+    if((videoStream->frameCacheState == FRAME_CACHE_SKIP ||		\
+	videoStream->frameCacheState == FRAME_CACHE_RESYNC) && pkt->data){
+      av_free_packet(pkt);
+      free(pkt);
+      continue;
     }
 
 
     /******************/
     /* decode the pkt */
     /******************/
+    if(videoStream->prerollClock != UINT32_MAX && pkt->data)
+      setPrerollDiscard(videoStream, pkt);
+    
     WV_decodeVideo(videoStream->codec, decodedFrame, &got_picture, pkt);
+
+    /* while draining, continue until the codec give nothing */
+    if(videoStream->eofPkt)
+      videoStream->drainGotFrame = got_picture;
     
 
     /******************/
@@ -887,6 +2706,41 @@ static int decodeVideo(VideoBitStream* videoStream)
     /******************/
     av_free_packet(pkt);  //seem ffmpeg never need partials pkts
     free(pkt);
+
+    /**************************/
+    /* drop the late frames   */
+    /* before the conversion  */
+    /**************************/
+    if(got_picture){
+      /* accurate seek : the frames before the target are not displayed */
+      if(videoStream->prerollClock != UINT32_MAX){
+	if(checkPrerollFrame(videoStream, WV_getFramePts(decodedFrame)))
+	  got_picture = 0;
+      }
+      /* keyframe and rewind trick play select the frames by steps */
+      else if(videoStream->trickMode == TRICK_KEYFRAME || videoStream->trickMode == TRICK_REWIND){
+	if(checkTrickStep(videoStream, WV_getFramePts(decodedFrame)))
+	  got_picture = 0;
+      }
+      /* the recorded loop keep all its frames */
+      else if(videoStream->frameCacheState != FRAME_CACHE_RECORD &&	\
+	      checkLateFrame(videoStream, WV_getFramePts(decodedFrame)))
+	got_picture = 0;
+    }
+  }
+
+  /* rewind reached the stream start */
+  if(!got_picture)
+    return -1;
+
+  /* the first frame of the stream */
+  if(!videoStream->firstFrameTime)
+    videoStream->firstFrameTime = WV_getMicroTime();
+  
+  /* the first frame after the seek */
+  if(videoStream->seekLatencyFlag){
+    videoStream->seekLatency = (uint32_t)(WV_getMicroTime() - videoStream->seekStartTime);
+    videoStream->seekLatencyFlag = 0;
   }
 
   
@@ -901,15 +2755,60 @@ static int decodeVideo(VideoBitStream* videoStream)
   //if we have AV_NOPTS_VALUE, the getPtsClock function will return UINT32_MAX
     
 
+  /*****************************/
+  /* check if the src changed   */
+  /*****************************/
+  checkSourceChange(videoStream);
+  
+
+  /*****************************/
+  /* lazy conversion : keep the */
+  /* frame in the codec format  */
+  /*****************************/
+  int writePos = videoStream->writePos;
+
+  /* native upload : the object */
+  /* upload the frame itself */
+  if(videoStream->uploadFlag){
+    if(WV_keepNativeFrame(&videoStream->nativeFrames[writePos], videoStream->codec, decodedFrame) >= 0)
+      videoStream->slotFlag[writePos] |= SLOT_FLAG_NATIVE;
+    //if we can't keep it, the slot show the previous frame
+    return 0;
+  }
+  
+  //the recorded frames are converted by the decoder
+  if(videoStream->conversionMethod == WV_LAZY_CONVERSION &&	\
+     videoStream->frameCacheState != FRAME_CACHE_RECORD){
+    if(WV_keepNativeFrame(&videoStream->nativeFrames[writePos], videoStream->codec, decodedFrame) >= 0){
+      videoStream->slotFlag[writePos] |= SLOT_FLAG_NATIVE;
+      return 0;
+    }
+    //if we can't keep it, convert now
+  }
+  
+
   /**************************/
   /* now scale and save the */
   /* output frame           */
   /**************************/
-  loadVideoFrame(videoStream, decodedFrame);
+  loadVideoFrame(videoStream, writePos,					\
+		 decodedFrame->data, decodedFrame->linesize,		\
+		 videoStream->codec->width, videoStream->codec->height, videoStream->codec->pix_fmt, \
+		 videoStream->frameCacheState == FRAME_CACHE_RECORD);
 
   /* done */
   return 0;
 }
+
+
+/* the decode task */
+//the streams of a decoder are decoded in parallel
+static void decodeVideoTask(void* param)
+{
+  VideoBitStream* videoStream = (VideoBitStream*)param;
+
+  videoStream->decodeResult = decodeVideo(videoStream);
+}
    
 
   
@@ -930,45 +2829,36 @@ static int decodeVideo(VideoBitStream* videoStream)
 //pauseVideo doesn't need to send a command to the decoder
 //playVideo  doesn't need to send a command to the decoder
 #define VIDEO_DECODER_QUIT 4
+#define VIDEO_DECODER_TRICK 5
+#define VIDEO_DECODER_NEXT_SOURCE 6
 
-static int decoderCommand;    //where the client put the command
-
-static SDL_mutex* cmdMutex;
-static SDL_cond* cmdExecuted;  //the client need to wait for command execution 
-                               //before continuing
-                               //WAIT (client) : "I have sent you a command say me 
-                               //                 the work is done"
-                               //SIGNAL (decoder) : "Well, command terminated"
-
-
-static int deleteStreamIdx;               //when we delete we give the stream idx to the decoder
-static WVVideoStreamHandle seekingStreamHandle;  //when we seek we give the stream to the decoder 
+//the command and its parameters are in the VideoDecoder struct
 
 
 
 /* !!! very important function !!! */
 /* used each time we send a command to the decoder */
 /* send a command, signal state change, and wait for execution */
-static void sendDecoderCommand(int cmd)
+static void sendDecoderCommand(VideoDecoder* decoder, int cmd)
 {
   /* send the command to the decoder */
-  SDL_mutexP(cmdMutex);
-  decoderCommand = cmd;
+  SDL_mutexP(decoder->cmdMutex);
+  decoder->decoderCommand = cmd;
   
   /* signal that state is updated */
-  SDL_mutexP(stateUpdatedMutex);    //change the state flag
-  stateUpdatedFlag = 1;
-  SDL_mutexV(stateUpdatedMutex);
+  SDL_mutexP(decoder->stateUpdatedMutex);    //change the state flag
+  decoder->stateUpdatedFlag = 1;
+  SDL_mutexV(decoder->stateUpdatedMutex);
 
-  SDL_CondSignal(stateUpdated);  //say to the decoder that it can thread commands
+  SDL_CondSignal(decoder->stateUpdated);  //say to the decoder that it can thread commands
                                  //or restart decoding                                  
                                  //if he was waiting 
   
   /* wait for command execution */
-  SDL_CondWait(cmdExecuted, cmdMutex); 
+  SDL_CondWait(decoder->cmdExecuted, decoder->cmdMutex); 
   
   /* release command variable  */
-  SDL_mutexV(cmdMutex);
+  SDL_mutexV(decoder->cmdMutex);
 }
 
 
@@ -982,25 +2872,40 @@ static void sendDecoderCommand(int cmd)
 /***************************************************/
 
 /* return a stream handle */
-WVVideoStreamHandle WV_addVideoStream(WVQueueHandle queueHdl,   \
+WVVideoStreamHandle WV_addVideoStream(WVVideoDecoderHandle decoderHdl,	\
+				      WVQueueHandle queueHdl,   \
 				      AVCodecContext* codec,    \
 				      AVRational timeBase,      \
 				      WVStreamingObject* streamObj,	\
-				      WVSyncObject* VSync)
+				      WVSyncObject* VSync,		\
+				      int conversionMethod,		\
+				      int presentMethod,		\
+				      int frameCacheFlag,		\
+				      SDL_Rect* cropRect,		\
+				      int outputWidth,			\
+				      int outputHeight)
   
 {
+  VideoDecoder* decoder = (VideoDecoder*)decoderHdl;
+
   /****************************/
   /* fill the streamObj struct*/
   /* there values are needed  */
   /* by init()                */
   /****************************/
-  streamObj->srcWidth = codec->width;
-  streamObj->srcHeight = codec->height;
+  SDL_Rect srcRect;
+  
+  getSourceRegion(codec, cropRect, outputWidth, outputHeight,		\
+		  &srcRect, &streamObj->srcWidth, &streamObj->srcHeight);
   streamObj->srcFormat = codec->pix_fmt;
 
+  /* choose the buffer format */
+  WV_negotiateStreamingFormat(streamObj);
+
   /* now init the streaming obj */
-  if(streamObj->init)
-    streamObj->init(streamObj);
+  //the stream can't be added if it fail
+  if(streamObj->init && streamObj->init(streamObj) < 0)
+    return NULL;
 
   /**********************/
   /*  to do             */
@@ -1020,8 +2925,11 @@ WVVideoStreamHandle WV_addVideoStream(WVQueueHandle queueHdl,   \
   int frameBufferSize = nbSlots * sizeof(WVStreamingBuffer);
   int slotFlagSize = nbSlots * sizeof(int);
   int framePtsSize = nbSlots * sizeof(int64_t);
+  int nativeFramesSize = 0;
+  if(conversionMethod == WV_LAZY_CONVERSION || streamObj->uploadFrame)
+    nativeFramesSize = nbSlots * sizeof(WVNativeFrame);
   
-  int totalSize =  structSize + frameBufferSize + slotFlagSize + framePtsSize; 
+  int totalSize =  structSize + frameBufferSize + slotFlagSize + framePtsSize + nativeFramesSize; 
 
   newStream = (VideoBitStream*)malloc(totalSize);
 
@@ -1031,6 +2939,7 @@ WVVideoStreamHandle WV_addVideoStream(WVQueueHandle queueHdl,   \
   /*******************/
  
   /* user params */
+  newStream->decoder = decoder;
   newStream->queueHdl = queueHdl;
   newStream->codec = codec;
   newStream->timeBase = timeBase;
@@ -1041,13 +2950,36 @@ WVVideoStreamHandle WV_addVideoStream(WVQueueHandle queueHdl,   \
   /* the frame to decode */
   newStream->decodedFrame = avcodec_alloc_frame();
 
-  /* the swscale context */
-  newStream->swsCtx = NULL;  //use getCatchedContext
+  /* the slice scaler */
+  newStream->sliceScaler = WV_getSliceScaler();
+  newStream->conversionTime = 0;
+
+  /* the source region */
+  newStream->cropRect.x = newStream->cropRect.y = 0;
+  newStream->cropRect.w = newStream->cropRect.h = 0;
+  if(cropRect)
+    newStream->cropRect = *cropRect;
+  newStream->outputWidth = outputWidth;
+  newStream->outputHeight = outputHeight;
+  newStream->srcRect = srcRect;
+  newStream->codecWidth = codec->width;
+  newStream->codecHeight = codec->height;
+  newStream->codecFormat = codec->pix_fmt;
+
+  /* native upload */
+  //the object can upload only the entire frames
+  newStream->uploadFlag = (streamObj->uploadFrame != NULL &&		\
+			   srcRect.w == codec->width && srcRect.h == codec->height && \
+			   streamObj->srcWidth == codec->width && streamObj->srcHeight == codec->height);
+  newStream->uploadableFlag = newStream->uploadFlag;
+  newStream->srcChangeFlag = 0;
   
      
   /******************************/
   /* init the frame buffer list */
   /******************************/
+  int i;
+
   newStream->refreshPos = 0;  
   newStream->writePos = 0;
   newStream->fullVoidFlag = 0; //void 
@@ -1064,14 +2996,19 @@ WVVideoStreamHandle WV_addVideoStream(WVQueueHandle queueHdl,   \
   structP += frameBufferSize;
   newStream->slotFlag = (uint32_t*)structP;
 
+  for(i=0; i<nbSlots; i++){
+    newStream->slotFlag[i] = SLOT_FLAG_NONE;
+    newStream->frameBuffer[i].data[0] = NULL;  //got later with native upload
+  }
+
 
   /*****************************/
   /* if we have static buffers */
   /* get it now                */
   /*****************************/
-  int i;
 
-  if(streamObj->getBuffer && streamObj->getBufferMethod == WV_STATIC_GET){
+  //with native upload the object doesn't give buffers
+  if(streamObj->getBuffer && streamObj->getBufferMethod == WV_STATIC_GET && !newStream->uploadFlag){
     for(i=0; i<streamObj->nbSlots; i++){
       newStream->frameBuffer[i] = streamObj->getBuffer(streamObj, i);
     }
@@ -1107,6 +3044,10 @@ WVVideoStreamHandle WV_addVideoStream(WVQueueHandle queueHdl,   \
     newStream->LRInDecodeFlag = 1;
   }
 
+  /* the fan-out outputs fed in decode are thread safe */
+  //so its conversions don't hold the object lock
+  newStream->releaseUnlockedFlag = WV_isStreamFanoutObj(streamObj);
+
   /* get in decode */
   if(streamObj->getBuffer &&				\
      streamObj->getBufferMethod == WV_DYNAMIC_GET &&\
@@ -1115,6 +3056,15 @@ WVVideoStreamHandle WV_addVideoStream(WVQueueHandle queueHdl,   \
     newStream->getInDecodeFlag = 1;
   }
 
+  /* with native upload */
+  /* nothing is get or locked */
+  if(newStream->uploadFlag){
+    newStream->LRInRefreshFlag = 0;
+    newStream->getInRefreshFlag = 0;
+    newStream->LRInDecodeFlag = 0;
+    newStream->getInDecodeFlag = 0;
+  }
+
 
   /*******************************/
   /* init the buffer if get or   */
@@ -1176,22 +3126,104 @@ WVVideoStreamHandle WV_addVideoStream(WVQueueHandle queueHdl,   \
 
   for(i=0; i<streamObj->nbSlots; i++)
     newStream->framePts[i] = AV_NOPTS_VALUE;
+
+  /**********************/
+  /* the native frames  */
+  /* (lazy conversion   */
+  /*  or native upload) */
+  /**********************/
+  newStream->conversionMethod = conversionMethod;
+  newStream->nativeFrames = NULL;
+
+  if(conversionMethod == WV_LAZY_CONVERSION || newStream->uploadFlag){
+    /* after the pts list */
+    structP += framePtsSize;
+    newStream->nativeFrames = (WVNativeFrame*)structP;
+  
+    for(i=0; i<streamObj->nbSlots; i++)
+      WV_initNativeFrame(&newStream->nativeFrames[i]);
+  }
  
   /* timer */
   newStream->startTimerT = 0;
   newStream->timerDelay = 0;
 
+  /* present */
+  newStream->presentMethod = presentMethod;
+  newStream->pullPendingFlag = 0;
+  newStream->pullCode = 0;
+  newStream->pullDueTime = 0;
+
+  /* catch-up */
+  newStream->catchUpLevel = CATCH_UP_NONE;
+  newStream->lateCount = 0;
+  newStream->inTimeCount = 0;
+  newStream->dropSequence = 0;
+  newStream->droppedFrames = 0;
+
+  /* trick play */
+  newStream->trickMode = TRICK_NONE;
+  newStream->trickRate = 1;
+  newStream->trickBaseTime = 0;
+  newStream->trickBaseClock = 0;
+  newStream->trickStepClock = UINT32_MAX;
+  newStream->trickStepFlag = 0;
+  newStream->trickEndFlag = 0;
+  newStream->feederHdl = NULL;
+  newStream->formatCtx = NULL;
+  newStream->streamIdx = -1;
+
+  /* seek */
+  newStream->seekingDoneFlag = 0;
+  newStream->accurateSeekClock = UINT32_MAX;
+  newStream->seekStartTime = 0;
+  newStream->seekLatencyFlag = 0;
+  newStream->seekLatency = 0;
+  newStream->firstFrameTime = 0;
+  newStream->prerollClock = UINT32_MAX;
+  newStream->frameDuration = 0;
+
   /* eof */
   newStream->eofSignalPos = -1;
   newStream->eofSignalHandle = NULL;
+
+  newStream->eofPkt = NULL;
+  newStream->drainGotFrame = 0;
+  newStream->drainDoneFlag = 0;
+
+  /* no next source */
+  newStream->nextQueueHdl = NULL;
+  newStream->nextCodec = NULL;
+  newStream->nextFormatCtx = NULL;
+  newStream->nextStreamIdx = -1;
+  newStream->spliceCall = NULL;
+  newStream->spliceParam = NULL;
+
+  /* frame cache */
+  //the native upload don't use converted frames
+  newStream->frameCacheFlag = frameCacheFlag;
+  if(newStream->uploadFlag)
+    newStream->frameCacheFlag = WV_NO_FRAME_CACHE;
+
+  if(newStream->frameCacheFlag)
+    newStream->frameCacheState = FRAME_CACHE_RECORD;  //record from the stream start
+  else
+    newStream->frameCacheState = FRAME_CACHE_NONE;
+  newStream->cacheFirst = NULL;
+  newStream->cacheLast = NULL;
+  newStream->cachePos = NULL;
+  newStream->replayEofCount = 0;
+  newStream->cacheSize = 0;
  
   /******************************/
   /* add the stream to the list */
   /******************************/
-  videoStreams[nbVideoStream] = newStream;
+  SDL_mutexP(decoder->clientMutex);
+  decoder->videoStreams[decoder->nbVideoStream] = newStream;
 
   /* send the command */
-  sendDecoderCommand(VIDEO_DECODER_ADD_STREAM);
+  sendDecoderCommand(decoder, VIDEO_DECODER_ADD_STREAM);
+  SDL_mutexV(decoder->clientMutex);
 
   // the decoder increase nbVideoStream
 
@@ -1200,10 +3232,10 @@ WVVideoStreamHandle WV_addVideoStream(WVQueueHandle queueHdl,   \
 }
 
 
-static void videoDecoderAddStream(void)
+static void videoDecoderAddStream(VideoDecoder* decoder)
 {
   /* update the stream count */
-  nbVideoStream++;
+  decoder->nbVideoStream++;
 }
 
 
@@ -1217,10 +3249,9 @@ static void videoDecoderAddStream(void)
 /***************************************************/
 static void freeVideoStream(VideoBitStream* deletedStream)
 {
-  /* remove the last timer if needed */
+  /* remove the scheduled refresh if needed */
   if(deletedStream->refreshStatus == REFRESH_LAUNCHED){
-    //!!! on some systems, Remove timer return false event if the timer is removed !!
-    SDL_RemoveTimer(deletedStream->lastTimer);
+    cancelRefresh(deletedStream);
     deletedStream->refreshStatus = NO_REFRESH;
   }
 
@@ -1233,9 +3264,23 @@ static void freeVideoStream(VideoBitStream* deletedStream)
   /* free the decoded frame */
   av_free(deletedStream->decodedFrame);
 
-  /* free the swscale context */
-  if(deletedStream->swsCtx)
-    sws_freeContext(deletedStream->swsCtx);
+  /* free the held eof pkt */
+  if(deletedStream->eofPkt)
+    free(deletedStream->eofPkt);
+
+  /* free the cached frames */
+  dropFrameCache(deletedStream);
+
+  /* free the native frames */
+  if(deletedStream->nativeFrames){
+    int i;
+    for(i=0; i<deletedStream->streamObj->nbSlots; i++)
+      WV_freeNativeFrame(&deletedStream->nativeFrames[i]);
+  }
+
+  /* free the slice scaler */
+  if(deletedStream->sliceScaler)
+    WV_freeSliceScaler(deletedStream->sliceScaler);
 
   /* free the stream struct */
   /* it was allocated in one time */
@@ -1246,18 +3291,23 @@ static void freeVideoStream(VideoBitStream* deletedStream)
 
 int WV_delVideoStream(WVVideoStreamHandle streamHdl)
 {
+  VideoDecoder* decoder = ((VideoBitStream*)streamHdl)->decoder;
+
   /* find the stream */
+  SDL_mutexP(decoder->clientMutex);
   int i = 0;
-  while(videoStreams[i] != streamHdl && i<nbVideoStream)
+  while(decoder->videoStreams[i] != streamHdl && i<decoder->nbVideoStream)
     i++;
 
   /* found ? */
-  if(i == nbVideoStream)
+  if(i == decoder->nbVideoStream){
+    SDL_mutexV(decoder->clientMutex);
     return -1;              //cannot find the stream
+  }
   //else the stream is in videoStreams[i]
 
   /* give the command parameter */
-  deleteStreamIdx = i;
+  decoder->deleteStreamIdx = i;
 
   /* ! save the streaming object  ! */
   /* ! to later closing           ! */
@@ -1265,7 +3315,8 @@ int WV_delVideoStream(WVVideoStreamHandle streamHdl)
   WVStreamingObject* closingObj = deletedStream->streamObj;
   
   /* and send the command */
-  sendDecoderCommand(VIDEO_DECODER_DEL_STREAM);
+  sendDecoderCommand(decoder, VIDEO_DECODER_DEL_STREAM);
+  SDL_mutexV(decoder->clientMutex);
   
   /* ! now we can close the streaming object  ! */
   if(closingObj->close)
@@ -1275,20 +3326,20 @@ int WV_delVideoStream(WVVideoStreamHandle streamHdl)
   return 0;
 }
 
-static void videoDecoderDelStream(void)
+static void videoDecoderDelStream(VideoDecoder* decoder)
 {
   /* get the deleted stream */
-  VideoBitStream* deletedStream = videoStreams[deleteStreamIdx];
+  VideoBitStream* deletedStream = decoder->videoStreams[decoder->deleteStreamIdx];
   
   /* free the stream */
   freeVideoStream(deletedStream);
 
   /* now shift the other streams */
   /* we use the variable deleteStreamIdx to do the job */
-  nbVideoStream--;     //update the stream count now !
-  while(deleteStreamIdx < nbVideoStream){  //shift the list  
-    videoStreams[deleteStreamIdx] = videoStreams[deleteStreamIdx+1];
-    deleteStreamIdx++;
+  decoder->nbVideoStream--;     //update the stream count now !
+  while(decoder->deleteStreamIdx < decoder->nbVideoStream){  //shift the list  
+    decoder->videoStreams[decoder->deleteStreamIdx] = decoder->videoStreams[decoder->deleteStreamIdx+1];
+    decoder->deleteStreamIdx++;
   }
 
 }
@@ -1330,11 +3381,15 @@ void WV_stopVideoEOFSignalHandle(WVVideoStreamHandle streamHdl)
 
 int WV_seekVideo(WVVideoStreamHandle streamHdl)
 {
+  VideoDecoder* decoder = ((VideoBitStream*)streamHdl)->decoder;
+
   /* recast the pointer */
-  seekingStreamHandle = streamHdl;
+  SDL_mutexP(decoder->clientMutex);
+  decoder->seekingStreamHandle = streamHdl;
 
   /* send the command */
-  sendDecoderCommand(VIDEO_DECODER_SEEK);
+  sendDecoderCommand(decoder, VIDEO_DECODER_SEEK);
+  SDL_mutexV(decoder->clientMutex);
 
   //the decoder remove the seeking pkt (if needed)
   // and seek (if not already done)
@@ -1344,10 +3399,10 @@ int WV_seekVideo(WVVideoStreamHandle streamHdl)
 }
 
 
-static void videoDecoderSeek(void)
+static void videoDecoderSeek(VideoDecoder* decoder)
 {
   /* read command parameter */
-  VideoBitStream* seekingStream = (VideoBitStream*)seekingStreamHandle; 
+  VideoBitStream* seekingStream = (VideoBitStream*)decoder->seekingStreamHandle; 
   
   /* if seeking is already done by reading a seeking pkt return */
   if(seekingStream->seekingDoneFlag)
@@ -1371,6 +3426,98 @@ static void videoDecoderSeek(void)
 
 
 
+/***************************************************/
+/*  The command : VIDEO_DECODER_TRICK              */
+/*  -first the user space function                 */
+/*  -next the decoder space function               */
+/***************************************************/
+void WV_setVideoTrickRate(WVVideoStreamHandle streamHdl, int rate, uint32_t clock, \
+			  WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, int streamIdx)
+{
+  VideoDecoder* decoder = ((VideoBitStream*)streamHdl)->decoder;
+
+  /* set the command params */
+  SDL_mutexP(decoder->clientMutex);
+  decoder->trickStreamHandle = streamHdl;
+  decoder->trickRateParam = rate;
+  decoder->trickClockParam = clock;
+  decoder->trickFeederHdl = feederHdl;
+  decoder->trickFormatCtx = formatCtx;
+  decoder->trickStreamIdx = streamIdx;
+
+  /* send the command */
+  sendDecoderCommand(decoder, VIDEO_DECODER_TRICK);
+  SDL_mutexV(decoder->clientMutex);
+}
+
+
+static void videoDecoderTrick(VideoDecoder* decoder)
+{
+  /* read command parameter */
+  VideoBitStream* trickStream = (VideoBitStream*)decoder->trickStreamHandle;
+
+  trickStream->feederHdl = decoder->trickFeederHdl;
+  trickStream->formatCtx = decoder->trickFormatCtx;
+  trickStream->streamIdx = decoder->trickStreamIdx;
+
+  setTrickMode(trickStream, decoder->trickRateParam, decoder->trickClockParam);
+}
+
+
+
+
+
+/***************************************************/
+/*  The command : VIDEO_DECODER_NEXT_SOURCE        */
+/*  -first the user space function                 */
+/*  -next the decoder space function               */
+/***************************************************/
+int WV_setVideoNextSource(WVVideoStreamHandle streamHdl, WVQueueHandle queueHdl, \
+			  AVCodecContext* codec, AVRational timeBase,	\
+			  AVFormatContext* formatCtx, int streamIdx,	\
+			  WVSpliceSignalCall spliceCall, void* spliceParam)
+{
+  VideoDecoder* decoder = ((VideoBitStream*)streamHdl)->decoder;
+
+  /* the splice need to be signaled */
+  if(queueHdl && !spliceCall)
+    return -1;
+
+  /* set the command params */
+  SDL_mutexP(decoder->clientMutex);
+  decoder->nextSourceStreamHandle = streamHdl;
+  decoder->nextSourceQueueHdl = queueHdl;
+  decoder->nextSourceCodec = codec;
+  decoder->nextSourceTimeBase = timeBase;
+  decoder->nextSourceFormatCtx = formatCtx;
+  decoder->nextSourceStreamIdx = streamIdx;
+  decoder->nextSourceSpliceCall = spliceCall;
+  decoder->nextSourceSpliceParam = spliceParam;
+
+  /* send the command */
+  sendDecoderCommand(decoder, VIDEO_DECODER_NEXT_SOURCE);
+  SDL_mutexV(decoder->clientMutex);
+
+  return 0;
+}
+
+
+static void videoDecoderNextSource(VideoDecoder* decoder)
+{
+  /* read command parameter */
+  VideoBitStream* stream = (VideoBitStream*)decoder->nextSourceStreamHandle;
+
+  stream->nextQueueHdl = decoder->nextSourceQueueHdl;
+  stream->nextCodec = decoder->nextSourceCodec;
+  stream->nextTimeBase = decoder->nextSourceTimeBase;
+  stream->nextFormatCtx = decoder->nextSourceFormatCtx;
+  stream->nextStreamIdx = decoder->nextSourceStreamIdx;
+  stream->spliceCall = decoder->nextSourceSpliceCall;
+  stream->spliceParam = decoder->nextSourceSpliceParam;
+}
+
+
+
 
 /***************************************************/
 /*  The command : VIDEO_DECODER_QUIT               */
@@ -1378,22 +3525,39 @@ static void videoDecoderSeek(void)
 /*  -next the decoder space function               */
 /***************************************************/
 
-int WV_videoDecoderShutdown(void)
+int WV_videoDecoderShutdown(WVVideoDecoderHandle decoderHdl)
 {
+  VideoDecoder* decoder = (VideoDecoder*)decoderHdl;
+
+  /* the clocks can't signal it now */
+  SDL_mutexP(videoDecodersMutex);
+  int i = 0;
+  while(videoDecoders[i] != decoder)
+    i++;
+  nbVideoDecoder--;
+  while(i < nbVideoDecoder){
+    videoDecoders[i] = videoDecoders[i+1];
+    i++;
+  }
+  int lastDecoderFlag = (nbVideoDecoder == 0);
+  SDL_mutexV(videoDecodersMutex);
+
   /* ! save all the streaming objects ! */
   /* ! for later close                ! */
-  WVStreamingObject** decoderObj = (WVStreamingObject**)malloc(nbVideoStream * sizeof(WVStreamingObject*));
-  int nbDecoderObj = nbVideoStream;
+  SDL_mutexP(decoder->clientMutex);
+  WVStreamingObject** decoderObj = (WVStreamingObject**)malloc(decoder->nbVideoStream * sizeof(WVStreamingObject*));
+  int nbDecoderObj = decoder->nbVideoStream;
 
-  int i;
   for(i=0; i<nbDecoderObj; i++)
-    decoderObj[i] = videoStreams[i]->streamObj;
+    decoderObj[i] = decoder->videoStreams[i]->streamObj;
 
   /* send directly the command */
-  sendDecoderCommand(VIDEO_DECODER_QUIT);
+  sendDecoderCommand(decoder, VIDEO_DECODER_QUIT);
+  SDL_mutexV(decoder->clientMutex);
 
   //the decoder free all the streams,
   //and stop his thread
+  SDL_WaitThread(decoder->thread, NULL);
 
   /* ! free the saved streaming objects ! */
   WVStreamingObject* closingObj;
@@ -1406,23 +3570,38 @@ int WV_videoDecoderShutdown(void)
 
   free(decoderObj);
 
+  /* the refresh scheduler and the task runtime */
+  /* are shared, stop them with the last decoder */
+  if(lastDecoderFlag){
+    WV_refreshSchedulerShutdown();
+    WV_sliceScalerShutdown();
+  }
+
   /* now close thread communication */
-  SDL_DestroyMutex(stateUpdatedMutex);
-  SDL_DestroyCond(stateUpdated);
+  SDL_DestroyMutex(decoder->stateUpdatedMutex);
+  SDL_DestroyCond(decoder->stateUpdated);
+
+  SDL_DestroyMutex(decoder->clientMutex);
+  SDL_DestroyMutex(decoder->cmdMutex);
+  SDL_DestroyCond(decoder->cmdExecuted);
+
+  SDL_DestroyMutex(decoder->pullMutex);
 
-  SDL_DestroyMutex(cmdMutex);
-  SDL_DestroyCond(cmdExecuted);
+  SDL_DestroyMutex(decoder->objectMutex);
+  WV_freeTaskGroup(decoder->decodeGroup);
+
+  free(decoder);
 
   /* it's ok */
   return 0;
 }
 
-static void videoDecoderQuit(void)
+static void videoDecoderQuit(VideoDecoder* decoder)
 {
   /* free all the streams */
   int i;
-  for(i=0; i<nbVideoStream; i++)
-    freeVideoStream(videoStreams[i]);
+  for(i=0; i<decoder->nbVideoStream; i++)
+    freeVideoStream(decoder->videoStreams[i]);
 }
 
 
@@ -1437,6 +3616,7 @@ static void videoDecoderQuit(void)
 
 static int videoDecoderThread(void* opaque)
 {
+  VideoDecoder* decoder = (VideoDecoder*)opaque;
   int needRelaunchFlag = 0; //at start we don't have streams
 
   while(1){
@@ -1444,57 +3624,65 @@ static int videoDecoderThread(void* opaque)
     /*********************/
     /* check for waiting */
     /*********************/
-    SDL_mutexP(stateUpdatedMutex);
+    SDL_mutexP(decoder->stateUpdatedMutex);
 
-    if(!stateUpdatedFlag && !needRelaunchFlag){
+    if(!decoder->stateUpdatedFlag && !needRelaunchFlag){
       /* if nothing append and we have no lacking, wait */
-      SDL_CondWait(stateUpdated, stateUpdatedMutex);
+      SDL_CondWait(decoder->stateUpdated, decoder->stateUpdatedMutex);
     }
     
 
     /* reinit state variables */
-    stateUpdatedFlag = 0;            //we will see if something append during the loop
+    decoder->stateUpdatedFlag = 0;            //we will see if something append during the loop
     needRelaunchFlag = 0;       
 
-    SDL_mutexV(stateUpdatedMutex);
+    SDL_mutexV(decoder->stateUpdatedMutex);
     
     
     /**************************/
     /* check for user command */
     /**************************/
-    SDL_mutexP(cmdMutex);
+    SDL_mutexP(decoder->cmdMutex);
     
-    if(decoderCommand){
-      switch(decoderCommand){
+    if(decoder->decoderCommand){
+      switch(decoder->decoderCommand){
 	
       case VIDEO_DECODER_ADD_STREAM:
-	videoDecoderAddStream();
+	videoDecoderAddStream(decoder);
 	break;
 
       case VIDEO_DECODER_DEL_STREAM:
-	videoDecoderDelStream();
+	videoDecoderDelStream(decoder);
 	break;
 	
       case VIDEO_DECODER_SEEK:
-	videoDecoderSeek();
+	videoDecoderSeek(decoder);
+	break;
+
+      case VIDEO_DECODER_TRICK:
+	videoDecoderTrick(decoder);
+	break;
+
+      case VIDEO_DECODER_NEXT_SOURCE:
+	videoDecoderNextSource(decoder);
 	break;
 	
       case VIDEO_DECODER_QUIT:
-	videoDecoderQuit();
-	decoderCommand = VIDEO_DECODER_NO_COMMAND;
-	SDL_mutexV(cmdMutex);
-	SDL_CondSignal(cmdExecuted);
+	videoDecoderQuit(decoder);
+	decoder->decoderCommand = VIDEO_DECODER_NO_COMMAND;
+	SDL_mutexV(decoder->cmdMutex);
+	SDL_CondSignal(decoder->cmdExecuted);
 	return 0;                  //get out of this loop !!!
 	break;
       }
       
       /* the command is executed, say this to the client */
-      decoderCommand = VIDEO_DECODER_NO_COMMAND;
-      SDL_mutexV(cmdMutex);                     
-      SDL_CondSignal(cmdExecuted);
+      decoder->decoderCommand = VIDEO_DECODER_NO_COMMAND;
+      SDL_mutexV(decoder->cmdMutex);                     
+      SDL_CondSignal(decoder->cmdExecuted);
     }
     else{    //else just release the cmd mutex 
-      SDL_mutexV(cmdMutex);
+      SDL_mutexV(decoder->cmdMutex);
     }
 
 
@@ -1506,9 +3694,12 @@ static int videoDecoderThread(void* opaque)
     
     int i;
     VideoBitStream* currStream;
+    int allocFlags[WV_VIDEO_DECODER_MAX_STREAMS];
+    int decodeFlags[WV_VIDEO_DECODER_MAX_STREAMS];
+    int nbDecodedStreams = 0;
     
-    for(i=0; i<nbVideoStream; i++){
-      currStream = videoStreams[i];
+    for(i=0; i<decoder->nbVideoStream; i++){
+      currStream = decoder->videoStreams[i];
       
       /*********************/
       /* check for refresh */
@@ -1575,7 +3766,8 @@ static int videoDecoderThread(void* opaque)
       /**********************/
       /* check for decoding */
       /**********************/
-      int allocFlag = 0;
+      allocFlags[i] = 0;
+      decodeFlags[i] = 0;
       
       if(canWrite(currStream)){
 	
@@ -1584,29 +3776,58 @@ static int videoDecoderThread(void* opaque)
 	   (currStream->slotFlag[currStream->writePos] & SLOT_FLAG_ALLOC)){
 	  /* alloc */
 	  launchRefreshImmediately(currStream, 1);
-	  allocFlag = 1;
+	  allocFlags[i] = 1;
 	}
 	
 	else{
-	/* decode */
-	  if(decodeVideo(currStream)>=0){
-	    currStream->writePos++;
-	    /* check for return */
-	    if(currStream->writePos >= currStream->streamObj->nbSlots)
-	      currStream->writePos = 0;
-	    /* check for full */
-	    if(currStream->writePos == currStream->refreshPos)
-	      currStream->fullVoidFlag = 1; //full
-	  }
+	  /* decode below */
+	  decodeFlags[i] = 1;
+	  nbDecodedStreams++;
 	}
 	
       }
-	  
+    }
+
+
+    /***************************/
+    /* decode the streams in   */
+    /* parallel, one task per  */
+    /* stream                  */
+    /***************************/
+    if(nbDecodedStreams > 1){
+      for(i=0; i<decoder->nbVideoStream; i++){
+	if(decodeFlags[i])
+	  WV_submitTask(decoder->decodeGroup, WV_TASK_PRIORITY_VIDEO, \
+			decodeVideoTask, decoder->videoStreams[i]);
+      }
+      WV_waitTaskGroup(decoder->decodeGroup);
+    }
+    else{
+      for(i=0; i<decoder->nbVideoStream; i++){
+	if(decodeFlags[i])
+	  decodeVideoTask(decoder->videoStreams[i]);
+      }
+    }
+
+    
+    for(i=0; i<decoder->nbVideoStream; i++){
+      currStream = decoder->videoStreams[i];
+
+      /* the frame is decoded */
+      if(decodeFlags[i] && currStream->decodeResult >= 0){
+	currStream->writePos++;
+	/* check for return */
+	if(currStream->writePos >= currStream->streamObj->nbSlots)
+	  currStream->writePos = 0;
+	/* check for full */
+	if(currStream->writePos == currStream->refreshPos)
+	  currStream->fullVoidFlag = 1; //full
+      }
       
       /*************************************/
       /* check if we can continue decoding */
       /*************************************/
-      if(canWrite(currStream) && !allocFlag)
+      if(canWrite(currStream) && !allocFlags[i])
 	needRelaunchFlag = 1;
 
       /***************************/
@@ -1637,39 +3858,83 @@ static int videoDecoderThread(void* opaque)
 /*||||||||||||||||||||||||||||||||||*/
 /************************************/
 
-int WV_initVideoDecoder(void)
+WVVideoDecoderHandle WV_initVideoDecoder(void)
 {
-  
+  /* the decoder registry */
+  if(!videoDecodersMutex)
+    videoDecodersMutex = SDL_CreateMutex();
+
+  /* the frame cache memory of all the decoders */
+  if(!frameCacheMutex)
+    frameCacheMutex = SDL_CreateMutex();
+
+  if(nbVideoDecoder >= WV_MAX_ENGINES)
+    return NULL;
+
+  /********************************/
+  /* the first decoder launch the */
+  /* shared refresh scheduler and */
+  /* task runtime                 */
+  /********************************/
+  if(nbVideoDecoder == 0){
+    if(WV_initRefreshScheduler() < 0)
+      return NULL;
+
+    if(WV_initSliceScaler() < 0)
+      return NULL;
+  }
+
+  /* alloc the decoder */
+  VideoDecoder* decoder = (VideoDecoder*)malloc(sizeof(VideoDecoder));
+  if(!decoder)
+    return NULL;
+
+  /* the streams are decoded in this group */
+  decoder->decodeGroup = WV_getTaskGroup();
+  if(!decoder->decodeGroup){
+    free(decoder);
+    return NULL;
+  }
+
   /*****************************/
   /* init communication system */
   /*****************************/
-  stateUpdatedMutex = SDL_CreateMutex();
-  stateUpdated = SDL_CreateCond();
-  stateUpdatedFlag = 0;   //wait at start
+  decoder->stateUpdatedMutex = SDL_CreateMutex();
+  decoder->stateUpdated = SDL_CreateCond();
+  decoder->stateUpdatedFlag = 0;   //wait at start
+
+  decoder->clientMutex = SDL_CreateMutex();
+  decoder->cmdMutex = SDL_CreateMutex();
+  decoder->cmdExecuted = SDL_CreateCond();
 
-  cmdMutex = SDL_CreateMutex();
-  cmdExecuted = SDL_CreateCond();
+  decoder->pullMutex = SDL_CreateMutex();
+
+  decoder->objectMutex = SDL_CreateMutex();
     
   /************************/
   /* init state variables */
   /************************/
-  nbVideoStream = 0;
-  decoderCommand = VIDEO_DECODER_NO_COMMAND;
+  decoder->nbVideoStream = 0;
+  decoder->decoderCommand = VIDEO_DECODER_NO_COMMAND;
+  decoder->frameCacheSize = 0;
 
   /*****************************/
   /* launch the decoder thread */
   /*****************************/
   #if SDL_VERSION_ATLEAST(2,0,0)
-  SDL_CreateThread(videoDecoderThread, "videoThread", NULL);
+  decoder->thread = SDL_CreateThread(videoDecoderThread, "videoThread", decoder);
   #else
-  SDL_CreateThread(videoDecoderThread, NULL);
+  decoder->thread = SDL_CreateThread(videoDecoderThread, decoder);
   #endif
 
-  
-
+  /* register it for the clocks */
+  SDL_mutexP(videoDecodersMutex);
+  videoDecoders[nbVideoDecoder] = decoder;
+  nbVideoDecoder++;
+  SDL_mutexV(videoDecodersMutex);
   
   /* all is ok */
-  return 0;
+  return (WVVideoDecoderHandle)decoder;
 }
 
 
@@ -39,6 +39,26 @@
 
 /* abstract pointer for the user */
 typedef void* WVVideoStreamHandle;
+typedef void* WVVideoDecoderHandle;
+
+
+/* the conversion method */
+//convert the frames to the streaming object format when decoded
+#define WV_EARLY_CONVERSION 0
+//keep the decoded frames and convert only the refreshed frames
+#define WV_LAZY_CONVERSION 1
+
+/* the present method */
+//the refresh are pushed with WV_REFRESH_EVENT
+#define WV_PUSH_PRESENT 0
+//the user present the due refresh 
+#define WV_PULL_PRESENT 1
+
+/* the frame cache */
+//each loop is decoded
+#define WV_NO_FRAME_CACHE 0
+//the converted frames of the first loop are kept and replayed
+#define WV_FRAME_CACHE 1
 
 
 /********************/
@@ -53,13 +73,27 @@ typedef void* WVVideoStreamHandle;
 void WV_refreshVideoFrame(SDL_Event* refreshEvent);
 
 
+/* !!! or in pull mode present the due frames !!! */
+/* "now" is given by the refresh scheduler time base (us) */
+/* must be called by the thread that add/del the streams */
+
+/* present all the due frames of a decoder, return the number of new frames */
+int WV_presentDueVideoFrames(WVVideoDecoderHandle decoderHdl, uint64_t now);
+
+/* present the due frame of one stream */
+/* return 1 if a new frame was presented, 0 if not, -1 if not in pull mode */
+int WV_presentVideoFrame(WVVideoStreamHandle streamHdl, uint64_t now);
+
+
 
 
 /****************************/
 /* INIT                     */
 /* first launch the decoder */
+/* one per engine, each has */
+/* its own thread           */
 /****************************/
-int WV_initVideoDecoder(void);
+WVVideoDecoderHandle WV_initVideoDecoder(void);
 
 
 
@@ -69,16 +103,34 @@ int WV_initVideoDecoder(void);
 /* !!! at start the stream is paused !!!*/
 /****************************************/
 
+/* the lowres level to set before opening the codec */
+//decode at the smallest size at or above the output size
+int WV_getVideoLowres(AVCodecContext* codec, AVCodec* decoder,	\
+		      SDL_Rect* cropRect, int outputWidth, int outputHeight);
+
 /* add a stream and return a stream handle */
-WVVideoStreamHandle WV_addVideoStream(WVQueueHandle queueHdl,  \
+//cropRect is in full size coords, NULL for the entire frame
+//outputWidth/outputHeight 0 to keep the source size
+WVVideoStreamHandle WV_addVideoStream(WVVideoDecoderHandle decoderHdl, \
+				      WVQueueHandle queueHdl,  \
 				      AVCodecContext* codec,   \
 				      AVRational timeBase,		\
 				      WVStreamingObject* streamObj,	\
-				      WVSyncObject* VSync);
+				      WVSyncObject* VSync,		\
+				      int conversionMethod,		\
+				      int presentMethod,		\
+				      int frameCacheFlag,		\
+				      SDL_Rect* cropRect,		\
+				      int outputWidth,			\
+				      int outputHeight);
 
 /* del a stream */
 int WV_delVideoStream(WVVideoStreamHandle streamHdl);
 
+/* choose the cheapest format accepted by a streaming object */
+//from its src format, also used by the objects feeding other objects
+void WV_negotiateStreamingFormat(WVStreamingObject* streamObj);
+
 
 
 /*****************************/
@@ -99,7 +151,8 @@ void WV_stopVideoEOFSignalHandle(WVVideoStreamHandle streamHdl);
 /*!!! to seek you need to follow three step !!!*/
 
 /* 1) prepare seeking  */
-void WV_startVideoSeeking(WVVideoStreamHandle streamHdl);
+/*    accurate clock is the first displayed frame, UINT32_MAX to start at the keyframe */
+void WV_startVideoSeeking(WVVideoStreamHandle streamHdl, uint32_t accurateClock);
 
 /* 2) send a seek command to the packet feeder */
 // it's here you set where seek
@@ -107,18 +160,85 @@ void WV_startVideoSeeking(WVVideoStreamHandle streamHdl);
 /* 3) send a seek command to the audio decoder */
 int WV_seekVideo(WVVideoStreamHandle streamHdl);
 
+/* the time between the last seek and its first frame (us) */
+uint32_t WV_getVideoSeekLatency(WVVideoStreamHandle streamHdl);
+
+/* when the first frame of the stream was decoded (us), 0 before */
+uint64_t WV_getVideoFirstFrameTime(WVVideoStreamHandle streamHdl);
+
 
 
 /**********/
 /* CLOSE  */
 /**********/
-int WV_videoDecoderShutdown(void);
+int WV_videoDecoderShutdown(WVVideoDecoderHandle decoderHdl);
+
+
+
+
+/*********************************/
+/* DROPPED FRAMES                */
+/* the late frames not displayed */
+/*********************************/
+uint32_t WV_getVideoDroppedFrames(WVVideoStreamHandle streamHdl);
+
+
+/*************************************/
+/* CONVERSION                        */
+/* the number of conversion slices   */
+/* and the last frame conversion time*/
+/*************************************/
+void WV_setVideoConversionSlices(WVVideoStreamHandle streamHdl, int nbSlices);
+
+uint32_t WV_getVideoConversionTime(WVVideoStreamHandle streamHdl);
+
+
+/*************************************/
+/* FRAME CACHE                       */
+/* the memory taken by the cached    */
+/* loops, per stream and per decoder */
+/*************************************/
+void WV_setVideoFrameCacheLimits(uint32_t maxStreamSize, uint32_t maxSize);
+
+uint32_t WV_getVideoFrameCacheSize(WVVideoDecoderHandle decoderHdl);
+
+
+/**************************************/
+/* TRICK PLAY                         */
+/* the video follow its own clock at  */
+/* rate times the real time, 1 to     */
+/* return to the sync object          */
+/* negative rates rewind              */
+/**************************************/
+
+/* the feeder, formatCtx and streamIdx are needed to step with the packet feeder */
+void WV_setVideoTrickRate(WVVideoStreamHandle streamHdl, int rate, uint32_t clock, \
+			  WVPacketFeederHandle feederHdl, AVFormatContext* formatCtx, int streamIdx);
+
+/* the current trick play clock */
+uint32_t WV_getVideoTrickClock(WVVideoStreamHandle streamHdl);
+
 
+/*****************************************/
+/* NEXT SOURCE                           */
+/* at the next eof, after the codec is   */
+/* drained, the stream continue with the */
+/* given queue and codec without gap     */
+/* spliceCall is called by the decoder   */
+/* when the source is switched           */
+/* (a NULL queueHdl remove the source)   */
+/*****************************************/
+int WV_setVideoNextSource(WVVideoStreamHandle streamHdl, WVQueueHandle queueHdl, \
+			  AVCodecContext* codec, AVRational timeBase,	\
+			  AVFormatContext* formatCtx, int streamIdx,	\
+			  WVSpliceSignalCall spliceCall, void* spliceParam);
 
 
 
 /******************/
 /* used by clocks */
+/* signal all the */
+/* decoders       */
 /******************/
 void WV_videoDecoderSignal(void);
 
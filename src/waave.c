@@ -37,71 +37,177 @@
 #include "audio_video_sync.h"
 #include "clock_video_sync.h"
 #include "eof_signal.h"
+#include "refresh_scheduler.h"
+#include "thumbnail_extractor.h"
+#include "stream_fanout.h"
+#include "stream_loader.h"
+#include "probe_cache.h"
+#include "task_runtime.h"
+#include "time_source.h"
 
 
 #define WAAVE_INIT_NONE 0
 #define WAAVE_INIT_AUDIO 1
 #define WAAVE_INIT_VIDEO 2
 
-static int packetFeederStartedFlag = 0;
-static int audioDecoderStartedFlag = 0;
-static int videoDecoderStartedFlag = 0;
+/* used by the playback control before their definition */
+int WV_setPlaybackRate(WVStream* stream, int rate);
+int WV_seekStream(WVStream* stream, uint32_t clock);
 
+/* used by the stream load before its definition */
+static int prepareStreamLoad(WVStream* stream);
+static int openStreamCodecs(WVStream* stream);
+static void closeStreamCodecs(WVStream* stream);
+static int addStreamToEngine(WVStream* stream);
+static void commitSplice(WVStream* stream);
 
-int WV_waaveInit(int flag)
+
+static int streamLoaderStartedFlag = 0;
+
+/* the default engine */
+/* used by the streams without engine */
+static WVEngine defaultEngine = {WAAVE_INIT_NONE, NULL, NULL, NULL, NULL, NULL};
+
+/* the streams whose decoders all switched to the next item */
+//the sources are swapped by the main thread
+static WVStream* spliceList = NULL;
+static SDL_mutex* spliceListMutex = NULL;
+
+/* the video loads finished by the main thread */
+//the streaming object init may need it (textures, overlays)
+static struct StreamReadyJob* loadList = NULL;
+static SDL_mutex* loadListMutex = NULL;
+
+
+/* launch the engine threads given by flag */
+//the already running threads are kept
+static int startEngine(WVEngine* engine, int flag, const char* audioDevice)
 {
-  /* launch ffmpeg */
-  av_register_all();
-  
-  /* init waave engine flags */
-  #if SDL_VERSION_ATLEAST(2,0,0)
-  initWaaveEngineFlags();
-  #endif
+  if(!engine->engineMutex)
+    engine->engineMutex = SDL_CreateMutex();
+
+  if(!engine->spliceMutex)
+    engine->spliceMutex = SDL_CreateMutex();
+
+  if(!spliceListMutex)
+    spliceListMutex = SDL_CreateMutex();
 
   /* launch packet feeder */
   if(flag & WAAVE_INIT_AUDIO || flag & WAAVE_INIT_VIDEO){
-    if(!packetFeederStartedFlag){
-      WV_initPacketFeeder();
-      packetFeederStartedFlag = 1;
+    if(!engine->feeder){
+      engine->feeder = WV_initPacketFeeder();
+      if(!engine->feeder)
+	return -1;
     }
   }
 
   /* launch audio decoder */
   if(flag & WAAVE_INIT_AUDIO){
-    if(!audioDecoderStartedFlag){
-      WV_initAudioDecoder();
-      audioDecoderStartedFlag = 1;
+    if(!engine->audioDecoder){
+      engine->audioDecoder = WV_initAudioDecoder(audioDevice);
+      if(!engine->audioDecoder)
+	return -1;
     }
   }
 
   /* launch video decoder */
   if(flag & WAAVE_INIT_VIDEO){
-    if(!videoDecoderStartedFlag){
-      WV_initVideoDecoder();
-      videoDecoderStartedFlag = 1;
+    if(!engine->videoDecoder){
+      engine->videoDecoder = WV_initVideoDecoder();
+      if(!engine->videoDecoder)
+	return -1;
     }
   }
 
+  engine->flag |= flag;
+
   return 0;
 }
 
 
-int WV_waaveClose(void)
+/* stop all the engine threads */
+//the streams need to be closed
+static void stopEngine(WVEngine* engine)
 {
   /* close video decoder */
-  if(videoDecoderStartedFlag)
-    WV_videoDecoderShutdown();
+  if(engine->videoDecoder){
+    WV_videoDecoderShutdown(engine->videoDecoder);
+    engine->videoDecoder = NULL;
+  }
 
   /* close audio decoder */
-  if(audioDecoderStartedFlag)
-    WV_audioDecoderShutdown();
+  if(engine->audioDecoder){
+    WV_audioDecoderShutdown(engine->audioDecoder);
+    engine->audioDecoder = NULL;
+  }
 
   /* close packet feeder */
-  if(packetFeederStartedFlag)
-    WV_packetFeederShutdown();
+  if(engine->feeder){
+    WV_packetFeederShutdown(engine->feeder);
+    engine->feeder = NULL;
+  }
+
+  if(engine->engineMutex){
+    SDL_DestroyMutex(engine->engineMutex);
+    engine->engineMutex = NULL;
+  }
+
+  if(engine->spliceMutex){
+    SDL_DestroyMutex(engine->spliceMutex);
+    engine->spliceMutex = NULL;
+  }
+
+  engine->flag = WAAVE_INIT_NONE;
+}
+
+
+int WV_waaveInit(int flag)
+{
+  /* launch ffmpeg */
+  av_register_all();
+  WV_initFFmpegLock();
+  
+  /* init waave engine flags */
+  #if SDL_VERSION_ATLEAST(2,0,0)
+  initWaaveEngineFlags();
+  #endif
+
+  /* the probe cache, disabled */
+  WV_initProbeCache();
+
+  /* launch the default engine */
+  startEngine(&defaultEngine, flag, NULL);
+
+  /* launch the stream loader */
+  if(!loadListMutex)
+    loadListMutex = SDL_CreateMutex();
+  
+  if(!streamLoaderStartedFlag){
+    if(WV_initStreamLoader() >= 0)
+      streamLoaderStartedFlag = 1;
+  }
+
+  return 0;
+}
+
+
+int WV_waaveClose(void)
+{
+  /* close the stream loader */
+  //finish the pending jobs
+  if(streamLoaderStartedFlag){
+    WV_streamLoaderShutdown();
+    streamLoaderStartedFlag = 0;
+  }
+  
+  /* close the default engine */
+  stopEngine(&defaultEngine);
 
   /* close ffmpeg */
   //seems there are no function to close av_register_all
+  WV_closeFFmpegLock();
+
+  WV_probeCacheShutdown();
 
 
   return 0; 
@@ -110,8 +216,188 @@ int WV_waaveClose(void)
 
 
 
+/***********************/
+/* the other engines   */
+/* scale the workload  */
+/***********************/
+
+WVEngine* WV_createEngine(int flag, const char* audioDevice)
+{
+  /* alloc and launch */
+  WVEngine* engine = (WVEngine*)malloc(sizeof(WVEngine));
+  if(!engine)
+    return NULL;
+
+  engine->flag = WAAVE_INIT_NONE;
+  engine->feeder = NULL;
+  engine->audioDecoder = NULL;
+  engine->videoDecoder = NULL;
+  engine->engineMutex = NULL;
+  engine->spliceMutex = NULL;
+
+  if(startEngine(engine, flag, audioDevice) < 0){
+    stopEngine(engine);
+    free(engine);
+    return NULL;
+  }
+
+  return engine;
+}
+
+
+int WV_destroyEngine(WVEngine* engine)
+{
+  /* the default engine is closed by WV_waaveClose */
+  if(!engine || engine == &defaultEngine)
+    return -1;
+
+  stopEngine(engine);
+  free(engine);
+
+  return 0;
+}
+
+
+int WV_setStreamEngine(WVStream* stream, WVEngine* engine)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
+
+  /* the stream need to be not loaded */
+  if(stream->audioQueueHdl || stream->videoQueueHdl)
+    return -1;
+
+  if(!engine)
+    engine = &defaultEngine;
+
+  stream->engine = engine;
+
+  return 0;
+}
+
+
+/* the task workers are shared by the engines */
+//they are launched with the first decoder
+int WV_setTaskWorkers(int nbWorkers, const int* cpus)
+{
+  return WV_setTaskRuntimeWorkers(nbWorkers, cpus);
+}
+
+
+
+/* the audio tracks */
+/* the master track is driven by the sync object */
+/* the others follow it */
+
+static int isOtherTrack(WVStream* stream, int track)
+{
+  return stream->audioTracks[track].streamHdl && track != stream->masterTrack;
+}
+
+
+static void playAudioTracks(WVStream* stream)
+{
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++)
+    if(isOtherTrack(stream, track) && stream->audioTracks[track].activeFlag)
+      WV_playAudio(stream->audioTracks[track].streamHdl);
+}
+
+
+static void pauseAudioTracks(WVStream* stream)
+{
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++)
+    if(isOtherTrack(stream, track))
+      WV_pauseAudio(stream->audioTracks[track].streamHdl);
+}
+
+
+/* the inactive tracks are always seeked paused */
+static void startAudioTracksSeeking(WVStream* stream, int seekFlag, uint32_t accurateClock)
+{
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++){
+    WVAudioTrack* audioTrack = &stream->audioTracks[track];
+    if(audioTrack->streamHdl)
+      WV_startAudioSeeking(audioTrack->streamHdl,			\
+			   audioTrack->activeFlag? seekFlag : WV_BLOCKING_SEEK, \
+			   accurateClock);
+  }
+}
+
+
+/* the master is seeked by the sync object */
+static void seekAudioTracks(WVStream* stream)
+{
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++)
+    if(isOtherTrack(stream, track))
+      WV_seekAudio(stream->audioTracks[track].streamHdl);
+}
+
+
+static void setAudioTracksVolume(WVStream* stream)
+{
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++){
+    WVAudioTrack* audioTrack = &stream->audioTracks[track];
+    if(audioTrack->streamHdl)
+      WV_setAudioVolume(audioTrack->streamHdl, stream->volume * audioTrack->volume);
+  }
+}
+
+
+/* the inactive tracks stay discarded */
+static void setAudioTracksDiscard(WVStream* stream, enum AVDiscard discard)
+{
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++){
+    WVAudioTrack* audioTrack = &stream->audioTracks[track];
+    if(audioTrack->streamHdl && audioTrack->activeFlag)
+      WV_setStreamDiscard(stream->engine->feeder, stream->formatCtx, audioTrack->streamIdx, discard);
+  }
+}
+
+
+/* give the clock and the eof signal to another track */
+static void setMasterTrack(WVStream* stream, int track)
+{
+  WVAudioTrack* master = &stream->audioTracks[stream->masterTrack];
+  WVAudioTrack* newMaster = &stream->audioTracks[track];
+
+  /* the old master follow now */
+  WV_stopAudioEOFSignalHandle(master->streamHdl);
+  if(stream->syncObj)
+    WV_stopAudioMasterSync(master->streamHdl);
+  setAudioDefaultLoopingFlag(master->streamHdl, stream->loopingFlag);
+
+  /* the new master */
+  //the audio sync objects keep the master handle
+  if(stream->syncObj){
+    stream->syncObj->wvStdPrivate = (void*)newMaster->streamHdl;
+    WV_setAudioMasterSync(newMaster->streamHdl, stream->syncObj);
+  }
+  WV_setAudioEOFSignalHandle(newMaster->streamHdl, stream);
+
+  /* the audio instance is the master */
+  stream->masterTrack = track;
+  stream->audioStreamIdx = newMaster->streamIdx;
+  stream->audioCodecCtx = newMaster->codecCtx;
+  stream->audioCodec = newMaster->codec;
+  stream->audioQueueHdl = newMaster->queueHdl;
+  stream->audioStreamHdl = newMaster->streamHdl;
+}
+
+
+
 WVStream* WV_closeStream(WVStream* stream)
 {
+  WVEngine* engine = stream->engine;
+
+  SDL_mutexP(engine->engineMutex);
+  
   /* close video stream */
   if(stream->videoStreamHdl){
     WV_delVideoStream(stream->videoStreamHdl);
@@ -120,6 +406,25 @@ WVStream* WV_closeStream(WVStream* stream)
     }
     stream->videoStreamHdl = NULL;
   }
+
+  /* free the fan-out object */
+  //the outputs are freed by the user
+  if(stream->fanoutObj){
+    WV_freeStreamFanoutObj(stream->fanoutObj);
+    stream->fanoutObj = NULL;
+  }
+  
+  /* close the other audio tracks */
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++){
+    if(isOtherTrack(stream, track)){
+      WVAudioTrack* audioTrack = &stream->audioTracks[track];
+      WV_delAudioStream(audioTrack->streamHdl);
+      audioTrack->streamHdl = NULL;
+      avcodec_close(audioTrack->codecCtx);
+      audioTrack->codecCtx = NULL;
+    }
+  }
   
   /* close audio stream */
   if(stream->audioStreamHdl){
@@ -127,14 +432,27 @@ WVStream* WV_closeStream(WVStream* stream)
     stream->audioStreamHdl = NULL;
   }
 
+  /* the decoders are deleted, no splice can be signaled now */
+  //commit the pending one before closing the source
+  commitSplice(stream);
+
 
   /* close queues */
   if(stream->audioQueueHdl || stream->videoQueueHdl){
-    WV_delFeederContext(stream->formatCtx);
+    WV_delFeederContext(engine->feeder, stream->formatCtx);
     stream->audioQueueHdl = NULL;
     stream->videoQueueHdl = NULL;
   }
 
+  SDL_mutexV(engine->engineMutex);
+
+  /* close the next item if it was not spliced */
+  //the decoders are deleted, the splice can't happen now
+  if(stream->nextStream){
+    WV_closeStream(stream->nextStream);
+    stream->nextStream = NULL;
+  }
+
   
   /* close codec */
   if(stream->videoCodecCtx){
@@ -178,7 +496,9 @@ WVStream* WV_closeStream(WVStream* stream)
 
 
 
-WVStream* WV_getStream(const char* filename)
+/* the dump is not done by the loader workers */
+//the outputs would be mixed
+static WVStream* openStream(const char* filename, int dumpFlag)
 {
   /* alloc the struct and set default value */
   WVStream* newStream = (WVStream*)malloc(sizeof(WVStream));
@@ -190,6 +510,7 @@ WVStream* WV_getStream(const char* filename)
   newStream->videoStreamIdx = -1;
   
   newStream->streamObj = NULL;
+  newStream->fanoutObj = NULL;
   newStream->syncObj = NULL;
   newStream->userSyncFlag = 0;
   
@@ -197,6 +518,9 @@ WVStream* WV_getStream(const char* filename)
   newStream->audioCodec = NULL;
   newStream->audioQueueHdl = NULL;
   newStream->audioStreamHdl = NULL;
+
+  newStream->nbAudioTracks = 0;
+  newStream->masterTrack = 0;
   
   newStream->videoCodecCtx = NULL;
   newStream->videoCodec = NULL;
@@ -212,13 +536,38 @@ WVStream* WV_getStream(const char* filename)
 
   newStream->loopingFlag = WV_BLOCKING_STREAM;
   newStream->seekFlag = WV_BLOCKING_SEEK;
+  newStream->seekPrecisionFlag = WV_FAST_SEEK;
   newStream->playFlag = WV_NEUTRAL_PLAY;
+  newStream->conversionFlag = WV_EARLY_CONVERSION;
+  newStream->presentFlag = WV_PUSH_PRESENT;
+  newStream->conversionSlices = 1;
+  newStream->cropRect.x = newStream->cropRect.y = 0;
+  newStream->cropRect.w = newStream->cropRect.h = 0;
+  newStream->outputWidth = 0;
+  newStream->outputHeight = 0;
+  newStream->loopCacheFlag = WV_NO_LOOP_CACHE;
+  newStream->frameCacheFlag = WV_NO_FRAME_CACHE;
+
+  /* decoded by the default engine */
+  newStream->engine = &defaultEngine;
+  newStream->playbackRate = 1;
+  newStream->trickResumeFlag = 0;
   
   newStream->eofSignalType = WV_EVENT_EOF_SIGNAL;
   newStream->eofSignalParam = NULL;
   newStream->eofSignalCall = NULL;
 
+  newStream->openTime = 0;
+  newStream->loadStartTime = 0;
+
+  newStream->nextStream = NULL;
+  newStream->spliceCount = 0;
+  newStream->splicePendingFlag = 0;
+  newStream->nextSplice = NULL;
+
   /* open file */
+  uint64_t startTime = WV_getMicroTime();
+  
   AVFormatContext* formatCtx = avformat_alloc_context();
   if(formatCtx == NULL)
     return NULL;
@@ -232,19 +581,27 @@ WVStream* WV_getStream(const char* filename)
   
   newStream->formatCtx = formatCtx;
 
-  /* read stream info */
-  if( avformat_find_stream_info(formatCtx, NULL) < 0 ){
-    /* error */
-    WV_closeStream(newStream);
-    return NULL;
-  }
+  /* read stream info and find streams */
+  //the cached files are not probed
+  int audioStreamIdx;
+  int videoStreamIdx;
+  
+  if(WV_applyProbeCache(formatCtx, filename, &audioStreamIdx, &videoStreamIdx) < 0){
+    
+    if( avformat_find_stream_info(formatCtx, NULL) < 0 ){
+      /* error */
+      WV_closeStream(newStream);
+      return NULL;
+    }
 
-  av_dump_format(formatCtx, 0, filename, 0);
+    audioStreamIdx = av_find_best_stream(formatCtx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+    videoStreamIdx = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
 
-  
-  /* find streams */
-  int audioStreamIdx = av_find_best_stream(formatCtx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
-  int videoStreamIdx = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    WV_saveProbeCache(formatCtx, filename, audioStreamIdx, videoStreamIdx);
+  }
+
+  if(dumpFlag)
+    av_dump_format(formatCtx, 0, filename, 0);
 
 
   /* set WVStream type */
@@ -272,11 +629,50 @@ WVStream* WV_getStream(const char* filename)
   newStream->videoStreamIdx = videoStreamIdx;
 
 
+  /* list the audio tracks */
+  /* by default only the best is loaded */
+  unsigned int i;
+  for(i=0; i<formatCtx->nb_streams && newStream->nbAudioTracks < WV_MAX_AUDIO_TRACKS; i++){
+    if(formatCtx->streams[i]->codec->codec_type != AVMEDIA_TYPE_AUDIO)
+      continue;
+
+    WVAudioTrack* audioTrack = &newStream->audioTracks[newStream->nbAudioTracks];
+    audioTrack->streamIdx = i;
+    audioTrack->loadFlag = ((int)i == audioStreamIdx);
+    audioTrack->activeFlag = 0;
+    audioTrack->volume = 1.0;
+    audioTrack->codecCtx = NULL;
+    audioTrack->codec = NULL;
+    audioTrack->queueHdl = NULL;
+    audioTrack->streamHdl = NULL;
+
+    if(audioTrack->loadFlag)
+      newStream->masterTrack = newStream->nbAudioTracks;
+
+    newStream->nbAudioTracks++;
+  }
+
+  //the best track is always listed
+  if(audioStreamIdx >= 0 && newStream->audioTracks[newStream->masterTrack].streamIdx != audioStreamIdx){
+    newStream->masterTrack = newStream->nbAudioTracks - 1;
+    newStream->audioTracks[newStream->masterTrack].streamIdx = audioStreamIdx;
+    newStream->audioTracks[newStream->masterTrack].loadFlag = 1;
+  }
+
+
+  newStream->openTime = (uint32_t)(WV_getMicroTime() - startTime);
+
   /* give the AVStream */
   return newStream;
 }
 
 
+WVStream* WV_getStream(const char* filename)
+{
+  return openStream(filename, 1);
+}
+
+
 
 int WV_getStreamType(WVStream* stream)
 {
@@ -364,312 +760,759 @@ int WV_disableVideo(WVStream* stream)
 }
 
 
-int WV_setStreamingMethod(WVStream* stream, WVStreamingObject* streamObj)
+int WV_getAudioTrackCount(WVStream* stream)
 {
-  /* check stream and streamObj */
-  if(!stream || !streamObj)
-    return -1;
-
-  /* check if stream Obj is correctly initialized */
-  if(!streamObj->getBuffer || !streamObj->refreshFrame)
+  /* check stream */
+  if(!stream)
     return -1;
 
-  /* save the streaming object */
-  stream->streamObj = streamObj;
-  return 0;
+  return stream->nbAudioTracks;
 }
 
 
-WVStreamingObject* WV_getStreamingMethod(WVStream* stream)
+int WV_setAudioTracks(WVStream* stream, const int* tracks, int nbTracks)
 {
   /* check stream */
-  if(!stream)
-    return NULL;
-
-  /* return the streaming object */
-  return stream->streamObj;
-}
+  if(!stream || !tracks || nbTracks <= 0)
+    return -1;
 
+  /* the tracks are chosen before loading */
+  if(stream->audioQueueHdl || stream->videoQueueHdl)
+    return -1;
 
+  /* check tracks */
+  int i;
+  for(i=0; i<nbTracks; i++)
+    if(tracks[i] < 0 || tracks[i] >= stream->nbAudioTracks)
+      return -1;
 
-int WV_setSyncMethod(WVStream* stream, WVSyncObject* syncObj)
-{
-  /* check stream and syncObj */
-  if(!stream || !syncObj)
-    return -1;
+  /* select */
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++)
+    stream->audioTracks[track].loadFlag = 0;
 
-  /* save the sync object */
-  stream->syncObj = syncObj;
-  stream->userSyncFlag = 1;
-  return 0;
-}
+  for(i=0; i<nbTracks; i++)
+    stream->audioTracks[tracks[i]].loadFlag = 1;
 
+  /* the first is the master */
+  stream->masterTrack = tracks[0];
+  stream->audioStreamIdx = stream->audioTracks[tracks[0]].streamIdx;
 
-WVSyncObject* WV_getSyncMethod(WVStream* stream)
-{
-  /* check stream */
-  if(!stream)
-    return NULL;
+  /* the audio may have been disabled */
+  if(stream->type == WV_STREAM_TYPE_VIDEO){
+    stream->type = WV_STREAM_TYPE_AUDIOVIDEO;
+  }
+  else if(stream->type == WV_STREAM_TYPE_NONE){
+    stream->type = WV_STREAM_TYPE_AUDIO;
+  }
 
-  /* return the sync object */
-  return stream->syncObj;
+  return 0;
 }
 
 
-int WV_setEOFMethod(WVStream* stream, int loopingFlag)
+int WV_setAudioTrackVolume(WVStream* stream, int track, double volume)
 {
-  /* check stream */
-  if(!stream)
+  /* check stream and track */
+  if(!stream || track < 0 || track >= stream->nbAudioTracks)
     return -1;
-  
-  /* set looping flag */
-  stream->loopingFlag = loopingFlag;
 
-  if(stream->syncObj)
-    stream->syncObj->loopingFlag = loopingFlag;
-  else if(stream->audioStreamHdl)
-    setAudioDefaultLoopingFlag(stream->audioStreamHdl, stream->loopingFlag);
+  /* set volume */
+  WVAudioTrack* audioTrack = &stream->audioTracks[track];
+  audioTrack->volume = volume;
+
+  if(audioTrack->streamHdl)
+    WV_setAudioVolume(audioTrack->streamHdl, stream->volume * volume);
 
   return 0;
 }
 
 
-int WV_setSeekMethod(WVStream* stream, int seekFlag)
+int WV_setAudioTrackActive(WVStream* stream, int track, int activeFlag)
 {
-  /* check stream */
-  if(!stream)
+  /* check stream and track */
+  if(!stream || track < 0 || track >= stream->nbAudioTracks)
     return -1;
-  
-  /* set looping flag */
-  stream->seekFlag = seekFlag;
 
-  return 0;
-}
+  /* only the loaded tracks */
+  WVAudioTrack* audioTrack = &stream->audioTracks[track];
+  if(!audioTrack->streamHdl)
+    return -1;
 
+  /* nothing to do */
+  activeFlag = (activeFlag != 0);
+  if(audioTrack->activeFlag == activeFlag)
+    return 0;
 
-int WV_setPlayMethod(WVStream* stream, int playFlag)
-{
-  /* check stream */
-  if(!stream)
-    return -1;
+  /* get the master clock */
+  WVReferenceClock refClock;
+  refClock.modIdx = 0;
   
-  /* set looping flag */
-  stream->playFlag = playFlag;
+  if(stream->syncObj)
+    stream->syncObj->getRefClock(stream->syncObj, &refClock);
+  else
+    refClock = WV_getAudioClock(stream->audioStreamHdl);
 
-  return 0;
-}
+  
+  /*********************/
+  /* deactivate        */
+  /*********************/
+  if(!activeFlag){
+    
+    /* keep at least one active track */
+    int newMaster;
+    for(newMaster=0; newMaster<stream->nbAudioTracks; newMaster++)
+      if(newMaster != track && stream->audioTracks[newMaster].streamHdl && stream->audioTracks[newMaster].activeFlag)
+	break;
 
+    if(newMaster == stream->nbAudioTracks)
+      return -1;
 
-int WV_setEOFSignalParam(WVStream* stream, void* param)
+    /* the master give the clock to another track */
+    int masterFlag = (track == stream->masterTrack);
+    if(masterFlag)
+      setMasterTrack(stream, newMaster);
+
+    /* mute the track and stop reading its pkts */
+    audioTrack->activeFlag = 0;
+    WV_pauseAudio(audioTrack->streamHdl);
+    WV_setStreamDiscard(stream->engine->feeder, stream->formatCtx, audioTrack->streamIdx, AVDISCARD_ALL);
+
+    /* the others tracks continue */
+    if(!masterFlag || stream->playbackRate != 1)
+      return 0;
+  }
+
+  /*********************/
+  /* activate          */
+  /*********************/
+  else{
+    audioTrack->activeFlag = 1;
+    
+    /* the trick play read the pkts and restart the tracks */
+    //when it return to normal play
+    if(stream->playbackRate != 1)
+      return 0;
+
+    WV_setStreamDiscard(stream->engine->feeder, stream->formatCtx, audioTrack->streamIdx, AVDISCARD_DEFAULT);
+  }
+
+  
+  /***********************************/
+  /* resync the tracks at the master */
+  /* clock, they restart together    */
+  /***********************************/
+  int seekFlag = stream->seekFlag;
+  int seekPrecisionFlag = stream->seekPrecisionFlag;
+
+  stream->seekFlag = WV_BLOCKING_SEEK;
+  stream->seekPrecisionFlag = WV_ACCURATE_SEEK;
+  WV_seekStream(stream, refClock.clock);
+  stream->seekFlag = seekFlag;
+  stream->seekPrecisionFlag = seekPrecisionFlag;
+
+  /* the activated track follow the master */
+  if(activeFlag && !refClock.pauseFlag)
+    WV_playAudio(audioTrack->streamHdl);
+
+  return 0;
+}
+
+
+int WV_setStreamingMethod(WVStream* stream, WVStreamingObject* streamObj)
+{
+  /* check stream and streamObj */
+  if(!stream || !streamObj)
+    return -1;
+
+  /* check if stream Obj is correctly initialized */
+  if(!streamObj->getBuffer || !streamObj->refreshFrame)
+    return -1;
+
+  /* replace the fan-out object */
+  if(stream->fanoutObj && streamObj != stream->fanoutObj){
+    WV_freeStreamFanoutObj(stream->fanoutObj);
+    stream->fanoutObj = NULL;
+  }
+
+  /* save the streaming object */
+  stream->streamObj = streamObj;
+  return 0;
+}
+
+
+int WV_addStreamingMethod(WVStream* stream, WVStreamingObject* streamObj)
+{
+  /* check stream and streamObj */
+  if(!stream || !streamObj)
+    return -1;
+
+  /* the outputs are given to the decoder at load */
+  if(stream->videoStreamHdl)
+    return -1;
+
+  /* the first object is used directly */
+  if(!stream->streamObj)
+    return WV_setStreamingMethod(stream, streamObj);
+
+  /* else feed all the objects with a fan-out */
+  if(!WV_isStreamFanoutObj(stream->streamObj)){
+    WVStreamingObject* fanoutObj = WV_getStreamFanoutObj();
+    if(WV_addStreamFanoutOutput(fanoutObj, stream->streamObj) < 0){
+      WV_freeStreamFanoutObj(fanoutObj);
+      return -1;
+    }
+    stream->streamObj = fanoutObj;
+    stream->fanoutObj = fanoutObj;
+  }
+
+  return WV_addStreamFanoutOutput(stream->streamObj, streamObj);
+}
+
+
+WVStreamingObject* WV_getStreamingMethod(WVStream* stream)
 {
   /* check stream */
   if(!stream)
+    return NULL;
+
+  /* return the streaming object */
+  return stream->streamObj;
+}
+
+
+
+int WV_setSyncMethod(WVStream* stream, WVSyncObject* syncObj)
+{
+  /* check stream and syncObj */
+  if(!stream || !syncObj)
     return -1;
-  
-  /* set looping flag */
-  stream->eofSignalParam = param;
 
+  /* save the sync object */
+  stream->syncObj = syncObj;
+  stream->userSyncFlag = 1;
   return 0;
 }
 
 
+WVSyncObject* WV_getSyncMethod(WVStream* stream)
+{
+  /* check stream */
+  if(!stream)
+    return NULL;
+
+  /* return the sync object */
+  return stream->syncObj;
+}
+
 
-int WV_setEOFSignalCall(WVStream* stream, WVEOFSignalCall eofCall)
+int WV_setEOFMethod(WVStream* stream, int loopingFlag)
 {
   /* check stream */
   if(!stream)
     return -1;
-  
+
   /* set looping flag */
-  stream->eofSignalType = WV_USER_EOF_SIGNAL;
-  stream->eofSignalCall = eofCall;
+  stream->loopingFlag = loopingFlag;
+
+  if(stream->syncObj)
+    stream->syncObj->loopingFlag = loopingFlag;
+  else if(stream->audioStreamHdl)
+    setAudioDefaultLoopingFlag(stream->audioStreamHdl, stream->loopingFlag);
+
+  /* the other audio tracks */
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++)
+    if(isOtherTrack(stream, track))
+      setAudioDefaultLoopingFlag(stream->audioTracks[track].streamHdl, stream->loopingFlag);
 
   return 0;
 }
 
 
-int WV_setVolume(WVStream* stream, double volume)
+int WV_setSeekMethod(WVStream* stream, int seekFlag)
 {
   /* check stream */
   if(!stream)
     return -1;
+  
+  /* set looping flag */
+  stream->seekFlag = seekFlag;
 
-  /* set volume */
-  stream->volume = volume;
-
-  if(stream->audioStreamHdl)
-    WV_setAudioVolume(stream->audioStreamHdl, volume);
-    
-  return 0; 
+  return 0;
 }
 
 
-double WV_getVolume(WVStream* stream)
+int WV_setSeekPrecision(WVStream* stream, int precisionFlag)
 {
   /* check stream */
   if(!stream)
-    return -1.0;
+    return -1;
 
-  /* return volume */
-  return stream->volume;
+  /* check flag */
+  if(precisionFlag != WV_FAST_SEEK && precisionFlag != WV_ACCURATE_SEEK)
+    return -1;
+  
+  /* set precision flag */
+  stream->seekPrecisionFlag = precisionFlag;
+
+  return 0;
 }
 
 
-int WV_setDBVolume(WVStream* stream, int DBVolume)
+int WV_setLoopCache(WVStream* stream, int cacheFlag)
 {
   /* check stream */
   if(!stream)
     return -1;
 
-  /* save db volume */
-  stream->volumeDBValue = DBVolume;
-
-  /* compute volume */
-  double volumeDBPitche = stream->volumeDBPitche;
-  if(volumeDBPitche <= 0)
+  /* check flag */
+  if(cacheFlag != WV_NO_LOOP_CACHE && cacheFlag != WV_LOOP_CACHE)
     return -1;
 
-  double volume = 1.0;
-  if(DBVolume >= 0){
-    while(DBVolume > 0){
-      volume *= volumeDBPitche;
-      DBVolume--;
-    }
-  }
-  else{
-    while(DBVolume < 0){
-      volume /= volumeDBPitche;
-      DBVolume++;
-    }
-  }
+  /* the pkts need to be recorded from the beginning */
+  if(stream->audioQueueHdl || stream->videoQueueHdl)
+    return -1;
 
-  /* save and set volume */
-  stream->volume = volume;
-  
-  if(stream->audioStreamHdl)
-    WV_setAudioVolume(stream->audioStreamHdl, volume);
+  stream->loopCacheFlag = cacheFlag;
 
   return 0;
 }
 
 
-double WV_getDBVolume(WVStream* stream)
+void WV_setLoopCacheLimits(uint32_t maxFileSize, uint32_t maxSize)
+{
+  WV_setFeederLoopCacheLimits(maxFileSize, maxSize);
+}
+
+
+uint32_t WV_getLoopCacheSize(void)
+{
+  if(!defaultEngine.feeder)
+    return 0;
+
+  return WV_getFeederLoopCacheSize(defaultEngine.feeder);
+}
+
+
+int WV_setFrameCache(WVStream* stream, int cacheFlag)
 {
   /* check stream */
   if(!stream)
     return -1;
 
-  /* return volume */
-  return stream->volumeDBValue;
+  /* check flag */
+  if(cacheFlag != WV_NO_FRAME_CACHE && cacheFlag != WV_FRAME_CACHE)
+    return -1;
+
+  /* the frames need to be recorded from the beginning */
+  if(stream->videoStreamHdl)
+    return -1;
+
+  stream->frameCacheFlag = cacheFlag;
+
+  return 0;
+}
+
+
+void WV_setFrameCacheLimits(uint32_t maxStreamSize, uint32_t maxSize)
+{
+  WV_setVideoFrameCacheLimits(maxStreamSize, maxSize);
 }
 
 
+uint32_t WV_getFrameCacheSize(void)
+{
+  if(!defaultEngine.videoDecoder)
+    return 0;
+
+  return WV_getVideoFrameCacheSize(defaultEngine.videoDecoder);
+}
 
-int WV_setVolumeDBPitche(WVStream* stream, double DBPitche)
+
+int WV_setConversionMethod(WVStream* stream, int conversionFlag)
 {
   /* check stream */
   if(!stream)
     return -1;
-
-  /* set DBPitche */
-  stream->volumeDBPitche = DBPitche;
   
-  /* reset volume */
-  WV_setDBVolume(stream, stream->volumeDBValue);
+  /* check flag */
+  if(conversionFlag != WV_EARLY_CONVERSION && conversionFlag != WV_LAZY_CONVERSION)
+    return -1;
+
+  /* set conversion flag */
+  stream->conversionFlag = conversionFlag;
 
   return 0;
 }
 
 
-double WV_getVolumeDBPitche(WVStream* stream)
+int WV_setPresentMethod(WVStream* stream, int presentFlag)
 {
   /* check stream */
   if(!stream)
-    return -1.0;
+    return -1;
+  
+  /* check flag */
+  if(presentFlag != WV_PUSH_PRESENT && presentFlag != WV_PULL_PRESENT)
+    return -1;
 
-  /* set DBPitche */
-  return stream->volumeDBPitche;
-} 
- 
+  /* set present flag */
+  stream->presentFlag = presentFlag;
 
+  return 0;
+}
 
-int WV_shiftDBVolume(WVStream* stream, int shift)
+
+int WV_setConversionSlices(WVStream* stream, int nbSlices)
 {
   /* check stream */
   if(!stream)
     return -1;
   
-  /* update DBVolume */
-  stream->volumeDBValue += shift;
+  /* check slices */
+  if(nbSlices < 1)
+    return -1;
 
-  /* reset volume */
-  WV_setDBVolume(stream, stream->volumeDBValue);
+  /* set the slices */
+  stream->conversionSlices = nbSlices;
+
+  /* the stream may be loaded */
+  if(stream->videoStreamHdl)
+    WV_setVideoConversionSlices(stream->videoStreamHdl, nbSlices);
 
   return 0;
 }
 
 
-
-
-int WV_loadStream(WVStream* stream)
+int WV_setSourceCrop(WVStream* stream, SDL_Rect* cropRect)
 {
   /* check stream */
   if(!stream)
     return -1;
 
-  /* check type */
-  if(stream->type == WV_STREAM_TYPE_NONE)
-    return -1;
-
-  /* check engine */
-  if(stream->type == WV_STREAM_TYPE_AUDIO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
-    if(!audioDecoderStartedFlag)
-      return -1;
+  /* NULL remove the crop */
+  if(!cropRect){
+    stream->cropRect.x = stream->cropRect.y = 0;
+    stream->cropRect.w = stream->cropRect.h = 0;
+    return 0;
   }
 
-  if(stream->type == WV_STREAM_TYPE_VIDEO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
-    if(!videoDecoderStartedFlag)
-      return -1;
-  }
+  /* check rect */
+  if(cropRect->x < 0 || cropRect->y < 0)
+    return -1;
+  
+  /* set the crop */
+  //used at the next load
+  stream->cropRect = *cropRect;
 
+  return 0;
+}
 
-  /******************************/
-  /* CHECK THE STREAMING OBJECT */
-  /******************************/
 
-  /* check if we have streaming method for the video */
-  if(stream->type == WV_STREAM_TYPE_VIDEO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
-    if(!stream->streamObj)
-      return -1;
-  }
+int WV_setOutputSize(WVStream* stream, int width, int height)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
 
+  /* check size */
+  if(width < 0 || height < 0)
+    return -1;
 
+  /* set the output size */
+  //used at the next load
+  stream->outputWidth = width;
+  stream->outputHeight = height;
 
+  return 0;
+}
 
-  /**********************/
-  /* TRY TO OPEN CODECS */
-  /**********************/
+
+int WV_setPlayMethod(WVStream* stream, int playFlag)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
   
-  /*********/
-  /* audio */
-  /*********/
-  if(stream->type == WV_STREAM_TYPE_AUDIO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
+  /* set looping flag */
+  stream->playFlag = playFlag;
 
-    /* find corresponding codec */
-    AVCodecContext* audioCodecCtx = stream->formatCtx->streams[stream->audioStreamIdx]->codec;
-    AVCodec* audioCodec = avcodec_find_decoder(audioCodecCtx->codec_id);
-    if(!audioCodec)
-      return -1;
-    
-    /* open codec */
-    if( avcodec_open2(audioCodecCtx, audioCodec, NULL) < 0 ){
-      free(audioCodec);  //to be verified 
+  return 0;
+}
+
+
+int WV_setEOFSignalParam(WVStream* stream, void* param)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
+  
+  /* set looping flag */
+  stream->eofSignalParam = param;
+
+  return 0;
+}
+
+
+
+int WV_setEOFSignalCall(WVStream* stream, WVEOFSignalCall eofCall)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
+  
+  /* set looping flag */
+  stream->eofSignalType = WV_USER_EOF_SIGNAL;
+  stream->eofSignalCall = eofCall;
+
+  return 0;
+}
+
+
+int WV_setVolume(WVStream* stream, double volume)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
+
+  /* set volume */
+  stream->volume = volume;
+
+  setAudioTracksVolume(stream);
+    
+  return 0; 
+}
+
+
+double WV_getVolume(WVStream* stream)
+{
+  /* check stream */
+  if(!stream)
+    return -1.0;
+
+  /* return volume */
+  return stream->volume;
+}
+
+
+int WV_setDBVolume(WVStream* stream, int DBVolume)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
+
+  /* save db volume */
+  stream->volumeDBValue = DBVolume;
+
+  /* compute volume */
+  double volumeDBPitche = stream->volumeDBPitche;
+  if(volumeDBPitche <= 0)
+    return -1;
+
+  double volume = 1.0;
+  if(DBVolume >= 0){
+    while(DBVolume > 0){
+      volume *= volumeDBPitche;
+      DBVolume--;
+    }
+  }
+  else{
+    while(DBVolume < 0){
+      volume /= volumeDBPitche;
+      DBVolume++;
+    }
+  }
+
+  /* save and set volume */
+  stream->volume = volume;
+  
+  setAudioTracksVolume(stream);
+
+  return 0;
+}
+
+
+double WV_getDBVolume(WVStream* stream)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
+
+  /* return volume */
+  return stream->volumeDBValue;
+}
+
+
+
+int WV_setVolumeDBPitche(WVStream* stream, double DBPitche)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
+
+  /* set DBPitche */
+  stream->volumeDBPitche = DBPitche;
+  
+  /* reset volume */
+  WV_setDBVolume(stream, stream->volumeDBValue);
+
+  return 0;
+}
+
+
+double WV_getVolumeDBPitche(WVStream* stream)
+{
+  /* check stream */
+  if(!stream)
+    return -1.0;
+
+  /* set DBPitche */
+  return stream->volumeDBPitche;
+} 
+ 
+
+
+int WV_shiftDBVolume(WVStream* stream, int shift)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
+  
+  /* update DBVolume */
+  stream->volumeDBValue += shift;
+
+  /* reset volume */
+  WV_setDBVolume(stream, stream->volumeDBValue);
+
+  return 0;
+}
+
+
+
+
+int WV_getThumbnails(WVThumbnail* thumbnails, int nbThumbnails)
+{
+  /* check requests */
+  if(!thumbnails || nbThumbnails <= 0)
+    return -1;
+
+  return WV_extractThumbnails(thumbnails, nbThumbnails);
+}
+
+
+int WV_getThumbnail(WVThumbnail* thumbnail)
+{
+  /* check request */
+  if(!thumbnail)
+    return -1;
+
+  if(WV_extractThumbnails(thumbnail, 1) <= 0)
+    return -1;
+
+  return 0;
+}
+
+
+
+int WV_loadStream(WVStream* stream)
+{
+  /* check and open the codecs */
+  if(prepareStreamLoad(stream) < 0)
+    return -1;
+
+  /* give the stream to the engine */
+  SDL_mutexP(stream->engine->engineMutex);
+  int ret = addStreamToEngine(stream);
+  SDL_mutexV(stream->engine->engineMutex);
+
+  return ret;
+}
+
+
+/* the load part that can be done by any thread */
+//the streaming object is initialized when the stream is added to the engine
+static int prepareStreamLoad(WVStream* stream)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
+
+  /* check type */
+  if(stream->type == WV_STREAM_TYPE_NONE)
+    return -1;
+
+  stream->loadStartTime = WV_getMicroTime();
+
+  /* check engine */
+  if(stream->type == WV_STREAM_TYPE_AUDIO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
+    if(!stream->engine->audioDecoder)
       return -1;
+  }
+
+  if(stream->type == WV_STREAM_TYPE_VIDEO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
+    if(!stream->engine->videoDecoder)
+      return -1;
+  }
+
+
+  /******************************/
+  /* CHECK THE STREAMING OBJECT */
+  /******************************/
+
+  /* check if we have streaming method for the video */
+  if(stream->type == WV_STREAM_TYPE_VIDEO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
+    if(!stream->streamObj)
+      return -1;
+  }
+
+
+
+
+  /**********************/
+  /* TRY TO OPEN CODECS */
+  /**********************/
+  return openStreamCodecs(stream);
+}
+
+
+/* open the codecs of the loaded tracks */
+static int openStreamCodecs(WVStream* stream)
+{
+  /*********/
+  /* audio */
+  /*********/
+  if(stream->type == WV_STREAM_TYPE_AUDIO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
+
+    /* one codec per loaded track */
+    int track;
+    for(track=0; track<stream->nbAudioTracks; track++){
+      WVAudioTrack* audioTrack = &stream->audioTracks[track];
+      if(!audioTrack->loadFlag)
+	continue;
+      
+      /* find corresponding codec */
+      AVCodecContext* audioCodecCtx = stream->formatCtx->streams[audioTrack->streamIdx]->codec;
+      AVCodec* audioCodec = avcodec_find_decoder(audioCodecCtx->codec_id);
+      if(!audioCodec){
+	closeStreamCodecs(stream);
+	return -1;
+      }
+    
+      /* open codec */
+      //the codecs are static, only the previous tracks are closed
+      if( avcodec_open2(audioCodecCtx, audioCodec, NULL) < 0 ){
+	closeStreamCodecs(stream);
+	return -1;
+      }
+
+      /* save codec */
+      audioTrack->codecCtx = audioCodecCtx;
+      audioTrack->codec = audioCodec;
     }
 
-    /* save codec */
-    stream->audioCodecCtx = audioCodecCtx;
-    stream->audioCodec = audioCodec;
+    /* the master track */
+    stream->audioCodecCtx = stream->audioTracks[stream->masterTrack].codecCtx;
+    stream->audioCodec = stream->audioTracks[stream->masterTrack].codec;
   }
   
   /*********/
@@ -680,12 +1523,33 @@ int WV_loadStream(WVStream* stream)
     /* find corresponding codec */
     AVCodecContext* videoCodecCtx = stream->formatCtx->streams[stream->videoStreamIdx]->codec;
     AVCodec* videoCodec = avcodec_find_decoder(videoCodecCtx->codec_id);
-    if(!videoCodec)
+    if(!videoCodec){
+      closeStreamCodecs(stream);
       return -1;
+    }
+    
+    /* decode at a lower resolution */
+    /* if the output is small */
+    videoCodecCtx->lowres = WV_getVideoLowres(videoCodecCtx, videoCodec,	\
+					      &stream->cropRect,		\
+					      stream->outputWidth, stream->outputHeight);
+
+    /* decode each frame with several threads */
+    //the task runtime decode the streams in parallel, the codec the frames and slices
+#if HAVE_CODEC_THREAD_TYPE
+    int codecThreads = WV_getTaskRuntimeWorkers();
+    if(codecThreads > WV_VIDEO_DECODER_CODEC_THREADS)
+      codecThreads = WV_VIDEO_DECODER_CODEC_THREADS;
+    if(codecThreads < 1)
+      codecThreads = 1;
+    
+    videoCodecCtx->thread_count = codecThreads;
+    videoCodecCtx->thread_type = WV_VIDEO_DECODER_THREAD_TYPE;
+#endif
     
     /* open codec */
     if( avcodec_open2(videoCodecCtx, videoCodec, NULL) < 0 ){
-      free(videoCodec);   //to be verified 
+      closeStreamCodecs(stream);
       return -1;
     }
 
@@ -694,217 +1558,710 @@ int WV_loadStream(WVStream* stream)
     stream->videoCodec = videoCodec;
   }
 
+  return 0;
+}
 
-  
+
+/* close the codecs opened by openStreamCodecs */
+//when the stream is not given to the decoders
+static void closeStreamCodecs(WVStream* stream)
+{
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++){
+    WVAudioTrack* audioTrack = &stream->audioTracks[track];
+    if(audioTrack->codecCtx){
+      avcodec_close(audioTrack->codecCtx);
+      audioTrack->codecCtx = NULL;
+      audioTrack->codec = NULL;
+    }
+  }
+  stream->audioCodecCtx = NULL;
+  stream->audioCodec = NULL;
+
+  if(stream->videoCodecCtx){
+    avcodec_close(stream->videoCodecCtx);
+    stream->videoCodecCtx = NULL;
+    stream->videoCodec = NULL;
+  }
+}
+
+
+/* !!! need engineMutex !!! */
+static int addStreamToEngine(WVStream* stream)
+{
+  WVEngine* engine = stream->engine;
 
   /*******************/
   /* LOAD THE QUEUES */
   /*******************/
   
+  /* one queue per loaded audio track */
+  /* and one for the video */
+  int audioFlag = (stream->type == WV_STREAM_TYPE_AUDIO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO);
+  int videoFlag = (stream->type == WV_STREAM_TYPE_VIDEO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO);
+  int nbQueues = 0;
+  int track;
+
+  if(audioFlag)
+    for(track=0; track<stream->nbAudioTracks; track++)
+      if(stream->audioTracks[track].loadFlag)
+	nbQueues++;
+  
+  if(videoFlag)
+    nbQueues++;
+  
+  if(WV_buildFeederContext(engine->feeder, stream->formatCtx, nbQueues) < 0)
+    return -1;
+
   /* audio */
-  if(stream->type == WV_STREAM_TYPE_AUDIO){
-    if(WV_buildFeederContext(stream->formatCtx, 1) < 0)  //just one audio stream
-      return -1;
-    
-    stream->audioQueueHdl = WV_getStreamQueue(stream->audioStreamIdx);
-    WV_addFeederContext();
+  //the other tracks are not read
+  for(track=0; track<stream->nbAudioTracks; track++){
+    WVAudioTrack* audioTrack = &stream->audioTracks[track];
+    if(audioFlag && audioTrack->loadFlag)
+      audioTrack->queueHdl = WV_getStreamQueue(engine->feeder, audioTrack->streamIdx);
+    else
+      stream->formatCtx->streams[audioTrack->streamIdx]->discard = AVDISCARD_ALL;
   }
 
+  if(audioFlag)
+    stream->audioQueueHdl = stream->audioTracks[stream->masterTrack].queueHdl;
+
   /* video */
-  else if(stream->type == WV_STREAM_TYPE_VIDEO){
-    if(WV_buildFeederContext(stream->formatCtx, 1) < 0)  //just one video stream
-      return -1;
+  if(videoFlag)
+    stream->videoQueueHdl = WV_getStreamQueue(engine->feeder, stream->videoStreamIdx);
+
+  //the too big files are read as usual
+  WV_setFeederLoopCache(engine->feeder, stream->loopCacheFlag);
+  WV_addFeederContext(engine->feeder);
+
+  
+  /**************/
+  /* LOAD AUDIO */
+  /**************/
+  if(audioFlag){
+    for(track=0; track<stream->nbAudioTracks; track++){
+      WVAudioTrack* audioTrack = &stream->audioTracks[track];
+      if(!audioTrack->loadFlag)
+	continue;
+      
+      audioTrack->streamHdl = WV_addAudioStream(engine->audioDecoder,	\
+						audioTrack->queueHdl,	\
+						audioTrack->codecCtx,	\
+						stream->formatCtx->streams[audioTrack->streamIdx]->time_base, \
+						stream->volume * audioTrack->volume);
+      audioTrack->activeFlag = 1;
+
+      /* the other tracks follow the master */
+      if(track != stream->masterTrack)
+	setAudioDefaultLoopingFlag(audioTrack->streamHdl, stream->loopingFlag);
+    }
     
-    stream->videoQueueHdl = WV_getStreamQueue(stream->videoStreamIdx);
-    WV_addFeederContext();
+    stream->audioStreamHdl = stream->audioTracks[stream->masterTrack].streamHdl;
   }
 
-  /* audio video */
-  else if(stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
-    if(WV_buildFeederContext(stream->formatCtx, 2) < 0)  //audio and video stream
-      return -1;
+
+  /*********************/
+  /* CHECK SYNC OBJECT */
+  /*********************/
+
+  /* if no sync object is given */
+  /* put the default sync object */
+  if(!stream->syncObj){
+
+    /* video only */
+    if(stream->type == WV_STREAM_TYPE_VIDEO){
+      stream->syncObj = WV_getCVSyncObj();  //hardware clock to sync video
+    }
+
+    /* audio with video */
+    else if(stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
+      stream->syncObj =  WV_getAVSyncObj(stream->audioStreamHdl);
+    }
+
+  }
+
+
+  /* if sync is given */
+  /* overwrite the default methods */
+  /* check if the the other methods are given */
+  else{
     
-    stream->audioQueueHdl = WV_getStreamQueue(stream->audioStreamIdx);
-    stream->videoQueueHdl = WV_getStreamQueue(stream->videoStreamIdx);
-    WV_addFeederContext();
+    /* audio only */
+    /* the user fill the slave part of the obj */
+    /* the signalStateChange function */
+    /* so fill the other with standard methods */
+    if(stream->type == WV_STREAM_TYPE_AUDIO){
+      WVSyncObject* syncObj = stream->syncObj;
+
+      /* check user */
+      if(!syncObj->signalStateChange)
+	return -1;
+
+      /* overrite other */
+      syncObj->getRefClock = &WV_AVSync_getRefClock;
+      syncObj->play = &WV_AVSync_play;
+      syncObj->pause = &WV_AVSync_pause;
+      syncObj->seek = &WV_AVSync_seek;
+      syncObj->wvStdPrivate = (void*)stream->audioStreamHdl;
+    }
+
+    /* video only */
+    /* the user fill the master part of the obj */
+    /* the getRefClock, play, pause, seek */
+    /* so fill the others with standard methods */
+    else if(stream->type == WV_STREAM_TYPE_VIDEO){
+      WVSyncObject* syncObj = stream->syncObj;
+
+      /* check user */
+      /* only getRefClock and play are mandatory */
+      if(!syncObj->getRefClock || !syncObj->play)
+	return -1;
+      
+      /* overwrite others */
+      syncObj->signalStateChange = &WV_AVSync_signalStateChange;
+    }
+
+    /* error on other case */
+    else{
+      return -1;
+    }
   }
 
+
+  /* !!!!!!!!!!! !!!!!!!!! */
+  /* put the looping flag  */
+  /* !!!!!!!!!!!!!!!!!!!!! */
+  if(stream->syncObj)
+    stream->syncObj->loopingFlag = stream->loopingFlag;
+
   
+    
+  /*****************************/
+  /* PUT THE AUDIO SYNC OBJECT */
+  /*****************************/
+  
+  /* audio video */
+  /* always have a sync object */
+  if(stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
+    WV_setAudioMasterSync(stream->audioStreamHdl, stream->syncObj);
+  }
+
+  /* audio only */
+  /* put the syncObject if we have one */
+  /* else set the default looping flag */
+  else if(stream->type == WV_STREAM_TYPE_AUDIO){
+    if(stream->syncObj){
+      WV_setAudioMasterSync(stream->audioStreamHdl, stream->syncObj);
+    }
+    else{
+      setAudioDefaultLoopingFlag(stream->audioStreamHdl, stream->loopingFlag);
+    }
+  }
+
+  /************************/
+  /* PUT AUDIO EOF SIGNAL */
+  /************************/
+  /* if we have audio we use it for signal eof */
+  if(stream->type == WV_STREAM_TYPE_AUDIO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO)
+    WV_setAudioEOFSignalHandle(stream->audioStreamHdl, stream);
+
+    
+
   /**************/
-  /* LOAD AUDIO */
+  /* LOAD VIDEO */
   /**************/
-  if(stream->type == WV_STREAM_TYPE_AUDIO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
-    stream->audioStreamHdl = WV_addAudioStream(stream->audioQueueHdl,	\
-					       stream->audioCodecCtx,		\
-					       stream->formatCtx->streams[stream->audioStreamIdx]->time_base, \
-					       stream->volume);
+  
+  /* video always have a sync and a streaming object */
+  if(stream->type == WV_STREAM_TYPE_VIDEO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
+    stream->videoStreamHdl = WV_addVideoStream(engine->videoDecoder,	\
+					       stream->videoQueueHdl,	\
+					       stream->videoCodecCtx,	\
+					       stream->formatCtx->streams[stream->videoStreamIdx]->time_base, \
+					       stream->streamObj,		\
+					       stream->syncObj,			\
+					       stream->conversionFlag,		\
+					       stream->presentFlag,		\
+					       stream->frameCacheFlag,		\
+					       &stream->cropRect,		\
+					       stream->outputWidth,		\
+					       stream->outputHeight);
+
+    //the streaming object can't be initialized
+    //the loaded parts are freed by WV_closeStream
+    if(!stream->videoStreamHdl)
+      return -1;
+
+    WV_setVideoConversionSlices(stream->videoStreamHdl, stream->conversionSlices);
+  
+  }
+  
+  /************************/
+  /* PUT VIDEO EOF SIGNAL */
+  /*   (if needed)        */
+  /************************/
+  if(stream->type == WV_STREAM_TYPE_VIDEO)
+    WV_setVideoEOFSignalHandle(stream->videoStreamHdl, stream);
+  
+
+  /* loading finished */
+  return 0;
+}
+
+
+
+/* the asynchronous open and load */
+/* done by the stream loader workers */
+typedef struct StreamReadyJob{
+  char* filename;          //the opened file, NULL for the load jobs
+  WVStream* stream;
+  WVStreamReadyCall readyCall;
+  void* param;
+  struct StreamReadyJob* next;   //waiting the main thread
+}StreamReadyJob;
+
+
+/* signal with the user function */
+/* or with the event system */
+static void signalStreamReady(StreamReadyJob* job, int status)
+{
+  if(job->readyCall){
+    job->readyCall(job->stream, status, job->param);
+  }
+  else{
+    SDL_Event event;
+    
+    event.type = WV_STREAM_READY_EVENT;
+    event.user.code = status;
+    event.user.data1 = job->stream;
+    event.user.data2 = job->param;
+    
+    SDL_PushEvent(&event);
+  }
+}
+
+
+static void openStreamJob(void* jobParam)
+{
+  StreamReadyJob* job = (StreamReadyJob*)jobParam;
+
+  job->stream = openStream(job->filename, 0);
+  signalStreamReady(job, job->stream? 0 : -1);
+
+  SDL_free(job->filename);
+  free(job);
+}
+
+
+static void loadStreamJob(void* jobParam)
+{
+  StreamReadyJob* job = (StreamReadyJob*)jobParam;
+  WVStream* stream = job->stream;
+
+  /* open the codecs here */
+  if(prepareStreamLoad(stream) < 0){
+    signalStreamReady(job, -1);
+    free(job);
+    return;
+  }
+
+  /* without video the load can be finished here */
+  if(stream->type != WV_STREAM_TYPE_VIDEO && stream->type != WV_STREAM_TYPE_AUDIOVIDEO){
+    SDL_mutexP(stream->engine->engineMutex);
+    int status = addStreamToEngine(stream);
+    SDL_mutexV(stream->engine->engineMutex);
+
+    signalStreamReady(job, status);
+    free(job);
+    return;
+  }
+
+  /* else wait for the main thread */
+  //with the load refresh event
+  SDL_mutexP(loadListMutex);
+  job->next = loadList;
+  loadList = job;
+  SDL_mutexV(loadListMutex);
+
+  SDL_Event event;
+  
+  event.type = WV_REFRESH_EVENT;
+  event.user.code = WV_LOAD_REFRESH_CODE;
+  event.user.data1 = NULL;
+  event.user.data2 = NULL;
+  
+  SDL_PushEvent(&event);
+}
+
+
+/* !!! called by the main thread with the load refresh event !!! */
+void WV_finishStreamLoads(void)
+{
+  if(!loadListMutex)
+    return;
+
+  /* take all the waiting loads */
+  SDL_mutexP(loadListMutex);
+  StreamReadyJob* job = loadList;
+  loadList = NULL;
+  SDL_mutexV(loadListMutex);
+
+  /* add the streams to their engine */
+  while(job){
+    StreamReadyJob* nextJob = job->next;
+    WVStream* stream = job->stream;
+
+    SDL_mutexP(stream->engine->engineMutex);
+    int status = addStreamToEngine(stream);
+    SDL_mutexV(stream->engine->engineMutex);
+
+    signalStreamReady(job, status);
+    free(job);
+    job = nextJob;
+  }
+}
+
+
+int WV_getStreamAsync(const char* filename, WVStreamReadyCall readyCall, void* param)
+{
+  if(!filename)
+    return -1;
+
+  StreamReadyJob* job = (StreamReadyJob*)malloc(sizeof(StreamReadyJob));
+  if(!job)
+    return -1;
+  
+  job->filename = SDL_strdup(filename);  //the caller string may not live until the open
+  if(!job->filename){
+    free(job);
+    return -1;
+  }
+  
+  job->stream = NULL;
+  job->readyCall = readyCall;
+  job->param = param;
+
+  if(WV_pushStreamLoaderJob(&openStreamJob, job) < 0){
+    SDL_free(job->filename);
+    free(job);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+int WV_loadStreamAsync(WVStream* stream, WVStreamReadyCall readyCall, void* param)
+{
+  if(!stream)
+    return -1;
+
+  StreamReadyJob* job = (StreamReadyJob*)malloc(sizeof(StreamReadyJob));
+  if(!job)
+    return -1;
+  
+  job->filename = NULL;
+  job->stream = stream;
+  job->readyCall = readyCall;
+  job->param = param;
+
+  if(WV_pushStreamLoaderJob(&loadStreamJob, job) < 0){
+    free(job);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+
+
+/********************************************/
+/* the gapless splice                       */
+/* the next item is fed and decoded by the  */
+/* stream at its eof, then the stream take  */
+/* its place                                */
+/********************************************/
+
+/* !!! main thread !!! */
+//the decoders don't use the old source anymore
+static void spliceStream(WVStream* stream)
+{
+  WVStream* nextStream = stream->nextStream;
+
+  /* close the old source */
+  WV_delFeederContext(stream->engine->feeder, stream->formatCtx);
+
+  if(stream->videoCodecCtx)
+    avcodec_close(stream->videoCodecCtx);
+
+  if(stream->audioCodecCtx)
+    avcodec_close(stream->audioCodecCtx);
+
+  avformat_close_input(&stream->formatCtx);
+
+  /* take the next source */
+  stream->formatCtx = nextStream->formatCtx;
+  stream->audioStreamIdx = nextStream->audioStreamIdx;
+  stream->videoStreamIdx = nextStream->videoStreamIdx;
+
+  /* the audio tracks */
+  //the decoder handle and the volume stay
+  if(nextStream->audioQueueHdl){
+    double trackVolume = stream->audioTracks[stream->masterTrack].volume;
+    int track;
+    for(track=0; track<nextStream->nbAudioTracks; track++)
+      stream->audioTracks[track] = nextStream->audioTracks[track];
+    stream->nbAudioTracks = nextStream->nbAudioTracks;
+    stream->masterTrack = nextStream->masterTrack;
+
+    WVAudioTrack* master = &stream->audioTracks[stream->masterTrack];
+    master->streamHdl = stream->audioStreamHdl;
+    master->activeFlag = 1;
+    master->volume = trackVolume;
+
+    stream->audioCodecCtx = nextStream->audioCodecCtx;
+    stream->audioCodec = nextStream->audioCodec;
+    stream->audioQueueHdl = nextStream->audioQueueHdl;
+  }
+
+  /* the video */
+  if(nextStream->videoQueueHdl){
+    stream->videoCodecCtx = nextStream->videoCodecCtx;
+    stream->videoCodec = nextStream->videoCodec;
+    stream->videoQueueHdl = nextStream->videoQueueHdl;
+  }
+
+  /* the seek info are from the old source */
+  stream->lastSeekModIdx = -1;
+  stream->lastSeekTargetClock = UINT32_MAX;
+  stream->openTime = nextStream->openTime;
+
+  /* the next item is now the stream */
+  stream->nextStream = NULL;
+  free(nextStream);
+}
+
+
+/* called by the decoders when they switch */
+/* the source is swapped when all are switched */
+/* !!! the decoders don't touch the stream source !!! */
+static void signalSplice(void* param)
+{
+  WVStream* stream = (WVStream*)param;
+
+  /* video only, the clock mod at eof is a seek */
+  //so a blocking stream doesn't pause
+  if(stream->type == WV_STREAM_TYPE_VIDEO && stream->syncObj->seek)
+    stream->syncObj->seek(stream->syncObj, 0, WV_BLOCKING_SEEK);
+
+  SDL_mutexP(stream->engine->spliceMutex);
+  stream->spliceCount--;
+  int switchedFlag = (stream->spliceCount == 0);
+  SDL_mutexV(stream->engine->spliceMutex);
+
+  if(!switchedFlag)
+    return;
+
+  /* the swap is done by the main thread */
+  //with the splice refresh event
+  SDL_mutexP(spliceListMutex);
+  stream->nextSplice = spliceList;
+  spliceList = stream;
+  stream->splicePendingFlag = 1;
+  SDL_mutexV(spliceListMutex);
+
+  WV_signalSplice();
+}
+
+
+/* commit the splice of one stream if it is pending */
+//used when the stream can't wait for the splice event
+static void commitSplice(WVStream* stream)
+{
+  //only the main thread set the next item
+  if(!stream->nextStream)
+    return;
+
+  /* remove it from the pending list */
+  SDL_mutexP(spliceListMutex);
+  int pendingFlag = stream->splicePendingFlag;
+  if(pendingFlag){
+    WVStream** prevP = &spliceList;
+    while(*prevP != stream)
+      prevP = &(*prevP)->nextSplice;
+    *prevP = stream->nextSplice;
+    stream->splicePendingFlag = 0;
+  }
+  SDL_mutexV(spliceListMutex);
+
+  if(pendingFlag)
+    spliceStream(stream);
+}
+
+
+/* !!! called by the main thread with the splice refresh event !!! */
+void WV_commitSplices(void)
+{
+  if(!spliceListMutex)
+    return;
+
+  /* take all the pending splices */
+  SDL_mutexP(spliceListMutex);
+  WVStream* stream = spliceList;
+  spliceList = NULL;
+  
+  WVStream* currStream;
+  for(currStream = stream; currStream; currStream = currStream->nextSplice)
+    currStream->splicePendingFlag = 0;
+  SDL_mutexV(spliceListMutex);
+
+  /* swap the sources */
+  while(stream){
+    WVStream* nextSplice = stream->nextSplice;
+    spliceStream(stream);
+    stream = nextSplice;
+  }
+}
+
 
-  }
+int WV_preloadNext(WVStream* stream, WVStream* nextStream)
+{
+  /* check streams */
+  if(!stream || !nextStream || stream == nextStream)
+    return -1;
 
+  /* the previous splice may be not committed yet */
+  //the eof can be handled before the splice event
+  commitSplice(stream);
 
-  /*********************/
-  /* CHECK SYNC OBJECT */
-  /*********************/
+  /* the stream need to be loaded */
+  /* and the next item only opened */
+  if(!stream->audioQueueHdl && !stream->videoQueueHdl)
+    return -1;
 
-  /* if no sync object is given */
-  /* put the default sync object */
-  if(!stream->syncObj){
+  if(nextStream->audioQueueHdl || nextStream->videoQueueHdl)
+    return -1;
 
-    /* video only */
-    if(stream->type == WV_STREAM_TYPE_VIDEO){
-      stream->syncObj = WV_getCVSyncObj();  //hardware clock to sync video
-    }
+  /* one next item at a time, of the same type */
+  if(stream->nextStream || nextStream->type != stream->type)
+    return -1;
 
-    /* audio with video */
-    else if(stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
-      stream->syncObj =  WV_getAVSyncObj(stream->audioStreamHdl);
-    }
+  /* only the master track can be spliced */
+  int track;
+  for(track=0; track<stream->nbAudioTracks; track++)
+    if(isOtherTrack(stream, track))
+      return -1;
+  
+  int audioFlag = (stream->type == WV_STREAM_TYPE_AUDIO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO);
+  int videoFlag = (stream->type == WV_STREAM_TYPE_VIDEO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO);
 
-  }
 
+  /**************************************/
+  /* OPEN THE NEXT ITEM LIKE THE STREAM */
+  /**************************************/
+  for(track=0; track<nextStream->nbAudioTracks; track++)
+    nextStream->audioTracks[track].loadFlag = (track == nextStream->masterTrack);
 
-  /* if sync is given */
-  /* overwrite the default methods */
-  /* check if the the other methods are given */
-  else{
-    
-    /* audio only */
-    /* the user fill the slave part of the obj */
-    /* the signalStateChange function */
-    /* so fill the other with standard methods */
-    if(stream->type == WV_STREAM_TYPE_AUDIO){
-      WVSyncObject* syncObj = stream->syncObj;
+  nextStream->cropRect = stream->cropRect;
+  nextStream->outputWidth = stream->outputWidth;
+  nextStream->outputHeight = stream->outputHeight;
 
-      /* check user */
-      if(!syncObj->signalStateChange)
-	return -1;
+  if(openStreamCodecs(nextStream) < 0)
+    return -1;
 
-      /* overrite other */
-      syncObj->getRefClock = &WV_AVSync_getRefClock;
-      syncObj->play = &WV_AVSync_play;
-      syncObj->pause = &WV_AVSync_pause;
-      syncObj->seek = &WV_AVSync_seek;
-      syncObj->wvStdPrivate = (void*)stream->audioStreamHdl;
-    }
 
-    /* video only */
-    /* the user fill the master part of the obj */
-    /* the getRefClock, play, pause, seek */
-    /* so fill the others with standard methods */
-    else if(stream->type == WV_STREAM_TYPE_VIDEO){
-      WVSyncObject* syncObj = stream->syncObj;
+  /************************************/
+  /* FEED THE NEXT ITEM NOW           */
+  /* the pkts wait in the queues      */
+  /************************************/
+  //the next item is fed by the stream engine
+  WVEngine* engine = stream->engine;
+  nextStream->engine = engine;
 
-      /* check user */
-      /* only getRefClock and play are mandatory */
-      if(!syncObj->getRefClock || !syncObj->play)
-	return -1;
-      
-      /* overwrite others */
-      syncObj->signalStateChange = &WV_AVSync_signalStateChange;
-    }
+  SDL_mutexP(engine->engineMutex);
 
-    /* error on other case */
-    else{
-      return -1;
-    }
+  if(WV_buildFeederContext(engine->feeder, nextStream->formatCtx, audioFlag + videoFlag) < 0){
+    SDL_mutexV(engine->engineMutex);
+    closeStreamCodecs(nextStream);
+    return -1;
   }
 
+  //the other tracks are not read
+  for(track=0; track<nextStream->nbAudioTracks; track++){
+    WVAudioTrack* audioTrack = &nextStream->audioTracks[track];
+    if(audioFlag && audioTrack->loadFlag)
+      audioTrack->queueHdl = WV_getStreamQueue(engine->feeder, audioTrack->streamIdx);
+    else
+      nextStream->formatCtx->streams[audioTrack->streamIdx]->discard = AVDISCARD_ALL;
+  }
 
-  /* !!!!!!!!!!! !!!!!!!!! */
-  /* put the looping flag  */
-  /* !!!!!!!!!!!!!!!!!!!!! */
-  if(stream->syncObj)
-    stream->syncObj->loopingFlag = stream->loopingFlag;
+  if(audioFlag)
+    nextStream->audioQueueHdl = nextStream->audioTracks[nextStream->masterTrack].queueHdl;
 
-  
-    
-  /*****************************/
-  /* PUT THE AUDIO SYNC OBJECT */
-  /*****************************/
-  
-  /* audio video */
-  /* always have a sync object */
-  if(stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
-    WV_setAudioMasterSync(stream->audioStreamHdl, stream->syncObj);
-  }
+  if(videoFlag)
+    nextStream->videoQueueHdl = WV_getStreamQueue(engine->feeder, nextStream->videoStreamIdx);
 
-  /* audio only */
-  /* put the syncObject if we have one */
-  /* else set the default looping flag */
-  else if(stream->type == WV_STREAM_TYPE_AUDIO){
-    if(stream->syncObj){
-      WV_setAudioMasterSync(stream->audioStreamHdl, stream->syncObj);
-    }
-    else{
-      setAudioDefaultLoopingFlag(stream->audioStreamHdl, stream->loopingFlag);
-    }
-  }
+  //the next item is cached like the stream
+  WV_setFeederLoopCache(engine->feeder, stream->loopCacheFlag);
+  WV_addFeederContext(engine->feeder);
 
-  /************************/
-  /* PUT AUDIO EOF SIGNAL */
-  /************************/
-  /* if we have audio we use it for signal eof */
-  if(stream->type == WV_STREAM_TYPE_AUDIO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO)
-    WV_setAudioEOFSignalHandle(stream->audioStreamHdl, stream);
 
-    
+  /******************************/
+  /* THE DECODERS SWITCH AT EOF */
+  /******************************/
+  stream->nextStream = nextStream;
+  stream->spliceCount = audioFlag + videoFlag;
 
-  /**************/
-  /* LOAD VIDEO */
-  /**************/
-  
-  /* video always have a sync and a streaming object */
-  if(stream->type == WV_STREAM_TYPE_VIDEO || stream->type == WV_STREAM_TYPE_AUDIOVIDEO){
-    stream->videoStreamHdl = WV_addVideoStream(stream->videoQueueHdl,	\
-					       stream->videoCodecCtx,	\
-					       stream->formatCtx->streams[stream->videoStreamIdx]->time_base, \
-					       stream->streamObj,		\
-					       stream->syncObj);
+  if(audioFlag)
+    WV_setAudioNextSource(stream->audioStreamHdl, nextStream->audioQueueHdl, \
+			  nextStream->audioCodecCtx,			\
+			  nextStream->formatCtx->streams[nextStream->audioStreamIdx]->time_base, \
+			  &signalSplice, stream);
 
-  
-  }
-  
-  /************************/
-  /* PUT VIDEO EOF SIGNAL */
-  /*   (if needed)        */
-  /************************/
-  if(stream->type == WV_STREAM_TYPE_VIDEO)
-    WV_setVideoEOFSignalHandle(stream->videoStreamHdl, stream);
-  
+  if(videoFlag)
+    WV_setVideoNextSource(stream->videoStreamHdl, nextStream->videoQueueHdl, \
+			  nextStream->videoCodecCtx,			\
+			  nextStream->formatCtx->streams[nextStream->videoStreamIdx]->time_base, \
+			  nextStream->formatCtx, nextStream->videoStreamIdx, \
+			  &signalSplice, stream);
+
+  SDL_mutexV(engine->engineMutex);
 
-  /* loading finished */
   return 0;
 }
 
 
 
-
 int WV_rewindStream(WVStream* stream)
 {
   /* check stream */
   if(!stream)
     return -1;
 
+  /* stop the trick play */
+  if(stream->playbackRate != 1)
+    WV_setPlaybackRate(stream, 1);
+
   /* if the user provide master syncObj */
   /* check if the seek function is defined */
   if(!stream->audioStreamHdl && stream->syncObj && !stream->syncObj->seek)
     return -1;
   
   /* prepare seek */
-  if(stream->audioStreamHdl)
-    WV_startAudioSeeking(stream->audioStreamHdl, stream->seekFlag);
+  startAudioTracksSeeking(stream, stream->seekFlag, UINT32_MAX);
       
   if(stream->videoStreamHdl)
-    WV_startVideoSeeking(stream->videoStreamHdl);
+    WV_startVideoSeeking(stream->videoStreamHdl, UINT32_MAX);
 
   /* packet feeder seek */
-  WV_contextSeek(stream->formatCtx, -1, 0, AVSEEK_FLAG_BACKWARD );
+  WV_contextSeek(stream->engine->feeder, stream->formatCtx, -1, 0, AVSEEK_FLAG_BACKWARD );
       
   /* master seek (audio or user) */
   if(stream->audioStreamHdl)
     WV_seekAudio(stream->audioStreamHdl);
   else if(stream->syncObj)
     stream->syncObj->seek(stream->syncObj, 0, stream->seekFlag);
+  seekAudioTracks(stream);
   
   /* slave seek */
   if(stream->videoStreamHdl)
@@ -921,6 +2278,12 @@ int WV_playStream(WVStream* stream)
   if(!stream)
     return -1;
 
+  /* in trick play, go back to normal play */
+  if(stream->playbackRate != 1){
+    stream->trickResumeFlag = 1;
+    return WV_setPlaybackRate(stream, 1);
+  }
+
   /* try to play */
   int playRet;
   if(stream->syncObj && stream->syncObj->play)
@@ -930,6 +2293,8 @@ int WV_playStream(WVStream* stream)
   else
     return -1;
 
+  playAudioTracks(stream);
+
   /* check playFlag */
   if(stream->playFlag == WV_LOOPING_PLAY){
     
@@ -949,6 +2314,12 @@ int WV_pauseStream(WVStream* stream)
   if(!stream)
     return -1;
 
+  /* in trick play, stop at the current position */
+  if(stream->playbackRate != 1){
+    stream->trickResumeFlag = 0;
+    return WV_setPlaybackRate(stream, 1);
+  }
+
   /* if the user provide master syncObj */
   /* check if the pause function is defined */
   if(stream->syncObj && !stream->syncObj->pause)
@@ -959,6 +2330,8 @@ int WV_pauseStream(WVStream* stream)
     stream->syncObj->pause(stream->syncObj);
   else if(stream->audioStreamHdl)
     WV_pauseAudio(stream->audioStreamHdl);
+
+  pauseAudioTracks(stream);
   
   return 0;
 }
@@ -969,6 +2342,10 @@ int WV_stopStream(WVStream* stream)
   /* check stream */
   if(!stream)
     return -1;
+
+  /* stop the trick play */
+  if(stream->playbackRate != 1)
+    WV_setPlaybackRate(stream, 1);
   
   /* pause stream */
   WV_pauseStream(stream);
@@ -981,20 +2358,20 @@ int WV_stopStream(WVStream* stream)
     return -1;
   
   /* prepare seek */
-  if(stream->audioStreamHdl)
-    WV_startAudioSeeking(stream->audioStreamHdl, WV_BLOCKING_SEEK);
+  startAudioTracksSeeking(stream, WV_BLOCKING_SEEK, UINT32_MAX);
       
   if(stream->videoStreamHdl)
-    WV_startVideoSeeking(stream->videoStreamHdl);
+    WV_startVideoSeeking(stream->videoStreamHdl, UINT32_MAX);
 
   /* packet feeder seek */
-  WV_contextSeek(stream->formatCtx, -1, 0, AVSEEK_FLAG_BACKWARD );
+  WV_contextSeek(stream->engine->feeder, stream->formatCtx, -1, 0, AVSEEK_FLAG_BACKWARD );
       
   /* master seek (audio or user) */
   if(stream->audioStreamHdl)
     WV_seekAudio(stream->audioStreamHdl);
   else if(stream->syncObj)
     stream->syncObj->seek(stream->syncObj, 0, WV_BLOCKING_SEEK);
+  seekAudioTracks(stream);
   
   /* slave seek */
   if(stream->videoStreamHdl)
@@ -1012,6 +2389,10 @@ int WV_rseekStream(WVStream* stream, uint32_t seekShift, int seekDirection)
   if(!stream)
     return -1;
 
+  /* stop the trick play */
+  if(stream->playbackRate != 1)
+    WV_setPlaybackRate(stream, 1);
+
   /* if the user provide master syncObj */
   /* check if the seek function is defined */
   if(!stream->audioStreamHdl && stream->syncObj && !stream->syncObj->seek)
@@ -1077,23 +2458,29 @@ int WV_rseekStream(WVStream* stream, uint32_t seekShift, int seekDirection)
     
   
   /* prepare seek */
-  if(stream->audioStreamHdl)
-    WV_startAudioSeeking(stream->audioStreamHdl, stream->seekFlag);
+  //accurate seek start exactly at the target clock
+  uint32_t accurateClock = UINT32_MAX;
+  if(stream->seekPrecisionFlag == WV_ACCURATE_SEEK)
+    accurateClock = targetClock;
+  
+  startAudioTracksSeeking(stream, stream->seekFlag, accurateClock);
       
   if(stream->videoStreamHdl)
-    WV_startVideoSeeking(stream->videoStreamHdl);
+    WV_startVideoSeeking(stream->videoStreamHdl, accurateClock);
 
   /* packet feeder seek */
-  if(seekDirection < 0)
-    WV_contextSeek(stream->formatCtx, -1, TBClock, AVSEEK_FLAG_BACKWARD);
+  //accurate seek need the keyframe before the target
+  if(seekDirection < 0 || accurateClock != UINT32_MAX)
+    WV_contextSeek(stream->engine->feeder, stream->formatCtx, -1, TBClock, AVSEEK_FLAG_BACKWARD);
   else
-    WV_contextSeek(stream->formatCtx, -1, TBClock, 0);
+    WV_contextSeek(stream->engine->feeder, stream->formatCtx, -1, TBClock, 0);
       
   /* master seek (audio or user) */
   if(stream->audioStreamHdl)
     WV_seekAudio(stream->audioStreamHdl);
   else if(stream->syncObj)
     stream->syncObj->seek(stream->syncObj, targetClock, stream->seekFlag);
+  seekAudioTracks(stream);
   
   /* slave seek */
   if(stream->videoStreamHdl)
@@ -1127,6 +2514,10 @@ uint32_t WV_getStreamClock(WVStream* stream)
 
   //sync objects always have a getRefClock
 
+  /* in trick play the video have its own clock */
+  if(stream->playbackRate != 1)
+    return WV_getVideoTrickClock(stream->videoStreamHdl);
+
   /* get clock */
   WVReferenceClock refClock;
   refClock.modIdx = 0;
@@ -1142,12 +2533,120 @@ uint32_t WV_getStreamClock(WVStream* stream)
   return refClock.clock;
 }
 
+uint64_t WV_getPresentClock(void)
+{
+  return WV_getEngineTime();
+}
+
+
+int WV_advanceVirtualTime(uint32_t delay)
+{
+  if(WV_addVirtualTime(delay) < 0)
+    return -1;
+
+  /* launch the due refreshs */
+  WV_wakeRefreshScheduler();
+
+  return 0;
+}
+
+
+int WV_presentEngineDue(WVEngine* engine, uint64_t now)
+{
+  /* check the video engine */
+  if(!engine || !engine->videoDecoder)
+    return 0;
+
+  /* present */
+  return WV_presentDueVideoFrames(engine->videoDecoder, now);
+}
+
+
+int WV_presentDue(uint64_t now)
+{
+  return WV_presentEngineDue(&defaultEngine, now);
+}
+
+
+int WV_acquireFrame(WVStream* stream, uint64_t now)
+{
+  /* check stream */
+  if(!stream || !stream->videoStreamHdl)
+    return -1;
+
+  /* present */
+  return WV_presentVideoFrame(stream->videoStreamHdl, now);
+}
+
+
+uint32_t WV_getDroppedFrames(WVStream* stream)
+{
+  /* check stream */
+  if(!stream || !stream->videoStreamHdl)
+    return 0;
+
+  /* get the count */
+  return WV_getVideoDroppedFrames(stream->videoStreamHdl);
+}
+
+
+uint32_t WV_getConversionTime(WVStream* stream)
+{
+  /* check stream */
+  if(!stream || !stream->videoStreamHdl)
+    return 0;
+
+  /* get the time */
+  return WV_getVideoConversionTime(stream->videoStreamHdl);
+}
+
+
+uint32_t WV_getSeekLatency(WVStream* stream)
+{
+  /* check stream */
+  if(!stream || !stream->videoStreamHdl)
+    return 0;
+
+  /* get the latency */
+  return WV_getVideoSeekLatency(stream->videoStreamHdl);
+}
+
+
+uint32_t WV_getStreamOpenTime(WVStream* stream)
+{
+  /* check stream */
+  if(!stream)
+    return 0;
+
+  return stream->openTime;
+}
+
+
+uint32_t WV_getFirstFrameLatency(WVStream* stream)
+{
+  /* check stream */
+  if(!stream || !stream->videoStreamHdl)
+    return 0;
+
+  /* check if the first frame is decoded */
+  uint64_t firstFrameTime = WV_getVideoFirstFrameTime(stream->videoStreamHdl);
+  if(!firstFrameTime)
+    return 0;
+  
+  return (uint32_t)(firstFrameTime - stream->loadStartTime);
+}
+
+
 int WV_seekStream(WVStream* stream, uint32_t clock)
 {
   /* check stream */
   if(!stream)
     return -1;
 
+  /* stop the trick play */
+  if(stream->playbackRate != 1)
+    WV_setPlaybackRate(stream, 1);
+
   /* if the user provide master syncObj */
   /* check if the seek function is defined */
   if(!stream->audioStreamHdl && stream->syncObj && !stream->syncObj->seek)
@@ -1183,23 +2682,29 @@ int WV_seekStream(WVStream* stream, uint32_t clock)
     
   
   /* prepare seek */
-  if(stream->audioStreamHdl)
-    WV_startAudioSeeking(stream->audioStreamHdl, stream->seekFlag);
+  //accurate seek start exactly at the target clock
+  uint32_t accurateClock = UINT32_MAX;
+  if(stream->seekPrecisionFlag == WV_ACCURATE_SEEK)
+    accurateClock = clock;
+  
+  startAudioTracksSeeking(stream, stream->seekFlag, accurateClock);
       
   if(stream->videoStreamHdl)
-    WV_startVideoSeeking(stream->videoStreamHdl);
+    WV_startVideoSeeking(stream->videoStreamHdl, accurateClock);
 
   /* packet feeder seek */
-  if(clock <= currentClock)
-    WV_contextSeek(stream->formatCtx, -1, TBClock, AVSEEK_FLAG_BACKWARD);
+  //accurate seek need the keyframe before the target
+  if(clock <= currentClock || accurateClock != UINT32_MAX)
+    WV_contextSeek(stream->engine->feeder, stream->formatCtx, -1, TBClock, AVSEEK_FLAG_BACKWARD);
   else
-    WV_contextSeek(stream->formatCtx, -1, TBClock, 0);
+    WV_contextSeek(stream->engine->feeder, stream->formatCtx, -1, TBClock, 0);
       
   /* master seek (audio or user) */
   if(stream->audioStreamHdl)
     WV_seekAudio(stream->audioStreamHdl);
   else if(stream->syncObj)
     stream->syncObj->seek(stream->syncObj, clock, stream->seekFlag);
+  seekAudioTracks(stream);
   
   /* slave seek */
   if(stream->videoStreamHdl)
@@ -1209,3 +2714,103 @@ int WV_seekStream(WVStream* stream, uint32_t clock)
 
 }
       
+
+
+
+int WV_setPlaybackRate(WVStream* stream, int rate)
+{
+  /* check stream */
+  if(!stream)
+    return -1;
+
+  /* check rate */
+  if(rate == 0 || rate > WV_TRICK_PLAY_MAX_RATE || rate < -WV_TRICK_PLAY_MAX_RATE)
+    return -1;
+
+  /* trick play need a loaded video */
+  if(!stream->videoStreamHdl)
+    return -1;
+
+  /* nothing to do */
+  if(rate == stream->playbackRate)
+    return 0;
+
+  /* normal play is resumed by a seek */
+  //so a user master syncObj without seek can't leave the trick play
+  if(!stream->audioStreamHdl && stream->syncObj && !stream->syncObj->seek)
+    return -1;
+
+  
+  /***************************/
+  /* get the current clock   */
+  /***************************/
+  uint32_t clock;
+  
+  if(stream->playbackRate == 1){
+    /* get ref clock */
+    WVReferenceClock refClock;
+    refClock.modIdx = 0;
+  
+    if(stream->syncObj)
+      stream->syncObj->getRefClock(stream->syncObj, &refClock);
+    else
+      refClock = WV_getAudioClock(stream->audioStreamHdl);
+
+    clock = refClock.clock;
+    stream->trickResumeFlag = !refClock.pauseFlag;
+
+    /* the master is paused, this mute the audio */
+    WV_pauseStream(stream);
+
+    /* and the audio pkts are not read */
+    setAudioTracksDiscard(stream, AVDISCARD_ALL);
+  }
+  else{
+    clock = WV_getVideoTrickClock(stream->videoStreamHdl);
+  }
+
+  
+  /**********************/
+  /* set the video rate */
+  /**********************/
+  stream->playbackRate = rate;
+  WV_setVideoTrickRate(stream->videoStreamHdl, rate, clock, \
+		       stream->engine->feeder, stream->formatCtx, stream->videoStreamIdx);
+
+  if(rate != 1)
+    return 0;
+
+  
+  /*************************/
+  /* back to normal play   */
+  /*************************/
+  setAudioTracksDiscard(stream, AVDISCARD_DEFAULT);
+
+  /* resync all the streams at the trick position */
+  int seekFlag = stream->seekFlag;
+  stream->seekFlag = WV_BLOCKING_SEEK;
+  WV_seekStream(stream, clock);
+  stream->seekFlag = seekFlag;
+
+  /* restart the master */
+  if(stream->trickResumeFlag){
+    if(stream->syncObj && stream->syncObj->play)
+      stream->syncObj->play(stream->syncObj);
+    else if(stream->audioStreamHdl)
+      WV_playAudio(stream->audioStreamHdl);
+
+    playAudioTracks(stream);
+  }
+  
+  return 0;
+}
+
+
+int WV_getPlaybackRate(WVStream* stream)
+{
+  /* check stream */
+  if(!stream)
+    return 0;
+
+  return stream->playbackRate;
+}
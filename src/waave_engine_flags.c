@@ -32,15 +32,17 @@
 
 int dynamic_wv_refresh_event = 0; 
 int dynamic_wv_eof_event = 0;
+int dynamic_wv_stream_ready_event = 0;
 
 void initWaaveEngineFlags(void)
 {
-  if(!dynamic_wv_refresh_event || !dynamic_wv_eof_event){
-    uint32_t baseEvent = SDL_RegisterEvents(2);
+  if(!dynamic_wv_refresh_event || !dynamic_wv_eof_event || !dynamic_wv_stream_ready_event){
+    uint32_t baseEvent = SDL_RegisterEvents(3);
 
     if(baseEvent != UINT32_MAX){
       dynamic_wv_refresh_event = baseEvent;
       dynamic_wv_eof_event = baseEvent + 1;
+      dynamic_wv_stream_ready_event = baseEvent + 2;
     }
   }
 
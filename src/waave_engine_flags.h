@@ -25,6 +25,31 @@
 #include "config_sdl.h"
 
 
+/***************/
+/* THE ENGINES */
+/***************/
+
+//the maximum number of simultaneous engines
+//each engine has its own feeder and decoder threads
+#define WV_MAX_ENGINES 4
+
+
+/********************/
+/* THE TASK RUNTIME */
+/********************/
+
+//the default number of workers shared by the engines
+//with SDL 2 the default is one worker per cpu
+#define WV_TASK_RUNTIME_WORKERS 4
+
+//the maximum number of workers
+#define WV_TASK_RUNTIME_MAX_WORKERS 16
+
+//the size of a worker deque, for each priority
+//a task submitted to a full deque is called immediately
+#define WV_TASK_RUNTIME_QUEUE_SIZE 64
+
+
 /*********************/
 /* THE PACKET FEEDER */
 /*********************/
@@ -37,6 +62,12 @@
 //the maximum number of simultaneous context 
 #define WV_PACKET_FEEDER_MAX_CONTEXT 10
 
+//the loop cache keep the pkts of the files smaller than this (bytes)
+#define WV_LOOP_CACHE_MAX_FILE_SIZE (16*1024*1024)
+
+//and all the cached pkts take less than this (bytes)
+#define WV_LOOP_CACHE_MAX_SIZE (64*1024*1024)
+
 
 /*********************/
 /* THE AUDIO DECODER */
@@ -67,6 +98,10 @@
 /* the maximum number of simultaneous loaded audio streams */
 #define WV_AUDIO_DECODER_MAX_STREAMS 30
 
+/* the maximum number of audio tracks */
+/* a stream can load from one file */
+#define WV_MAX_AUDIO_TRACKS 8
+
 
 
 /*********************/
@@ -96,6 +131,12 @@ extern int dynamic_wv_refresh_event;  //dynamic, see waave_engine_flags.c
 
 #endif
 
+/* the WV_REFRESH_EVENT code that commit the gapless splices */
+#define WV_SPLICE_REFRESH_CODE 2
+
+/* the WV_REFRESH_EVENT code that finish the async video loads */
+#define WV_LOAD_REFRESH_CODE 3
+
 /* the decoder store refresh durations for A/V sync */
 /* and filter it with a median filter */
 #define WV_REFRESH_DURATION_LIST_SIZE 3
@@ -105,11 +146,103 @@ extern int dynamic_wv_refresh_event;  //dynamic, see waave_engine_flags.c
 /* the ffmpeg filter used to scale video frames */
 #define WV_VIDEO_DECODER_SCALE_FILTER SWS_BICUBIC
 
+/* the slice scaler */
+//the maximum number of slices of a frame, converted in parallel by the task runtime
+#define WV_SLICE_SCALER_MAX_SLICES 4
+//the slice boundaries are aligned on this number of lines (chroma lines and dither patterns)
+#define WV_SLICE_SCALER_ALIGN 8
+//the minimum number of lines of a slice
+#define WV_SLICE_SCALER_MIN_HEIGHT 64
+
+/* the maximum libavcodec threads of each video stream */
+//the task runtime already decode the streams in parallel, so the codec
+//threads are also limited to the number of task workers
+#define WV_VIDEO_DECODER_CODEC_THREADS 2
+//frame threading need the codec delay, slice threading don't
+#define WV_VIDEO_DECODER_THREAD_TYPE (FF_THREAD_FRAME | FF_THREAD_SLICE)
+
 /* the maximum number of simultaneous loaded video streams */
 #define WV_VIDEO_DECODER_MAX_STREAMS 30
 
-/* the sdl granularity */
-#define WV_TIMER_GRANULARITY 10
+/* the refresh scheduler */
+//the maximum number of scheduled refreshs, one per stream
+//the scheduler is shared by all the engines
+#define WV_REFRESH_SCHEDULER_MAX_ENTRIES (WV_VIDEO_DECODER_MAX_STREAMS * WV_MAX_ENGINES)
+//the number of sleeps used to measure the system sleep precision
+#define WV_REFRESH_SCHEDULER_CALIBRATION_LOOPS 10
+//the scheduler spin before the due time, the spin delay is between (us)
+#define WV_REFRESH_SCHEDULER_MIN_SPIN 500
+#define WV_REFRESH_SCHEDULER_MAX_SPIN 20000
+
+/* catch-up policy when the video fall behind the clock */
+//a decoded frame is late when the clock is after its pts + this margin (ms)
+#define WV_VIDEO_DECODER_LATE_THRESHOLD 40
+//the number of consecutive late frames before discarding more frames in the codec
+#define WV_VIDEO_DECODER_CATCH_UP_STEP 4
+//the number of consecutive in time frames before going back to a better quality
+#define WV_VIDEO_DECODER_RESYNC_STEP 8
+//the maximum number of consecutive dropped frames, after that a late frame is displayed
+#define WV_VIDEO_DECODER_MAX_DROP_SEQUENCE 12
+
+/* trick play */
+//the maximum fast forward and rewind rate
+#define WV_TRICK_PLAY_MAX_RATE 32
+//up to this rate all the frames are decoded and the late ones dropped
+//above, and for rewind, only the keyframes are decoded
+#define WV_TRICK_PLAY_DROP_MAX_RATE 4
+//the keyframe stepping seek when a keyframe is late by this real time (ms)
+#define WV_TRICK_PLAY_STEP_DELAY 100
+
+/* frame cache */
+//the cached frames of one looping stream take less than this (bytes)
+#define WV_FRAME_CACHE_MAX_STREAM_SIZE (32*1024*1024)
+//and all the cached frames of all the engines take less than this (bytes)
+#define WV_FRAME_CACHE_MAX_SIZE (128*1024*1024)
+
+/* the thumbnail extractor */
+//the maximum number of threads extracting thumbnails in parallel
+#define WV_THUMBNAIL_WORKERS 4
+//the maximum number of packets read to find a keyframe
+#define WV_THUMBNAIL_MAX_PACKETS 256
+
+/* the stream loader */
+//the number of threads opening and loading the streams in parallel
+#define WV_STREAM_LOADER_WORKERS 4
+
+/* the probe cache */
+//the maximum number of cached files, the oldest are dropped
+#define WV_PROBE_CACHE_MAX_ENTRIES 1024
+//the bounds of the entries read from the cache file
+#define WV_PROBE_CACHE_MAX_STREAMS 64
+#define WV_PROBE_CACHE_MAX_NAME_SIZE 4096
+#define WV_PROBE_CACHE_MAX_EXTRADATA_SIZE (1024*1024)
+
+
+/*************************/
+/* THE STREAMING OBJECTS */
+/*************************/
+
+/* the maximum number of formats accepted by a streaming object */
+#define WV_STREAMING_MAX_FORMATS 8
+
+/* the slots of the memory objects */
+#define WV_STREAM_MEMORY_DEFAULT_SLOTS 3
+#define WV_STREAM_MEMORY_MAX_SLOTS 16
+
+/* the format negotiation costs */
+//convert between two YUV or two RGB formats
+#define WV_NEGOTIATION_REPACK_COST 2
+//convert between YUV and RGB
+#define WV_NEGOTIATION_COLOR_COST 4
+//scale the frame
+#define WV_NEGOTIATION_SCALE_COST 4
+
+/* the maximum number of streams rendered by a renderer compositor */
+#define WV_RENDERER_COMPOSITOR_MAX_TILES WV_VIDEO_DECODER_MAX_STREAMS
+
+/* the maximum number of rects updated in one time by the surface objects */
+//if more streams are refreshed the rects are merged
+#define WV_STREAM_SURFACE_MAX_UPDATE_RECTS WV_VIDEO_DECODER_MAX_STREAMS
 
 
 /**************/
@@ -127,6 +260,21 @@ extern int dynamic_wv_eof_event;  //dynamic, see waave_engine_flags.c
 #endif
 
 
+/************************/
+/* SIGNAL STREAM READY  */
+/************************/
+#if SDL_VERSION_ATLEAST(2,0,0)
+
+extern int dynamic_wv_stream_ready_event;  //dynamic, see waave_engine_flags.c
+#define WV_STREAM_READY_EVENT dynamic_wv_stream_ready_event
+
+#else
+
+#define WV_STREAM_READY_EVENT SDL_NUMEVENTS - 3
+
+#endif
+
+
 /**********/
 /* VOLUME */
 /**********/
@@ -27,6 +27,7 @@
 #include "common.h"
 #include "config_ffmpeg.h"
 
+#include "config_sdl.h"
 #include "waave_engine_flags.h"
 
 #if !HAVE_AUDIO_DECODE_RESAMPLE && HAVE_LIBAVCODEC_AUDIOCONVERT_H
@@ -52,6 +53,73 @@ int WV_findBestStream(AVFormatContext* formatCtx, int type)
 
 
 
+/***********************/
+/*       AVCODEC       */
+/***********************/
+#if HAVE_AV_LOCKMGR_REGISTER
+
+/* ffmpeg lock its global state with SDL mutex */
+static int lockManager(void** mutex, enum AVLockOp op)
+{
+  switch(op){
+    
+  case AV_LOCK_CREATE :
+    *mutex = (void*)SDL_CreateMutex();
+    return (*mutex)? 0 : 1;
+
+  case AV_LOCK_OBTAIN :
+    return (SDL_mutexP((SDL_mutex*)*mutex) < 0)? 1 : 0;
+
+  case AV_LOCK_RELEASE :
+    return (SDL_mutexV((SDL_mutex*)*mutex) < 0)? 1 : 0;
+
+  case AV_LOCK_DESTROY :
+    SDL_DestroyMutex((SDL_mutex*)*mutex);
+    *mutex = NULL;
+    return 0;
+  }
+
+  return 1;
+}
+
+#endif
+
+
+/* say if our lock manager is registered */
+static int ffmpegLockedFlag = 0;
+
+
+int WV_initFFmpegLock(void)
+{
+#if HAVE_AV_LOCKMGR_REGISTER
+  if(av_lockmgr_register(&lockManager) < 0)
+    return -1;
+
+  ffmpegLockedFlag = 1;
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+
+void WV_closeFFmpegLock(void)
+{
+#if HAVE_AV_LOCKMGR_REGISTER
+  av_lockmgr_register(NULL);
+  ffmpegLockedFlag = 0;
+#endif
+}
+
+
+int WV_isFFmpegLocked(void)
+{
+  return ffmpegLockedFlag;
+}
+
+
+
+
 /************************/
 /*    AVCODEC video     */
 /************************/
@@ -99,6 +167,102 @@ int64_t WV_getFramePts(AVFrame* frame)
 } 
 
 
+/* keep decoded frames without converting them */
+void WV_initNativeFrame(WVNativeFrame* nativeFrame)
+{
+  nativeFrame->width = 0;
+  nativeFrame->height = 0;
+  nativeFrame->format = PIX_FMT_NONE;
+
+#if HAVE_AV_FRAME_REF
+  nativeFrame->refFrame = av_frame_alloc();
+#else
+  nativeFrame->allocWidth = 0;
+  nativeFrame->allocHeight = 0;
+  nativeFrame->allocFormat = PIX_FMT_NONE;
+  nativeFrame->allocFlag = 0;
+#endif
+}
+
+
+/* !!! the decoded frame is not valid after the next decode !!! */
+/* so we take a reference or we copy it */
+int WV_keepNativeFrame(WVNativeFrame* nativeFrame, AVCodecContext* codecCtx, AVFrame* decodedFrame)
+{
+  int i;
+  
+  nativeFrame->width = codecCtx->width;
+  nativeFrame->height = codecCtx->height;
+  nativeFrame->format = codecCtx->pix_fmt;
+
+#if HAVE_AV_FRAME_REF
+  /* reference the decoder buffers */
+  av_frame_unref(nativeFrame->refFrame);
+  if(av_frame_ref(nativeFrame->refFrame, decodedFrame) < 0)
+    return -1;
+
+  for(i=0; i<4; i++){
+    nativeFrame->data[i] = nativeFrame->refFrame->data[i];
+    nativeFrame->linesize[i] = nativeFrame->refFrame->linesize[i];
+  }
+#else
+  /* realloc the picture if the size or the format change */
+  if(!nativeFrame->allocFlag ||					\
+     nativeFrame->allocWidth != nativeFrame->width ||		\
+     nativeFrame->allocHeight != nativeFrame->height ||		\
+     nativeFrame->allocFormat != nativeFrame->format){
+
+    if(nativeFrame->allocFlag)
+      avpicture_free(&nativeFrame->picture);
+    nativeFrame->allocFlag = 0;
+
+    if(avpicture_alloc(&nativeFrame->picture, nativeFrame->format, nativeFrame->width, nativeFrame->height) < 0)
+      return -1;
+
+    nativeFrame->allocFlag = 1;
+    nativeFrame->allocWidth = nativeFrame->width;
+    nativeFrame->allocHeight = nativeFrame->height;
+    nativeFrame->allocFormat = nativeFrame->format;
+  }
+
+  /* copy */
+  av_picture_copy(&nativeFrame->picture, (const AVPicture*)decodedFrame,	\
+		  nativeFrame->format, nativeFrame->width, nativeFrame->height);
+
+  for(i=0; i<4; i++){
+    nativeFrame->data[i] = nativeFrame->picture.data[i];
+    nativeFrame->linesize[i] = nativeFrame->picture.linesize[i];
+  }
+#endif
+
+  return 0;
+}
+
+
+/* the frame is no longer needed */
+void WV_releaseNativeFrame(WVNativeFrame* nativeFrame)
+{
+#if HAVE_AV_FRAME_REF
+  av_frame_unref(nativeFrame->refFrame);
+#else
+  //the picture is kept for the next frame
+#endif
+}
+
+
+void WV_freeNativeFrame(WVNativeFrame* nativeFrame)
+{
+#if HAVE_AV_FRAME_REF
+  av_frame_free(&nativeFrame->refFrame);
+#else
+  if(nativeFrame->allocFlag)
+    avpicture_free(&nativeFrame->picture);
+  nativeFrame->allocFlag = 0;
+#endif
+}
+
+
+
 /************************/
 /*   AVCODEC audio      */
 /************************/
@@ -88,6 +88,20 @@ int WV_findBestStream(AVFormatContext* formatCtx, int type);
 #define avcodec_open2(codecCtx, codec,  options)  avcodec_open(codecCtx, codec)
 #endif
 
+#ifndef AV_PKT_FLAG_KEY
+#define AV_PKT_FLAG_KEY PKT_FLAG_KEY
+#endif
+
+
+/* let the codecs be opened by several threads */
+//!!! without av_lockmgr_register the codecs need to be opened by one thread !!!
+int WV_initFFmpegLock(void);
+void WV_closeFFmpegLock(void);
+
+/* 1 if the lock manager is registered, so the codecs */
+/* can be opened in parallel */
+int WV_isFFmpegLocked(void);
+
 
 
 /************************/
@@ -104,6 +118,34 @@ int WV_decodeVideo(AVCodecContext* codecCtx, AVFrame* frame, int* got_picture, A
 int64_t WV_getFramePts(AVFrame* frame);
 
 
+/* a decoded frame kept in the codec pixel format */
+/* refcounted when possible, else copied */
+typedef struct WVNativeFrame{
+  
+  uint8_t* data[4];
+  int linesize[4];
+  int width;
+  int height;
+  enum PixelFormat format;
+
+#if HAVE_AV_FRAME_REF
+  AVFrame* refFrame;       //hold the reference on the decoder buffers
+#else
+  AVPicture picture;       //the copy of the decoded frame
+  int allocWidth;
+  int allocHeight;
+  enum PixelFormat allocFormat;
+  int allocFlag;
+#endif
+
+}WVNativeFrame;
+
+void WV_initNativeFrame(WVNativeFrame* nativeFrame);
+int WV_keepNativeFrame(WVNativeFrame* nativeFrame, AVCodecContext* codecCtx, AVFrame* decodedFrame);
+void WV_releaseNativeFrame(WVNativeFrame* nativeFrame);
+void WV_freeNativeFrame(WVNativeFrame* nativeFrame);
+
+
 
 
 /************************/
@@ -49,6 +49,10 @@
 #define WV_SEEK_BACKWARD -1
 #define WV_SEEK_FORWARD 1
 
+/* the seek precision */
+#define WV_FAST_SEEK 0       //restart at the keyframe before the target
+#define WV_ACCURATE_SEEK 1   //restart exactly at the target
+
 /* the signal eof type */
 //no signal
 #define WV_NO_EOF_SIGNAL 0
@@ -61,10 +65,48 @@
 
 
 
+/* an audio track of the file */
+/* all the tracks share the same format and feeder context */
+typedef struct WVAudioTrack{
+  int streamIdx;                  //the ffmpeg stream
+  int loadFlag;                   //the track is loaded with the stream
+  int activeFlag;                 //the inactive tracks are paused and discarded by the demuxer
+  double volume;                  //multiplied by the stream volume
+
+  AVCodecContext* codecCtx;
+  AVCodec* codec;
+  WVQueueHandle queueHdl;         //the packet feeder queue
+  WVAudioStreamHandle streamHdl;  //the audio decoder handle, NULL if not loaded
+}WVAudioTrack;
+
+
+/* an engine own a packet feeder and the decoders */
+/* each with its own thread, the streams loaded in */
+/* an engine are decoded by its threads            */
+typedef struct WVEngine{
+  int flag;                           //the started decoders, WAAVE_INIT_AUDIO|WAAVE_INIT_VIDEO
+  WVPacketFeederHandle feeder;        //NULL if not started
+  WVAudioDecoderHandle audioDecoder;
+  WVVideoDecoderHandle videoDecoder;
+
+  /* the streams can be added by the loader workers */
+  /* protect the engine while adding or deleting streams */
+  SDL_mutex* engineMutex;
+
+  /* the decoders signal the splices from their threads */
+  //they can't take the engineMutex, it is held when deleting streams
+  SDL_mutex* spliceMutex;
+}WVEngine;
+
+
 /* to signal eof */
 struct WVStream;
 typedef  int (*WVEOFSignalCall)(struct WVStream* stream, void* param);
 
+/* the asynchronous open/load signal */
+//status is 0 if the stream is ready, -1 otherwise
+typedef  int (*WVStreamReadyCall)(struct WVStream* stream, int status, void* param);
+
 /* the main waave struct */
 typedef struct WVStream{
   
@@ -78,6 +120,7 @@ typedef struct WVStream{
 
   /* the WAAVE objects */
   WVStreamingObject* streamObj;  //how stream the video
+  WVStreamingObject* fanoutObj;  //created by WV_addStreamingMethod, freed with the stream
   WVSyncObject* syncObj;         //how sync audio/video
   int userSyncFlag;              //say the the user give the sync object 
 
@@ -87,6 +130,13 @@ typedef struct WVStream{
   WVQueueHandle audioQueueHdl;        //the packet feeder queue
   WVAudioStreamHandle audioStreamHdl; //the audio decoder handle
   
+  /* the audio tracks */
+  /* the audio instance above is the master track */
+  /* it give the clock and signal eof */
+  int nbAudioTracks;
+  int masterTrack;
+  WVAudioTrack audioTracks[WV_MAX_AUDIO_TRACKS];
+  
 
   /* the video instance */
   AVCodecContext* videoCodecCtx;
@@ -109,13 +159,39 @@ typedef struct WVStream{
   /* stream flags */
   int loopingFlag;   //at stream end continue playing ? WV_BLOCKING_STREAM or WV_LOOPING_STREAM
   int seekFlag; //at seek, preserve pause or restart playing ? WV_PLAYING_SEEK or WV_BLOCKING_SEEK
+  int seekPrecisionFlag; //seek to the keyframe or to the exact clock ? WV_FAST_SEEK or WV_ACCURATE_SEEK
   int playFlag; //when play is useless, go to the beginning ? WV_NEUTRAL_PLAY or WV_LOOPING_PLAY
+  int conversionFlag; //when convert the video frames ? WV_EARLY_CONVERSION or WV_LAZY_CONVERSION
+  int presentFlag; //how display the video frames ? WV_PUSH_PRESENT or WV_PULL_PRESENT
+  int conversionSlices; //in how many slices convert the video frames ? 1 by default
+  SDL_Rect cropRect; //the visible part of the video frames, w = 0 for the entire frames
+  int outputWidth;  //the size the video is displayed, 0 for the source size
+  int outputHeight; 
+  int loopCacheFlag; //keep the pkts in memory for the next loops ? WV_NO_LOOP_CACHE or WV_LOOP_CACHE
+  int frameCacheFlag; //keep the converted frames for the next loops ? WV_NO_FRAME_CACHE or WV_FRAME_CACHE
+
+  /* the engine that feed and decode the stream */
+  WVEngine* engine;
+
+  /* trick play */
+  int playbackRate;     //1 for normal play, 2 to 32 fast forward, negative to rewind
+  int trickResumeFlag;  //the stream was playing before the trick play
+
+  /* opening measures */
+  uint32_t openTime;        //the time taken to open and probe the file (us)
+  uint64_t loadStartTime;   //when the load was asked (us)
 
   /* eof signal */
   int eofSignalType;
   void* eofSignalParam;
   WVEOFSignalCall eofSignalCall;
 
+  /* gapless splice */
+  struct WVStream* nextStream;  //the preloaded next item, NULL if none
+  int spliceCount;              //the decoders that have not switched to it
+  int splicePendingFlag;        //all switched, the source swap waits for the main thread
+  struct WVStream* nextSplice;  //in the pending splice list
+
 }WVStream;
 
 #endif